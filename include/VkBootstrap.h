@@ -16,13 +16,18 @@
 
 #pragma once
 
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cstdio>
 #include <cstring>
 
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <string>
 #include <system_error>
+#include <unordered_map>
 
 #include <vulkan/vulkan.h>
 
@@ -189,6 +194,7 @@ enum class PhysicalDeviceError {
 	failed_enumerate_physical_devices,
 	no_physical_devices_found,
 	no_suitable_device,
+	failed_get_image_format_properties,
 };
 enum class QueueError {
 	present_unavailable,
@@ -200,6 +206,7 @@ enum class QueueError {
 };
 enum class DeviceError {
 	failed_create_device,
+	global_priority_not_permitted,
 };
 enum class SwapchainError {
 	surface_handle_not_provided,
@@ -208,6 +215,9 @@ enum class SwapchainError {
 	failed_get_swapchain_images,
 	failed_create_swapchain_image_views,
 	required_min_image_count_too_low,
+	present_timing_not_enabled,
+	failed_wait_for_present,
+	failed_get_presentation_timing,
 };
 
 std::error_code make_error_code(InstanceError instance_error);
@@ -454,9 +464,119 @@ VKAPI_ATTR VkBool32 VKAPI_CALL default_debug_callback(VkDebugUtilsMessageSeverit
 void destroy_debug_utils_messenger(
     VkInstance const instance, VkDebugUtilsMessengerEXT const messenger, VkAllocationCallbacks* allocation_callbacks = nullptr);
 
+// ---- Format Capabilities ---- //
+class FormatCapabilityTable;
+
+namespace detail {
+struct FormatCapabilityCache;
+FormatCapabilityTable const& get_format_capabilities(FormatCapabilityCache& cache);
+} // namespace detail
+
+// Snapshot of the format support of a physical device. The per-format properties are gathered once when the
+// table is built and are immutable afterwards, so lookups never reach the driver.
+class FormatCapabilityTable {
+	public:
+	// Returns the VkFormatProperties of `format`. Formats unknown to the table report no features.
+	VkFormatProperties get_format_properties(VkFormat format) const;
+#if defined(VKB_VK_API_VERSION_1_3)
+	// Returns the VkFormatProperties3 of `format`. When VK_KHR_format_feature_flags2 or Vulkan 1.3 isn't
+	// available the flags are widened from VkFormatProperties instead.
+	VkFormatProperties3 get_format_properties3(VkFormat format) const;
+#endif
+#if defined(VK_EXT_image_drm_format_modifier)
+	// Returns the DRM format modifiers of `format`. Always empty unless has_drm_format_modifiers() is true.
+	std::vector<VkDrmFormatModifierPropertiesEXT> const& get_drm_format_modifiers(VkFormat format) const;
+#endif
+
+	// Returns true if `format` supports all of `features` with the given image tiling.
+	bool supports_image_features(VkFormat format, VkImageTiling tiling, VkFormatFeatureFlags features) const;
+	// Returns true if `format` supports all of `features` when used in a buffer.
+	bool supports_buffer_features(VkFormat format, VkFormatFeatureFlags features) const;
+	// Returns the first format in `candidates` which supports `features` with the given image tiling.
+	// Returns VK_FORMAT_UNDEFINED if none of them do.
+	VkFormat find_supported_format(std::vector<VkFormat> const& candidates, VkImageTiling tiling, VkFormatFeatureFlags features) const;
+
+	// Returns the VkImageFormatProperties for the given image parameters.
+	// Results are memoized, so each combination only queries the driver once.
+	detail::Result<VkImageFormatProperties> get_image_format_properties(VkFormat format,
+	    VkImageType type,
+	    VkImageTiling tiling,
+	    VkImageUsageFlags usage,
+	    VkImageCreateFlags flags = 0) const;
+
+	// True if the table holds VkFormatProperties3 reported by the driver.
+	bool has_format_feature_flags2() const;
+	// True if the table holds the DRM format modifiers of each format.
+	bool has_drm_format_modifiers() const;
+
+	private:
+	struct Entry {
+		VkFormatProperties properties{};
+#if defined(VKB_VK_API_VERSION_1_3)
+		VkFormatProperties3 properties3{};
+#endif
+#if defined(VK_EXT_image_drm_format_modifier)
+		std::vector<VkDrmFormatModifierPropertiesEXT> drm_format_modifiers;
+#endif
+	};
+	struct ImageFormatKey {
+		VkFormat format;
+		VkImageType type;
+		VkImageTiling tiling;
+		VkImageUsageFlags usage;
+		VkImageCreateFlags flags;
+		bool operator==(ImageFormatKey const& other) const;
+	};
+	struct ImageFormatKeyHash {
+		size_t operator()(ImageFormatKey const& key) const;
+	};
+	struct ImageFormatResult {
+		VkResult result = VK_SUCCESS;
+		VkImageFormatProperties properties{};
+	};
+
+	void populate(detail::FormatCapabilityCache const& cache);
+	void query_entry(VkFormat format, Entry& entry) const;
+	Entry const* find_entry(VkFormat format) const;
+
+	VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+	bool use_properties2 = false;
+	bool use_khr_properties2 = false;
+	bool format_feature_flags2 = false;
+	bool drm_format_modifiers = false;
+	std::vector<Entry> entries;
+
+	mutable std::mutex image_format_mutex;
+	mutable std::unordered_map<ImageFormatKey, ImageFormatResult, ImageFormatKeyHash> image_format_properties;
+
+	friend FormatCapabilityTable const& detail::get_format_capabilities(detail::FormatCapabilityCache& cache);
+};
+
+namespace detail {
+// Shared by every copy of a PhysicalDevice (and the Device and SwapchainBuilder made from it) so the
+// table is built at most once per physical device, on first use.
+struct FormatCapabilityCache {
+	VkPhysicalDevice physical_device = VK_NULL_HANDLE;
+	uint32_t api_version = VKB_VK_API_VERSION_1_0;
+	bool supports_properties2 = false;
+	bool supports_properties2_ext = false;
+	bool supports_format_feature_flags2 = false;
+	bool query_drm_format_modifiers = false;
+
+	std::once_flag built;
+	FormatCapabilityTable table;
+};
+} // namespace detail
+
 // ---- Physical Device ---- //
+
+// The system wide priority of a queue relative to queues of other devices and processes, from VK_KHR_global_priority.
+// The values match VkQueueGlobalPriorityKHR. `unspecified` leaves the choice to the driver, which is usually medium.
+enum class QueueGlobalPriority : uint32_t { unspecified = 0, low = 128, medium = 256, high = 512, realtime = 1024 };
+
 class PhysicalDeviceSelector;
 class DeviceBuilder;
+class SwapchainBuilder;
 
 struct PhysicalDevice {
 	std::string name;
@@ -484,6 +604,16 @@ struct PhysicalDevice {
 	// Query the list of extensions which should be enabled
 	std::vector<std::string> get_extensions() const;
 
+	// Whether queues can be created with a global priority, through VK_KHR_global_priority or VK_EXT_global_priority.
+	bool supports_global_priority() const;
+	// The global priorities queues of a family may be created with. Empty when the device cannot report them,
+	// in which case any priority may be requested and the driver decides when the device is created.
+	std::vector<QueueGlobalPriority> get_queue_family_global_priorities(uint32_t family_index) const;
+
+	// Get the format capabilities of the device. The table is built the first time this is called
+	// and shared by every copy of this PhysicalDevice, so it is cheap to call repeatedly.
+	FormatCapabilityTable const& get_format_capabilities() const;
+
 	// A conversion function which allows this PhysicalDevice to be used
 	// in places where VkPhysicalDevice would have been used.
 	operator VkPhysicalDevice() const;
@@ -499,10 +629,19 @@ struct PhysicalDevice {
 	VkPhysicalDeviceFeatures2KHR features2{};
 #endif
 	bool defer_surface_initialization = false;
+	struct {
+		bool present_id = false;
+		bool present_wait = false;
+		bool display_timing = false;
+	} present_timing;
+	const char* global_priority_extension = nullptr;
+	std::vector<std::vector<QueueGlobalPriority>> queue_family_global_priorities;
+	std::shared_ptr<detail::FormatCapabilityCache> format_capability_cache = std::make_shared<detail::FormatCapabilityCache>();
 	enum class Suitable { yes, partial, no };
 	Suitable suitable = Suitable::yes;
 	friend class PhysicalDeviceSelector;
 	friend class DeviceBuilder;
+	friend class SwapchainBuilder;
 };
 
 enum class PreferredDeviceType { other = 0, integrated = 1, discrete = 2, virtual_gpu = 3, cpu = 4 };
@@ -616,6 +755,15 @@ class PhysicalDeviceSelector {
 	// Only use when: The first gpu in the list may be set by global user preferences and an application may wish to respect it.
 	PhysicalDeviceSelector& select_first_device_unconditionally(bool unconditionally = true);
 
+	// Include the DRM format modifiers of each format in the FormatCapabilityTable of the selected device.
+	// Only has an effect on devices supporting VK_EXT_image_drm_format_modifier. Defaults to false.
+	PhysicalDeviceSelector& gather_drm_format_modifiers(bool gather = true);
+
+	// Enable VK_KHR_present_id, VK_KHR_present_wait and VK_GOOGLE_display_timing along with their
+	// features on the selected device, for each one that is available. Missing support does not make a device unsuitable.
+	// Use SwapchainBuilder::enable_present_timing() to make use of them.
+	PhysicalDeviceSelector& enable_present_timing(bool enable = true);
+
 	private:
 	struct InstanceInfo {
 		VkInstance instance = VK_NULL_HANDLE;
@@ -654,6 +802,8 @@ class PhysicalDeviceSelector {
 		bool defer_surface_initialization = false;
 		bool use_first_gpu_unconditionally = false;
 		bool enable_portability_subset = true;
+		bool gather_drm_format_modifiers = false;
+		bool enable_present_timing = false;
 	} criteria;
 
 	PhysicalDevice populate_device_details(VkPhysicalDevice phys_device,
@@ -670,8 +820,73 @@ enum class QueueType { present, graphics, compute, transfer };
 namespace detail {
 // Sentinel value, used in implementation only
 const uint32_t QUEUE_INDEX_MAX_VALUE = 65536;
+
+// The lock and statistics shared by every QueueHandle referring to the same VkQueue
+struct QueueSyncState {
+	VkQueue queue = VK_NULL_HANDLE;
+	uint32_t family_index = 0;
+	uint32_t queue_index = 0;
+	PFN_vkQueueSubmit fp_vkQueueSubmit = nullptr;
+	PFN_vkQueuePresentKHR fp_vkQueuePresentKHR = nullptr;
+	PFN_vkQueueWaitIdle fp_vkQueueWaitIdle = nullptr;
+
+	std::mutex mutex;
+	std::atomic<uint64_t> lock_count{ 0 };
+	std::atomic<uint64_t> contended_count{ 0 };
+	std::atomic<uint64_t> total_wait_ns{ 0 };
+	std::atomic<uint64_t> max_wait_ns{ 0 };
+
+	std::unique_lock<std::mutex> lock();
+};
+struct QueueRegistry;
 } // namespace detail
 
+// How often the lock of a queue was taken, and how much time was lost waiting for it
+struct QueueContentionStats {
+	uint64_t lock_count = 0;
+	// The number of times the lock was already held by another thread
+	uint64_t contended_count = 0;
+	uint64_t total_wait_ns = 0;
+	uint64_t max_wait_ns = 0;
+};
+
+// A VkQueue along with the lock Vulkan requires around vkQueueSubmit, vkQueuePresentKHR and friends.
+// Every QueueHandle obtained from a Device for the same VkQueue shares one lock, even when the queue was asked for
+// as different QueueTypes, while handles for different VkQueues never wait on each other.
+class QueueHandle {
+	public:
+	QueueHandle() = default;
+
+	VkQueue get_queue() const;
+	uint32_t get_family_index() const;
+	uint32_t get_queue_index() const;
+
+	// Externally synchronized wrappers of vkQueueSubmit, vkQueuePresentKHR and vkQueueWaitIdle.
+	// A default constructed QueueHandle has no queue, so these return VK_ERROR_INITIALIZATION_FAILED.
+	VkResult submit(uint32_t submit_count, const VkSubmitInfo* submits, VkFence fence = VK_NULL_HANDLE) const;
+	VkResult present(VkPresentInfoKHR const& present_info) const;
+	VkResult wait_idle() const;
+
+	// Call `func` with the VkQueue while holding its lock, for queue operations not wrapped above
+	// (vkQueueSubmit2, vkQueueBindSparse, debug labels, ...). Returns whatever `func` returns.
+	template <typename F> auto with_lock(F&& func) const -> decltype(func(VkQueue{})) {
+		assert(state != nullptr && "QueueHandle must be obtained from a Device");
+		auto lock = state->lock();
+		return func(state->queue);
+	}
+
+	QueueContentionStats get_contention_stats() const;
+
+	// A conversion function which allows this QueueHandle to be used
+	// in places where VkQueue would have been used.
+	operator VkQueue() const;
+
+	private:
+	explicit QueueHandle(std::shared_ptr<detail::QueueSyncState> state);
+	std::shared_ptr<detail::QueueSyncState> state;
+	friend struct Device;
+};
+
 // ---- Device ---- //
 
 struct Device {
@@ -690,6 +905,17 @@ struct Device {
 	// Only a compute or transfer queue type is valid. All other queue types do not support a 'dedicated' queue
 	detail::Result<VkQueue> get_dedicated_queue(QueueType type) const;
 
+	// Like get_queue and get_dedicated_queue, but return a QueueHandle which makes submitting and presenting thread safe.
+	detail::Result<QueueHandle> get_queue_handle(QueueType type) const;
+	detail::Result<QueueHandle> get_dedicated_queue_handle(QueueType type) const;
+	// For custom queue setups: the QueueHandle of queue `queue_index` in family `family_index`.
+	// The queue must have been requested when the device was created, otherwise queue_index_out_of_range is returned.
+	detail::Result<QueueHandle> get_queue_handle(uint32_t family_index, uint32_t queue_index) const;
+
+	// The global priority the queues of a family were created with. This may be lower than requested when the
+	// driver refused the requested priority. `unspecified` when no priority was requested for the family.
+	QueueGlobalPriority get_queue_global_priority(uint32_t family_index) const;
+
 	// Return a loaded dispatch table
 	DispatchTable make_table() const;
 
@@ -701,7 +927,14 @@ struct Device {
 	struct {
 		PFN_vkGetDeviceQueue fp_vkGetDeviceQueue = nullptr;
 		PFN_vkDestroyDevice fp_vkDestroyDevice = nullptr;
+		PFN_vkQueueSubmit fp_vkQueueSubmit = nullptr;
+		PFN_vkQueuePresentKHR fp_vkQueuePresentKHR = nullptr;
+		PFN_vkQueueWaitIdle fp_vkQueueWaitIdle = nullptr;
 	} internal_table;
+	std::shared_ptr<detail::QueueRegistry> queue_registry;
+	std::vector<QueueGlobalPriority> queue_global_priorities;
+	// Number of queues of each family requested at device creation, which may be less than its queueCount
+	std::vector<uint32_t> created_queue_counts;
 	friend class DeviceBuilder;
 	friend void destroy_device(Device device);
 };
@@ -709,9 +942,14 @@ struct Device {
 // For advanced device queue setup
 struct CustomQueueDescription {
 	explicit CustomQueueDescription(uint32_t index, uint32_t count, std::vector<float> priorities);
+	// Request a global priority for the queues of the family. If the device can't grant it, a lower priority is
+	// used instead, see Device::get_queue_global_priority.
+	explicit CustomQueueDescription(
+	    uint32_t index, uint32_t count, std::vector<float> priorities, QueueGlobalPriority global_priority);
 	uint32_t index = 0;
 	uint32_t count = 0;
 	std::vector<float> priorities;
+	QueueGlobalPriority global_priority = QueueGlobalPriority::unspecified;
 };
 
 void destroy_device(Device device);
@@ -769,6 +1007,22 @@ struct Swapchain {
 	detail::Result<std::vector<VkImageView>> get_image_views(const void* pNext);
 	void destroy_image_views(std::vector<VkImageView> const& image_views);
 
+	// Whether presents on this swapchain may carry a VkPresentIdKHR, wait on one, or carry VkPresentTimesInfoGOOGLE.
+	// Only set when the swapchain was built with SwapchainBuilder::enable_present_timing().
+	bool present_id_enabled = false;
+	bool present_wait_enabled = false;
+	bool display_timing_enabled = false;
+
+	// Wait until the present with the given VkPresentIdKHR value has been displayed.
+	// Returns true once it has, or false if `timeout` nanoseconds passed first.
+	detail::Result<bool> wait_for_present(uint64_t present_id, uint64_t timeout = UINT64_MAX) const;
+	// Returns the duration in nanoseconds of a refresh cycle of the display.
+	detail::Result<uint64_t> get_refresh_cycle_duration() const;
+#if defined(VK_GOOGLE_display_timing)
+	// Returns the timing of presents which completed since the last call.
+	detail::Result<std::vector<VkPastPresentationTimingGOOGLE>> get_past_presentation_timing() const;
+#endif
+
 	// A conversion function which allows this Swapchain to be used
 	// in places where VkSwapchainKHR would have been used.
 	operator VkSwapchainKHR() const;
@@ -779,6 +1033,13 @@ struct Swapchain {
 		PFN_vkCreateImageView fp_vkCreateImageView = nullptr;
 		PFN_vkDestroyImageView fp_vkDestroyImageView = nullptr;
 		PFN_vkDestroySwapchainKHR fp_vkDestroySwapchainKHR = nullptr;
+#if defined(VK_KHR_present_wait)
+		PFN_vkWaitForPresentKHR fp_vkWaitForPresentKHR = nullptr;
+#endif
+#if defined(VK_GOOGLE_display_timing)
+		PFN_vkGetRefreshCycleDurationGOOGLE fp_vkGetRefreshCycleDurationGOOGLE = nullptr;
+		PFN_vkGetPastPresentationTimingGOOGLE fp_vkGetPastPresentationTimingGOOGLE = nullptr;
+#endif
 	} internal_table;
 	friend class SwapchainBuilder;
 	friend void destroy_swapchain(Swapchain const& swapchain);
@@ -786,6 +1047,8 @@ struct Swapchain {
 
 void destroy_swapchain(Swapchain const& swapchain);
 
+class SwapchainTuner;
+
 class SwapchainBuilder {
 	public:
 	// Construct a SwapchainBuilder with a `vkb::Device`
@@ -893,6 +1156,15 @@ class SwapchainBuilder {
 	// Provide custom allocation callbacks.
 	SwapchainBuilder& set_allocation_callbacks(VkAllocationCallbacks* callbacks);
 
+	// Make the present timing extensions enabled by PhysicalDeviceSelector::enable_present_timing() usable
+	// on the swapchain. Only has an effect when the builder was constructed with a `vkb::Device`.
+	SwapchainBuilder& enable_present_timing(bool enable = true);
+
+	// Let `tuner` pick the present mode and image count. Until the tuner has measured enough frames to
+	// decide, the desired present modes and image count of this builder are used.
+	// The tuner must be valid when SwapchainBuilder::build() is called.
+	SwapchainBuilder& set_tuner(SwapchainTuner* tuner);
+
 	private:
 	void add_desired_formats(std::vector<VkSurfaceFormatKHR>& formats) const;
 	void add_desired_present_modes(std::vector<VkPresentModeKHR>& modes) const;
@@ -919,9 +1191,142 @@ class SwapchainBuilder {
 		bool clipped = true;
 		VkSwapchainKHR old_swapchain = VK_NULL_HANDLE;
 		VkAllocationCallbacks* allocation_callbacks = VK_NULL_HANDLE;
+		std::shared_ptr<detail::FormatCapabilityCache> format_capability_cache;
+		bool enable_present_timing = false;
+		bool present_id_available = false;
+		bool present_wait_available = false;
+		bool display_timing_available = false;
+		SwapchainTuner* tuner = nullptr;
 	} info;
 };
 
+// Which way SwapchainTuner leans when trading latency for smooth frame delivery.
+enum class SwapchainTuningPolicy {
+	// Use as few images as the frame times allow, and tear rather than miss a refresh.
+	latency,
+	balanced,
+	// Keep an extra image queued, and only drop images with plenty of headroom.
+	throughput
+};
+
+// Watches measured CPU and GPU frame times and decides when the swapchain should be rebuilt with a
+// different image count or present mode, for instance dropping from triple to double buffering while the
+// GPU keeps up with the display. Decisions must hold for a number of consecutive frames before they are
+// acted on, and no decision is made for a while after a rebuild.
+//
+// Usage: pass the tuner to SwapchainBuilder::set_tuner(), report every frame with record_frame(), and when
+// it returns true rebuild the swapchain with the same builder and set_old_swapchain().
+class SwapchainTuner {
+	public:
+	explicit SwapchainTuner(SwapchainTuningPolicy policy = SwapchainTuningPolicy::balanced);
+
+	SwapchainTuner& set_policy(SwapchainTuningPolicy policy);
+	// The time the display takes for one refresh, which frame times are measured against. No tuning happens until it is set.
+	SwapchainTuner& set_refresh_cycle_duration(std::chrono::nanoseconds duration);
+	// The number of consecutive frames a decision must hold before a rebuild is requested. Defaults to 120.
+	SwapchainTuner& set_hysteresis(uint32_t frame_count);
+	// The number of frames after a rebuild during which no decision is made. Defaults to 60.
+	SwapchainTuner& set_cooldown(uint32_t frame_count);
+
+	// Report the CPU and GPU time a frame took. Returns true when the swapchain should be rebuilt.
+	bool record_frame(std::chrono::nanoseconds cpu_time, std::chrono::nanoseconds gpu_time);
+
+	// Whether the last call to record_frame() requested a rebuild which has not happened yet.
+	bool needs_rebuild() const;
+	// The image count and present mode the next build will use.
+	uint32_t get_image_count() const;
+	VkPresentModeKHR get_present_mode() const;
+
+	private:
+	void on_swapchain_built(VkSurfaceCapabilitiesKHR const& capabilities,
+	    std::vector<VkPresentModeKHR> const& available_present_modes,
+	    VkPresentModeKHR present_mode,
+	    uint32_t image_count);
+	bool is_present_mode_available(VkPresentModeKHR present_mode) const;
+	uint32_t get_max_image_count() const;
+
+	SwapchainTuningPolicy policy;
+	std::chrono::nanoseconds refresh_cycle_duration{ 0 };
+	uint32_t hysteresis = 120;
+	uint32_t cooldown = 60;
+
+	bool built = false;
+	bool rebuild_requested = false;
+	std::vector<VkPresentModeKHR> available_present_modes;
+	uint32_t surface_min_image_count = 1;
+	uint32_t surface_max_image_count = 0;
+	VkPresentModeKHR present_mode = VK_PRESENT_MODE_FIFO_KHR;
+	uint32_t image_count = 0;
+
+	uint32_t cooldown_remaining = 0;
+	uint32_t frames_keeping_up = 0;
+	uint32_t frames_falling_behind = 0;
+	friend class SwapchainBuilder;
+};
+
+// ---- Frame Latency ---- //
+
+// The points in a frame's life which FrameLatencyTracker records.
+enum class FrameStage { frame_start, acquire, submit, present, present_complete };
+
+// Records when each frame started, acquired its image, submitted, presented and was displayed in a
+// fixed size ring, so that latency percentiles can be queried over the most recent frames.
+// Frame ids start at 1 and are suitable values for VkPresentIdKHR::pPresentIds.
+class FrameLatencyTracker {
+	public:
+	using clock = std::chrono::steady_clock;
+
+	explicit FrameLatencyTracker(uint32_t frame_capacity = 128);
+
+	// Start a new frame and return its id.
+	uint64_t begin_frame();
+	// Sleep for the current pacing delay, then start a new frame and return its id.
+	uint64_t wait_and_begin_frame();
+
+	// Record that `frame_id` reached `stage`, either now or at `time`.
+	// Records for frames which have already left the ring are ignored.
+	void record(uint64_t frame_id, FrameStage stage);
+	void record(uint64_t frame_id, FrameStage stage, clock::time_point time);
+
+	// The given percentile (0 to 100) of the time it took frames to go from stage `from` to stage `to`.
+	// Only frames in the ring which recorded both stages are considered. Returns zero if there are none.
+	std::chrono::nanoseconds get_percentile(FrameStage from, FrameStage to, double percentile) const;
+	// The number of frames in the ring which recorded both stages.
+	uint32_t get_sample_count(FrameStage from, FrameStage to) const;
+
+	// In low latency mode, frames that queue up behind the display push the start of later frames back
+	// by way of the pacing delay, so the CPU does not run ahead of presentation. Defaults to false.
+	void set_low_latency_mode(bool enable = true);
+	// The duration of a display refresh, for instance from Swapchain::get_refresh_cycle_duration().
+	// Used as the expected present latency when pacing. If unset, the lowest observed latency is used.
+	void set_refresh_cycle_duration(std::chrono::nanoseconds duration);
+	// How long wait_and_begin_frame() currently sleeps before starting a frame.
+	std::chrono::nanoseconds get_pacing_delay() const;
+
+	// Forget all recorded frames and reset the pacing delay.
+	void reset();
+
+	private:
+	static const uint32_t stage_count = 5;
+	struct FrameRecord {
+		uint64_t frame_id = 0;
+		clock::time_point times[stage_count];
+		bool recorded[stage_count] = {};
+	};
+
+	FrameRecord* find_record(uint64_t frame_id);
+	void gather_intervals(FrameStage from, FrameStage to, std::vector<std::chrono::nanoseconds>& out) const;
+	void update_pacing_delay();
+
+	mutable std::mutex mutex;
+	std::vector<FrameRecord> frames;
+	uint64_t next_frame_id = 1;
+	uint64_t last_paced_frame_id = 0;
+	bool low_latency_mode = false;
+	std::chrono::nanoseconds refresh_cycle_duration{ 0 };
+	std::chrono::nanoseconds pacing_delay{ 0 };
+};
+
 } // namespace vkb
 
 
@@ -49,10 +49,12 @@ License: MIT
     - [Mapping functions](@ref memory_mapping_mapping_functions)
     - [Persistently mapped memory](@ref memory_mapping_persistently_mapped_memory)
     - [Cache flush and invalidate](@ref memory_mapping_cache_control)
+    - [Batching flushes](@ref memory_mapping_batching_flushes)
   - \subpage staying_within_budget
     - [Querying for budget](@ref staying_within_budget_querying_for_budget)
     - [Controlling memory usage](@ref staying_within_budget_controlling_memory_usage)
   - \subpage resource_aliasing
+  - \subpage sparse_resources
   - \subpage custom_memory_pools
     - [Choosing memory type index](@ref custom_memory_pools_MemTypeIndex)
     - [Linear allocation algorithm](@ref linear_algorithm)
@@ -61,9 +63,11 @@ License: MIT
       - [Double stack](@ref linear_algorithm_double_stack)
       - [Ring buffer](@ref linear_algorithm_ring_buffer)
   - \subpage defragmentation
+  - \subpage residency_management
   - \subpage statistics
     - [Numeric statistics](@ref statistics_numeric_statistics)
     - [JSON dump](@ref statistics_json_dump)
+  - \subpage warm_start
   - \subpage allocation_annotation
     - [Allocation user data](@ref allocation_user_data)
     - [Allocation names](@ref allocation_names)
@@ -72,6 +76,7 @@ License: MIT
     - [Memory initialization](@ref debugging_memory_usage_initialization)
     - [Margins](@ref debugging_memory_usage_margins)
     - [Corruption detection](@ref debugging_memory_usage_corruption_detection)
+  - \subpage record_and_replay
   - \subpage opengl_interop
 - \subpage usage_patterns
     - [GPU-only resource](@ref usage_patterns_gpu_only)
@@ -162,6 +167,8 @@ extern "C" {
     extern PFN_vkCreateImage vkCreateImage;
     extern PFN_vkDestroyImage vkDestroyImage;
     extern PFN_vkCmdCopyBuffer vkCmdCopyBuffer;
+    extern PFN_vkQueueBindSparse vkQueueBindSparse;
+    extern PFN_vkGetImageSparseMemoryRequirements vkGetImageSparseMemoryRequirements;
     #if VMA_VULKAN_VERSION >= 1001000
         extern PFN_vkGetBufferMemoryRequirements2 vkGetBufferMemoryRequirements2;
         extern PFN_vkGetImageMemoryRequirements2 vkGetImageMemoryRequirements2;
@@ -169,6 +176,21 @@ extern "C" {
         extern PFN_vkBindImageMemory2 vkBindImageMemory2;
         extern PFN_vkGetPhysicalDeviceMemoryProperties2 vkGetPhysicalDeviceMemoryProperties2;
     #endif // #if VMA_VULKAN_VERSION >= 1001000
+    #if VMA_VULKAN_VERSION >= 1002000 || VK_KHR_timeline_semaphore
+        extern PFN_vkCreateCommandPool vkCreateCommandPool;
+        extern PFN_vkDestroyCommandPool vkDestroyCommandPool;
+        extern PFN_vkAllocateCommandBuffers vkAllocateCommandBuffers;
+        extern PFN_vkResetCommandPool vkResetCommandPool;
+        extern PFN_vkBeginCommandBuffer vkBeginCommandBuffer;
+        extern PFN_vkEndCommandBuffer vkEndCommandBuffer;
+        extern PFN_vkQueueSubmit vkQueueSubmit;
+        extern PFN_vkCreateSemaphore vkCreateSemaphore;
+        extern PFN_vkDestroySemaphore vkDestroySemaphore;
+    #endif // #if VMA_VULKAN_VERSION >= 1002000 || VK_KHR_timeline_semaphore
+    #if VMA_VULKAN_VERSION >= 1002000
+        extern PFN_vkGetSemaphoreCounterValue vkGetSemaphoreCounterValue;
+        extern PFN_vkWaitSemaphores vkWaitSemaphores;
+    #endif // #if VMA_VULKAN_VERSION >= 1002000
 #endif // #if defined(__ANDROID__) && VMA_STATIC_VULKAN_FUNCTIONS && VK_NO_PROTOTYPES
 
 #if !defined(VMA_DEDICATED_ALLOCATION)
@@ -204,6 +226,16 @@ extern "C" {
     #endif
 #endif
 
+// Defined to 1 when VK_KHR_timeline_semaphore device extension or equivalent core Vulkan 1.2 feature is defined in its headers.
+// Enables #VmaDefragmentationExecutor.
+#if !defined(VMA_TIMELINE_SEMAPHORE)
+    #if VK_KHR_timeline_semaphore || VMA_VULKAN_VERSION >= 1002000
+        #define VMA_TIMELINE_SEMAPHORE 1
+    #else
+        #define VMA_TIMELINE_SEMAPHORE 0
+    #endif
+#endif
+
 // Defined to 1 when VK_EXT_memory_priority device extension is defined in Vulkan headers.
 #if !defined(VMA_MEMORY_PRIORITY)
     #if VK_EXT_memory_priority
@@ -291,6 +323,15 @@ extern "C" {
     #define VMA_STATS_STRING_ENABLED 1
 #endif
 
+/*
+Define this macro to 1 to enable support for recording calls of the allocator
+to a file, configured with VmaAllocatorCreateInfo::pRecordSettings.
+See \ref record_and_replay.
+*/
+#ifndef VMA_RECORDING_ENABLED
+    #define VMA_RECORDING_ENABLED 0
+#endif
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 //
@@ -420,12 +461,73 @@ typedef enum VmaAllocatorCreateFlagBits
     For more details, see the documentation of the VK_EXT_memory_priority extension.
     */
     VMA_ALLOCATOR_CREATE_EXT_MEMORY_PRIORITY_BIT = 0x00000040,
+    /**
+    Enables per-thread caches of small suballocations in default pools.
+
+    Every thread calling the library gets its own set of "magazines" - small stacks
+    of already suballocated buffer memory, one for each memory type and size class.
+    Allocations of buffers not larger than #VMA_THREAD_CACHE_MAX_ALLOCATION_SIZE are then
+    served from the magazine of the calling thread and freed back to it, without
+    taking the lock of the whole memory type. An empty magazine is refilled and a full one is
+    flushed in a batch, under a single lock.
+
+    It can considerably improve scalability when many threads create and destroy small buffers
+    at the same time. The downsides are:
+
+    - The size of an allocation is rounded up to its size class, so some memory is wasted.
+    - Suballocations parked in magazines are still reported as allocated in statistics and budget.
+      Call vmaFlushThreadCaches() to return them to their memory blocks.
+    - Magazines of a thread that has exited keep their suballocations until vmaFlushThreadCaches()
+      or destruction of the allocator.
+    - While a defragmentation context of default pools exists, the caches are flushed and bypassed.
+
+    Only allocations of type buffer, made without a custom pool and without flags
+    #VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT, #VMA_ALLOCATION_CREATE_NEVER_ALLOCATE_BIT,
+    #VMA_ALLOCATION_CREATE_MAPPED_BIT, #VMA_ALLOCATION_CREATE_UPPER_ADDRESS_BIT,
+    #VMA_ALLOCATION_CREATE_CAN_ALIAS_BIT, #VMA_ALLOCATION_CREATE_WITHIN_BUDGET_BIT use the caches.
+    The flag is ignored together with #VMA_ALLOCATOR_CREATE_EXTERNALLY_SYNCHRONIZED_BIT.
+    */
+    VMA_ALLOCATOR_CREATE_THREAD_CACHE_BIT = 0x00000080,
+    /**
+    Enables approximate statistics maintained incrementally.
+
+    Default pools and custom pools using the default or buddy algorithm then keep running totals
+    of their allocations and unused ranges, updated on every allocation and free,
+    so vmaCalculateStatistics() and vmaCalculatePoolStatistics() don't need to walk all their blocks
+    and their cost doesn't grow with the number of allocations. The downsides are:
+
+    - `allocationSizeMin/Max` and `unusedRangeSizeMin/Max` are rounded down to 4 significant bits
+      (less than 12.5% error).
+    - The totals are read without taking any lock. When other threads allocate or free memory
+      at the same time, the result can mix values from before and after their changes,
+      e.g. an allocation counted in `allocationCount` but not yet in `allocationBytes`,
+      or a minimum greater than the maximum. Without concurrent changes the result is consistent.
+    - Every allocation and free updates a few more counters.
+
+    Linear and slab pools and dedicated allocations are still walked and reported exactly.
+    */
+    VMA_ALLOCATOR_CREATE_INCREMENTAL_STATISTICS_BIT = 0x00000100,
 
     VMA_ALLOCATOR_CREATE_FLAG_BITS_MAX_ENUM = 0x7FFFFFFF
 } VmaAllocatorCreateFlagBits;
 /// See #VmaAllocatorCreateFlagBits.
 typedef VkFlags VmaAllocatorCreateFlags;
 
+/// Flags to be used in VmaRecordSettings::flags.
+typedef enum VmaRecordFlagBits
+{
+    /** \brief Enables flush after recording every function call.
+
+    Enable it if you expect your application to crash, which may leave recording file truncated.
+    It may degrade performance though.
+    */
+    VMA_RECORD_FLUSH_AFTER_CALL_BIT = 0x00000001,
+
+    VMA_RECORD_FLAG_BITS_MAX_ENUM = 0x7FFFFFFF
+} VmaRecordFlagBits;
+/// See #VmaRecordFlagBits.
+typedef VkFlags VmaRecordFlags;
+
 /** @} */
 
 /**
@@ -617,6 +719,17 @@ typedef enum VmaAllocationCreateFlagBits
     `VK_BUFFER_USAGE_TRANSFER_DST_BIT`, `VK_BUFFER_USAGE_TRANSFER_SRC_BIT` to the parameters of created buffer or image.
     */
     VMA_ALLOCATION_CREATE_HOST_ACCESS_ALLOW_TRANSFER_INSTEAD_BIT = 0x00001000,
+    /** \brief Allocation may be moved between memory types by #VmaResidencyManager.
+
+    When a `DEVICE_LOCAL` heap goes over budget, the residency manager moves allocations with this flag
+    that were not used recently (see vmaTouchAllocation()) to memory types outside of it, and back
+    when they are used again and the budget allows.
+    Only allocations made from default pools, not dedicated, are moved.
+
+    It cannot be used together with #VMA_ALLOCATION_CREATE_MAPPED_BIT.
+    For more information, see [Residency management](@ref residency_management).
+    */
+    VMA_ALLOCATION_CREATE_CAN_BE_DEMOTED_BIT = 0x00002000,
     /** Allocation strategy that chooses smallest possible free range for the allocation
     to minimize memory usage and fragmentation, possibly at the expense of allocation time.
     */
@@ -684,10 +797,35 @@ typedef enum VmaPoolCreateFlagBits
     */
     VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT = 0x00000004,
 
+    /** \brief Enables alternative, slab allocation algorithm in this pool.
+
+    Specify this flag for pools dedicated to many small allocations, like uniform
+    or staging buffers of a few hundred bytes. Memory blocks are divided into slabs
+    that each serve one fixed size class, so allocation and free take constant time
+    and almost no metadata is kept per allocation. Allocations are rounded up to
+    their size class and cannot be larger than 4 KiB.
+
+    For details, see documentation chapter \ref slab_algorithm.
+    */
+    VMA_POOL_CREATE_SLAB_ALGORITHM_BIT = 0x00000008,
+
+    /** \brief Enables alternative, buddy allocation algorithm in this pool.
+
+    It operates on a tree of blocks, each having size that is a power of two and
+    a half of its parent's size. Comparing to default algorithm, this one provides
+    faster allocation and deallocation and predictable, bounded coalescing of freed
+    space, at the cost of allocations being rounded up to a power of two.
+
+    For details, see documentation chapter \ref buddy_algorithm.
+    */
+    VMA_POOL_CREATE_BUDDY_ALGORITHM_BIT = 0x00000010,
+
     /** Bit mask to extract only `ALGORITHM` bits from entire set of flags.
     */
     VMA_POOL_CREATE_ALGORITHM_MASK =
-        VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT,
+        VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT |
+        VMA_POOL_CREATE_SLAB_ALGORITHM_BIT |
+        VMA_POOL_CREATE_BUDDY_ALGORITHM_BIT,
 
     VMA_POOL_CREATE_FLAG_BITS_MAX_ENUM = 0x7FFFFFFF
 } VmaPoolCreateFlagBits;
@@ -762,10 +900,27 @@ typedef enum VmaVirtualBlockCreateFlagBits
     */
     VMA_VIRTUAL_BLOCK_CREATE_LINEAR_ALGORITHM_BIT = 0x00000001,
 
+    /** \brief Enables alternative, slab allocation algorithm in this virtual block.
+
+    Allocations are rounded up to one of fixed size classes, up to 4 KiB, and made
+    in constant time. For details, see documentation chapter \ref slab_algorithm.
+    */
+    VMA_VIRTUAL_BLOCK_CREATE_SLAB_ALGORITHM_BIT = 0x00000002,
+
+    /** \brief Enables alternative, buddy allocation algorithm in this virtual block.
+
+    Allocations are rounded up to a power of two. Only largest power of two not greater
+    than VmaVirtualBlockCreateInfo::size is available for allocations.
+    For details, see documentation chapter \ref buddy_algorithm.
+    */
+    VMA_VIRTUAL_BLOCK_CREATE_BUDDY_ALGORITHM_BIT = 0x00000004,
+
     /** \brief Bit mask to extract only `ALGORITHM` bits from entire set of flags.
     */
     VMA_VIRTUAL_BLOCK_CREATE_ALGORITHM_MASK =
-        VMA_VIRTUAL_BLOCK_CREATE_LINEAR_ALGORITHM_BIT,
+        VMA_VIRTUAL_BLOCK_CREATE_LINEAR_ALGORITHM_BIT |
+        VMA_VIRTUAL_BLOCK_CREATE_SLAB_ALGORITHM_BIT |
+        VMA_VIRTUAL_BLOCK_CREATE_BUDDY_ALGORITHM_BIT,
 
     VMA_VIRTUAL_BLOCK_CREATE_FLAG_BITS_MAX_ENUM = 0x7FFFFFFF
 } VmaVirtualBlockCreateFlagBits;
@@ -870,6 +1025,38 @@ Call function vmaEndDefragmentation() to destroy it.
 */
 VK_DEFINE_HANDLE(VmaDefragmentationContext)
 
+/** \struct VmaDefragmentationExecutor
+\brief An opaque object that performs defragmentation incrementally, copying data on a transfer queue.
+
+Fill structure #VmaDefragmentationExecutorCreateInfo and call function vmaCreateDefragmentationExecutor() to create it.
+Call function vmaDestroyDefragmentationExecutor() to destroy it.
+*/
+VK_DEFINE_HANDLE(VmaDefragmentationExecutor)
+
+/** \struct VmaResidencyManager
+\brief An opaque object that moves rarely used allocations out of `DEVICE_LOCAL` memory when it is over budget.
+
+Fill structure #VmaResidencyManagerCreateInfo and call function vmaCreateResidencyManager() to create it.
+Call function vmaDestroyResidencyManager() to destroy it.
+*/
+VK_DEFINE_HANDLE(VmaResidencyManager)
+
+/** \struct VmaSparseResource
+\brief Represents a buffer or image created with `VK_*_CREATE_SPARSE_BINDING_BIT`, whose pages are backed by allocations on demand.
+
+Call function vmaCreateSparseBuffer() or vmaCreateSparseImage() to create it.
+Call function vmaDestroySparseResource() to destroy it.
+*/
+VK_DEFINE_HANDLE(VmaSparseResource)
+
+/** \struct VmaCacheRangeBatch
+\brief Collects ranges of allocations to flush or invalidate, to submit them merged in a single call.
+
+Call function vmaCreateCacheRangeBatch() to create it.
+Call function vmaDestroyCacheRangeBatch() to destroy it.
+*/
+VK_DEFINE_HANDLE(VmaCacheRangeBatch)
+
 /** @} */
 
 /**
@@ -970,6 +1157,10 @@ typedef struct VmaVulkanFunctions
     PFN_vkCreateImage VMA_NULLABLE vkCreateImage;
     PFN_vkDestroyImage VMA_NULLABLE vkDestroyImage;
     PFN_vkCmdCopyBuffer VMA_NULLABLE vkCmdCopyBuffer;
+    /// Used only by #VmaSparseResource. Optional otherwise.
+    PFN_vkQueueBindSparse VMA_NULLABLE vkQueueBindSparse;
+    /// Used only by #VmaSparseResource of images created with `VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT`. Optional otherwise.
+    PFN_vkGetImageSparseMemoryRequirements VMA_NULLABLE vkGetImageSparseMemoryRequirements;
 #if VMA_DEDICATED_ALLOCATION || VMA_VULKAN_VERSION >= 1001000
     /// Fetch "vkGetBufferMemoryRequirements2" on Vulkan >= 1.1, fetch "vkGetBufferMemoryRequirements2KHR" when using VK_KHR_dedicated_allocation extension.
     PFN_vkGetBufferMemoryRequirements2KHR VMA_NULLABLE vkGetBufferMemoryRequirements2KHR;
@@ -991,8 +1182,45 @@ typedef struct VmaVulkanFunctions
     /// Fetch from "vkGetDeviceImageMemoryRequirements" on Vulkan >= 1.3, but you can also fetch it from "vkGetDeviceImageMemoryRequirementsKHR" if you enabled extension VK_KHR_maintenance4.
     PFN_vkGetDeviceImageMemoryRequirements VMA_NULLABLE vkGetDeviceImageMemoryRequirements;
 #endif
+#if VMA_TIMELINE_SEMAPHORE
+    /// Used only by #VmaDefragmentationExecutor. Optional otherwise.
+    PFN_vkCreateCommandPool VMA_NULLABLE vkCreateCommandPool;
+    /// Used only by #VmaDefragmentationExecutor. Optional otherwise.
+    PFN_vkDestroyCommandPool VMA_NULLABLE vkDestroyCommandPool;
+    /// Used only by #VmaDefragmentationExecutor. Optional otherwise.
+    PFN_vkAllocateCommandBuffers VMA_NULLABLE vkAllocateCommandBuffers;
+    /// Used only by #VmaDefragmentationExecutor. Optional otherwise.
+    PFN_vkResetCommandPool VMA_NULLABLE vkResetCommandPool;
+    /// Used only by #VmaDefragmentationExecutor. Optional otherwise.
+    PFN_vkBeginCommandBuffer VMA_NULLABLE vkBeginCommandBuffer;
+    /// Used only by #VmaDefragmentationExecutor. Optional otherwise.
+    PFN_vkEndCommandBuffer VMA_NULLABLE vkEndCommandBuffer;
+    /// Used only by #VmaDefragmentationExecutor. Optional otherwise.
+    PFN_vkQueueSubmit VMA_NULLABLE vkQueueSubmit;
+    /// Used only by #VmaDefragmentationExecutor. Optional otherwise.
+    PFN_vkCreateSemaphore VMA_NULLABLE vkCreateSemaphore;
+    /// Used only by #VmaDefragmentationExecutor. Optional otherwise.
+    PFN_vkDestroySemaphore VMA_NULLABLE vkDestroySemaphore;
+    /// Fetch "vkGetSemaphoreCounterValue" on Vulkan >= 1.2, fetch "vkGetSemaphoreCounterValueKHR" when using VK_KHR_timeline_semaphore extension. Used only by #VmaDefragmentationExecutor.
+    PFN_vkGetSemaphoreCounterValueKHR VMA_NULLABLE vkGetSemaphoreCounterValue;
+    /// Fetch "vkWaitSemaphores" on Vulkan >= 1.2, fetch "vkWaitSemaphoresKHR" when using VK_KHR_timeline_semaphore extension. Used only by #VmaDefragmentationExecutor.
+    PFN_vkWaitSemaphoresKHR VMA_NULLABLE vkWaitSemaphores;
+#endif
 } VmaVulkanFunctions;
 
+/// Parameters for recording calls to VMA functions. To be used in VmaAllocatorCreateInfo::pRecordSettings.
+typedef struct VmaRecordSettings
+{
+    /// Flags for recording. Use #VmaRecordFlagBits enum.
+    VmaRecordFlags flags;
+    /** \brief Path to the file that should be written by the recording.
+
+    Recording is written in a binary format described in \ref record_and_replay.
+    File is overwritten if it already exists.
+    */
+    const char* VMA_NOT_NULL pFilePath;
+} VmaRecordSettings;
+
 /// Description of a Allocator to be created.
 typedef struct VmaAllocatorCreateInfo
 {
@@ -1070,6 +1298,29 @@ typedef struct VmaAllocatorCreateInfo
     */
     const VkExternalMemoryHandleTypeFlagsKHR* VMA_NULLABLE VMA_LEN_IF_NOT_NULL("VkPhysicalDeviceMemoryProperties::memoryTypeCount") pTypeExternalMemoryHandleTypes;
 #endif // #if VMA_EXTERNAL_MEMORY
+    /** \brief Number of frames to wait before memory is actually freed. Enables deferred freeing.
+
+    Optional, can be 0, which means memory is freed immediately.
+
+    If not 0, vmaFreeMemory(), vmaFreeMemoryPages(), vmaDestroyBuffer(), vmaDestroyBuffers(), and vmaDestroyImage()
+    don't free anything immediately. Allocations, buffers, and images passed to them are queued in a list
+    private to the calling thread, tagged with the current frame index set by vmaSetCurrentFrameIndex().
+    They are destroyed inside vmaSetCurrentFrameIndex() once the frame index has advanced by at least
+    `deferredFreeFrameCount` frames, all together, taking the lock of every memory pool only once.
+    It replaces a custom queue of resources waiting until the GPU finishes using them.
+
+    Queued resources are also released by vmaFlushDeferredFrees(), those of a custom pool by vmaDestroyPool(),
+    and all of them on destruction of the allocator. Until then, their memory is reported as allocated in statistics and budget,
+    and defragmentation never moves the queued allocations.
+    */
+    uint32_t deferredFreeFrameCount;
+    /** \brief Parameters for recording of VMA calls. Can be null.
+
+    If not null, it enables recording of calls to VMA functions to a file.
+    If support for recording is not enabled using `VMA_RECORDING_ENABLED` macro,
+    creation of the allocator object fails with `VK_ERROR_FEATURE_NOT_PRESENT`.
+    */
+    const VmaRecordSettings* VMA_NULLABLE pRecordSettings;
 } VmaAllocatorCreateInfo;
 
 /// Information about existing #VmaAllocator object.
@@ -1204,6 +1455,16 @@ typedef struct VmaBudget
     VkDeviceSize budget;
 } VmaBudget;
 
+/** \brief Callback function that receives consecutive parts of a JSON statistics string.
+
+Used by vmaWriteStatsString() and vmaWriteVirtualBlockStatsString().
+`pData` is not null-terminated and is valid only during the call.
+*/
+typedef void (VKAPI_PTR* PFN_vmaWriteStatsStringFunction)(
+    void* VMA_NULLABLE                                   pUserData,
+    const char* VMA_NOT_NULL VMA_LEN_IF_NOT_NULL("size") pData,
+    size_t                                               size);
+
 /** @} */
 
 /**
@@ -1477,6 +1738,172 @@ typedef struct VmaDefragmentationStats
     uint32_t deviceMemoryBlocksFreed;
 } VmaDefragmentationStats;
 
+#if VMA_TIMELINE_SEMAPHORE
+
+/// Callback function called by #VmaDefragmentationExecutor after an allocation has been moved to a new place.
+typedef void (VKAPI_PTR* PFN_vmaDefragmentationMoveCallback)(
+    VmaAllocator VMA_NOT_NULL    allocator,
+    VmaAllocation VMA_NOT_NULL   allocation,
+    void* VMA_NULLABLE           pUserData);
+
+/** \brief Parameters for creation of #VmaDefragmentationExecutor.
+
+To be used with function vmaCreateDefragmentationExecutor().
+*/
+typedef struct VmaDefragmentationExecutorCreateInfo
+{
+    /** \brief Parameters of the defragmentation, same as for vmaBeginDefragmentation().
+
+    VmaDefragmentationInfo::maxBytesPerPass and VmaDefragmentationInfo::maxAllocationsPerPass
+    limit the amount of data copied in a single call to vmaStepDefragmentationExecutor().
+    */
+    VmaDefragmentationInfo defragmentationInfo;
+    /** \brief Queue used to execute copies.
+
+    Preferably a queue of a dedicated transfer family, so copies don't compete with rendering.
+    The executor submits to it from vmaStepDefragmentationExecutor(), so you must synchronize access to this queue
+    with your own submissions.
+    */
+    VkQueue VMA_NOT_NULL transferQueue;
+    /// Index of the queue family of `transferQueue`.
+    uint32_t transferQueueFamilyIndex;
+    /** \brief Maximum time in nanoseconds that single call to vmaStepDefragmentationExecutor() should spend on the CPU.
+
+    When exceeded, remaining moves of the pass are recorded and submitted by following calls, and no new pass
+    is started until then. At least one move is submitted per call. `0` means no limit.
+    */
+    uint64_t maxStepDuration;
+    /** \brief Number of frames the old places of moved allocations are kept after `pfnAllocationMoved` is called for them.
+
+    Frames are counted by vmaSetCurrentFrameIndex(). Work you submitted before recreating the buffer
+    may still read it at the old place, so set it to the maximum number of frames in flight.
+    `0` frees old places right after `pfnAllocationMoved`, which is safe only if the GPU doesn't use them anymore.
+    */
+    uint32_t frameInUseCount;
+    /** \brief Optional callback called for every allocation that has been moved.
+
+    It is called from vmaStepDefragmentationExecutor() or vmaDestroyDefragmentationExecutor() after the copy finished
+    on the GPU and the allocation points to the new place. You should destroy the buffer bound to the old place
+    and create a new one using the allocation, e.g. with vmaCreateAliasingBuffer() or vmaBindBufferMemory().
+    */
+    PFN_vmaDefragmentationMoveCallback VMA_NULLABLE pfnAllocationMoved;
+    /// Optional, can be null. Passed to `pfnAllocationMoved`.
+    void* VMA_NULLABLE pUserData;
+} VmaDefragmentationExecutorCreateInfo;
+
+#endif // #if VMA_TIMELINE_SEMAPHORE
+
+/** \brief Parameters for creation of #VmaResidencyManager.
+
+To be used with function vmaCreateResidencyManager().
+*/
+typedef struct VmaResidencyManagerCreateInfo
+{
+    /** \brief Fraction of the budget of a `DEVICE_LOCAL` heap, above which its usage triggers demotion of allocations.
+
+    For example 0.95. Must be in range (0, 1].
+    */
+    float demoteThreshold;
+    /** \brief Fraction of the budget of a `DEVICE_LOCAL` heap, to which demotion lowers the bytes of its allocations.
+
+    Demoted allocations are promoted back only as long as the bytes of allocations stay below it.
+    For example 0.85. Must not be greater than `demoteThreshold`.
+    */
+    float promoteThreshold;
+    /** \brief Number of frames without vmaTouchAllocation() after which an allocation can be demoted.
+
+    Demoted allocations touched within this number of frames are promoted back.
+    */
+    uint32_t minIdleFrameCount;
+    /** \brief Maximum numbers of bytes that can be copied during single pass.
+
+    `0` means no limit.
+    */
+    VkDeviceSize maxBytesPerPass;
+    /** \brief Maximum number of allocations that can be moved during single pass.
+
+    `0` means no limit.
+    */
+    uint32_t maxAllocationsPerPass;
+} VmaResidencyManagerCreateInfo;
+
+/// Statistics of allocations moved by #VmaResidencyManager, returned by vmaGetResidencyStats().
+typedef struct VmaResidencyStats
+{
+    /// Number of allocations moved out of `DEVICE_LOCAL` memory.
+    uint32_t allocationsDemoted;
+    /// Number of allocations moved back to `DEVICE_LOCAL` memory.
+    uint32_t allocationsPromoted;
+    /// Total number of bytes of allocations moved out of `DEVICE_LOCAL` memory.
+    VkDeviceSize bytesDemoted;
+    /// Total number of bytes of allocations moved back to `DEVICE_LOCAL` memory.
+    VkDeviceSize bytesPromoted;
+} VmaResidencyStats;
+
+/// Parameters of #VmaSparseResource, returned by vmaGetSparseResourceInfo().
+typedef struct VmaSparseResourceInfo
+{
+    /// Size of a single page, equal to `VkMemoryRequirements::alignment` of the resource.
+    VkDeviceSize pageSize;
+    /// Number of pages covering whole resource.
+    VkDeviceSize pageCount;
+    /// Number of pages currently backed by memory, including those not yet bound with vmaBindSparsePages().
+    VkDeviceSize committedPageCount;
+    /// Number of tiles committed with vmaCommitSparseImageRegion(), including those not yet bound with vmaBindSparsePages().
+    VkDeviceSize committedTileCount;
+    /// Number of pages and tiles committed or decommitted since the last vmaBindSparsePages().
+    VkDeviceSize pendingPageCount;
+    /// Number of pages and tiles already unbound whose memory waits for vmaFreeUnboundSparsePages().
+    VkDeviceSize unboundPageCount;
+} VmaSparseResourceInfo;
+
+/** \brief Region of a single subresource of an image created with `VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT`.
+
+Used in vmaCommitSparseImageRegion() and vmaDecommitSparseImageRegion().
+*/
+typedef struct VmaSparseImageRegion
+{
+    /** \brief Aspect, mip level, and array layer of the region.
+
+    `aspectMask` must be covered by `VkSparseImageFormatProperties::aspectMask` of one of the elements
+    returned by `vkGetImageSparseMemoryRequirements()`. `mipLevel` must be less than its `imageMipTailFirstLod`,
+    as the mip tail is backed with vmaCommitSparsePages().
+    */
+    VkImageSubresource subresource;
+    /// Offset in texels. Must be a multiple of `VkSparseImageFormatProperties::imageGranularity`.
+    VkOffset3D offset;
+    /// Extent in texels. Must be a multiple of the granularity, unless the region reaches the edge of the mip level.
+    VkExtent3D extent;
+} VmaSparseImageRegion;
+
+/// Synchronization of the `vkQueueBindSparse` call made by vmaBindSparsePages().
+typedef struct VmaSparseBindSubmitInfo
+{
+    /// Number of semaphores to wait on before the binding is performed.
+    uint32_t waitSemaphoreCount;
+    /// Pointer to an array of `waitSemaphoreCount` semaphores.
+    const VkSemaphore VMA_NOT_NULL_NON_DISPATCHABLE* VMA_NULLABLE VMA_LEN_IF_NOT_NULL(waitSemaphoreCount) pWaitSemaphores;
+    /// Number of semaphores to signal when the binding is completed.
+    uint32_t signalSemaphoreCount;
+    /// Pointer to an array of `signalSemaphoreCount` semaphores.
+    const VkSemaphore VMA_NOT_NULL_NON_DISPATCHABLE* VMA_NULLABLE VMA_LEN_IF_NOT_NULL(signalSemaphoreCount) pSignalSemaphores;
+    /// Optional, can be null. Fence to signal when the binding is completed.
+    VkFence VMA_NULLABLE_NON_DISPATCHABLE fence;
+} VmaSparseBindSubmitInfo;
+
+/// Counters of #VmaCacheRangeBatch since its creation, returned by vmaGetCacheRangeBatchStats().
+typedef struct VmaCacheRangeBatchStats
+{
+    /// Number of ranges of non-coherent memory added with vmaAddCacheRange().
+    uint32_t rangesCollected;
+    /// Number of `VkMappedMemoryRange` structures passed to Vulkan after merging.
+    uint32_t rangesIssued;
+    /// Number of calls to `vkFlushMappedMemoryRanges` or `vkInvalidateMappedMemoryRanges`.
+    uint32_t callsIssued;
+    /// Total size of the ranges passed to Vulkan.
+    VkDeviceSize bytesIssued;
+} VmaCacheRangeBatchStats;
+
 /** @} */
 
 /**
@@ -1548,6 +1975,75 @@ typedef struct VmaVirtualAllocationInfo
     void* VMA_NULLABLE pUserData;
 } VmaVirtualAllocationInfo;
 
+/** \brief Parameters for defragmentation of a virtual block.
+
+To be used with function vmaBeginVirtualBlockDefragmentationPass().
+*/
+typedef struct VmaVirtualDefragmentationInfo
+{
+    /** \brief Maximum numbers of bytes that can be moved during single pass.
+
+    `0` means no limit.
+    */
+    VkDeviceSize maxBytesPerPass;
+    /** \brief Maximum number of allocations that can be moved during single pass.
+
+    `0` means no limit.
+    */
+    uint32_t maxAllocationsPerPass;
+    /** \brief Greatest alignment used by allocations in the block.
+
+    The block doesn't remember alignment requested for its allocations, so new offset of an allocation is aligned
+    to the greatest power of two that divides its current offset, but not more than this value.
+    Must be a power of two or `0`.
+
+    `0` means no cap: new offset keeps the full alignment of the current one. This is always safe,
+    but an allocation that happens to sit at a highly aligned offset, e.g. half of the block, then has few places to go.
+    */
+    VkDeviceSize maxAlignment;
+} VmaVirtualDefragmentationInfo;
+
+/// Single move of a virtual allocation to be performed by the user.
+typedef struct VmaVirtualDefragmentationMove
+{
+    /** \brief Operation to be performed on the allocation by vmaEndVirtualBlockDefragmentationPass().
+
+    Default value is #VMA_DEFRAGMENTATION_MOVE_OPERATION_COPY. You can modify it.
+    */
+    VmaDefragmentationMoveOperation operation;
+    /// Allocation that should be moved.
+    VmaVirtualAllocation VMA_NOT_NULL_NON_DISPATCHABLE srcAllocation;
+    /** \brief Allocation reserved at the new place, with the same size and `pUserData` as `srcAllocation`.
+
+    After vmaEndVirtualBlockDefragmentationPass() with #VMA_DEFRAGMENTATION_MOVE_OPERATION_COPY
+    `srcAllocation` is freed and you should use this handle instead.
+    */
+    VmaVirtualAllocation VMA_NOT_NULL_NON_DISPATCHABLE dstAllocation;
+    /// Offset of `srcAllocation`, where data should be copied from.
+    VkDeviceSize srcOffset;
+    /// Offset of `dstAllocation`, where data should be copied to.
+    VkDeviceSize dstOffset;
+    /// Number of bytes to copy.
+    VkDeviceSize size;
+} VmaVirtualDefragmentationMove;
+
+/** \brief Moves computed for a single defragmentation pass of a virtual block.
+
+To be used with functions vmaBeginVirtualBlockDefragmentationPass() and vmaEndVirtualBlockDefragmentationPass().
+*/
+typedef struct VmaVirtualDefragmentationPassMoveInfo
+{
+    /// Number of elements in the `pMoves` array.
+    uint32_t moveCount;
+    /** \brief Array of moves to be performed by the user in the current pass.
+
+    Pointer to an array of `moveCount` elements, owned by the virtual block, created in vmaBeginVirtualBlockDefragmentationPass(),
+    destroyed in vmaEndVirtualBlockDefragmentationPass().
+    Source and destination ranges of the moves never overlap each other.
+    */
+    VmaVirtualDefragmentationMove* VMA_NULLABLE VMA_LEN_IF_NOT_NULL(moveCount) pMoves;
+} VmaVirtualDefragmentationPassMoveInfo;
+
 /** @} */
 
 #endif // _VMA_DATA_TYPES_DECLARATIONS
@@ -1605,11 +2101,32 @@ VMA_CALL_PRE void VMA_CALL_POST vmaGetMemoryTypeProperties(
     VkMemoryPropertyFlags* VMA_NOT_NULL pFlags);
 
 /** \brief Sets index of the current frame.
+
+If VmaAllocatorCreateInfo::deferredFreeFrameCount is not 0, it also destroys resources
+whose deferred freeing has waited that many frames.
 */
 VMA_CALL_PRE void VMA_CALL_POST vmaSetCurrentFrameIndex(
     VmaAllocator VMA_NOT_NULL allocator,
     uint32_t frameIndex);
 
+/** \brief Returns suballocations held in per-thread caches of all threads back to their memory blocks.
+
+Has effect only when the allocator was created with #VMA_ALLOCATOR_CREATE_THREAD_CACHE_BIT.
+It is called automatically before defragmentation of default pools and on destruction of the allocator.
+It is safe to call it while other threads allocate and free memory, but they may start
+filling their caches again immediately.
+*/
+VMA_CALL_PRE void VMA_CALL_POST vmaFlushThreadCaches(
+    VmaAllocator VMA_NOT_NULL allocator);
+
+/** \brief Immediately destroys all allocations, buffers, and images queued by deferred freeing.
+
+Has effect only when VmaAllocatorCreateInfo::deferredFreeFrameCount was not 0.
+Call it only when the GPU no longer uses any of them, e.g. after `vkDeviceWaitIdle()`.
+*/
+VMA_CALL_PRE void VMA_CALL_POST vmaFlushDeferredFrees(
+    VmaAllocator VMA_NOT_NULL allocator);
+
 /** @} */
 
 /**
@@ -1619,8 +2136,10 @@ VMA_CALL_PRE void VMA_CALL_POST vmaSetCurrentFrameIndex(
 
 /** \brief Retrieves statistics from current state of the Allocator.
 
-This function is called "calculate" not "get" because it has to traverse all
-internal data structures, so it may be quite slow. Use it for debugging purposes.
+This function is called "calculate" not "get" because it may have to traverse
+internal data structures. Sizes are exact, unless the allocator was created with
+#VMA_ALLOCATOR_CREATE_INCREMENTAL_STATISTICS_BIT, which makes the call cheap for default pools
+and custom pools using the default or buddy algorithm, at the cost of approximate minimum and maximum sizes.
 For faster but more brief statistics suitable to be called every frame or every allocation,
 use vmaGetHeapBudgets().
 
@@ -1953,6 +2472,19 @@ VMA_CALL_PRE void VMA_CALL_POST vmaGetAllocationMemoryProperties(
     VmaAllocation VMA_NOT_NULL allocation,
     VkMemoryPropertyFlags* VMA_NOT_NULL pFlags);
 
+/** \brief Marks the allocation as used in the current frame.
+
+It sets frame index of last use of the allocation to the one set by vmaSetCurrentFrameIndex().
+It is very cheap, so it can be called every time the resource is used in a frame.
+It matters only for allocations created with #VMA_ALLOCATION_CREATE_CAN_BE_DEMOTED_BIT,
+which #VmaResidencyManager demotes when they are not touched for some frames and promotes back when touched again.
+
+This function can be called from multiple threads at the same time, also for the same allocation.
+*/
+VMA_CALL_PRE void VMA_CALL_POST vmaTouchAllocation(
+    VmaAllocator VMA_NOT_NULL allocator,
+    VmaAllocation VMA_NOT_NULL allocation);
+
 /** \brief Maps memory represented by given allocation and returns pointer to it.
 
 Maps memory represented by given allocation to make it accessible to CPU code.
@@ -2103,6 +2635,63 @@ VMA_CALL_PRE VkResult VMA_CALL_POST vmaInvalidateAllocations(
     const VkDeviceSize* VMA_NULLABLE VMA_LEN_IF_NOT_NULL(allocationCount) offsets,
     const VkDeviceSize* VMA_NULLABLE VMA_LEN_IF_NOT_NULL(allocationCount) sizes);
 
+/** \brief Creates an object that collects ranges to flush or invalidate.
+
+\param allocator
+\param[out] pBatch Created object. Must be destroyed with vmaDestroyCacheRangeBatch().
+
+The object is not thread-safe. Use a separate one for each thread or synchronize access to it.
+For more information, see [Batching flushes](@ref memory_mapping_batching_flushes).
+*/
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaCreateCacheRangeBatch(
+    VmaAllocator VMA_NOT_NULL allocator,
+    VmaCacheRangeBatch VMA_NULLABLE* VMA_NOT_NULL pBatch);
+
+/** \brief Destroys object created by vmaCreateCacheRangeBatch(). Ranges not submitted yet are discarded.
+*/
+VMA_CALL_PRE void VMA_CALL_POST vmaDestroyCacheRangeBatch(
+    VmaAllocator VMA_NOT_NULL allocator,
+    VmaCacheRangeBatch VMA_NULLABLE batch);
+
+/** \brief Adds a range of an allocation to be flushed or invalidated later.
+
+`offset` and `size` have the same meaning as in vmaFlushAllocation(). The range is aligned to `nonCoherentAtomSize`
+immediately. If the memory type of the allocation is `HOST_COHERENT` or `size` is 0, this call is ignored.
+The allocation must stay alive until the batch is submitted.
+*/
+VMA_CALL_PRE void VMA_CALL_POST vmaAddCacheRange(
+    VmaAllocator VMA_NOT_NULL allocator,
+    VmaCacheRangeBatch VMA_NOT_NULL batch,
+    VmaAllocation VMA_NOT_NULL allocation,
+    VkDeviceSize offset,
+    VkDeviceSize size);
+
+/** \brief Flushes all ranges added to the batch and clears it.
+
+Ranges are sorted by `VkDeviceMemory` and offset, adjacent and overlapping ones are merged,
+and the result is passed to a single call to `vkFlushMappedMemoryRanges`.
+
+This function returns the `VkResult` from `vkFlushMappedMemoryRanges` if it is
+called, otherwise `VK_SUCCESS`. The batch is cleared in either case.
+*/
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaFlushCacheRangeBatch(
+    VmaAllocator VMA_NOT_NULL allocator,
+    VmaCacheRangeBatch VMA_NOT_NULL batch);
+
+/** \brief Invalidates all ranges added to the batch and clears it.
+
+Works like vmaFlushCacheRangeBatch(), but calls `vkInvalidateMappedMemoryRanges`.
+*/
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaInvalidateCacheRangeBatch(
+    VmaAllocator VMA_NOT_NULL allocator,
+    VmaCacheRangeBatch VMA_NOT_NULL batch);
+
+/// Returns counters of ranges collected and issued by the batch since its creation.
+VMA_CALL_PRE void VMA_CALL_POST vmaGetCacheRangeBatchStats(
+    VmaAllocator VMA_NOT_NULL allocator,
+    VmaCacheRangeBatch VMA_NOT_NULL batch,
+    VmaCacheRangeBatchStats* VMA_NOT_NULL pStats);
+
 /** \brief Checks magic number in margins around all allocations in given memory types (in both default and custom pools) in search for corruptions.
 
 \param allocator
@@ -2124,6 +2713,73 @@ VMA_CALL_PRE VkResult VMA_CALL_POST vmaCheckCorruption(
     VmaAllocator VMA_NOT_NULL allocator,
     uint32_t memoryTypeBits);
 
+/** \brief Saves peak numbers and sizes of memory blocks, to pre-create them with vmaImportAllocationProfile() on the next run.
+
+\param allocator
+\param[in,out] pDataSize Size of the buffer pointed by `pData` on input, number of bytes written on output.
+\param[out] pData Optional. Buffer to write the profile to. If null, only the required size is returned in `pDataSize`.
+\returns `VK_INCOMPLETE` if the buffer is too small, in which case nothing is written and `*pDataSize` is set to 0.
+
+The profile contains one entry for each default pool and each custom pool with a name set by vmaSetPoolName()
+that had at least one block created. It is only valid for the same physical device.
+For more information, see [Warm start](@ref warm_start).
+*/
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaExportAllocationProfile(
+    VmaAllocator VMA_NOT_NULL allocator,
+    size_t* VMA_NOT_NULL pDataSize,
+    void* VMA_NULLABLE VMA_LEN_IF_NOT_NULL(*pDataSize) pData);
+
+/** \brief Pre-creates memory blocks described by a profile returned by vmaExportAllocationProfile().
+
+\param allocator
+\param dataSize Size of the profile in bytes.
+\param pData The profile.
+\returns
+- `VK_SUCCESS` if all the blocks that fit in the heap budget got created.
+- `VK_ERROR_INCOMPATIBLE_DRIVER` if the profile was created with another physical device or version of the library.
+  No blocks are created.
+- `VK_ERROR_INITIALIZATION_FAILED` if the data is not a valid profile. No blocks are created.
+- Other value: Error returned by Vulkan when allocating memory.
+
+Custom pools are matched by name, so they must be created and named before this call,
+and must not be destroyed until it returns.
+Only the blocks created by this call are not released when empty, similarly to VmaPoolCreateInfo::minBlockCount.
+
+This function is thread-safe, so it can be called from a background thread while the application
+keeps allocating from the same allocator.
+*/
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaImportAllocationProfile(
+    VmaAllocator VMA_NOT_NULL allocator,
+    size_t dataSize,
+    const void* VMA_NOT_NULL VMA_LEN_IF_NOT_NULL(dataSize) pData);
+
+/** \brief Allocates the next memory block of default pools that are running out of free space.
+
+\param allocator
+\param memoryTypeBits Bit mask of memory types to consider. Use `UINT32_MAX` for all of them.
+\param minFreeSize A new block is allocated for a memory type when the free space in its blocks is less than this.
+\param[out] pAllocatedBlockCount Optional. Number of blocks allocated by this call.
+\returns `VK_SUCCESS` or an error returned by Vulkan when allocating memory. On error, other memory types are still processed.
+
+Only memory types that already have at least one block and no empty block are considered.
+Block is not allocated if it would exceed the heap budget. It has the size of the next block
+the allocator would create on its own. It stays alive while empty until it is used,
+but only as the single empty block of its memory type: as soon as a free empties any other block,
+the preallocated block is released like any other extra empty block, and the newly emptied one is kept instead.
+
+This function calls `vkAllocateMemory` without blocking allocations from the same memory type,
+so it is meant to be called periodically from a low priority background thread,
+which allows allocations on other threads to almost never wait for a new block.
+An allocation that finds no room and creates a block on its own still calls `vkAllocateMemory`
+with the memory type locked for all other allocations and frees.
+For more information, see [Block preallocation](@ref warm_start_block_preallocation).
+*/
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaPreallocateBlocks(
+    VmaAllocator VMA_NOT_NULL allocator,
+    uint32_t memoryTypeBits,
+    VkDeviceSize minFreeSize,
+    uint32_t* VMA_NULLABLE pAllocatedBlockCount);
+
 /** \brief Begins defragmentation process.
 
 \param allocator Allocator object.
@@ -2192,6 +2848,162 @@ VMA_CALL_PRE VkResult VMA_CALL_POST vmaEndDefragmentationPass(
     VmaDefragmentationContext VMA_NOT_NULL context,
     VmaDefragmentationPassMoveInfo* VMA_NOT_NULL pPassInfo);
 
+#if VMA_TIMELINE_SEMAPHORE
+/** \brief Creates an object that performs defragmentation incrementally on a transfer queue.
+
+\param allocator Allocator object.
+\param pCreateInfo Parameters of the executor.
+\param[out] pExecutor Created object. Must be destroyed with vmaDestroyDefragmentationExecutor().
+\returns
+- `VK_SUCCESS` if the executor has been created.
+- `VK_ERROR_FEATURE_NOT_PRESENT` if defragmentation is not supported for given pool, or Vulkan functions needed by the executor
+  are not available. It requires `timelineSemaphore` feature of Vulkan 1.2 or `VK_KHR_timeline_semaphore` extension enabled.
+- Other value: Error returned by Vulkan.
+
+The executor begins defragmentation like vmaBeginDefragmentation() does. Call vmaStepDefragmentationExecutor() once per frame
+to make progress.
+*/
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaCreateDefragmentationExecutor(
+    VmaAllocator VMA_NOT_NULL allocator,
+    const VmaDefragmentationExecutorCreateInfo* VMA_NOT_NULL pCreateInfo,
+    VmaDefragmentationExecutor VMA_NULLABLE* VMA_NOT_NULL pExecutor);
+
+/** \brief Performs single step of incremental defragmentation.
+
+\param allocator Allocator object.
+\param executor Object created by vmaCreateDefragmentationExecutor().
+\returns
+- `VK_SUCCESS` if defragmentation is finished and old places of all moved allocations are freed. You can destroy the executor.
+- `VK_NOT_READY` if copies submitted in previous step are still executing on the GPU.
+- `VK_INCOMPLETE` if more steps are needed.
+- Other value: Error returned by Vulkan.
+
+It frees old places of moved allocations that are no longer in use according to
+VmaDefragmentationExecutorCreateInfo::frameInUseCount. If all copies of the current pass finished, it commits them
+and calls VmaDefragmentationExecutorCreateInfo::pfnAllocationMoved for every moved allocation. Then, if time budget allows,
+it records copies of remaining moves of the pass or computes next pass, and submits them to
+VmaDefragmentationExecutorCreateInfo::transferQueue signaling the timeline semaphore returned by
+vmaGetDefragmentationExecutorSemaphore().
+
+Only the data of buffers, linear images and allocations made without a resource is copied. Moves of allocations that
+may hold images with optimal tiling are skipped, as they cannot be copied without their `VkImage`.
+Allocations being moved must not be written by the GPU or the CPU until they are reported as moved.
+
+This function must not be called concurrently for the same executor.
+*/
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaStepDefragmentationExecutor(
+    VmaAllocator VMA_NOT_NULL allocator,
+    VmaDefragmentationExecutor VMA_NOT_NULL executor);
+
+/** \brief Returns timeline semaphore signaled by copies of the executor.
+
+\param allocator Allocator object.
+\param executor Object created by vmaCreateDefragmentationExecutor().
+\param[out] pSemaphore Timeline semaphore owned by the executor.
+\param[out] pValue Value that will be signaled when copies submitted so far finish.
+
+If you access moved data from a queue other than VmaDefragmentationExecutorCreateInfo::transferQueue,
+make your submission wait on this semaphore and value.
+*/
+VMA_CALL_PRE void VMA_CALL_POST vmaGetDefragmentationExecutorSemaphore(
+    VmaAllocator VMA_NOT_NULL allocator,
+    VmaDefragmentationExecutor VMA_NOT_NULL executor,
+    VkSemaphore VMA_NULLABLE_NON_DISPATCHABLE* VMA_NOT_NULL pSemaphore,
+    uint64_t* VMA_NOT_NULL pValue);
+
+/** \brief Finishes defragmentation performed by the executor and destroys it.
+
+\param allocator Allocator object.
+\param executor Object created by vmaCreateDefragmentationExecutor().
+\param[out] pStats Optional stats for the whole defragmentation. Can be null.
+
+Waits for copies still executing on the GPU and commits them before destroying the executor.
+Moves of the current pass not copied yet are abandoned. Old places of moved allocations are freed immediately,
+regardless of VmaDefragmentationExecutorCreateInfo::frameInUseCount, so make sure the GPU doesn't use them anymore.
+*/
+VMA_CALL_PRE void VMA_CALL_POST vmaDestroyDefragmentationExecutor(
+    VmaAllocator VMA_NOT_NULL allocator,
+    VmaDefragmentationExecutor VMA_NULLABLE executor,
+    VmaDefragmentationStats* VMA_NULLABLE pStats);
+#endif // #if VMA_TIMELINE_SEMAPHORE
+
+/** \brief Creates an object that moves rarely used allocations out of `DEVICE_LOCAL` memory when it is over budget.
+
+\param allocator Allocator object.
+\param pCreateInfo Parameters of the residency manager.
+\param[out] pManager Created object. Must be destroyed with vmaDestroyResidencyManager().
+
+For more information, see [Residency management](@ref residency_management).
+*/
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaCreateResidencyManager(
+    VmaAllocator VMA_NOT_NULL allocator,
+    const VmaResidencyManagerCreateInfo* VMA_NOT_NULL pCreateInfo,
+    VmaResidencyManager VMA_NULLABLE* VMA_NOT_NULL pManager);
+
+/** \brief Destroys residency manager object.
+
+\param allocator Allocator object.
+\param manager Object created by vmaCreateResidencyManager(). Can be null.
+
+There must be no pass begun with vmaBeginResidencyPass() and not ended.
+*/
+VMA_CALL_PRE void VMA_CALL_POST vmaDestroyResidencyManager(
+    VmaAllocator VMA_NOT_NULL allocator,
+    VmaResidencyManager VMA_NULLABLE manager);
+
+/** \brief Computes allocations to demote or promote in single pass.
+
+\param allocator Allocator object.
+\param manager Object created by vmaCreateResidencyManager().
+\param[out] pPassInfo Computed information for current pass.
+\returns
+- `VK_SUCCESS` if no moves are needed now.
+- `VK_INCOMPLETE` if there are pending moves returned in `pPassInfo`. You need to perform them like moves
+  of a defragmentation pass and call vmaEndResidencyPass().
+
+Checks current budget of every `DEVICE_LOCAL` heap. If its usage is above VmaResidencyManagerCreateInfo::demoteThreshold,
+allocations created with #VMA_ALLOCATION_CREATE_CAN_BE_DEMOTED_BIT that were not touched for
+VmaResidencyManagerCreateInfo::minIdleFrameCount frames are scheduled to be moved to other memory types,
+least recently used first, until bytes of allocations in the heap drop to VmaResidencyManagerCreateInfo::promoteThreshold.
+If they are below VmaResidencyManagerCreateInfo::promoteThreshold and usage doesn't exceed
+VmaResidencyManagerCreateInfo::demoteThreshold, demoted allocations touched recently are scheduled to be moved back,
+most recently used first.
+
+It is meant to be called once per frame, after vmaSetCurrentFrameIndex().
+Allocations created with #VMA_ALLOCATION_CREATE_CAN_BE_DEMOTED_BIT must not be freed concurrently with this call.
+*/
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaBeginResidencyPass(
+    VmaAllocator VMA_NOT_NULL allocator,
+    VmaResidencyManager VMA_NOT_NULL manager,
+    VmaDefragmentationPassMoveInfo* VMA_NOT_NULL pPassInfo);
+
+/** \brief Commits moves of single residency pass.
+
+\param allocator Allocator object.
+\param manager Object created by vmaCreateResidencyManager().
+\param pPassInfo Computed information for current pass filled by vmaBeginResidencyPass() and possibly modified by you.
+
+Moves are applied the same way as by vmaEndDefragmentationPass(), including VmaDefragmentationMove::operation.
+After this call, allocations moved with #VMA_DEFRAGMENTATION_MOVE_OPERATION_COPY point to the new memory type.
+*/
+VMA_CALL_PRE void VMA_CALL_POST vmaEndResidencyPass(
+    VmaAllocator VMA_NOT_NULL allocator,
+    VmaResidencyManager VMA_NOT_NULL manager,
+    VmaDefragmentationPassMoveInfo* VMA_NOT_NULL pPassInfo);
+
+/** \brief Returns statistics of allocations moved by the residency manager.
+
+\param allocator Allocator object.
+\param manager Object created by vmaCreateResidencyManager().
+\param[out] pFrameStats Optional. Moves committed in the current frame, as set by vmaSetCurrentFrameIndex().
+\param[out] pTotalStats Optional. Moves committed since the manager was created.
+*/
+VMA_CALL_PRE void VMA_CALL_POST vmaGetResidencyStats(
+    VmaAllocator VMA_NOT_NULL allocator,
+    VmaResidencyManager VMA_NOT_NULL manager,
+    VmaResidencyStats* VMA_NULLABLE pFrameStats,
+    VmaResidencyStats* VMA_NULLABLE pTotalStats);
+
 /** \brief Binds buffer to allocation.
 
 Binds specified buffer to region of memory represented by specified allocation.
@@ -2395,13 +3207,60 @@ VMA_CALL_PRE void VMA_CALL_POST vmaDestroyBuffer(
     VkBuffer VMA_NULLABLE_NON_DISPATCHABLE buffer,
     VmaAllocation VMA_NULLABLE allocation);
 
-/// Function similar to vmaCreateBuffer().
-VMA_CALL_PRE VkResult VMA_CALL_POST vmaCreateImage(
-    VmaAllocator VMA_NOT_NULL allocator,
-    const VkImageCreateInfo* VMA_NOT_NULL pImageCreateInfo,
-    const VmaAllocationCreateInfo* VMA_NOT_NULL pAllocationCreateInfo,
-    VkImage VMA_NULLABLE_NON_DISPATCHABLE* VMA_NOT_NULL pImage,
-    VmaAllocation VMA_NULLABLE* VMA_NOT_NULL pAllocation,
+/** \brief Creates multiple buffers with the same parameters, allocates and binds memory for them.
+
+\param allocator
+\param pBufferCreateInfo Parameters used to create each of the buffers.
+\param pAllocationCreateInfo Parameters used to create each of the allocations.
+\param bufferCount Number of buffers to create.
+\param[out] pBuffers Pointer to array that will be filled with created buffers.
+\param[out] pAllocations Pointer to array that will be filled with handles to created allocations.
+\param[out] pAllocationInfos Optional. Pointer to array that will be filled with parameters of created allocations.
+
+It is equivalent to calling vmaCreateBuffer() `bufferCount` times, but more efficient:
+
+-# Memory requirements are queried only once, as they are identical for buffers created with the same parameters.
+-# All allocations are made together, like in vmaAllocateMemoryPages(), locking the memory pool only once
+   and continuing in the same memory block as long as it has enough free space.
+-# Buffers are bound using `vkBindBufferMemory2` with a single call per memory block,
+   if #VMA_ALLOCATOR_CREATE_KHR_BIND_MEMORY2_BIT is used or Vulkan 1.1 is enabled.
+
+If the buffers require or prefer dedicated allocations, a separate dedicated allocation is made for each of them.
+
+If any of the operations fails, all buffers and allocations made within this function call are destroyed,
+so when returned result is not `VK_SUCCESS`, `pBuffers` and `pAllocations` arrays are entirely filled with null handles.
+
+Destroy the buffers using vmaDestroyBuffers() or vmaDestroyBuffer().
+*/
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaCreateBuffers(
+    VmaAllocator VMA_NOT_NULL allocator,
+    const VkBufferCreateInfo* VMA_NOT_NULL pBufferCreateInfo,
+    const VmaAllocationCreateInfo* VMA_NOT_NULL pAllocationCreateInfo,
+    size_t bufferCount,
+    VkBuffer VMA_NULLABLE_NON_DISPATCHABLE* VMA_NOT_NULL VMA_LEN_IF_NOT_NULL(bufferCount) pBuffers,
+    VmaAllocation VMA_NULLABLE* VMA_NOT_NULL VMA_LEN_IF_NOT_NULL(bufferCount) pAllocations,
+    VmaAllocationInfo* VMA_NULLABLE VMA_LEN_IF_NOT_NULL(bufferCount) pAllocationInfos);
+
+/** \brief Destroys multiple Vulkan buffers and frees their memory.
+
+It is equivalent to calling vmaDestroyBuffer() for each pair of `pBuffers[i]`, `pAllocations[i]`,
+but allocations are freed together, like in vmaFreeMemoryPages().
+
+Passing null handles as elements of the arrays is valid. Such entries are just skipped.
+*/
+VMA_CALL_PRE void VMA_CALL_POST vmaDestroyBuffers(
+    VmaAllocator VMA_NOT_NULL allocator,
+    size_t bufferCount,
+    const VkBuffer VMA_NULLABLE_NON_DISPATCHABLE* VMA_NOT_NULL VMA_LEN_IF_NOT_NULL(bufferCount) pBuffers,
+    const VmaAllocation VMA_NULLABLE* VMA_NOT_NULL VMA_LEN_IF_NOT_NULL(bufferCount) pAllocations);
+
+/// Function similar to vmaCreateBuffer().
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaCreateImage(
+    VmaAllocator VMA_NOT_NULL allocator,
+    const VkImageCreateInfo* VMA_NOT_NULL pImageCreateInfo,
+    const VmaAllocationCreateInfo* VMA_NOT_NULL pAllocationCreateInfo,
+    VkImage VMA_NULLABLE_NON_DISPATCHABLE* VMA_NOT_NULL pImage,
+    VmaAllocation VMA_NULLABLE* VMA_NOT_NULL pAllocation,
     VmaAllocationInfo* VMA_NULLABLE pAllocationInfo);
 
 /// Function similar to vmaCreateAliasingBuffer() but for images.
@@ -2435,6 +3294,148 @@ VMA_CALL_PRE void VMA_CALL_POST vmaDestroyImage(
     VkImage VMA_NULLABLE_NON_DISPATCHABLE image,
     VmaAllocation VMA_NULLABLE allocation);
 
+/** \brief Creates a sparse buffer without any memory bound to it.
+
+\param allocator
+\param pBufferCreateInfo Must have `VK_BUFFER_CREATE_SPARSE_BINDING_BIT` set in `flags`.
+\param pAllocationCreateInfo Parameters used for allocations backing pages of the buffer.
+  #VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT, #VMA_ALLOCATION_CREATE_MAPPED_BIT and
+  #VMA_ALLOCATION_CREATE_CAN_BE_DEMOTED_BIT are not allowed.
+  If VmaAllocationCreateInfo::pool is used, the pool must outlive the resource.
+\param[out] pBuffer Buffer that was created.
+\param[out] pResource Object tracking pages of the buffer. Must be destroyed with vmaDestroySparseResource().
+
+Memory is added with vmaCommitSparsePages() and bound with vmaBindSparsePages(),
+so the buffer may span much more address space than there is memory.
+For more information, see [Sparse resources](@ref sparse_resources).
+*/
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaCreateSparseBuffer(
+    VmaAllocator VMA_NOT_NULL allocator,
+    const VkBufferCreateInfo* VMA_NOT_NULL pBufferCreateInfo,
+    const VmaAllocationCreateInfo* VMA_NOT_NULL pAllocationCreateInfo,
+    VkBuffer VMA_NULLABLE_NON_DISPATCHABLE* VMA_NOT_NULL pBuffer,
+    VmaSparseResource VMA_NULLABLE* VMA_NOT_NULL pResource);
+
+/** \brief Function similar to vmaCreateSparseBuffer(), but for images.
+
+`pImageCreateInfo->flags` must contain `VK_IMAGE_CREATE_SPARSE_BINDING_BIT`.
+Pages are bound as opaque ranges of the image memory.
+
+For an image created with `VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT`, mip levels above the mip tail
+are backed tile by tile with vmaCommitSparseImageRegion(), which requires VmaVulkanFunctions::vkGetImageSparseMemoryRequirements.
+Pages back the mip tail and metadata, calculating page index from `VkSparseImageMemoryRequirements::imageMipTailOffset`.
+*/
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaCreateSparseImage(
+    VmaAllocator VMA_NOT_NULL allocator,
+    const VkImageCreateInfo* VMA_NOT_NULL pImageCreateInfo,
+    const VmaAllocationCreateInfo* VMA_NOT_NULL pAllocationCreateInfo,
+    VkImage VMA_NULLABLE_NON_DISPATCHABLE* VMA_NOT_NULL pImage,
+    VmaSparseResource VMA_NULLABLE* VMA_NOT_NULL pResource);
+
+/** \brief Destroys the sparse buffer or image and frees all its pages.
+
+It is safe to pass null as resource.
+The resource must not be in use by the GPU anymore, as well as any binding submitted for it.
+*/
+VMA_CALL_PRE void VMA_CALL_POST vmaDestroySparseResource(
+    VmaAllocator VMA_NOT_NULL allocator,
+    VmaSparseResource VMA_NULLABLE resource);
+
+/// Returns page size and the number of pages of the sparse resource.
+VMA_CALL_PRE void VMA_CALL_POST vmaGetSparseResourceInfo(
+    VmaAllocator VMA_NOT_NULL allocator,
+    VmaSparseResource VMA_NOT_NULL resource,
+    VmaSparseResourceInfo* VMA_NOT_NULL pInfo);
+
+/** \brief Allocates memory for a range of pages of the sparse resource.
+
+\param allocator
+\param resource
+\param firstPage Index of the first page, in units of VmaSparseResourceInfo::pageSize.
+\param pageCount Number of pages. `firstPage + pageCount` must not exceed VmaSparseResourceInfo::pageCount.
+
+Pages that are already committed are left untouched. If memory for any page cannot be allocated,
+none of them is committed and error is returned.
+The memory becomes bound to the resource after the next vmaBindSparsePages().
+*/
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaCommitSparsePages(
+    VmaAllocator VMA_NOT_NULL allocator,
+    VmaSparseResource VMA_NOT_NULL resource,
+    VkDeviceSize firstPage,
+    VkDeviceSize pageCount);
+
+/** \brief Releases memory of a range of pages of the sparse resource.
+
+Pages that are not committed are ignored. The pages get unbound by the next vmaBindSparsePages().
+Their memory is not freed before the GPU executes that binding:
+if VmaAllocatorCreateInfo::deferredFreeFrameCount is not 0, it is queued for deferred freeing
+after the binding is submitted, just like with vmaFreeMemory(),
+otherwise it is kept until vmaFreeUnboundSparsePages() or vmaDestroySparseResource().
+*/
+VMA_CALL_PRE void VMA_CALL_POST vmaDecommitSparsePages(
+    VmaAllocator VMA_NOT_NULL allocator,
+    VmaSparseResource VMA_NOT_NULL resource,
+    VkDeviceSize firstPage,
+    VkDeviceSize pageCount);
+
+/** \brief Allocates memory for tiles of a region of an image created with `VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT`.
+
+Every tile, of size `VkSparseImageFormatProperties::imageGranularity`, is backed by its own page-sized allocation.
+Tiles that are already committed are left untouched. If memory for any tile cannot be allocated,
+none of them is committed and error is returned.
+The memory becomes bound to the image with `VkSparseImageMemoryBind` after the next vmaBindSparsePages().
+*/
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaCommitSparseImageRegion(
+    VmaAllocator VMA_NOT_NULL allocator,
+    VmaSparseResource VMA_NOT_NULL resource,
+    const VmaSparseImageRegion* VMA_NOT_NULL pRegion);
+
+/** \brief Releases memory of tiles of a region of an image created with `VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT`.
+
+Tiles that are not committed are ignored. Memory of the tiles is released like in vmaDecommitSparsePages().
+*/
+VMA_CALL_PRE void VMA_CALL_POST vmaDecommitSparseImageRegion(
+    VmaAllocator VMA_NOT_NULL allocator,
+    VmaSparseResource VMA_NOT_NULL resource,
+    const VmaSparseImageRegion* VMA_NOT_NULL pRegion);
+
+/** \brief Binds and unbinds pages changed since the previous call, for all given resources in a single `vkQueueBindSparse`.
+
+\param allocator
+\param queue Queue supporting `VK_QUEUE_SPARSE_BINDING_BIT`.
+\param resourceCount
+\param pResources
+\param pSubmitInfo Optional. Semaphores and fence of the batch.
+
+Adjacent pages placed next to each other in the same `VkDeviceMemory` are bound with a single `VkSparseMemoryBind`.
+Tiles of images are bound with one `VkSparseImageMemoryBind` each.
+If there are no changes and no synchronization is requested, `vkQueueBindSparse` is not called.
+If the call fails, the changes remain pending.
+
+The binding executes asynchronously, so memory of decommitted pages and tiles is not freed by this call.
+See vmaDecommitSparsePages().
+
+Requires VmaVulkanFunctions::vkQueueBindSparse.
+Access to `queue` must be externally synchronized.
+*/
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaBindSparsePages(
+    VmaAllocator VMA_NOT_NULL allocator,
+    VkQueue VMA_NOT_NULL queue,
+    uint32_t resourceCount,
+    const VmaSparseResource VMA_NOT_NULL* VMA_NULLABLE VMA_LEN_IF_NOT_NULL(resourceCount) pResources,
+    const VmaSparseBindSubmitInfo* VMA_NULLABLE pSubmitInfo);
+
+/** \brief Frees memory of pages and tiles unbound by previous calls to vmaBindSparsePages().
+
+Call it once the GPU has executed these bindings, e.g. after their fence or semaphore has signaled.
+Not needed when VmaAllocatorCreateInfo::deferredFreeFrameCount is not 0,
+because the memory is then released by deferred freeing.
+*/
+VMA_CALL_PRE void VMA_CALL_POST vmaFreeUnboundSparsePages(
+    VmaAllocator VMA_NOT_NULL allocator,
+    uint32_t resourceCount,
+    const VmaSparseResource VMA_NOT_NULL* VMA_NULLABLE VMA_LEN_IF_NOT_NULL(resourceCount) pResources);
+
 /** @} */
 
 /**
@@ -2534,6 +3535,39 @@ VMA_CALL_PRE void VMA_CALL_POST vmaCalculateVirtualBlockStatistics(
     VmaVirtualBlock VMA_NOT_NULL virtualBlock,
     VmaDetailedStatistics* VMA_NOT_NULL pStats);
 
+/** \brief Computes moves of virtual allocations towards the beginning of the block.
+
+\param virtualBlock Virtual block.
+\param pInfo Parameters of the pass.
+\param[out] pPassInfo Computed moves.
+\returns
+- `VK_SUCCESS` if no more moves are possible. Then you don't need to call vmaEndVirtualBlockDefragmentationPass().
+- `VK_INCOMPLETE` if there are moves returned in `pPassInfo`. You need to perform them and call vmaEndVirtualBlockDefragmentationPass().
+- `VK_ERROR_FEATURE_NOT_PRESENT` if the block was created with #VMA_VIRTUAL_BLOCK_CREATE_LINEAR_ALGORITHM_BIT.
+
+Destination places are reserved in the block until the pass is ended, so the layout stays valid during the whole pass.
+Don't free the allocations returned in `pPassInfo` until then.
+
+For more information, see \ref virtual_allocator_defragmentation.
+*/
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaBeginVirtualBlockDefragmentationPass(
+    VmaVirtualBlock VMA_NOT_NULL virtualBlock,
+    const VmaVirtualDefragmentationInfo* VMA_NOT_NULL pInfo,
+    VmaVirtualDefragmentationPassMoveInfo* VMA_NOT_NULL pPassInfo);
+
+/** \brief Commits moves of the pass started with vmaBeginVirtualBlockDefragmentationPass().
+
+\param virtualBlock Virtual block.
+\param pPassInfo Moves of the pass, with VmaVirtualDefragmentationMove::operation possibly changed by you.
+
+All moves are applied at once: for #VMA_DEFRAGMENTATION_MOVE_OPERATION_COPY source allocation is freed,
+for #VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE destination allocation is freed,
+for #VMA_DEFRAGMENTATION_MOVE_OPERATION_DESTROY both are freed.
+*/
+VMA_CALL_PRE void VMA_CALL_POST vmaEndVirtualBlockDefragmentationPass(
+    VmaVirtualBlock VMA_NOT_NULL virtualBlock,
+    VmaVirtualDefragmentationPassMoveInfo* VMA_NOT_NULL pPassInfo);
+
 /** @} */
 
 #if VMA_STATS_STRING_ENABLED
@@ -2573,6 +3607,39 @@ VMA_CALL_PRE void VMA_CALL_POST vmaFreeStatsString(
     VmaAllocator VMA_NOT_NULL allocator,
     char* VMA_NULLABLE pStatsString);
 
+/** \brief Writes statistics in JSON format through a callback, in parts, instead of building one string.
+\param allocator
+\param pfnWrite Function called with consecutive parts of the string, without null terminator.
+\param pUserData Passed to `pfnWrite`.
+\param detailedMap
+
+Produces the same document as vmaBuildStatsString(), but never holds more than one
+block or dedicated allocation list of it in memory at a time.
+Suballocations of each block are copied under the lock of the block and formatted after it is released,
+and `pfnWrite` is never called with a lock held that allocations wait for,
+so it can be slow, e.g. write to a file, without stalling allocations.
+Every block is described consistently, but the whole document is not an atomic snapshot
+of the allocator when other threads allocate or free memory in the meantime:
+blocks created during the call are omitted and blocks freed during the call may be missing.
+
+`pfnWrite` must not call any functions of the library on this allocator that create or destroy custom pools.
+*/
+VMA_CALL_PRE void VMA_CALL_POST vmaWriteStatsString(
+    VmaAllocator VMA_NOT_NULL allocator,
+    PFN_vmaWriteStatsStringFunction VMA_NOT_NULL pfnWrite,
+    void* VMA_NULLABLE pUserData,
+    VkBool32 detailedMap);
+
+/** \brief Writes statistics of a #VmaVirtualBlock in JSON format through a callback, in parts.
+
+Produces the same document as vmaBuildVirtualBlockStatsString(). See vmaWriteStatsString().
+*/
+VMA_CALL_PRE void VMA_CALL_POST vmaWriteVirtualBlockStatsString(
+    VmaVirtualBlock VMA_NOT_NULL virtualBlock,
+    PFN_vmaWriteStatsStringFunction VMA_NOT_NULL pfnWrite,
+    void* VMA_NULLABLE pUserData,
+    VkBool32 detailedMap);
+
 /** @} */
 
 #endif // VMA_STATS_STRING_ENABLED
@@ -2607,6 +3674,12 @@ VMA_CALL_PRE void VMA_CALL_POST vmaFreeStatsString(
 #include <utility>
 #include <type_traits>
 
+#if VMA_RECORDING_ENABLED
+    #include <cstdio>
+    #include <thread>
+    #include <functional> // For std::hash
+#endif
+
 #ifdef _MSC_VER
     #include <intrin.h> // For functions like __popcnt, _BitScanForward etc.
 #endif
@@ -2947,6 +4020,21 @@ If providing your own implementation, you need to implement a subset of std::ato
     #define VMA_ATOMIC_UINT64 std::atomic<uint64_t>
 #endif
 
+#ifndef VMA_ATOMIC_POINTER
+    #include <atomic>
+    #define VMA_ATOMIC_POINTER std::atomic<void*>
+#endif
+
+/*
+Returns monotonic time in nanoseconds as uint64_t. Used only to respect time budgets,
+e.g. VmaDefragmentationExecutorCreateInfo::maxStepDuration.
+*/
+#ifndef VMA_TIME_NANOSECONDS
+    #include <chrono>
+    #define VMA_TIME_NANOSECONDS() ((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>( \
+        std::chrono::steady_clock::now().time_since_epoch()).count())
+#endif
+
 #ifndef VMA_DEBUG_ALWAYS_DEDICATED_MEMORY
     /**
     Every allocation will have its own memory block.
@@ -3026,6 +4114,16 @@ If providing your own implementation, you need to implement a subset of std::ato
    #define VMA_DEFAULT_LARGE_HEAP_BLOCK_SIZE (256ull * 1024 * 1024)
 #endif
 
+#ifndef VMA_THREAD_CACHE_MAX_ALLOCATION_SIZE
+   /// Maximum size of an allocation served from per-thread caches, see #VMA_ALLOCATOR_CREATE_THREAD_CACHE_BIT.
+   #define VMA_THREAD_CACHE_MAX_ALLOCATION_SIZE (64ull * 1024)
+#endif
+
+#ifndef VMA_THREAD_CACHE_MAGAZINE_BYTES
+   /// Maximum number of bytes held by a single per-thread magazine of one memory type and size class.
+   #define VMA_THREAD_CACHE_MAGAZINE_BYTES (256ull * 1024)
+#endif
+
 /*
 Mapping hysteresis is a logic that launches when vmaMapMemory/vmaUnmapMemory is called
 or a persistently mapped allocation is created and destroyed several times in a row.
@@ -3069,6 +4167,13 @@ static const int32_t VK_IMAGE_TILING_DRM_FORMAT_MODIFIER_EXT_COPY = 1000158000;
 static const uint32_t VMA_ALLOCATION_INTERNAL_STRATEGY_MIN_OFFSET = 0x10000000u;
 static const uint32_t VMA_ALLOCATION_TRY_COUNT = 32;
 static const uint32_t VMA_VENDOR_ID_AMD = 4098;
+// Size classes of per-thread caches are 256 B, 384 B, 512 B, 768 B, 1 KiB, ...
+static const VkDeviceSize VMA_THREAD_CACHE_MIN_CLASS_SIZE = 256;
+static const uint32_t VMA_THREAD_CACHE_MAX_CLASS_COUNT = 32;
+static const uint32_t VMA_THREAD_CACHE_MAX_MAGAZINE_CAPACITY = 32;
+static const uint32_t VMA_THREAD_LOCAL_SLOT_COUNT = 4;
+static const uint32_t VMA_CACHE_LINE_SIZE = 64;
+static const uint32_t VMA_BUDGET_SHARD_COUNT = 16;
 
 // This one is tricky. Vulkan specification defines this code as available since
 // Vulkan 1.0, but doesn't actually define it in Vulkan SDK earlier than 1.2.131.
@@ -3120,6 +4225,8 @@ enum class VmaAllocationRequestType
     UpperAddress,
     EndOf1st,
     EndOf2nd,
+    // Used by "Slab" algorithm.
+    Slab,
 };
 
 #endif // _VMA_ENUM_DECLARATIONS
@@ -3189,9 +4296,13 @@ typedef VmaList<VmaSuballocation, VmaStlAllocator<VmaSuballocation>> VmaSuballoc
 
 struct VmaAllocationRequest;
 
+class VmaStatisticsCounters;
+
 class VmaBlockMetadata;
 class VmaBlockMetadata_Linear;
+class VmaBlockMetadata_Buddy;
 class VmaBlockMetadata_TLSF;
+class VmaBlockMetadata_Slab;
 
 class VmaBlockVector;
 
@@ -3201,6 +4312,9 @@ struct VmaCurrentBudgetData;
 
 class VmaAllocationObjectAllocator;
 
+struct VmaThreadCacheMagazine;
+class VmaThreadCache;
+
 #endif // _VMA_FORWARD_DECLARATIONS
 
 
@@ -4173,7 +5287,7 @@ void VmaVector<T, AllocatorT>::reserve(size_t newCapacity, bool freeMemory)
 
     if (newCapacity != m_Capacity)
     {
-        T* const newArray = newCapacity ? VmaAllocateArray<T>(m_Allocator, newCapacity) : VMA_NULL;
+        T* const newArray = newCapacity ? VmaAllocateArray<T>(m_Allocator.m_pCallbacks, newCapacity) : VMA_NULL;
         if (m_Count != 0)
         {
             memcpy(newArray, m_pArray, m_Count * sizeof(T));
@@ -5383,6 +6497,8 @@ class VmaStringBuilder
 {
 public:
     VmaStringBuilder(const VkAllocationCallbacks* allocationCallbacks) : m_Data(VmaStlAllocator<char>(allocationCallbacks)) {}
+    // Streaming mode: text is passed to pfnWrite by Flush() and FlushIfNeeded() instead of being kept.
+    VmaStringBuilder(const VkAllocationCallbacks* allocationCallbacks, PFN_vmaWriteStatsStringFunction pfnWrite, void* pUserData);
     ~VmaStringBuilder() = default;
 
     size_t GetLength() const { return m_Data.size(); }
@@ -5395,11 +6511,37 @@ public:
     void AddNumber(uint64_t num);
     void AddPointer(const void* ptr);
 
+    // Call only where no lock is held, as the callback may take arbitrary time.
+    void FlushIfNeeded() { if (m_Data.size() >= STREAM_CHUNK_SIZE) Flush(); }
+    void Flush();
+
 private:
+    static const size_t STREAM_CHUNK_SIZE = 64 * 1024;
+
     VmaVector<char, VmaStlAllocator<char>> m_Data;
+    PFN_vmaWriteStatsStringFunction m_pfnWrite = VMA_NULL;
+    void* m_pUserData = VMA_NULL;
 };
 
 #ifndef _VMA_STRING_BUILDER_FUNCTIONS
+VmaStringBuilder::VmaStringBuilder(const VkAllocationCallbacks* allocationCallbacks,
+    PFN_vmaWriteStatsStringFunction pfnWrite, void* pUserData)
+    : m_Data(VmaStlAllocator<char>(allocationCallbacks)),
+    m_pfnWrite(pfnWrite),
+    m_pUserData(pUserData)
+{
+    m_Data.reserve(STREAM_CHUNK_SIZE * 2);
+}
+
+void VmaStringBuilder::Flush()
+{
+    if (m_pfnWrite != VMA_NULL && !m_Data.empty())
+    {
+        m_pfnWrite(m_pUserData, m_Data.data(), m_Data.size());
+        m_Data.clear();
+    }
+}
+
 void VmaStringBuilder::Add(const char* pStr)
 {
     const size_t strLen = strlen(pStr);
@@ -5503,6 +6645,10 @@ public:
     // Writes a null value.
     void WriteNull();
 
+    // Passes the document written so far to the callback of a streaming VmaStringBuilder.
+    // Call only where no lock is held.
+    void FlushIfNeeded() { m_SB.FlushIfNeeded(); }
+
 private:
     enum COLLECTION_TYPE
     {
@@ -5924,13 +7070,16 @@ Thread-safety:
 class VmaDeviceMemoryBlock
 {
     VMA_CLASS_NO_COPY(VmaDeviceMemoryBlock)
+    friend struct VmaDefragmentationExecutor_T;
 public:
     VmaBlockMetadata* m_pMetadata;
+    // Position in m_Blocks of the parent VmaBlockVector, maintained by it.
+    size_t m_BlockVectorIndex;
 
     VmaDeviceMemoryBlock(VmaAllocator hAllocator);
     ~VmaDeviceMemoryBlock();
 
-    // Always call after construction.
+    // Always call after construction. pStatisticsCounters is optional and must outlive this block.
     void Init(
         VmaAllocator hAllocator,
         VmaPool hParentPool,
@@ -5939,12 +7088,14 @@ public:
         VkDeviceSize newSize,
         uint32_t id,
         uint32_t algorithm,
-        VkDeviceSize bufferImageGranularity);
+        VkDeviceSize bufferImageGranularity,
+        VmaStatisticsCounters* pStatisticsCounters);
     // Always call before destruction.
     void Destroy(VmaAllocator allocator);
 
     VmaPool GetParentPool() const { return m_hParentPool; }
     VkDeviceMemory GetDeviceMemory() const { return m_hMemory; }
+    VMA_MUTEX& GetMetadataMutex() { return m_MetadataMutex; }
     uint32_t GetMemoryTypeIndex() const { return m_MemoryTypeIndex; }
     uint32_t GetId() const { return m_Id; }
     void* GetMappedData() const { return m_pMappedData; }
@@ -5978,6 +7129,13 @@ public:
         VkDeviceSize allocationLocalOffset,
         VkImage hImage,
         const void* pNext);
+#if VMA_VULKAN_VERSION >= 1001000 || VMA_BIND_MEMORY2
+    // Binds multiple buffers to m_hMemory with a single vkBindBufferMemory2 call.
+    VkResult BindBufferMemories(
+        const VmaAllocator hAllocator,
+        uint32_t bindInfoCount,
+        const VkBindBufferMemoryInfoKHR* pBindInfos);
+#endif
 
 private:
     VmaPool m_hParentPool; // VK_NULL_HANDLE if not belongs to custom pool.
@@ -5987,13 +7145,20 @@ private:
 
     /*
     Protects access to m_hMemory so it is not used by multiple threads simultaneously, e.g. vkMapMemory, vkBindBufferMemory.
-    Also protects m_MapCount, m_pMappedData.
-    Allocations, deallocations, any change in m_pMetadata is protected by parent's VmaBlockVector::m_Mutex.
+    Also protects m_MapCount and writes to m_pMappedData.
     */
     VMA_MUTEX m_MapAndBindMutex;
+    /*
+    Protects m_pMetadata: allocations, deallocations, reading statistics.
+    Taken while holding parent's VmaBlockVector::m_Mutex for reading, so threads working on different blocks
+    don't wait for each other. Holding VmaBlockVector::m_Mutex for writing gives exclusive access to all its blocks.
+    Lock order: VmaBlockVector::m_Mutex, m_MetadataMutex, m_MapAndBindMutex.
+    */
+    VMA_MUTEX m_MetadataMutex;
     VmaMappingHysteresis m_MappingHysteresis;
     uint32_t m_MapCount;
-    void* m_pMappedData;
+    // Atomic because allocations read it without m_MapAndBindMutex, e.g. to prefer mapped blocks.
+    VMA_ATOMIC_POINTER m_pMappedData;
 };
 #endif // _VMA_DEVICE_MEMORY_BLOCK
 
@@ -6006,6 +7171,8 @@ struct VmaAllocation_T
     {
         FLAG_PERSISTENT_MAP   = 0x01,
         FLAG_MAPPING_ALLOWED  = 0x02,
+        FLAG_CAN_BE_DEMOTED   = 0x04,
+        FLAG_NOT_MOVABLE      = 0x08,
     };
 
 public:
@@ -6051,7 +7218,21 @@ public:
 
     void SetUserData(VmaAllocator hAllocator, void* pUserData) { m_pUserData = pUserData; }
     void SetName(VmaAllocator hAllocator, const char* pName);
+
+    // Marks the allocation as movable by VmaResidencyManager_T between memory types from memoryTypeBits.
+    void InitResidency(uint32_t memoryTypeBits, uint32_t frameIndex);
+    bool CanBeDemoted() const { return (m_Flags & FLAG_CAN_BE_DEMOTED) != 0; }
+    // Called when the allocation is being freed, so VmaResidencyManager_T no longer considers it.
+    void ClearCanBeDemoted() { m_Flags &= (uint8_t)~FLAG_CAN_BE_DEMOTED; }
+    uint32_t GetResidencyMemoryTypeBits() const { return m_ResidencyMemoryTypeBits; }
+    void Touch(uint32_t frameIndex) { m_LastUseFrameIndex = frameIndex; }
+    uint32_t GetLastUseFrameIndex() const { return m_LastUseFrameIndex.load(); }
+    // Excludes the allocation from defragmentation, e.g. when memory is bound by the library itself.
+    void SetNotMovable() { m_Flags |= (uint8_t)FLAG_NOT_MOVABLE; }
+    bool IsMovable() const { return (m_Flags & FLAG_NOT_MOVABLE) == 0; }
     void FreeName(VmaAllocator hAllocator);
+    // Clears state left by the previous owner of a block allocation parked in a per-thread cache.
+    void ResetCachedBlockAllocation(bool mappingAllowed);
     uint8_t SwapBlockAllocation(VmaAllocator hAllocator, VmaAllocation allocation);
     VmaAllocHandle GetAllocHandle() const;
     VkDeviceSize GetOffset() const;
@@ -6105,6 +7286,10 @@ private:
     // Reference counter for vmaMapMemory()/vmaUnmapMemory().
     uint8_t m_MapCount;
     uint8_t m_Flags; // enum FLAGS
+    // Frame index of the last vmaTouchAllocation(). Used only with FLAG_CAN_BE_DEMOTED.
+    VMA_ATOMIC_UINT32 m_LastUseFrameIndex;
+    // Memory types the allocation can be moved to. Used only with FLAG_CAN_BE_DEMOTED.
+    uint32_t m_ResidencyMemoryTypeBits;
 #if VMA_STATS_STRING_ENABLED
     uint32_t m_BufferImageUsage; // 0 if unknown.
 #endif
@@ -6324,209 +7509,540 @@ struct VmaAllocationRequest
 };
 #endif // _VMA_ALLOCATION_REQUEST
 
-#ifndef _VMA_BLOCK_METADATA
+#ifndef _VMA_STATISTICS_COUNTERS
 /*
-Data structure used for bookkeeping of allocations and unused ranges of memory
-in a single VkDeviceMemory block.
+Running totals of allocations and unused ranges in all the blocks that share it,
+updated by block metadata on every change, so VmaDetailedStatistics of a whole
+block vector can be read in constant time.
+
+Sizes of allocations and unused ranges are also counted in a histogram of classes,
+8 classes per power of 2, to be able to find minimum and maximum after a removal.
+Those are reported as the lower bound of their class.
+
+Used with VMA_ALLOCATOR_CREATE_INCREMENTAL_STATISTICS_BIT. Blocks update it under their own
+metadata locks, so a reader sees every counter atomically, but not all of them from the same moment.
 */
-class VmaBlockMetadata
+class VmaStatisticsCounters
 {
+    VMA_CLASS_NO_COPY(VmaStatisticsCounters)
 public:
-    // pAllocationCallbacks, if not null, must be owned externally - alive and unchanged for the whole lifetime of this object.
-    VmaBlockMetadata(const VkAllocationCallbacks* pAllocationCallbacks,
-        VkDeviceSize bufferImageGranularity, bool isVirtual);
-    virtual ~VmaBlockMetadata() = default;
-
-    virtual void Init(VkDeviceSize size) { m_Size = size; }
-    bool IsVirtual() const { return m_IsVirtual; }
-    VkDeviceSize GetSize() const { return m_Size; }
-
-    // Validates all data structures inside this object. If not valid, returns false.
-    virtual bool Validate() const = 0;
-    virtual size_t GetAllocationCount() const = 0;
-    virtual size_t GetFreeRegionsCount() const = 0;
-    virtual VkDeviceSize GetSumFreeSize() const = 0;
-    // Returns true if this block is empty - contains only single free suballocation.
-    virtual bool IsEmpty() const = 0;
-    virtual void GetAllocationInfo(VmaAllocHandle allocHandle, VmaVirtualAllocationInfo& outInfo) = 0;
-    virtual VkDeviceSize GetAllocationOffset(VmaAllocHandle allocHandle) const = 0;
-    virtual void* GetAllocationUserData(VmaAllocHandle allocHandle) const = 0;
-
-    virtual VmaAllocHandle GetAllocationListBegin() const = 0;
-    virtual VmaAllocHandle GetNextAllocation(VmaAllocHandle prevAlloc) const = 0;
-    virtual VkDeviceSize GetNextFreeRegionSize(VmaAllocHandle alloc) const = 0;
-
-    // Shouldn't modify blockCount.
-    virtual void AddDetailedStatistics(VmaDetailedStatistics& inoutStats) const = 0;
-    virtual void AddStatistics(VmaStatistics& inoutStats) const = 0;
-
-#if VMA_STATS_STRING_ENABLED
-    virtual void PrintDetailedMap(class VmaJsonWriter& json) const = 0;
-#endif
-
-    // Tries to find a place for suballocation with given parameters inside this block.
-    // If succeeded, fills pAllocationRequest and returns true.
-    // If failed, returns false.
-    virtual bool CreateAllocationRequest(
-        VkDeviceSize allocSize,
-        VkDeviceSize allocAlignment,
-        bool upperAddress,
-        VmaSuballocationType allocType,
-        // Always one of VMA_ALLOCATION_CREATE_STRATEGY_* or VMA_ALLOCATION_INTERNAL_STRATEGY_* flags.
-        uint32_t strategy,
-        VmaAllocationRequest* pAllocationRequest) = 0;
-
-    virtual VkResult CheckCorruption(const void* pBlockData) = 0;
-
-    // Makes actual allocation based on request. Request must already be checked and valid.
-    virtual void Alloc(
-        const VmaAllocationRequest& request,
-        VmaSuballocationType type,
-        void* userData) = 0;
-
-    // Frees suballocation assigned to given memory region.
-    virtual void Free(VmaAllocHandle allocHandle) = 0;
-
-    // Frees all allocations.
-    // Careful! Don't call it if there are VmaAllocation objects owned by userData of cleared allocations!
-    virtual void Clear() = 0;
+    VmaStatisticsCounters();
 
-    virtual void SetAllocationUserData(VmaAllocHandle allocHandle, void* userData) = 0;
-    virtual void DebugLogAllAllocations() const = 0;
+    void AddBlock(VkDeviceSize size) { ++m_BlockCount; m_BlockBytes += size; }
+    void RemoveBlock(VkDeviceSize size) { --m_BlockCount; m_BlockBytes -= size; }
+    void AddAllocation(VkDeviceSize size);
+    void RemoveAllocation(VkDeviceSize size);
+    void AddUnusedRange(VkDeviceSize size) { ++m_UnusedRangeCount; ++m_UnusedRangeClasses[SizeToClass(size)]; }
+    void RemoveUnusedRange(VkDeviceSize size) { --m_UnusedRangeCount; --m_UnusedRangeClasses[SizeToClass(size)]; }
 
-protected:
-    const VkAllocationCallbacks* GetAllocationCallbacks() const { return m_pAllocationCallbacks; }
-    VkDeviceSize GetBufferImageGranularity() const { return m_BufferImageGranularity; }
-    VkDeviceSize GetDebugMargin() const { return IsVirtual() ? 0 : VMA_DEBUG_MARGIN; }
+    // Unlike VmaBlockMetadata::AddDetailedStatistics, adds blockCount too.
+    void AddStatistics(VmaStatistics& inoutStats) const;
+    void AddDetailedStatistics(VmaDetailedStatistics& inoutStats) const;
 
-    void DebugLogAllocation(VkDeviceSize offset, VkDeviceSize size, void* userData) const;
-#if VMA_STATS_STRING_ENABLED
-    // mapRefCount == UINT32_MAX means unspecified.
-    void PrintDetailedMap_Begin(class VmaJsonWriter& json,
-        VkDeviceSize unusedBytes,
-        size_t allocationCount,
-        size_t unusedRangeCount) const;
-    void PrintDetailedMap_Allocation(class VmaJsonWriter& json,
-        VkDeviceSize offset, VkDeviceSize size, void* userData) const;
-    void PrintDetailedMap_UnusedRange(class VmaJsonWriter& json,
-        VkDeviceSize offset,
-        VkDeviceSize size) const;
-    void PrintDetailedMap_End(class VmaJsonWriter& json) const;
-#endif
+    static uint32_t SizeToClass(VkDeviceSize size);
+    // Returns the smallest size that falls into given class.
+    static VkDeviceSize ClassToSize(uint32_t sizeClass);
 
 private:
-    VkDeviceSize m_Size;
-    const VkAllocationCallbacks* m_pAllocationCallbacks;
-    const VkDeviceSize m_BufferImageGranularity;
-    const bool m_IsVirtual;
+    // Sizes below 16 have a class each, then 8 classes for every power of 2 up to 2^63.
+    static const uint32_t SIZE_CLASS_COUNT = 496;
+
+    VMA_ATOMIC_UINT32 m_BlockCount;
+    VMA_ATOMIC_UINT32 m_AllocationCount;
+    VMA_ATOMIC_UINT32 m_UnusedRangeCount;
+    VMA_ATOMIC_UINT64 m_BlockBytes;
+    VMA_ATOMIC_UINT64 m_AllocationBytes;
+    VMA_ATOMIC_UINT32 m_AllocationClasses[SIZE_CLASS_COUNT];
+    VMA_ATOMIC_UINT32 m_UnusedRangeClasses[SIZE_CLASS_COUNT];
 };
 
-#ifndef _VMA_BLOCK_METADATA_FUNCTIONS
-VmaBlockMetadata::VmaBlockMetadata(const VkAllocationCallbacks* pAllocationCallbacks,
-    VkDeviceSize bufferImageGranularity, bool isVirtual)
-    : m_Size(0),
-    m_pAllocationCallbacks(pAllocationCallbacks),
-    m_BufferImageGranularity(bufferImageGranularity),
-    m_IsVirtual(isVirtual) {}
-
-void VmaBlockMetadata::DebugLogAllocation(VkDeviceSize offset, VkDeviceSize size, void* userData) const
+#ifndef _VMA_STATISTICS_COUNTERS_FUNCTIONS
+VmaStatisticsCounters::VmaStatisticsCounters()
+    : m_BlockCount(0),
+    m_AllocationCount(0),
+    m_UnusedRangeCount(0),
+    m_BlockBytes(0),
+    m_AllocationBytes(0)
 {
-    if (IsVirtual())
+    for (uint32_t i = 0; i < SIZE_CLASS_COUNT; ++i)
     {
-        VMA_DEBUG_LOG("UNFREED VIRTUAL ALLOCATION; Offset: %llu; Size: %llu; UserData: %p", offset, size, userData);
+        m_AllocationClasses[i] = 0;
+        m_UnusedRangeClasses[i] = 0;
     }
-    else
-    {
-        VMA_ASSERT(userData != VMA_NULL);
-        VmaAllocation allocation = reinterpret_cast<VmaAllocation>(userData);
+}
 
-        userData = allocation->GetUserData();
-        const char* name = allocation->GetName();
+void VmaStatisticsCounters::AddAllocation(VkDeviceSize size)
+{
+    ++m_AllocationCount;
+    m_AllocationBytes += size;
+    ++m_AllocationClasses[SizeToClass(size)];
+}
 
-#if VMA_STATS_STRING_ENABLED
-        VMA_DEBUG_LOG("UNFREED ALLOCATION; Offset: %llu; Size: %llu; UserData: %p; Name: %s; Type: %s; Usage: %u",
-            offset, size, userData, name ? name : "vma_empty",
-            VMA_SUBALLOCATION_TYPE_NAMES[allocation->GetSuballocationType()],
-            allocation->GetBufferImageUsage());
-#else
-        VMA_DEBUG_LOG("UNFREED ALLOCATION; Offset: %llu; Size: %llu; UserData: %p; Name: %s; Type: %u",
-            offset, size, userData, name ? name : "vma_empty",
-            (uint32_t)allocation->GetSuballocationType());
-#endif // VMA_STATS_STRING_ENABLED
-    }
+void VmaStatisticsCounters::RemoveAllocation(VkDeviceSize size)
+{
+    --m_AllocationCount;
+    m_AllocationBytes -= size;
+    --m_AllocationClasses[SizeToClass(size)];
+}
 
+void VmaStatisticsCounters::AddStatistics(VmaStatistics& inoutStats) const
+{
+    inoutStats.blockCount += m_BlockCount;
+    inoutStats.allocationCount += m_AllocationCount;
+    inoutStats.blockBytes += m_BlockBytes;
+    inoutStats.allocationBytes += m_AllocationBytes;
 }
 
-#if VMA_STATS_STRING_ENABLED
-void VmaBlockMetadata::PrintDetailedMap_Begin(class VmaJsonWriter& json,
-    VkDeviceSize unusedBytes, size_t allocationCount, size_t unusedRangeCount) const
+void VmaStatisticsCounters::AddDetailedStatistics(VmaDetailedStatistics& inoutStats) const
 {
-    json.WriteString("TotalBytes");
-    json.WriteNumber(GetSize());
+    AddStatistics(inoutStats.statistics);
+    inoutStats.unusedRangeCount += m_UnusedRangeCount;
 
-    json.WriteString("UnusedBytes");
-    json.WriteSize(unusedBytes);
+    for (uint32_t i = 0; i < SIZE_CLASS_COUNT; ++i)
+    {
+        if (m_AllocationClasses[i] != 0)
+        {
+            inoutStats.allocationSizeMin = VMA_MIN(inoutStats.allocationSizeMin, ClassToSize(i));
+            break;
+        }
+    }
+    for (uint32_t i = SIZE_CLASS_COUNT; i--; )
+    {
+        if (m_AllocationClasses[i] != 0)
+        {
+            inoutStats.allocationSizeMax = VMA_MAX(inoutStats.allocationSizeMax, ClassToSize(i));
+            break;
+        }
+    }
+    for (uint32_t i = 0; i < SIZE_CLASS_COUNT; ++i)
+    {
+        if (m_UnusedRangeClasses[i] != 0)
+        {
+            inoutStats.unusedRangeSizeMin = VMA_MIN(inoutStats.unusedRangeSizeMin, ClassToSize(i));
+            break;
+        }
+    }
+    for (uint32_t i = SIZE_CLASS_COUNT; i--; )
+    {
+        if (m_UnusedRangeClasses[i] != 0)
+        {
+            inoutStats.unusedRangeSizeMax = VMA_MAX(inoutStats.unusedRangeSizeMax, ClassToSize(i));
+            break;
+        }
+    }
+}
+
+uint32_t VmaStatisticsCounters::SizeToClass(VkDeviceSize size)
+{
+    if (size < 16)
+        return (uint32_t)size;
+    // Top 4 bits of the size select the class within its power of 2.
+    const uint32_t shift = VMA_BITSCAN_MSB(size) - 3;
+    return shift * 8 + (uint32_t)(size >> shift);
+}
+
+VkDeviceSize VmaStatisticsCounters::ClassToSize(uint32_t sizeClass)
+{
+    if (sizeClass < 16)
+        return sizeClass;
+    const uint32_t shift = sizeClass / 8 - 1;
+    return (VkDeviceSize)(sizeClass % 8 + 8) << shift;
+}
+#endif // _VMA_STATISTICS_COUNTERS_FUNCTIONS
+#endif // _VMA_STATISTICS_COUNTERS
+
+#if VMA_STATS_STRING_ENABLED
+#ifndef _VMA_BLOCK_DETAILED_MAP
+/*
+Receives the suballocations of a block from VmaBlockMetadata::PrintDetailedMap().
+Either writes them straight to JSON, or keeps a copy that Write() formats later,
+so a block of VmaBlockVector is only copied under its lock and formatted after the lock is released.
+*/
+class VmaBlockDetailedMap
+{
+    VMA_CLASS_NO_COPY(VmaBlockDetailedMap)
+public:
+    // Writes suballocations to json as they come. Used for virtual blocks, which are synchronized externally.
+    VmaBlockDetailedMap(VmaJsonWriter& json);
+    // Keeps a copy of suballocations until Write().
+    VmaBlockDetailedMap(const VkAllocationCallbacks* pAllocationCallbacks);
+    ~VmaBlockDetailedMap() = default;
+
+    void Begin(VkDeviceSize blockSize, VkDeviceSize unusedBytes, size_t allocationCount, size_t unusedRangeCount);
+    // userData is VmaAllocation unless isVirtual.
+    void AddAllocation(VkDeviceSize offset, VkDeviceSize size, void* userData, bool isVirtual);
+    void AddUnusedRange(VkDeviceSize offset, VkDeviceSize size);
+    void End();
+
+    // Writes the copy to json and clears it, so the next block can be captured with the same memory.
+    void Write(VmaJsonWriter& json);
+
+private:
+    struct Suballocation
+    {
+        VkDeviceSize offset;
+        // Size of the VmaAllocation for allocations of non-virtual blocks.
+        VkDeviceSize size;
+        void* pUserData;
+        // Offset of null-terminated name in m_Names, SIZE_MAX if there is none.
+        size_t nameOffset;
+        uint32_t bufferImageUsage;
+        // VMA_SUBALLOCATION_TYPE_FREE for unused ranges.
+        VmaSuballocationType type;
+        bool isVirtual;
+    };
+
+    VmaJsonWriter* const m_pJson;
+    VkDeviceSize m_BlockSize;
+    VkDeviceSize m_UnusedBytes;
+    size_t m_AllocationCount;
+    size_t m_UnusedRangeCount;
+    VmaVector<Suballocation, VmaStlAllocator<Suballocation>> m_Suballocations;
+    VmaVector<char, VmaStlAllocator<char>> m_Names;
+
+    void WriteBegin(VmaJsonWriter& json) const;
+    void WriteSuballocation(VmaJsonWriter& json, const Suballocation& suballoc, const char* pName) const;
+    void AddSuballocation(const Suballocation& suballoc, const char* pName);
+};
+
+#ifndef _VMA_BLOCK_DETAILED_MAP_FUNCTIONS
+VmaBlockDetailedMap::VmaBlockDetailedMap(VmaJsonWriter& json)
+    : m_pJson(&json),
+    m_BlockSize(0),
+    m_UnusedBytes(0),
+    m_AllocationCount(0),
+    m_UnusedRangeCount(0),
+    m_Suballocations(VmaStlAllocator<Suballocation>(VMA_NULL)),
+    m_Names(VmaStlAllocator<char>(VMA_NULL)) {}
+
+VmaBlockDetailedMap::VmaBlockDetailedMap(const VkAllocationCallbacks* pAllocationCallbacks)
+    : m_pJson(VMA_NULL),
+    m_BlockSize(0),
+    m_UnusedBytes(0),
+    m_AllocationCount(0),
+    m_UnusedRangeCount(0),
+    m_Suballocations(VmaStlAllocator<Suballocation>(pAllocationCallbacks)),
+    m_Names(VmaStlAllocator<char>(pAllocationCallbacks)) {}
+
+void VmaBlockDetailedMap::Begin(VkDeviceSize blockSize, VkDeviceSize unusedBytes, size_t allocationCount, size_t unusedRangeCount)
+{
+    m_BlockSize = blockSize;
+    m_UnusedBytes = unusedBytes;
+    m_AllocationCount = allocationCount;
+    m_UnusedRangeCount = unusedRangeCount;
+    if (m_pJson)
+        WriteBegin(*m_pJson);
+    else
+        m_Suballocations.reserve(allocationCount + unusedRangeCount);
+}
+
+void VmaBlockDetailedMap::AddAllocation(VkDeviceSize offset, VkDeviceSize size, void* userData, bool isVirtual)
+{
+    Suballocation suballoc = {};
+    suballoc.offset = offset;
+    suballoc.nameOffset = SIZE_MAX;
+    suballoc.isVirtual = isVirtual;
+    if (isVirtual)
+    {
+        suballoc.size = size;
+        suballoc.pUserData = userData;
+        AddSuballocation(suballoc, VMA_NULL);
+    }
+    else
+    {
+        const VmaAllocation allocation = (VmaAllocation)userData;
+        suballoc.size = allocation->GetSize();
+        suballoc.pUserData = allocation->GetUserData();
+        suballoc.bufferImageUsage = allocation->GetBufferImageUsage();
+        suballoc.type = allocation->GetSuballocationType();
+        AddSuballocation(suballoc, allocation->GetName());
+    }
+}
+
+void VmaBlockDetailedMap::AddUnusedRange(VkDeviceSize offset, VkDeviceSize size)
+{
+    Suballocation suballoc = {};
+    suballoc.offset = offset;
+    suballoc.size = size;
+    suballoc.nameOffset = SIZE_MAX;
+    suballoc.type = VMA_SUBALLOCATION_TYPE_FREE;
+    AddSuballocation(suballoc, VMA_NULL);
+}
+
+void VmaBlockDetailedMap::End()
+{
+    if (m_pJson)
+        m_pJson->EndArray();
+}
+
+void VmaBlockDetailedMap::Write(VmaJsonWriter& json)
+{
+    VMA_ASSERT(m_pJson == VMA_NULL);
+    WriteBegin(json);
+    for (size_t i = 0; i < m_Suballocations.size(); ++i)
+    {
+        const Suballocation& suballoc = m_Suballocations[i];
+        WriteSuballocation(json, suballoc, suballoc.nameOffset != SIZE_MAX ? m_Names.data() + suballoc.nameOffset : VMA_NULL);
+    }
+    json.EndArray();
+    m_Suballocations.clear();
+    m_Names.clear();
+}
+
+void VmaBlockDetailedMap::WriteBegin(VmaJsonWriter& json) const
+{
+    json.WriteString("TotalBytes");
+    json.WriteNumber(m_BlockSize);
+
+    json.WriteString("UnusedBytes");
+    json.WriteSize(m_UnusedBytes);
 
     json.WriteString("Allocations");
-    json.WriteSize(allocationCount);
+    json.WriteSize(m_AllocationCount);
 
     json.WriteString("UnusedRanges");
-    json.WriteSize(unusedRangeCount);
+    json.WriteSize(m_UnusedRangeCount);
 
     json.WriteString("Suballocations");
     json.BeginArray();
 }
 
-void VmaBlockMetadata::PrintDetailedMap_Allocation(class VmaJsonWriter& json,
-    VkDeviceSize offset, VkDeviceSize size, void* userData) const
+void VmaBlockDetailedMap::WriteSuballocation(VmaJsonWriter& json, const Suballocation& suballoc, const char* pName) const
 {
     json.BeginObject(true);
 
     json.WriteString("Offset");
-    json.WriteNumber(offset);
+    json.WriteNumber(suballoc.offset);
 
-    if (IsVirtual())
+    if (suballoc.type == VMA_SUBALLOCATION_TYPE_FREE)
+    {
+        json.WriteString("Type");
+        json.WriteString(VMA_SUBALLOCATION_TYPE_NAMES[VMA_SUBALLOCATION_TYPE_FREE]);
+
+        json.WriteString("Size");
+        json.WriteNumber(suballoc.size);
+    }
+    else if (suballoc.isVirtual)
     {
         json.WriteString("Size");
-        json.WriteNumber(size);
-        if (userData)
+        json.WriteNumber(suballoc.size);
+        if (suballoc.pUserData)
         {
             json.WriteString("CustomData");
             json.BeginString();
-            json.ContinueString_Pointer(userData);
+            json.ContinueString_Pointer(suballoc.pUserData);
             json.EndString();
         }
     }
     else
     {
-        ((VmaAllocation)userData)->PrintParameters(json);
+        // Same as VmaAllocation_T::PrintParameters().
+        json.WriteString("Type");
+        json.WriteString(VMA_SUBALLOCATION_TYPE_NAMES[suballoc.type]);
+
+        json.WriteString("Size");
+        json.WriteNumber(suballoc.size);
+        json.WriteString("Usage");
+        json.WriteNumber(suballoc.bufferImageUsage);
+
+        if (suballoc.pUserData != VMA_NULL)
+        {
+            json.WriteString("CustomData");
+            json.BeginString();
+            json.ContinueString_Pointer(suballoc.pUserData);
+            json.EndString();
+        }
+        if (pName != VMA_NULL)
+        {
+            json.WriteString("Name");
+            json.WriteString(pName);
+        }
     }
 
     json.EndObject();
 }
 
-void VmaBlockMetadata::PrintDetailedMap_UnusedRange(class VmaJsonWriter& json,
-    VkDeviceSize offset, VkDeviceSize size) const
+void VmaBlockDetailedMap::AddSuballocation(const Suballocation& suballoc, const char* pName)
 {
-    json.BeginObject(true);
+    if (m_pJson)
+    {
+        WriteSuballocation(*m_pJson, suballoc, pName);
+        // No lock is held in this mode.
+        m_pJson->FlushIfNeeded();
+        return;
+    }
 
-    json.WriteString("Offset");
-    json.WriteNumber(offset);
+    m_Suballocations.push_back(suballoc);
+    if (pName != VMA_NULL)
+    {
+        const size_t nameLength = strlen(pName) + 1;
+        m_Suballocations.back().nameOffset = m_Names.size();
+        m_Names.resize(m_Names.size() + nameLength);
+        memcpy(m_Names.data() + m_Suballocations.back().nameOffset, pName, nameLength);
+    }
+}
+#endif // _VMA_BLOCK_DETAILED_MAP_FUNCTIONS
+#endif // _VMA_BLOCK_DETAILED_MAP
+#endif // VMA_STATS_STRING_ENABLED
 
-    json.WriteString("Type");
-    json.WriteString(VMA_SUBALLOCATION_TYPE_NAMES[VMA_SUBALLOCATION_TYPE_FREE]);
+#ifndef _VMA_BLOCK_METADATA
+/*
+Data structure used for bookkeeping of allocations and unused ranges of memory
+in a single VkDeviceMemory block.
+*/
+class VmaBlockMetadata
+{
+public:
+    // pAllocationCallbacks, if not null, must be owned externally - alive and unchanged for the whole lifetime of this object.
+    VmaBlockMetadata(const VkAllocationCallbacks* pAllocationCallbacks,
+        VkDeviceSize bufferImageGranularity, bool isVirtual);
+    virtual ~VmaBlockMetadata();
 
-    json.WriteString("Size");
-    json.WriteNumber(size);
+    // Optional. Must be called before Init, pStatisticsCounters must outlive this object.
+    void SetStatisticsCounters(VmaStatisticsCounters* pStatisticsCounters) { m_pStatisticsCounters = pStatisticsCounters; }
+    virtual void Init(VkDeviceSize size);
+    bool IsVirtual() const { return m_IsVirtual; }
+    VkDeviceSize GetSize() const { return m_Size; }
 
-    json.EndObject();
+    // Validates all data structures inside this object. If not valid, returns false.
+    virtual bool Validate() const = 0;
+    virtual size_t GetAllocationCount() const = 0;
+    virtual size_t GetFreeRegionsCount() const = 0;
+    virtual VkDeviceSize GetSumFreeSize() const = 0;
+    // Returns size of the largest free region or, if an algorithm can't tell it quickly, an upper bound of it.
+    virtual VkDeviceSize GetMaxFreeRegionSize() const { return GetSumFreeSize(); }
+    // Returns true if this block is empty - contains only single free suballocation.
+    virtual bool IsEmpty() const = 0;
+    virtual void GetAllocationInfo(VmaAllocHandle allocHandle, VmaVirtualAllocationInfo& outInfo) = 0;
+    virtual VkDeviceSize GetAllocationOffset(VmaAllocHandle allocHandle) const = 0;
+    virtual void* GetAllocationUserData(VmaAllocHandle allocHandle) const = 0;
+
+    virtual VmaAllocHandle GetAllocationListBegin() const = 0;
+    virtual VmaAllocHandle GetNextAllocation(VmaAllocHandle prevAlloc) const = 0;
+    virtual VkDeviceSize GetNextFreeRegionSize(VmaAllocHandle alloc) const = 0;
+
+    // Shouldn't modify blockCount.
+    virtual void AddDetailedStatistics(VmaDetailedStatistics& inoutStats) const = 0;
+    virtual void AddStatistics(VmaStatistics& inoutStats) const = 0;
+
+#if VMA_STATS_STRING_ENABLED
+    virtual void PrintDetailedMap(class VmaBlockDetailedMap& map) const = 0;
+#endif
+
+    // Tries to find a place for suballocation with given parameters inside this block.
+    // If succeeded, fills pAllocationRequest and returns true.
+    // If failed, returns false.
+    virtual bool CreateAllocationRequest(
+        VkDeviceSize allocSize,
+        VkDeviceSize allocAlignment,
+        bool upperAddress,
+        VmaSuballocationType allocType,
+        // Always one of VMA_ALLOCATION_CREATE_STRATEGY_* or VMA_ALLOCATION_INTERNAL_STRATEGY_* flags.
+        uint32_t strategy,
+        VmaAllocationRequest* pAllocationRequest) = 0;
+
+    virtual VkResult CheckCorruption(const void* pBlockData) = 0;
+
+    // Makes actual allocation based on request. Request must already be checked and valid.
+    virtual void Alloc(
+        const VmaAllocationRequest& request,
+        VmaSuballocationType type,
+        void* userData) = 0;
+
+    // Frees suballocation assigned to given memory region.
+    virtual void Free(VmaAllocHandle allocHandle) = 0;
+
+    // Frees all allocations.
+    // Careful! Don't call it if there are VmaAllocation objects owned by userData of cleared allocations!
+    virtual void Clear() = 0;
+
+    virtual void SetAllocationUserData(VmaAllocHandle allocHandle, void* userData) = 0;
+    virtual void DebugLogAllAllocations() const = 0;
+
+protected:
+    const VkAllocationCallbacks* GetAllocationCallbacks() const { return m_pAllocationCallbacks; }
+    VkDeviceSize GetBufferImageGranularity() const { return m_BufferImageGranularity; }
+    VkDeviceSize GetDebugMargin() const { return IsVirtual() ? 0 : VMA_DEBUG_MARGIN; }
+
+    // To be called by derived classes on every change of their allocations and unused ranges.
+    bool HasStatisticsCounters() const { return m_pStatisticsCounters != VMA_NULL; }
+    void TrackAllocation(VkDeviceSize size) { if (m_pStatisticsCounters) m_pStatisticsCounters->AddAllocation(size); }
+    void UntrackAllocation(VkDeviceSize size) { if (m_pStatisticsCounters) m_pStatisticsCounters->RemoveAllocation(size); }
+    void TrackUnusedRange(VkDeviceSize size) { if (m_pStatisticsCounters) m_pStatisticsCounters->AddUnusedRange(size); }
+    void UntrackUnusedRange(VkDeviceSize size) { if (m_pStatisticsCounters) m_pStatisticsCounters->RemoveUnusedRange(size); }
+
+    void DebugLogAllocation(VkDeviceSize offset, VkDeviceSize size, void* userData) const;
+#if VMA_STATS_STRING_ENABLED
+    void PrintDetailedMap_Begin(class VmaBlockDetailedMap& map,
+        VkDeviceSize unusedBytes,
+        size_t allocationCount,
+        size_t unusedRangeCount) const { map.Begin(GetSize(), unusedBytes, allocationCount, unusedRangeCount); }
+    void PrintDetailedMap_Allocation(class VmaBlockDetailedMap& map,
+        VkDeviceSize offset, VkDeviceSize size, void* userData) const { map.AddAllocation(offset, size, userData, IsVirtual()); }
+    void PrintDetailedMap_UnusedRange(class VmaBlockDetailedMap& map,
+        VkDeviceSize offset,
+        VkDeviceSize size) const { map.AddUnusedRange(offset, size); }
+    void PrintDetailedMap_End(class VmaBlockDetailedMap& map) const { map.End(); }
+#endif
+
+private:
+    VkDeviceSize m_Size;
+    const VkAllocationCallbacks* m_pAllocationCallbacks;
+    const VkDeviceSize m_BufferImageGranularity;
+    const bool m_IsVirtual;
+    VmaStatisticsCounters* m_pStatisticsCounters;
+};
+
+#ifndef _VMA_BLOCK_METADATA_FUNCTIONS
+VmaBlockMetadata::VmaBlockMetadata(const VkAllocationCallbacks* pAllocationCallbacks,
+    VkDeviceSize bufferImageGranularity, bool isVirtual)
+    : m_Size(0),
+    m_pAllocationCallbacks(pAllocationCallbacks),
+    m_BufferImageGranularity(bufferImageGranularity),
+    m_IsVirtual(isVirtual),
+    m_pStatisticsCounters(VMA_NULL) {}
+
+VmaBlockMetadata::~VmaBlockMetadata()
+{
+    if (m_pStatisticsCounters)
+        m_pStatisticsCounters->RemoveBlock(m_Size);
 }
 
-void VmaBlockMetadata::PrintDetailedMap_End(class VmaJsonWriter& json) const
+void VmaBlockMetadata::Init(VkDeviceSize size)
 {
-    json.EndArray();
+    m_Size = size;
+    if (m_pStatisticsCounters)
+        m_pStatisticsCounters->AddBlock(size);
 }
+
+void VmaBlockMetadata::DebugLogAllocation(VkDeviceSize offset, VkDeviceSize size, void* userData) const
+{
+    if (IsVirtual())
+    {
+        VMA_DEBUG_LOG("UNFREED VIRTUAL ALLOCATION; Offset: %llu; Size: %llu; UserData: %p", offset, size, userData);
+    }
+    else
+    {
+        VMA_ASSERT(userData != VMA_NULL);
+        VmaAllocation allocation = reinterpret_cast<VmaAllocation>(userData);
+
+        userData = allocation->GetUserData();
+        const char* name = allocation->GetName();
+
+#if VMA_STATS_STRING_ENABLED
+        VMA_DEBUG_LOG("UNFREED ALLOCATION; Offset: %llu; Size: %llu; UserData: %p; Name: %s; Type: %s; Usage: %u",
+            offset, size, userData, name ? name : "vma_empty",
+            VMA_SUBALLOCATION_TYPE_NAMES[allocation->GetSuballocationType()],
+            allocation->GetBufferImageUsage());
+#else
+        VMA_DEBUG_LOG("UNFREED ALLOCATION; Offset: %llu; Size: %llu; UserData: %p; Name: %s; Type: %u",
+            offset, size, userData, name ? name : "vma_empty",
+            (uint32_t)allocation->GetSuballocationType());
 #endif // VMA_STATS_STRING_ENABLED
+    }
+
+}
+
 #endif // _VMA_BLOCK_METADATA_FUNCTIONS
 #endif // _VMA_BLOCK_METADATA
 
@@ -7629,7 +9145,7 @@ public:
     void AddStatistics(VmaStatistics& inoutStats) const override;
 
 #if VMA_STATS_STRING_ENABLED
-    void PrintDetailedMap(class VmaJsonWriter& json) const override;
+    void PrintDetailedMap(class VmaBlockDetailedMap& map) const override;
 #endif
 
     bool CreateAllocationRequest(
@@ -8216,7 +9732,7 @@ void VmaBlockMetadata_Linear::AddStatistics(VmaStatistics& inoutStats) const
 }
 
 #if VMA_STATS_STRING_ENABLED
-void VmaBlockMetadata_Linear::PrintDetailedMap(class VmaJsonWriter& json) const
+void VmaBlockMetadata_Linear::PrintDetailedMap(class VmaBlockDetailedMap& map) const
 {
     const VkDeviceSize size = GetSize();
     const SuballocationVectorType& suballocations1st = AccessSuballocations1st();
@@ -8378,7 +9894,7 @@ void VmaBlockMetadata_Linear::PrintDetailedMap(class VmaJsonWriter& json) const
     }
 
     const VkDeviceSize unusedBytes = size - usedBytes;
-    PrintDetailedMap_Begin(json, unusedBytes, alloc1stCount + alloc2ndCount, unusedRangeCount);
+    PrintDetailedMap_Begin(map, unusedBytes, alloc1stCount + alloc2ndCount, unusedRangeCount);
 
     // SECOND PASS
     lastOffset = 0;
@@ -8406,12 +9922,12 @@ void VmaBlockMetadata_Linear::PrintDetailedMap(class VmaJsonWriter& json) const
                 {
                     // There is free space from lastOffset to suballoc.offset.
                     const VkDeviceSize unusedRangeSize = suballoc.offset - lastOffset;
-                    PrintDetailedMap_UnusedRange(json, lastOffset, unusedRangeSize);
+                    PrintDetailedMap_UnusedRange(map, lastOffset, unusedRangeSize);
                 }
 
                 // 2. Process this allocation.
                 // There is allocation with suballoc.offset, suballoc.size.
-                PrintDetailedMap_Allocation(json, suballoc.offset, suballoc.size, suballoc.userData);
+                PrintDetailedMap_Allocation(map, suballoc.offset, suballoc.size, suballoc.userData);
 
                 // 3. Prepare for next iteration.
                 lastOffset = suballoc.offset + suballoc.size;
@@ -8424,7 +9940,7 @@ void VmaBlockMetadata_Linear::PrintDetailedMap(class VmaJsonWriter& json) const
                 {
                     // There is free space from lastOffset to freeSpace2ndTo1stEnd.
                     const VkDeviceSize unusedRangeSize = freeSpace2ndTo1stEnd - lastOffset;
-                    PrintDetailedMap_UnusedRange(json, lastOffset, unusedRangeSize);
+                    PrintDetailedMap_UnusedRange(map, lastOffset, unusedRangeSize);
                 }
 
                 // End of loop.
@@ -8453,12 +9969,12 @@ void VmaBlockMetadata_Linear::PrintDetailedMap(class VmaJsonWriter& json) const
             {
                 // There is free space from lastOffset to suballoc.offset.
                 const VkDeviceSize unusedRangeSize = suballoc.offset - lastOffset;
-                PrintDetailedMap_UnusedRange(json, lastOffset, unusedRangeSize);
+                PrintDetailedMap_UnusedRange(map, lastOffset, unusedRangeSize);
             }
 
             // 2. Process this allocation.
             // There is allocation with suballoc.offset, suballoc.size.
-            PrintDetailedMap_Allocation(json, suballoc.offset, suballoc.size, suballoc.userData);
+            PrintDetailedMap_Allocation(map, suballoc.offset, suballoc.size, suballoc.userData);
 
             // 3. Prepare for next iteration.
             lastOffset = suballoc.offset + suballoc.size;
@@ -8471,7 +9987,7 @@ void VmaBlockMetadata_Linear::PrintDetailedMap(class VmaJsonWriter& json) const
             {
                 // There is free space from lastOffset to freeSpace1stTo2ndEnd.
                 const VkDeviceSize unusedRangeSize = freeSpace1stTo2ndEnd - lastOffset;
-                PrintDetailedMap_UnusedRange(json, lastOffset, unusedRangeSize);
+                PrintDetailedMap_UnusedRange(map, lastOffset, unusedRangeSize);
             }
 
             // End of loop.
@@ -8501,12 +10017,12 @@ void VmaBlockMetadata_Linear::PrintDetailedMap(class VmaJsonWriter& json) const
                 {
                     // There is free space from lastOffset to suballoc.offset.
                     const VkDeviceSize unusedRangeSize = suballoc.offset - lastOffset;
-                    PrintDetailedMap_UnusedRange(json, lastOffset, unusedRangeSize);
+                    PrintDetailedMap_UnusedRange(map, lastOffset, unusedRangeSize);
                 }
 
                 // 2. Process this allocation.
                 // There is allocation with suballoc.offset, suballoc.size.
-                PrintDetailedMap_Allocation(json, suballoc.offset, suballoc.size, suballoc.userData);
+                PrintDetailedMap_Allocation(map, suballoc.offset, suballoc.size, suballoc.userData);
 
                 // 3. Prepare for next iteration.
                 lastOffset = suballoc.offset + suballoc.size;
@@ -8519,7 +10035,7 @@ void VmaBlockMetadata_Linear::PrintDetailedMap(class VmaJsonWriter& json) const
                 {
                     // There is free space from lastOffset to size.
                     const VkDeviceSize unusedRangeSize = size - lastOffset;
-                    PrintDetailedMap_UnusedRange(json, lastOffset, unusedRangeSize);
+                    PrintDetailedMap_UnusedRange(map, lastOffset, unusedRangeSize);
                 }
 
                 // End of loop.
@@ -8528,7 +10044,7 @@ void VmaBlockMetadata_Linear::PrintDetailedMap(class VmaJsonWriter& json) const
         }
     }
 
-    PrintDetailedMap_End(json);
+    PrintDetailedMap_End(map);
 }
 #endif // VMA_STATS_STRING_ENABLED
 
@@ -9253,7 +10769,6 @@ bool VmaBlockMetadata_Linear::CreateAllocationRequest_UpperAddress(
 #endif // _VMA_BLOCK_METADATA_LINEAR_FUNCTIONS
 #endif // _VMA_BLOCK_METADATA_LINEAR
 
-#if 0
 #ifndef _VMA_BLOCK_METADATA_BUDDY
 /*
 - GetSize() is the original size of allocated memory block.
@@ -9275,9 +10790,11 @@ public:
     virtual ~VmaBlockMetadata_Buddy();
 
     size_t GetAllocationCount() const override { return m_AllocationCount; }
+    size_t GetFreeRegionsCount() const override { return m_FreeCount + (GetUnusableSize() > 0 ? 1 : 0); }
     VkDeviceSize GetSumFreeSize() const override { return m_SumFreeSize + GetUnusableSize(); }
+    VkDeviceSize GetMaxFreeRegionSize() const override;
     bool IsEmpty() const override { return m_Root->type == Node::TYPE_FREE; }
-    VkResult CheckCorruption(const void* pBlockData) override { return VK_ERROR_FEATURE_NOT_PRESENT; }
+    VkResult CheckCorruption(const void* pBlockData) override;
     VkDeviceSize GetAllocationOffset(VmaAllocHandle allocHandle) const override { return (VkDeviceSize)allocHandle - 1; };
     void DebugLogAllAllocations() const override { DebugLogAllAllocationNode(m_Root, 0); }
 
@@ -9288,7 +10805,7 @@ public:
     void AddStatistics(VmaStatistics& inoutStats) const override;
 
 #if VMA_STATS_STRING_ENABLED
-    void PrintDetailedMap(class VmaJsonWriter& json, uint32_t mapRefCount) const override;
+    void PrintDetailedMap(class VmaBlockDetailedMap& map) const override;
 #endif
 
     bool CreateAllocationRequest(
@@ -9309,6 +10826,7 @@ public:
     void* GetAllocationUserData(VmaAllocHandle allocHandle) const override;
     VmaAllocHandle GetAllocationListBegin() const override;
     VmaAllocHandle GetNextAllocation(VmaAllocHandle prevAlloc) const override;
+    VkDeviceSize GetNextFreeRegionSize(VmaAllocHandle alloc) const override;
     void Clear() override;
     void SetAllocationUserData(VmaAllocHandle allocHandle, void* userData) override;
 
@@ -9383,10 +10901,16 @@ private:
         return VmaNextPow2(size);
     }
     Node* FindAllocationNode(VkDeviceSize offset, uint32_t& outLevel) const;
+    // Returns leftmost node of the subtree that is not split.
+    const Node* FindFirstLeaf(const Node* node, uint32_t& inoutLevel) const;
+    // Returns root of the subtree that directly follows given node in order of offsets, or null if it is the last one.
+    const Node* FindNextSubtree(const Node* node, uint32_t& inoutLevel) const;
     void DeleteNodeChildren(Node* node);
     bool ValidateNode(ValidationContext& ctx, const Node* parent, const Node* curr, uint32_t level, VkDeviceSize levelNodeSize) const;
     uint32_t AllocSizeToLevel(VkDeviceSize allocSize) const;
     void AddNodeToDetailedStatistics(VmaDetailedStatistics& inoutStats, const Node* node, VkDeviceSize levelNodeSize) const;
+    // Removes node and its children from statistics counters.
+    void UntrackNode(const Node* node, VkDeviceSize levelNodeSize);
     // Adds node to the front of FreeList at given level.
     // node->type must be FREE.
     // node->free.prev, next can be undefined.
@@ -9398,7 +10922,7 @@ private:
     void DebugLogAllAllocationNode(Node* node, uint32_t level) const;
 
 #if VMA_STATS_STRING_ENABLED
-    void PrintDetailedMapNode(class VmaJsonWriter& json, const Node* node, VkDeviceSize levelNodeSize) const;
+    void PrintDetailedMapNode(class VmaBlockDetailedMap& map, const Node* node, VkDeviceSize levelNodeSize) const;
 #endif
 };
 
@@ -9417,10 +10941,27 @@ VmaBlockMetadata_Buddy::VmaBlockMetadata_Buddy(const VkAllocationCallbacks* pAll
 
 VmaBlockMetadata_Buddy::~VmaBlockMetadata_Buddy()
 {
+    if (HasStatisticsCounters())
+    {
+        UntrackNode(m_Root, LevelToNodeSize(0));
+        if (GetUnusableSize() > 0)
+            UntrackUnusedRange(GetUnusableSize());
+    }
     DeleteNodeChildren(m_Root);
     m_NodeAllocator.Free(m_Root);
 }
 
+VkDeviceSize VmaBlockMetadata_Buddy::GetMaxFreeRegionSize() const
+{
+    // Lower levels have larger nodes.
+    for (uint32_t level = 0; level < m_LevelCount; ++level)
+    {
+        if (m_FreeList[level].front != VMA_NULL)
+            return LevelToNodeSize(level);
+    }
+    return 0;
+}
+
 void VmaBlockMetadata_Buddy::Init(VkDeviceSize size)
 {
     VmaBlockMetadata::Init(size);
@@ -9445,6 +10986,9 @@ void VmaBlockMetadata_Buddy::Init(VkDeviceSize size)
 
     m_Root = rootNode;
     AddToFreeListFront(0, rootNode);
+
+    if (GetUnusableSize() > 0)
+        TrackUnusedRange(GetUnusableSize());
 }
 
 bool VmaBlockMetadata_Buddy::Validate() const
@@ -9507,34 +11051,34 @@ void VmaBlockMetadata_Buddy::AddStatistics(VmaStatistics& inoutStats) const
     inoutStats.blockCount++;
     inoutStats.allocationCount += (uint32_t)m_AllocationCount;
     inoutStats.blockBytes += GetSize();
-    inoutStats.allocationBytes += GetSize() - m_SumFreeSize;
+    // Unusable tail is reported as an unused range by AddDetailedStatistics(), not as allocated.
+    inoutStats.allocationBytes += m_UsableSize - m_SumFreeSize;
 }
 
 #if VMA_STATS_STRING_ENABLED
-void VmaBlockMetadata_Buddy::PrintDetailedMap(class VmaJsonWriter& json, uint32_t mapRefCount) const
+void VmaBlockMetadata_Buddy::PrintDetailedMap(class VmaBlockDetailedMap& map) const
 {
     VmaDetailedStatistics stats;
     VmaClearDetailedStatistics(stats);
     AddDetailedStatistics(stats);
 
     PrintDetailedMap_Begin(
-        json,
+        map,
         stats.statistics.blockBytes - stats.statistics.allocationBytes,
         stats.statistics.allocationCount,
-        stats.unusedRangeCount,
-        mapRefCount);
+        stats.unusedRangeCount);
 
-    PrintDetailedMapNode(json, m_Root, LevelToNodeSize(0));
+    PrintDetailedMapNode(map, m_Root, LevelToNodeSize(0));
 
     const VkDeviceSize unusableSize = GetUnusableSize();
     if (unusableSize > 0)
     {
-        PrintDetailedMap_UnusedRange(json,
+        PrintDetailedMap_UnusedRange(map,
             m_UsableSize, // offset
             unusableSize); // size
     }
 
-    PrintDetailedMap_End(json);
+    PrintDetailedMap_End(map);
 }
 #endif // VMA_STATS_STRING_ENABLED
 
@@ -9547,8 +11091,10 @@ bool VmaBlockMetadata_Buddy::CreateAllocationRequest(
     VmaAllocationRequest* pAllocationRequest)
 {
     VMA_ASSERT(!upperAddress && "VMA_ALLOCATION_CREATE_UPPER_ADDRESS_BIT can be used only with linear algorithm.");
+    // Free lists are searched from the smallest fitting level anyway, so all strategies behave the same.
+    (void)strategy;
 
-    allocSize = AlignAllocationSize(allocSize);
+    allocSize = AlignAllocationSize(allocSize + GetDebugMargin());
 
     // Simple way to respect bufferImageGranularity. May be optimized some day.
     // Whenever it might be an OPTIMAL image...
@@ -9565,8 +11111,9 @@ bool VmaBlockMetadata_Buddy::CreateAllocationRequest(
         return false;
     }
 
+    // Prefer smallest free node that fits, so larger ones stay available.
     const uint32_t targetLevel = AllocSizeToLevel(allocSize);
-    for (uint32_t level = targetLevel; level--; )
+    for (uint32_t level = targetLevel + 1; level--; )
     {
         for (Node* freeNode = m_FreeList[level].front;
             freeNode != VMA_NULL;
@@ -9576,8 +11123,9 @@ bool VmaBlockMetadata_Buddy::CreateAllocationRequest(
             {
                 pAllocationRequest->type = VmaAllocationRequestType::Normal;
                 pAllocationRequest->allocHandle = (VmaAllocHandle)(freeNode->offset + 1);
-                pAllocationRequest->size = allocSize;
+                pAllocationRequest->size = LevelToNodeSize(targetLevel) - GetDebugMargin();
                 pAllocationRequest->customData = (void*)(uintptr_t)level;
+                pAllocationRequest->algorithmData = targetLevel;
                 return true;
             }
         }
@@ -9592,8 +11140,10 @@ void VmaBlockMetadata_Buddy::Alloc(
     void* userData)
 {
     VMA_ASSERT(request.type == VmaAllocationRequestType::Normal);
+    // bufferImageGranularity was already respected in CreateAllocationRequest(), so type is not needed.
+    (void)type;
 
-    const uint32_t targetLevel = AllocSizeToLevel(request.size);
+    const uint32_t targetLevel = (uint32_t)request.algorithmData;
     uint32_t currLevel = (uint32_t)(uintptr_t)request.customData;
 
     Node* currNode = m_FreeList[currLevel].front;
@@ -9658,7 +11208,8 @@ void VmaBlockMetadata_Buddy::Alloc(
 
     ++m_AllocationCount;
     --m_FreeCount;
-    m_SumFreeSize -= request.size;
+    m_SumFreeSize -= LevelToNodeSize(targetLevel);
+    TrackAllocation(LevelToNodeSize(targetLevel));
 }
 
 void VmaBlockMetadata_Buddy::GetAllocationInfo(VmaAllocHandle allocHandle, VmaVirtualAllocationInfo& outInfo)
@@ -9666,7 +11217,7 @@ void VmaBlockMetadata_Buddy::GetAllocationInfo(VmaAllocHandle allocHandle, VmaVi
     uint32_t level = 0;
     outInfo.offset = (VkDeviceSize)allocHandle - 1;
     const Node* const node = FindAllocationNode(outInfo.offset, level);
-    outInfo.size = LevelToNodeSize(level);
+    outInfo.size = LevelToNodeSize(level) - GetDebugMargin();
     outInfo.pUserData = node->allocation.userData;
 }
 
@@ -9679,23 +11230,81 @@ void* VmaBlockMetadata_Buddy::GetAllocationUserData(VmaAllocHandle allocHandle)
 
 VmaAllocHandle VmaBlockMetadata_Buddy::GetAllocationListBegin() const
 {
-    // Function only used for defragmentation, which is disabled for this algorithm
-    return VK_NULL_HANDLE;
+    uint32_t level = 0;
+    for (const Node* node = FindFirstLeaf(m_Root, level); node != VMA_NULL; node = FindFirstLeaf(FindNextSubtree(node, level), level))
+    {
+        if (node->type == Node::TYPE_ALLOCATION)
+            return (VmaAllocHandle)(node->offset + 1);
+    }
+    return VK_NULL_HANDLE;
 }
 
 VmaAllocHandle VmaBlockMetadata_Buddy::GetNextAllocation(VmaAllocHandle prevAlloc) const
 {
-    // Function only used for defragmentation, which is disabled for this algorithm
+    uint32_t level = 0;
+    const Node* node = FindAllocationNode((VkDeviceSize)prevAlloc - 1, level);
+    while ((node = FindFirstLeaf(FindNextSubtree(node, level), level)) != VMA_NULL)
+    {
+        if (node->type == Node::TYPE_ALLOCATION)
+            return (VmaAllocHandle)(node->offset + 1);
+    }
     return VK_NULL_HANDLE;
 }
 
+VkDeviceSize VmaBlockMetadata_Buddy::GetNextFreeRegionSize(VmaAllocHandle alloc) const
+{
+    uint32_t level = 0;
+    const Node* node = FindAllocationNode((VkDeviceSize)alloc - 1, level);
+    node = FindFirstLeaf(FindNextSubtree(node, level), level);
+    if (node != VMA_NULL && node->type == Node::TYPE_FREE)
+        return LevelToNodeSize(level);
+    return 0;
+}
+
+VkResult VmaBlockMetadata_Buddy::CheckCorruption(const void* pBlockData)
+{
+    uint32_t level = 0;
+    for (const Node* node = FindFirstLeaf(m_Root, level); node != VMA_NULL; node = FindFirstLeaf(FindNextSubtree(node, level), level))
+    {
+        if (node->type == Node::TYPE_ALLOCATION &&
+            !VmaValidateMagicValue(pBlockData, node->offset + LevelToNodeSize(level) - GetDebugMargin()))
+        {
+            VMA_ASSERT(0 && "MEMORY CORRUPTION DETECTED AFTER VALIDATED ALLOCATION!");
+            return VK_ERROR_UNKNOWN_COPY;
+        }
+    }
+    return VK_SUCCESS;
+}
+
+const VmaBlockMetadata_Buddy::Node* VmaBlockMetadata_Buddy::FindFirstLeaf(const Node* node, uint32_t& inoutLevel) const
+{
+    if (node == VMA_NULL)
+        return VMA_NULL;
+    while (node->type == Node::TYPE_SPLIT)
+    {
+        node = node->split.leftChild;
+        ++inoutLevel;
+    }
+    return node;
+}
+
+const VmaBlockMetadata_Buddy::Node* VmaBlockMetadata_Buddy::FindNextSubtree(const Node* node, uint32_t& inoutLevel) const
+{
+    // Go up while node is a right child, then continue with its right buddy.
+    for (; node->parent != VMA_NULL; node = node->parent, --inoutLevel)
+    {
+        if (node->parent->split.leftChild == node)
+            return node->buddy;
+    }
+    return VMA_NULL;
+}
+
 void VmaBlockMetadata_Buddy::DeleteNodeChildren(Node* node)
 {
     if (node->type == Node::TYPE_SPLIT)
     {
         DeleteNodeChildren(node->split.leftChild->buddy);
         DeleteNodeChildren(node->split.leftChild);
-        const VkAllocationCallbacks* allocationCallbacks = GetAllocationCallbacks();
         m_NodeAllocator.Free(node->split.leftChild->buddy);
         m_NodeAllocator.Free(node->split.leftChild);
     }
@@ -9703,11 +11312,15 @@ void VmaBlockMetadata_Buddy::DeleteNodeChildren(Node* node)
 
 void VmaBlockMetadata_Buddy::Clear()
 {
+    if (HasStatisticsCounters())
+        UntrackNode(m_Root, LevelToNodeSize(0));
     DeleteNodeChildren(m_Root);
     m_Root->type = Node::TYPE_FREE;
     m_AllocationCount = 0;
     m_FreeCount = 1;
     m_SumFreeSize = m_UsableSize;
+    memset(m_FreeList, 0, sizeof(m_FreeList));
+    AddToFreeListFront(0, m_Root);
 }
 
 void VmaBlockMetadata_Buddy::SetAllocationUserData(VmaAllocHandle allocHandle, void* userData)
@@ -9812,6 +11425,7 @@ void VmaBlockMetadata_Buddy::Free(VmaAllocHandle allocHandle)
     ++m_FreeCount;
     --m_AllocationCount;
     m_SumFreeSize += LevelToNodeSize(level);
+    UntrackAllocation(LevelToNodeSize(level));
 
     node->type = Node::TYPE_FREE;
 
@@ -9857,9 +11471,33 @@ void VmaBlockMetadata_Buddy::AddNodeToDetailedStatistics(VmaDetailedStatistics&
     }
 }
 
+void VmaBlockMetadata_Buddy::UntrackNode(const Node* node, VkDeviceSize levelNodeSize)
+{
+    switch (node->type)
+    {
+    case Node::TYPE_FREE:
+        UntrackUnusedRange(levelNodeSize);
+        break;
+    case Node::TYPE_ALLOCATION:
+        UntrackAllocation(levelNodeSize);
+        break;
+    case Node::TYPE_SPLIT:
+    {
+        const VkDeviceSize childrenNodeSize = levelNodeSize / 2;
+        const Node* const leftChild = node->split.leftChild;
+        UntrackNode(leftChild, childrenNodeSize);
+        UntrackNode(leftChild->buddy, childrenNodeSize);
+    }
+    break;
+    default:
+        VMA_ASSERT(0);
+    }
+}
+
 void VmaBlockMetadata_Buddy::AddToFreeListFront(uint32_t level, Node* node)
 {
     VMA_ASSERT(node->type == Node::TYPE_FREE);
+    TrackUnusedRange(LevelToNodeSize(level));
 
     // List is empty.
     Node* const frontNode = m_FreeList[level].front;
@@ -9882,6 +11520,7 @@ void VmaBlockMetadata_Buddy::AddToFreeListFront(uint32_t level, Node* node)
 void VmaBlockMetadata_Buddy::RemoveFromFreeList(uint32_t level, Node* node)
 {
     VMA_ASSERT(m_FreeList[level].front != VMA_NULL);
+    UntrackUnusedRange(LevelToNodeSize(level));
 
     // It is at the front.
     if (node->free.prev == VMA_NULL)
@@ -9932,23 +11571,23 @@ void VmaBlockMetadata_Buddy::DebugLogAllAllocationNode(Node* node, uint32_t leve
 }
 
 #if VMA_STATS_STRING_ENABLED
-void VmaBlockMetadata_Buddy::PrintDetailedMapNode(class VmaJsonWriter& json, const Node* node, VkDeviceSize levelNodeSize) const
+void VmaBlockMetadata_Buddy::PrintDetailedMapNode(class VmaBlockDetailedMap& map, const Node* node, VkDeviceSize levelNodeSize) const
 {
     switch (node->type)
     {
     case Node::TYPE_FREE:
-        PrintDetailedMap_UnusedRange(json, node->offset, levelNodeSize);
+        PrintDetailedMap_UnusedRange(map, node->offset, levelNodeSize);
         break;
     case Node::TYPE_ALLOCATION:
-        PrintDetailedMap_Allocation(json, node->offset, levelNodeSize, node->allocation.userData);
+        PrintDetailedMap_Allocation(map, node->offset, levelNodeSize, node->allocation.userData);
         break;
     case Node::TYPE_SPLIT:
     {
         const VkDeviceSize childrenNodeSize = levelNodeSize / 2;
         const Node* const leftChild = node->split.leftChild;
-        PrintDetailedMapNode(json, leftChild, childrenNodeSize);
+        PrintDetailedMapNode(map, leftChild, childrenNodeSize);
         const Node* const rightChild = leftChild->buddy;
-        PrintDetailedMapNode(json, rightChild, childrenNodeSize);
+        PrintDetailedMapNode(map, rightChild, childrenNodeSize);
     }
     break;
     default:
@@ -9958,7 +11597,6 @@ void VmaBlockMetadata_Buddy::PrintDetailedMapNode(class VmaJsonWriter& json, con
 #endif // VMA_STATS_STRING_ENABLED
 #endif // _VMA_BLOCK_METADATA_BUDDY_FUNCTIONS
 #endif // _VMA_BLOCK_METADATA_BUDDY
-#endif // #if 0
 
 #ifndef _VMA_BLOCK_METADATA_TLSF
 // To not search current larger region if first allocation won't succeed and skip to smaller range
@@ -9976,6 +11614,7 @@ public:
     size_t GetAllocationCount() const override { return m_AllocCount; }
     size_t GetFreeRegionsCount() const override { return m_BlocksFreeCount + 1; }
     VkDeviceSize GetSumFreeSize() const override { return m_BlocksFreeSize + m_NullBlock->size; }
+    VkDeviceSize GetMaxFreeRegionSize() const override;
     bool IsEmpty() const override { return m_NullBlock->offset == 0; }
     VkDeviceSize GetAllocationOffset(VmaAllocHandle allocHandle) const override { return ((Block*)allocHandle)->offset; };
 
@@ -9986,7 +11625,7 @@ public:
     void AddStatistics(VmaStatistics& inoutStats) const override;
 
 #if VMA_STATS_STRING_ENABLED
-    void PrintDetailedMap(class VmaJsonWriter& json) const override;
+    void PrintDetailedMap(class VmaBlockDetailedMap& map) const override;
 #endif
 
     bool CreateAllocationRequest(
@@ -10073,6 +11712,8 @@ private:
     void RemoveFreeBlock(Block* block);
     void InsertFreeBlock(Block* block);
     void MergeBlock(Block* block, Block* prev);
+    // Removes all blocks from statistics counters, if any.
+    void UntrackAllBlocks();
 
     Block* FindFreeBlock(VkDeviceSize size, uint32_t& listIndex) const;
     bool CheckBlock(
@@ -10101,6 +11742,8 @@ VmaBlockMetadata_TLSF::VmaBlockMetadata_TLSF(const VkAllocationCallbacks* pAlloc
 
 VmaBlockMetadata_TLSF::~VmaBlockMetadata_TLSF()
 {
+    if (m_NullBlock)
+        UntrackAllBlocks();
     if (m_FreeList)
         vma_delete_array(GetAllocationCallbacks(), m_FreeList, m_ListsCount);
     m_GranularityHandler.Destroy(GetAllocationCallbacks());
@@ -10121,6 +11764,8 @@ void VmaBlockMetadata_TLSF::Init(VkDeviceSize size)
     m_NullBlock->MarkFree();
     m_NullBlock->NextFree() = VMA_NULL;
     m_NullBlock->PrevFree() = VMA_NULL;
+    if (size > 0)
+        TrackUnusedRange(size);
     uint8_t memoryClass = SizeToMemoryClass(size);
     uint16_t sli = SizeToSecondIndex(size, memoryClass);
     m_ListsCount = (memoryClass == 0 ? 0 : (memoryClass - 1) * (1UL << SECOND_LEVEL_INDEX) + sli) + 1;
@@ -10136,6 +11781,33 @@ void VmaBlockMetadata_TLSF::Init(VkDeviceSize size)
     memset(m_FreeList, 0, m_ListsCount * sizeof(Block*));
 }
 
+VkDeviceSize VmaBlockMetadata_TLSF::GetMaxFreeRegionSize() const
+{
+    VkDeviceSize result = m_NullBlock->size;
+    if (m_IsFreeBitmap != 0)
+    {
+        // Largest free blocks are all in the highest non-empty list. Walking it on every allocation and free
+        // would be O(n), so unless the list has a single block, the largest size it can hold is returned.
+        const uint8_t memoryClass = VmaBitScanMSB(m_IsFreeBitmap);
+        const uint16_t secondIndex = VmaBitScanMSB(m_InnerIsFreeBitmap[memoryClass]);
+        Block* const head = m_FreeList[GetListIndex(memoryClass, secondIndex)];
+        VkDeviceSize listMaxSize = head->size;
+        if (head->NextFree() != VMA_NULL)
+        {
+            if (memoryClass == 0)
+                listMaxSize = static_cast<VkDeviceSize>(secondIndex + 1) * (IsVirtual() ? 8 : 64);
+            else
+            {
+                const uint8_t shift = memoryClass + MEMORY_CLASS_SHIFT - SECOND_LEVEL_INDEX;
+                listMaxSize = ((static_cast<VkDeviceSize>((1U << SECOND_LEVEL_INDEX) | secondIndex) + 1) << shift) - 1;
+            }
+            listMaxSize = VMA_MIN(listMaxSize, m_BlocksFreeSize);
+        }
+        result = VMA_MAX(result, listMaxSize);
+    }
+    return result;
+}
+
 bool VmaBlockMetadata_TLSF::Validate() const
 {
     VMA_VALIDATE(GetSumFreeSize() <= GetSize());
@@ -10259,7 +11931,7 @@ void VmaBlockMetadata_TLSF::AddStatistics(VmaStatistics& inoutStats) const
 }
 
 #if VMA_STATS_STRING_ENABLED
-void VmaBlockMetadata_TLSF::PrintDetailedMap(class VmaJsonWriter& json) const
+void VmaBlockMetadata_TLSF::PrintDetailedMap(class VmaBlockDetailedMap& map) const
 {
     size_t blockCount = m_AllocCount + m_BlocksFreeCount;
     VmaStlAllocator<Block*> allocator(GetAllocationCallbacks());
@@ -10276,7 +11948,7 @@ void VmaBlockMetadata_TLSF::PrintDetailedMap(class VmaJsonWriter& json) const
     VmaClearDetailedStatistics(stats);
     AddDetailedStatistics(stats);
 
-    PrintDetailedMap_Begin(json,
+    PrintDetailedMap_Begin(map,
         stats.statistics.blockBytes - stats.statistics.allocationBytes,
         stats.statistics.allocationCount,
         stats.unusedRangeCount);
@@ -10285,14 +11957,14 @@ void VmaBlockMetadata_TLSF::PrintDetailedMap(class VmaJsonWriter& json) const
     {
         Block* block = blockList[i];
         if (block->IsFree())
-            PrintDetailedMap_UnusedRange(json, block->offset, block->size);
+            PrintDetailedMap_UnusedRange(map, block->offset, block->size);
         else
-            PrintDetailedMap_Allocation(json, block->offset, block->size, block->UserData());
+            PrintDetailedMap_Allocation(map, block->offset, block->size, block->UserData());
     }
     if (m_NullBlock->size > 0)
-        PrintDetailedMap_UnusedRange(json, m_NullBlock->offset, m_NullBlock->size);
+        PrintDetailedMap_UnusedRange(map, m_NullBlock->offset, m_NullBlock->size);
 
-    PrintDetailedMap_End(json);
+    PrintDetailedMap_End(map);
 }
 #endif
 
@@ -10487,6 +12159,7 @@ void VmaBlockMetadata_TLSF::Alloc(
     VkDeviceSize offset = request.algorithmData;
     VMA_ASSERT(currentBlock != VMA_NULL);
     VMA_ASSERT(currentBlock->offset <= offset);
+    const VkDeviceSize prevNullBlockSize = m_NullBlock->size;
 
     if (currentBlock != m_NullBlock)
         RemoveFreeBlock(currentBlock);
@@ -10513,7 +12186,11 @@ void VmaBlockMetadata_TLSF::Alloc(
                 InsertFreeBlock(prevBlock);
             }
             else
+            {
                 m_BlocksFreeSize += misssingAlignment;
+                UntrackUnusedRange(prevBlock->size - misssingAlignment);
+                TrackUnusedRange(prevBlock->size);
+            }
         }
         else
         {
@@ -10599,6 +12276,18 @@ void VmaBlockMetadata_TLSF::Alloc(
         m_GranularityHandler.AllocPages((uint8_t)(uintptr_t)request.customData,
             currentBlock->offset, currentBlock->size);
     ++m_AllocCount;
+
+    if (HasStatisticsCounters())
+    {
+        TrackAllocation(currentBlock->size);
+        if (m_NullBlock->size != prevNullBlockSize)
+        {
+            if (prevNullBlockSize > 0)
+                UntrackUnusedRange(prevNullBlockSize);
+            if (m_NullBlock->size > 0)
+                TrackUnusedRange(m_NullBlock->size);
+        }
+    }
 }
 
 void VmaBlockMetadata_TLSF::Free(VmaAllocHandle allocHandle)
@@ -10610,6 +12299,7 @@ void VmaBlockMetadata_TLSF::Free(VmaAllocHandle allocHandle)
     if (!IsVirtual())
         m_GranularityHandler.FreePages(block->offset, block->size);
     --m_AllocCount;
+    UntrackAllocation(block->size);
 
     VkDeviceSize debugMargin = GetDebugMargin();
     if (debugMargin > 0)
@@ -10631,7 +12321,12 @@ void VmaBlockMetadata_TLSF::Free(VmaAllocHandle allocHandle)
     if (!next->IsFree())
         InsertFreeBlock(block);
     else if (next == m_NullBlock)
+    {
+        if (m_NullBlock->size > 0)
+            UntrackUnusedRange(m_NullBlock->size);
         MergeBlock(m_NullBlock, block);
+        TrackUnusedRange(m_NullBlock->size);
+    }
     else
     {
         RemoveFreeBlock(next);
@@ -10695,6 +12390,7 @@ VkDeviceSize VmaBlockMetadata_TLSF::GetNextFreeRegionSize(VmaAllocHandle alloc)
 
 void VmaBlockMetadata_TLSF::Clear()
 {
+    UntrackAllBlocks();
     m_AllocCount = 0;
     m_BlocksFreeCount = 0;
     m_BlocksFreeSize = 0;
@@ -10712,6 +12408,8 @@ void VmaBlockMetadata_TLSF::Clear()
     memset(m_FreeList, 0, m_ListsCount * sizeof(Block*));
     memset(m_InnerIsFreeBitmap, 0, m_MemoryClasses * sizeof(uint32_t));
     m_GranularityHandler.Clear();
+    if (m_NullBlock->size > 0)
+        TrackUnusedRange(m_NullBlock->size);
 }
 
 void VmaBlockMetadata_TLSF::SetAllocationUserData(VmaAllocHandle allocHandle, void* userData)
@@ -10792,6 +12490,7 @@ void VmaBlockMetadata_TLSF::RemoveFreeBlock(Block* block)
     block->UserData() = VMA_NULL;
     --m_BlocksFreeCount;
     m_BlocksFreeSize -= block->size;
+    UntrackUnusedRange(block->size);
 }
 
 void VmaBlockMetadata_TLSF::InsertFreeBlock(Block* block)
@@ -10815,6 +12514,7 @@ void VmaBlockMetadata_TLSF::InsertFreeBlock(Block* block)
     }
     ++m_BlocksFreeCount;
     m_BlocksFreeSize += block->size;
+    TrackUnusedRange(block->size);
 }
 
 void VmaBlockMetadata_TLSF::MergeBlock(Block* block, Block* prev)
@@ -10830,6 +12530,22 @@ void VmaBlockMetadata_TLSF::MergeBlock(Block* block, Block* prev)
     m_BlockAllocator.Free(prev);
 }
 
+void VmaBlockMetadata_TLSF::UntrackAllBlocks()
+{
+    if (!HasStatisticsCounters())
+        return;
+
+    if (m_NullBlock->size > 0)
+        UntrackUnusedRange(m_NullBlock->size);
+    for (Block* block = m_NullBlock->prevPhysical; block != VMA_NULL; block = block->prevPhysical)
+    {
+        if (block->IsFree())
+            UntrackUnusedRange(block->size);
+        else
+            UntrackAllocation(block->size);
+    }
+}
+
 VmaBlockMetadata_TLSF::Block* VmaBlockMetadata_TLSF::FindFreeBlock(VkDeviceSize size, uint32_t& listIndex) const
 {
     uint8_t memoryClass = SizeToMemoryClass(size);
@@ -10896,557 +12612,2241 @@ bool VmaBlockMetadata_TLSF::CheckBlock(
 #endif // _VMA_BLOCK_METADATA_TLSF_FUNCTIONS
 #endif // _VMA_BLOCK_METADATA_TLSF
 
-#ifndef _VMA_BLOCK_VECTOR
+#ifndef _VMA_BLOCK_METADATA_SLAB
 /*
-Sequence of VmaDeviceMemoryBlock. Represents memory blocks allocated for a specific
-Vulkan memory type.
+Metadata for blocks dedicated to many small allocations.
 
-Synchronized internally with a mutex.
+Block is divided into slabs of equal, power-of-2 size. A slab that is in use
+serves exactly one size class and tracks its slots in a bitmap, so the only
+per-allocation state is a single bit plus the user data pointer. Slabs with
+some free slots are kept on a list per size class, so allocation and free take
+constant time. When last allocation is freed from a slab, it returns to the
+list of free slabs and can be reused for any size class.
+
+Allocations larger than the biggest size class cannot be made in such block.
 */
-class VmaBlockVector
+class VmaBlockMetadata_Slab : public VmaBlockMetadata
 {
-    friend struct VmaDefragmentationContext_T;
-    VMA_CLASS_NO_COPY(VmaBlockVector)
+    VMA_CLASS_NO_COPY(VmaBlockMetadata_Slab)
 public:
-    VmaBlockVector(
-        VmaAllocator hAllocator,
-        VmaPool hParentPool,
-        uint32_t memoryTypeIndex,
-        VkDeviceSize preferredBlockSize,
-        size_t minBlockCount,
-        size_t maxBlockCount,
-        VkDeviceSize bufferImageGranularity,
-        bool explicitBlockSize,
-        uint32_t algorithm,
-        float priority,
-        VkDeviceSize minAllocationAlignment,
-        void* pMemoryAllocateNext);
-    ~VmaBlockVector();
+    VmaBlockMetadata_Slab(const VkAllocationCallbacks* pAllocationCallbacks,
+        VkDeviceSize bufferImageGranularity, bool isVirtual);
+    virtual ~VmaBlockMetadata_Slab();
 
-    VmaAllocator GetAllocator() const { return m_hAllocator; }
-    VmaPool GetParentPool() const { return m_hParentPool; }
-    bool IsCustomPool() const { return m_hParentPool != VMA_NULL; }
-    uint32_t GetMemoryTypeIndex() const { return m_MemoryTypeIndex; }
-    VkDeviceSize GetPreferredBlockSize() const { return m_PreferredBlockSize; }
-    VkDeviceSize GetBufferImageGranularity() const { return m_BufferImageGranularity; }
-    uint32_t GetAlgorithm() const { return m_Algorithm; }
-    bool HasExplicitBlockSize() const { return m_ExplicitBlockSize; }
-    float GetPriority() const { return m_Priority; }
-    const void* GetAllocationNextPtr() const { return m_pMemoryAllocateNext; }
-    // To be used only while the m_Mutex is locked. Used during defragmentation.
-    size_t GetBlockCount() const { return m_Blocks.size(); }
-    // To be used only while the m_Mutex is locked. Used during defragmentation.
-    VmaDeviceMemoryBlock* GetBlock(size_t index) const { return m_Blocks[index]; }
-    VMA_RW_MUTEX &GetMutex() { return m_Mutex; }
+    size_t GetAllocationCount() const override { return m_AllocCount; }
+    size_t GetFreeRegionsCount() const override;
+    VkDeviceSize GetSumFreeSize() const override { return GetSize() - m_AllocatedSize; }
+    VkDeviceSize GetMaxFreeRegionSize() const override;
+    bool IsEmpty() const override { return m_AllocCount == 0; }
+    VkDeviceSize GetAllocationOffset(VmaAllocHandle allocHandle) const override { return (VkDeviceSize)allocHandle - 1; };
 
-    VkResult CreateMinBlocks();
-    void AddStatistics(VmaStatistics& inoutStats);
-    void AddDetailedStatistics(VmaDetailedStatistics& inoutStats);
-    bool IsEmpty();
-    bool IsCorruptionDetectionEnabled() const;
+    // Returns true if allocation of given size, debug margin and alignment fits into one of the size classes,
+    // after the same padding to granularity pages that CreateAllocationRequest() applies to resources of unknown kind.
+    static bool IsAllocationSupported(VkDeviceSize size, VkDeviceSize debugMargin, VkDeviceSize alignment,
+        VmaSuballocationType allocType, VkDeviceSize bufferImageGranularity);
 
-    VkResult Allocate(
-        VkDeviceSize size,
-        VkDeviceSize alignment,
-        const VmaAllocationCreateInfo& createInfo,
-        VmaSuballocationType suballocType,
-        size_t allocationCount,
-        VmaAllocation* pAllocations);
+    void Init(VkDeviceSize size) override;
+    bool Validate() const override;
 
-    void Free(const VmaAllocation hAllocation);
+    void AddDetailedStatistics(VmaDetailedStatistics& inoutStats) const override;
+    void AddStatistics(VmaStatistics& inoutStats) const override;
 
 #if VMA_STATS_STRING_ENABLED
-    void PrintDetailedMap(class VmaJsonWriter& json);
+    void PrintDetailedMap(class VmaBlockDetailedMap& map) const override;
 #endif
 
-    VkResult CheckCorruption();
+    bool CreateAllocationRequest(
+        VkDeviceSize allocSize,
+        VkDeviceSize allocAlignment,
+        bool upperAddress,
+        VmaSuballocationType allocType,
+        uint32_t strategy,
+        VmaAllocationRequest* pAllocationRequest) override;
 
-private:
-    const VmaAllocator m_hAllocator;
-    const VmaPool m_hParentPool;
-    const uint32_t m_MemoryTypeIndex;
-    const VkDeviceSize m_PreferredBlockSize;
-    const size_t m_MinBlockCount;
-    const size_t m_MaxBlockCount;
-    const VkDeviceSize m_BufferImageGranularity;
-    const bool m_ExplicitBlockSize;
-    const uint32_t m_Algorithm;
-    const float m_Priority;
-    const VkDeviceSize m_MinAllocationAlignment;
+    VkResult CheckCorruption(const void* pBlockData) override;
+    void Alloc(
+        const VmaAllocationRequest& request,
+        VmaSuballocationType type,
+        void* userData) override;
 
-    void* const m_pMemoryAllocateNext;
-    VMA_RW_MUTEX m_Mutex;
-    // Incrementally sorted by sumFreeSize, ascending.
-    VmaVector<VmaDeviceMemoryBlock*, VmaStlAllocator<VmaDeviceMemoryBlock*>> m_Blocks;
-    uint32_t m_NextBlockId;
-    bool m_IncrementalSort = true;
+    void Free(VmaAllocHandle allocHandle) override;
+    void GetAllocationInfo(VmaAllocHandle allocHandle, VmaVirtualAllocationInfo& outInfo) override;
+    void* GetAllocationUserData(VmaAllocHandle allocHandle) const override;
+    VmaAllocHandle GetAllocationListBegin() const override;
+    VmaAllocHandle GetNextAllocation(VmaAllocHandle prevAlloc) const override;
+    VkDeviceSize GetNextFreeRegionSize(VmaAllocHandle alloc) const override;
+    void Clear() override;
+    void SetAllocationUserData(VmaAllocHandle allocHandle, void* userData) override;
+    void DebugLogAllAllocations() const override;
 
-    void SetIncrementalSort(bool val) { m_IncrementalSort = val; }
+private:
+    static const VkDeviceSize SLAB_SIZE = 64 * 1024;
+    // Size classes go 64, 96, 128, 192, ..., 3072, 4096 bytes.
+    static const uint8_t MIN_SIZE_CLASS_SHIFT = 6;
+    static const uint8_t SIZE_CLASS_COUNT = 13;
+    // Buffers and linear images, optimal images, resources of unknown kind.
+    static const uint8_t GRANULARITY_KIND_COUNT = 3;
+    static const uint8_t FREE_SLAB = UINT8_MAX;
+    static const uint32_t INVALID_SLAB = UINT32_MAX;
+
+    struct Slab
+    {
+        // Bit set for every free slot.
+        uint64_t* freeMask;
+        void** userData;
+        uint32_t slotCapacity;
+        uint32_t slotCount;
+        uint32_t freeSlotCount;
+        // Words of freeMask before this one have no free slots.
+        uint32_t firstFreeWord;
+        // Neighbours on the list of free slabs or partially used slabs of the same size class.
+        uint32_t prev;
+        uint32_t next;
+        uint8_t sizeClass;
+        uint8_t granularityKind;
+    };
 
-    VkDeviceSize CalcMaxBlockSize() const;
-    // Finds and removes given block from vector.
-    void Remove(VmaDeviceMemoryBlock* pBlock);
-    // Performs single step in sorting m_Blocks. They may not be fully sorted
-    // after this call.
-    void IncrementallySortBlocks();
-    void SortByFreeSize();
+    size_t m_AllocCount;
+    // Sum of slot sizes of all allocations
+    VkDeviceSize m_AllocatedSize;
+    VkDeviceSize m_SlabSize;
+    uint8_t m_SlabSizeShift;
+    uint32_t m_SlabCount;
+    uint32_t m_FreeSlabCount;
+    // Total number of free slots in slabs that are in use
+    size_t m_FreeSlotCount;
+    Slab* m_Slabs;
+    uint32_t m_FreeSlabs;
+    uint32_t m_PartialSlabs[SIZE_CLASS_COUNT * GRANULARITY_KIND_COUNT];
+
+    static VkDeviceSize GetClassSize(uint8_t sizeClass);
+    // Returns SIZE_CLASS_COUNT if no size class fits.
+    static uint8_t FindSizeClass(VkDeviceSize size, VkDeviceSize alignment);
+    static uint32_t GetListIndex(uint8_t sizeClass, uint8_t granularityKind) { return sizeClass * GRANULARITY_KIND_COUNT + granularityKind; }
+    static bool IsSlotFree(const Slab& slab, uint32_t slot) { return (slab.freeMask[slot / 64] & (1ULL << (slot % 64))) != 0; }
+
+    static uint8_t GetGranularityKind(VmaSuballocationType type, VkDeviceSize bufferImageGranularity);
+    uint8_t GetGranularityKind(VmaSuballocationType type) const { return IsVirtual() ? 0 : GetGranularityKind(type, GetBufferImageGranularity()); }
+    VkDeviceSize GetSlotOffset(uint32_t slabIndex, uint32_t slot) const;
+    void FindSlot(VmaAllocHandle allocHandle, uint32_t& outSlabIndex, uint32_t& outSlot) const;
+    uint32_t FindFreeSlot(const Slab& slab) const;
+    VmaAllocHandle FindAllocation(uint32_t slabIndex, uint32_t slot) const;
+
+    void InitSlab(Slab& slab, uint8_t sizeClass, uint8_t granularityKind);
+    void PushSlab(uint32_t& listHead, uint32_t slabIndex);
+    void RemoveSlab(uint32_t& listHead, uint32_t slabIndex);
+    void ResetSlabs();
+
+    // Calls func(offset, size, pUserData, isFree) for every allocation and every maximal free range, in order of offsets.
+    template<typename Func>
+    void VisitRanges(Func func) const;
+};
 
-    VkResult AllocatePage(
-        VkDeviceSize size,
-        VkDeviceSize alignment,
-        const VmaAllocationCreateInfo& createInfo,
-        VmaSuballocationType suballocType,
-        VmaAllocation* pAllocation);
+#ifndef _VMA_BLOCK_METADATA_SLAB_FUNCTIONS
+VmaBlockMetadata_Slab::VmaBlockMetadata_Slab(const VkAllocationCallbacks* pAllocationCallbacks,
+    VkDeviceSize bufferImageGranularity, bool isVirtual)
+    : VmaBlockMetadata(pAllocationCallbacks, bufferImageGranularity, isVirtual),
+    m_AllocCount(0),
+    m_AllocatedSize(0),
+    m_SlabSize(0),
+    m_SlabSizeShift(0),
+    m_SlabCount(0),
+    m_FreeSlabCount(0),
+    m_FreeSlotCount(0),
+    m_Slabs(VMA_NULL),
+    m_FreeSlabs(INVALID_SLAB) {}
 
-    VkResult AllocateFromBlock(
-        VmaDeviceMemoryBlock* pBlock,
-        VkDeviceSize size,
-        VkDeviceSize alignment,
-        VmaAllocationCreateFlags allocFlags,
-        void* pUserData,
-        VmaSuballocationType suballocType,
-        uint32_t strategy,
-        VmaAllocation* pAllocation);
+VmaBlockMetadata_Slab::~VmaBlockMetadata_Slab()
+{
+    for (uint32_t i = 0; i < m_SlabCount; ++i)
+    {
+        Slab& slab = m_Slabs[i];
+        if (slab.slotCapacity > 0)
+        {
+            vma_delete_array(GetAllocationCallbacks(), slab.freeMask, (slab.slotCapacity + 63) / 64);
+            vma_delete_array(GetAllocationCallbacks(), slab.userData, slab.slotCapacity);
+        }
+    }
+    if (m_Slabs)
+        vma_delete_array(GetAllocationCallbacks(), m_Slabs, m_SlabCount);
+}
 
-    VkResult CommitAllocationRequest(
-        VmaAllocationRequest& allocRequest,
-        VmaDeviceMemoryBlock* pBlock,
-        VkDeviceSize alignment,
-        VmaAllocationCreateFlags allocFlags,
-        void* pUserData,
-        VmaSuballocationType suballocType,
-        VmaAllocation* pAllocation);
+template<typename Func>
+void VmaBlockMetadata_Slab::VisitRanges(Func func) const
+{
+    VkDeviceSize freeSize = 0;
+    for (uint32_t slabIndex = 0; slabIndex < m_SlabCount; ++slabIndex)
+    {
+        const Slab& slab = m_Slabs[slabIndex];
+        if (slab.sizeClass == FREE_SLAB)
+        {
+            freeSize += m_SlabSize;
+            continue;
+        }
 
-    VkResult CreateBlock(VkDeviceSize blockSize, size_t* pNewBlockIndex);
-    bool HasEmptyBlock();
-};
-#endif // _VMA_BLOCK_VECTOR
+        const VkDeviceSize classSize = GetClassSize(slab.sizeClass);
+        for (uint32_t slot = 0; slot < slab.slotCount; ++slot)
+        {
+            if (IsSlotFree(slab, slot))
+            {
+                freeSize += classSize;
+                continue;
+            }
+            const VkDeviceSize offset = GetSlotOffset(slabIndex, slot);
+            if (freeSize > 0)
+                func(offset - freeSize, freeSize, VMA_NULL, true);
+            freeSize = 0;
+            func(offset, classSize, slab.userData[slot], false);
+        }
+        // Space at the end of the slab that is too small for another slot.
+        freeSize += m_SlabSize - slab.slotCount * classSize;
+    }
+    freeSize += GetSize() - ((VkDeviceSize)m_SlabCount << m_SlabSizeShift);
+    if (freeSize > 0)
+        func(GetSize() - freeSize, freeSize, VMA_NULL, true);
+}
 
-#ifndef _VMA_DEFRAGMENTATION_CONTEXT
-struct VmaDefragmentationContext_T
+size_t VmaBlockMetadata_Slab::GetFreeRegionsCount() const
 {
-    VMA_CLASS_NO_COPY(VmaDefragmentationContext_T)
-public:
-    VmaDefragmentationContext_T(
-        VmaAllocator hAllocator,
-        const VmaDefragmentationInfo& info);
-    ~VmaDefragmentationContext_T();
-
-    void GetStats(VmaDefragmentationStats& outStats) { outStats = m_GlobalStats; }
+    const VkDeviceSize tailSize = GetSize() - ((VkDeviceSize)m_SlabCount << m_SlabSizeShift);
+    return m_FreeSlotCount + m_FreeSlabCount + (tailSize > 0 ? 1 : 0);
+}
 
-    VkResult DefragmentPassBegin(VmaDefragmentationPassMoveInfo& moveInfo);
-    VkResult DefragmentPassEnd(VmaDefragmentationPassMoveInfo& moveInfo);
-
-private:
-    // Max number of allocations to ignore due to size constraints before ending single pass
-    static const uint8_t MAX_ALLOCS_TO_IGNORE = 16;
-    enum class CounterStatus { Pass, Ignore, End };
-
-    struct FragmentedBlock
+VkDeviceSize VmaBlockMetadata_Slab::GetMaxFreeRegionSize() const
+{
+    // Free slab can take any size class, otherwise only classes with free slots count.
+    if (m_FreeSlabCount > 0)
     {
-        uint32_t data;
-        VmaDeviceMemoryBlock* block;
-    };
-    struct StateBalanced
+        VkDeviceSize result = GetClassSize(SIZE_CLASS_COUNT - 1);
+        return result < m_SlabSize ? result : m_SlabSize;
+    }
+    for (uint32_t listIndex = SIZE_CLASS_COUNT * GRANULARITY_KIND_COUNT; listIndex > 0; --listIndex)
     {
-        VkDeviceSize avgFreeSize = 0;
-        VkDeviceSize avgAllocSize = UINT64_MAX;
-    };
-    struct StateExtensive
+        if (m_PartialSlabs[listIndex - 1] != INVALID_SLAB)
+            return GetClassSize((uint8_t)((listIndex - 1) / GRANULARITY_KIND_COUNT));
+    }
+    return 0;
+}
+
+bool VmaBlockMetadata_Slab::IsAllocationSupported(VkDeviceSize size, VkDeviceSize debugMargin, VkDeviceSize alignment,
+    VmaSuballocationType allocType, VkDeviceSize bufferImageGranularity)
+{
+    if (GetGranularityKind(allocType, bufferImageGranularity) == GRANULARITY_KIND_COUNT - 1)
     {
-        enum class Operation : uint8_t
-        {
-            FindFreeBlockBuffer, FindFreeBlockTexture, FindFreeBlockAll,
-            MoveBuffers, MoveTextures, MoveAll,
-            Cleanup, Done
-        };
+        size = VmaAlignUp(size, bufferImageGranularity);
+        alignment = VMA_MAX(alignment, bufferImageGranularity);
+    }
+    return FindSizeClass(size + debugMargin, alignment) < SIZE_CLASS_COUNT;
+}
 
-        Operation operation = Operation::FindFreeBlockTexture;
-        size_t firstFreeBlock = SIZE_MAX;
-    };
-    struct MoveAllocationData
+void VmaBlockMetadata_Slab::Init(VkDeviceSize size)
+{
+    VmaBlockMetadata::Init(size);
+
+    VkDeviceSize slabSize = SLAB_SIZE;
+    if (size < slabSize)
+        slabSize = VmaPrevPow2(size);
+    // Every granularity page must belong to a single slab.
+    if (!IsVirtual() && GetBufferImageGranularity() > slabSize)
+        slabSize = VmaNextPow2(GetBufferImageGranularity());
+
+    m_SlabSize = slabSize;
+    m_SlabSizeShift = VMA_BITSCAN_MSB(slabSize);
+    m_SlabCount = (uint32_t)(size / slabSize);
+    if (m_SlabCount > 0)
     {
-        VkDeviceSize size;
-        VkDeviceSize alignment;
-        VmaSuballocationType type;
-        VmaAllocationCreateFlags flags;
-        VmaDefragmentationMove move = {};
-    };
+        m_Slabs = vma_new_array(GetAllocationCallbacks(), Slab, m_SlabCount);
+        memset(m_Slabs, 0, m_SlabCount * sizeof(Slab));
+    }
+    ResetSlabs();
+}
 
-    const VkDeviceSize m_MaxPassBytes;
-    const uint32_t m_MaxPassAllocations;
+bool VmaBlockMetadata_Slab::Validate() const
+{
+    size_t allocCount = 0;
+    size_t freeSlotCount = 0;
+    uint32_t freeSlabCount = 0;
+    VkDeviceSize allocatedSize = 0;
+    for (uint32_t i = 0; i < m_SlabCount; ++i)
+    {
+        const Slab& slab = m_Slabs[i];
+        if (slab.sizeClass == FREE_SLAB)
+        {
+            ++freeSlabCount;
+            continue;
+        }
+        VMA_VALIDATE(slab.sizeClass < SIZE_CLASS_COUNT);
+        VMA_VALIDATE(slab.granularityKind < GRANULARITY_KIND_COUNT);
+        VMA_VALIDATE(slab.slotCount == m_SlabSize / GetClassSize(slab.sizeClass));
+        VMA_VALIDATE(slab.slotCount <= slab.slotCapacity);
+        VMA_VALIDATE(slab.freeSlotCount < slab.slotCount);
 
-    VmaStlAllocator<VmaDefragmentationMove> m_MoveAllocator;
-    VmaVector<VmaDefragmentationMove, VmaStlAllocator<VmaDefragmentationMove>> m_Moves;
+        uint32_t slabFreeSlotCount = 0;
+        for (uint32_t slot = 0; slot < slab.slotCount; ++slot)
+        {
+            if (IsSlotFree(slab, slot))
+            {
+                VMA_VALIDATE(slot / 64 >= slab.firstFreeWord);
+                ++slabFreeSlotCount;
+            }
+        }
+        VMA_VALIDATE(slabFreeSlotCount == slab.freeSlotCount);
+        allocCount += slab.slotCount - slabFreeSlotCount;
+        freeSlotCount += slabFreeSlotCount;
+        allocatedSize += (slab.slotCount - slabFreeSlotCount) * GetClassSize(slab.sizeClass);
+    }
+    VMA_VALIDATE(allocCount == m_AllocCount);
+    VMA_VALIDATE(freeSlotCount == m_FreeSlotCount);
+    VMA_VALIDATE(freeSlabCount == m_FreeSlabCount);
+    VMA_VALIDATE(allocatedSize == m_AllocatedSize);
 
-    uint8_t m_IgnoredAllocs = 0;
-    uint32_t m_Algorithm;
-    uint32_t m_BlockVectorCount;
-    VmaBlockVector* m_PoolBlockVector;
-    VmaBlockVector** m_pBlockVectors;
-    size_t m_ImmovableBlockCount = 0;
-    VmaDefragmentationStats m_GlobalStats = { 0 };
-    VmaDefragmentationStats m_PassStats = { 0 };
-    void* m_AlgorithmState = VMA_NULL;
+    uint32_t listedSlabCount = 0;
+    for (uint32_t i = m_FreeSlabs, prev = INVALID_SLAB; i != INVALID_SLAB; prev = i, i = m_Slabs[i].next)
+    {
+        VMA_VALIDATE(i < m_SlabCount);
+        VMA_VALIDATE(m_Slabs[i].sizeClass == FREE_SLAB);
+        VMA_VALIDATE(m_Slabs[i].prev == prev);
+        ++listedSlabCount;
+    }
+    VMA_VALIDATE(listedSlabCount == m_FreeSlabCount);
 
-    static MoveAllocationData GetMoveData(VmaAllocHandle handle, VmaBlockMetadata* metadata);
-    CounterStatus CheckCounters(VkDeviceSize bytes);
-    bool IncrementCounters(VkDeviceSize bytes);
-    bool ReallocWithinBlock(VmaBlockVector& vector, VmaDeviceMemoryBlock* block);
-    bool AllocInOtherBlock(size_t start, size_t end, MoveAllocationData& data, VmaBlockVector& vector);
+    for (uint32_t listIndex = 0; listIndex < SIZE_CLASS_COUNT * GRANULARITY_KIND_COUNT; ++listIndex)
+    {
+        for (uint32_t i = m_PartialSlabs[listIndex], prev = INVALID_SLAB; i != INVALID_SLAB; prev = i, i = m_Slabs[i].next)
+        {
+            VMA_VALIDATE(i < m_SlabCount);
+            VMA_VALIDATE(m_Slabs[i].sizeClass != FREE_SLAB);
+            VMA_VALIDATE(GetListIndex(m_Slabs[i].sizeClass, m_Slabs[i].granularityKind) == listIndex);
+            VMA_VALIDATE(m_Slabs[i].freeSlotCount > 0);
+            VMA_VALIDATE(m_Slabs[i].prev == prev);
+        }
+    }
 
-    bool ComputeDefragmentation(VmaBlockVector& vector, size_t index);
-    bool ComputeDefragmentation_Fast(VmaBlockVector& vector);
-    bool ComputeDefragmentation_Balanced(VmaBlockVector& vector, size_t index, bool update);
-    bool ComputeDefragmentation_Full(VmaBlockVector& vector);
-    bool ComputeDefragmentation_Extensive(VmaBlockVector& vector, size_t index);
+    return true;
+}
 
-    void UpdateVectorStatistics(VmaBlockVector& vector, StateBalanced& state);
-    bool MoveDataToFreeBlocks(VmaSuballocationType currentType,
-        VmaBlockVector& vector, size_t firstFreeBlock,
-        bool& texturePresent, bool& bufferPresent, bool& otherPresent);
-};
-#endif // _VMA_DEFRAGMENTATION_CONTEXT
+void VmaBlockMetadata_Slab::AddDetailedStatistics(VmaDetailedStatistics& inoutStats) const
+{
+    inoutStats.statistics.blockCount++;
+    inoutStats.statistics.blockBytes += GetSize();
 
-#ifndef _VMA_POOL_T
-struct VmaPool_T
+    VisitRanges([&inoutStats](VkDeviceSize, VkDeviceSize size, void*, bool isFree)
+        {
+            if (isFree)
+                VmaAddDetailedStatisticsUnusedRange(inoutStats, size);
+            else
+                VmaAddDetailedStatisticsAllocation(inoutStats, size);
+        });
+}
+
+void VmaBlockMetadata_Slab::AddStatistics(VmaStatistics& inoutStats) const
 {
-    friend struct VmaPoolListItemTraits;
-    VMA_CLASS_NO_COPY(VmaPool_T)
-public:
-    VmaBlockVector m_BlockVector;
-    VmaDedicatedAllocationList m_DedicatedAllocations;
+    inoutStats.blockCount++;
+    inoutStats.allocationCount += (uint32_t)m_AllocCount;
+    inoutStats.blockBytes += GetSize();
+    inoutStats.allocationBytes += m_AllocatedSize;
+}
 
-    VmaPool_T(
-        VmaAllocator hAllocator,
-        const VmaPoolCreateInfo& createInfo,
-        VkDeviceSize preferredBlockSize);
-    ~VmaPool_T();
+#if VMA_STATS_STRING_ENABLED
+void VmaBlockMetadata_Slab::PrintDetailedMap(class VmaBlockDetailedMap& map) const
+{
+    VmaDetailedStatistics stats;
+    VmaClearDetailedStatistics(stats);
+    AddDetailedStatistics(stats);
 
-    uint32_t GetId() const { return m_Id; }
-    void SetId(uint32_t id) { VMA_ASSERT(m_Id == 0); m_Id = id; }
+    PrintDetailedMap_Begin(map,
+        stats.statistics.blockBytes - stats.statistics.allocationBytes,
+        stats.statistics.allocationCount,
+        stats.unusedRangeCount);
 
-    const char* GetName() const { return m_Name; }
-    void SetName(const char* pName);
+    VisitRanges([this, &map](VkDeviceSize offset, VkDeviceSize size, void* pUserData, bool isFree)
+        {
+            if (isFree)
+                PrintDetailedMap_UnusedRange(map, offset, size);
+            else
+                PrintDetailedMap_Allocation(map, offset, size, pUserData);
+        });
 
-#if VMA_STATS_STRING_ENABLED
-    //void PrintDetailedMap(class VmaStringBuilder& sb);
+    PrintDetailedMap_End(map);
+}
 #endif
 
-private:
-    uint32_t m_Id;
-    char* m_Name;
-    VmaPool_T* m_PrevPool = VMA_NULL;
-    VmaPool_T* m_NextPool = VMA_NULL;
-};
+bool VmaBlockMetadata_Slab::CreateAllocationRequest(
+    VkDeviceSize allocSize,
+    VkDeviceSize allocAlignment,
+    bool upperAddress,
+    VmaSuballocationType allocType,
+    uint32_t strategy,
+    VmaAllocationRequest* pAllocationRequest)
+{
+    VMA_ASSERT(allocSize > 0 && "Cannot allocate empty block!");
+    VMA_ASSERT(!upperAddress && "VMA_ALLOCATION_CREATE_UPPER_ADDRESS_BIT can be used only with linear algorithm.");
+    // Slots of a size class are all equivalent, so there is nothing to choose from.
+    (void)strategy;
 
-struct VmaPoolListItemTraits
+    // Resources of unknown kind take whole granularity pages so they never conflict with neighbours.
+    const uint8_t granularityKind = GetGranularityKind(allocType);
+    if (granularityKind == GRANULARITY_KIND_COUNT - 1)
+    {
+        allocSize = VmaAlignUp(allocSize, GetBufferImageGranularity());
+        allocAlignment = VMA_MAX(allocAlignment, GetBufferImageGranularity());
+    }
+
+    const uint8_t sizeClass = FindSizeClass(allocSize + GetDebugMargin(), allocAlignment);
+    if (sizeClass == SIZE_CLASS_COUNT || GetClassSize(sizeClass) > m_SlabSize)
+        return false;
+
+    uint32_t slabIndex = m_PartialSlabs[GetListIndex(sizeClass, granularityKind)];
+    uint32_t slot = 0;
+    if (slabIndex != INVALID_SLAB)
+        slot = FindFreeSlot(m_Slabs[slabIndex]);
+    else if (m_FreeSlabs != INVALID_SLAB)
+        slabIndex = m_FreeSlabs;
+    else
+        return false;
+
+    const VkDeviceSize classSize = GetClassSize(sizeClass);
+    pAllocationRequest->type = VmaAllocationRequestType::Slab;
+    pAllocationRequest->allocHandle = (VmaAllocHandle)(((VkDeviceSize)slabIndex << m_SlabSizeShift) + slot * classSize + 1);
+    pAllocationRequest->size = classSize - GetDebugMargin();
+    pAllocationRequest->customData = (void*)allocType;
+    pAllocationRequest->algorithmData = sizeClass | ((uint64_t)granularityKind << 8);
+    return true;
+}
+
+VkResult VmaBlockMetadata_Slab::CheckCorruption(const void* pBlockData)
 {
-    typedef VmaPool_T ItemType;
+    const VkDeviceSize debugMargin = GetDebugMargin();
+    bool corrupted = false;
+    VisitRanges([pBlockData, debugMargin, &corrupted](VkDeviceSize offset, VkDeviceSize size, void*, bool isFree)
+        {
+            if (!isFree && !corrupted && !VmaValidateMagicValue(pBlockData, offset + size - debugMargin))
+                corrupted = true;
+        });
 
-    static ItemType* GetPrev(const ItemType* item) { return item->m_PrevPool; }
-    static ItemType* GetNext(const ItemType* item) { return item->m_NextPool; }
-    static ItemType*& AccessPrev(ItemType* item) { return item->m_PrevPool; }
-    static ItemType*& AccessNext(ItemType* item) { return item->m_NextPool; }
-};
-#endif // _VMA_POOL_T
+    if (corrupted)
+    {
+        VMA_ASSERT(0 && "MEMORY CORRUPTION DETECTED AFTER VALIDATED ALLOCATION!");
+        return VK_ERROR_UNKNOWN_COPY;
+    }
+    return VK_SUCCESS;
+}
 
-#ifndef _VMA_CURRENT_BUDGET_DATA
-struct VmaCurrentBudgetData
+void VmaBlockMetadata_Slab::Alloc(
+    const VmaAllocationRequest& request,
+    VmaSuballocationType type,
+    void* userData)
 {
-    VMA_ATOMIC_UINT32 m_BlockCount[VK_MAX_MEMORY_HEAPS];
-    VMA_ATOMIC_UINT32 m_AllocationCount[VK_MAX_MEMORY_HEAPS];
-    VMA_ATOMIC_UINT64 m_BlockBytes[VK_MAX_MEMORY_HEAPS];
-    VMA_ATOMIC_UINT64 m_AllocationBytes[VK_MAX_MEMORY_HEAPS];
+    VMA_ASSERT(request.type == VmaAllocationRequestType::Slab);
 
-#if VMA_MEMORY_BUDGET
-    VMA_ATOMIC_UINT32 m_OperationsSinceBudgetFetch;
-    VMA_RW_MUTEX m_BudgetMutex;
-    uint64_t m_VulkanUsage[VK_MAX_MEMORY_HEAPS];
-    uint64_t m_VulkanBudget[VK_MAX_MEMORY_HEAPS];
-    uint64_t m_BlockBytesAtBudgetFetch[VK_MAX_MEMORY_HEAPS];
-#endif // VMA_MEMORY_BUDGET
+    uint32_t slabIndex = 0;
+    uint32_t slot = 0;
+    FindSlot(request.allocHandle, slabIndex, slot);
+    Slab& slab = m_Slabs[slabIndex];
 
-    VmaCurrentBudgetData();
+    if (slab.sizeClass == FREE_SLAB)
+    {
+        RemoveSlab(m_FreeSlabs, slabIndex);
+        --m_FreeSlabCount;
+        InitSlab(slab, (uint8_t)request.algorithmData, (uint8_t)(request.algorithmData >> 8));
+        PushSlab(m_PartialSlabs[GetListIndex(slab.sizeClass, slab.granularityKind)], slabIndex);
+        m_FreeSlotCount += slab.slotCount;
+        // Handle was computed for the first slot before the slab got its size class.
+        VMA_ASSERT(slot == 0);
+    }
+    VMA_ASSERT(slab.sizeClass == (uint8_t)request.algorithmData);
+    VMA_ASSERT(slab.granularityKind == GetGranularityKind(type));
+    VMA_ASSERT(IsSlotFree(slab, slot));
 
-    void AddAllocation(uint32_t heapIndex, VkDeviceSize allocationSize);
-    void RemoveAllocation(uint32_t heapIndex, VkDeviceSize allocationSize);
-};
+    slab.freeMask[slot / 64] &= ~(1ULL << (slot % 64));
+    slab.userData[slot] = userData;
+    const uint32_t wordCount = (slab.slotCount + 63) / 64;
+    while (slab.firstFreeWord < wordCount && slab.freeMask[slab.firstFreeWord] == 0)
+        ++slab.firstFreeWord;
 
-#ifndef _VMA_CURRENT_BUDGET_DATA_FUNCTIONS
-VmaCurrentBudgetData::VmaCurrentBudgetData()
+    if (--slab.freeSlotCount == 0)
+        RemoveSlab(m_PartialSlabs[GetListIndex(slab.sizeClass, slab.granularityKind)], slabIndex);
+    --m_FreeSlotCount;
+    ++m_AllocCount;
+    m_AllocatedSize += GetClassSize(slab.sizeClass);
+}
+
+void VmaBlockMetadata_Slab::Free(VmaAllocHandle allocHandle)
 {
-    for (uint32_t heapIndex = 0; heapIndex < VK_MAX_MEMORY_HEAPS; ++heapIndex)
+    uint32_t slabIndex = 0;
+    uint32_t slot = 0;
+    FindSlot(allocHandle, slabIndex, slot);
+    Slab& slab = m_Slabs[slabIndex];
+    VMA_ASSERT(slab.sizeClass != FREE_SLAB && !IsSlotFree(slab, slot) && "Invalid allocation handle!");
+
+    slab.freeMask[slot / 64] |= 1ULL << (slot % 64);
+    slab.userData[slot] = VMA_NULL;
+    if (slot / 64 < slab.firstFreeWord)
+        slab.firstFreeWord = slot / 64;
+
+    uint32_t& listHead = m_PartialSlabs[GetListIndex(slab.sizeClass, slab.granularityKind)];
+    if (slab.freeSlotCount++ == 0)
+        PushSlab(listHead, slabIndex);
+    ++m_FreeSlotCount;
+    --m_AllocCount;
+    m_AllocatedSize -= GetClassSize(slab.sizeClass);
+
+    // Return empty slab so it can serve any size class.
+    if (slab.freeSlotCount == slab.slotCount)
     {
-        m_BlockCount[heapIndex] = 0;
-        m_AllocationCount[heapIndex] = 0;
-        m_BlockBytes[heapIndex] = 0;
-        m_AllocationBytes[heapIndex] = 0;
-#if VMA_MEMORY_BUDGET
-        m_VulkanUsage[heapIndex] = 0;
-        m_VulkanBudget[heapIndex] = 0;
-        m_BlockBytesAtBudgetFetch[heapIndex] = 0;
-#endif
+        RemoveSlab(listHead, slabIndex);
+        m_FreeSlotCount -= slab.slotCount;
+        slab.sizeClass = FREE_SLAB;
+        PushSlab(m_FreeSlabs, slabIndex);
+        ++m_FreeSlabCount;
     }
+}
 
-#if VMA_MEMORY_BUDGET
-    m_OperationsSinceBudgetFetch = 0;
-#endif
+void VmaBlockMetadata_Slab::GetAllocationInfo(VmaAllocHandle allocHandle, VmaVirtualAllocationInfo& outInfo)
+{
+    uint32_t slabIndex = 0;
+    uint32_t slot = 0;
+    FindSlot(allocHandle, slabIndex, slot);
+    const Slab& slab = m_Slabs[slabIndex];
+    VMA_ASSERT(slab.sizeClass != FREE_SLAB && !IsSlotFree(slab, slot) && "Cannot get allocation info for free slot!");
+    outInfo.offset = GetSlotOffset(slabIndex, slot);
+    outInfo.size = GetClassSize(slab.sizeClass) - GetDebugMargin();
+    outInfo.pUserData = slab.userData[slot];
 }
 
-void VmaCurrentBudgetData::AddAllocation(uint32_t heapIndex, VkDeviceSize allocationSize)
+void* VmaBlockMetadata_Slab::GetAllocationUserData(VmaAllocHandle allocHandle) const
 {
-    m_AllocationBytes[heapIndex] += allocationSize;
-    ++m_AllocationCount[heapIndex];
-#if VMA_MEMORY_BUDGET
-    ++m_OperationsSinceBudgetFetch;
-#endif
+    uint32_t slabIndex = 0;
+    uint32_t slot = 0;
+    FindSlot(allocHandle, slabIndex, slot);
+    const Slab& slab = m_Slabs[slabIndex];
+    VMA_ASSERT(slab.sizeClass != FREE_SLAB && !IsSlotFree(slab, slot) && "Cannot get user data for free slot!");
+    return slab.userData[slot];
 }
 
-void VmaCurrentBudgetData::RemoveAllocation(uint32_t heapIndex, VkDeviceSize allocationSize)
+VmaAllocHandle VmaBlockMetadata_Slab::GetAllocationListBegin() const
 {
-    VMA_ASSERT(m_AllocationBytes[heapIndex] >= allocationSize);
-    m_AllocationBytes[heapIndex] -= allocationSize;
-    VMA_ASSERT(m_AllocationCount[heapIndex] > 0);
-    --m_AllocationCount[heapIndex];
-#if VMA_MEMORY_BUDGET
-    ++m_OperationsSinceBudgetFetch;
-#endif
+    if (m_AllocCount == 0)
+        return VK_NULL_HANDLE;
+    return FindAllocation(0, 0);
 }
-#endif // _VMA_CURRENT_BUDGET_DATA_FUNCTIONS
-#endif // _VMA_CURRENT_BUDGET_DATA
 
-#ifndef _VMA_ALLOCATION_OBJECT_ALLOCATOR
-/*
-Thread-safe wrapper over VmaPoolAllocator free list, for allocation of VmaAllocation_T objects.
-*/
-class VmaAllocationObjectAllocator
+VmaAllocHandle VmaBlockMetadata_Slab::GetNextAllocation(VmaAllocHandle prevAlloc) const
 {
-    VMA_CLASS_NO_COPY(VmaAllocationObjectAllocator)
-public:
-    VmaAllocationObjectAllocator(const VkAllocationCallbacks* pAllocationCallbacks)
-        : m_Allocator(pAllocationCallbacks, 1024) {}
+    uint32_t slabIndex = 0;
+    uint32_t slot = 0;
+    FindSlot(prevAlloc, slabIndex, slot);
+    return FindAllocation(slabIndex, slot + 1);
+}
 
-    template<typename... Types> VmaAllocation Allocate(Types&&... args);
-    void Free(VmaAllocation hAlloc);
+VkDeviceSize VmaBlockMetadata_Slab::GetNextFreeRegionSize(VmaAllocHandle alloc) const
+{
+    uint32_t slabIndex = 0;
+    uint32_t slot = 0;
+    FindSlot(alloc, slabIndex, slot);
+    const Slab& slab = m_Slabs[slabIndex];
+    VMA_ASSERT(slab.sizeClass != FREE_SLAB && !IsSlotFree(slab, slot) && "Incorrect allocation!");
 
-private:
-    VMA_MUTEX m_Mutex;
-    VmaPoolAllocator<VmaAllocation_T> m_Allocator;
-};
+    if (slot + 1 < slab.slotCount && IsSlotFree(slab, slot + 1))
+        return GetClassSize(slab.sizeClass);
+    return 0;
+}
 
-template<typename... Types>
-VmaAllocation VmaAllocationObjectAllocator::Allocate(Types&&... args)
+void VmaBlockMetadata_Slab::Clear()
 {
-    VmaMutexLock mutexLock(m_Mutex);
-    return m_Allocator.Alloc<Types...>(std::forward<Types>(args)...);
+    m_AllocCount = 0;
+    m_AllocatedSize = 0;
+    m_FreeSlotCount = 0;
+    ResetSlabs();
 }
 
-void VmaAllocationObjectAllocator::Free(VmaAllocation hAlloc)
+void VmaBlockMetadata_Slab::SetAllocationUserData(VmaAllocHandle allocHandle, void* userData)
 {
-    VmaMutexLock mutexLock(m_Mutex);
-    m_Allocator.Free(hAlloc);
+    uint32_t slabIndex = 0;
+    uint32_t slot = 0;
+    FindSlot(allocHandle, slabIndex, slot);
+    Slab& slab = m_Slabs[slabIndex];
+    VMA_ASSERT(slab.sizeClass != FREE_SLAB && !IsSlotFree(slab, slot) && "Trying to set user data for not allocated slot!");
+    slab.userData[slot] = userData;
 }
-#endif // _VMA_ALLOCATION_OBJECT_ALLOCATOR
 
-#ifndef _VMA_VIRTUAL_BLOCK_T
-struct VmaVirtualBlock_T
+void VmaBlockMetadata_Slab::DebugLogAllAllocations() const
 {
-    VMA_CLASS_NO_COPY(VmaVirtualBlock_T)
-public:
-    const bool m_AllocationCallbacksSpecified;
-    const VkAllocationCallbacks m_AllocationCallbacks;
-
-    VmaVirtualBlock_T(const VmaVirtualBlockCreateInfo& createInfo);
-    ~VmaVirtualBlock_T();
-
-    VkResult Init() { return VK_SUCCESS; }
-    bool IsEmpty() const { return m_Metadata->IsEmpty(); }
-    void Free(VmaVirtualAllocation allocation) { m_Metadata->Free((VmaAllocHandle)allocation); }
-    void SetAllocationUserData(VmaVirtualAllocation allocation, void* userData) { m_Metadata->SetAllocationUserData((VmaAllocHandle)allocation, userData); }
-    void Clear() { m_Metadata->Clear(); }
+    VisitRanges([this](VkDeviceSize offset, VkDeviceSize size, void* pUserData, bool isFree)
+        {
+            if (!isFree)
+                DebugLogAllocation(offset, size, pUserData);
+        });
+}
 
-    const VkAllocationCallbacks* GetAllocationCallbacks() const;
-    void GetAllocationInfo(VmaVirtualAllocation allocation, VmaVirtualAllocationInfo& outInfo);
-    VkResult Allocate(const VmaVirtualAllocationCreateInfo& createInfo, VmaVirtualAllocation& outAllocation,
-        VkDeviceSize* outOffset);
-    void GetStatistics(VmaStatistics& outStats) const;
-    void CalculateDetailedStatistics(VmaDetailedStatistics& outStats) const;
-#if VMA_STATS_STRING_ENABLED
-    void BuildStatsString(bool detailedMap, VmaStringBuilder& sb) const;
-#endif
+VkDeviceSize VmaBlockMetadata_Slab::GetClassSize(uint8_t sizeClass)
+{
+    const VkDeviceSize base = 1ULL << (MIN_SIZE_CLASS_SHIFT + sizeClass / 2);
+    return (sizeClass % 2) ? base + base / 2 : base;
+}
 
-private:
-    VmaBlockMetadata* m_Metadata;
-};
+uint8_t VmaBlockMetadata_Slab::FindSizeClass(VkDeviceSize size, VkDeviceSize alignment)
+{
+    uint8_t sizeClass = 0;
+    if (size > (1ULL << MIN_SIZE_CLASS_SHIFT))
+    {
+        // Between 2^n and 2^(n+1) there is one more class at 1.5 * 2^n.
+        const uint8_t msb = VMA_BITSCAN_MSB(size - 1);
+        sizeClass = (uint8_t)((msb - MIN_SIZE_CLASS_SHIFT) * 2 + (size <= (3ULL << (msb - 1)) ? 1 : 2));
+    }
+    // Slot offsets are aligned to the lowest set bit of the class size.
+    for (; sizeClass < SIZE_CLASS_COUNT; ++sizeClass)
+    {
+        const VkDeviceSize classSize = GetClassSize(sizeClass);
+        if ((classSize & (~classSize + 1)) >= alignment)
+            break;
+    }
+    // Sizes above the largest class compute an index past the end.
+    return sizeClass < SIZE_CLASS_COUNT ? sizeClass : SIZE_CLASS_COUNT;
+}
 
-#ifndef _VMA_VIRTUAL_BLOCK_T_FUNCTIONS
-VmaVirtualBlock_T::VmaVirtualBlock_T(const VmaVirtualBlockCreateInfo& createInfo)
-    : m_AllocationCallbacksSpecified(createInfo.pAllocationCallbacks != VMA_NULL),
-    m_AllocationCallbacks(createInfo.pAllocationCallbacks != VMA_NULL ? *createInfo.pAllocationCallbacks : VmaEmptyAllocationCallbacks)
+uint8_t VmaBlockMetadata_Slab::GetGranularityKind(VmaSuballocationType type, VkDeviceSize bufferImageGranularity)
 {
-    const uint32_t algorithm = createInfo.flags & VMA_VIRTUAL_BLOCK_CREATE_ALGORITHM_MASK;
-    switch (algorithm)
+    if (bufferImageGranularity == 1)
+        return 0;
+
+    switch (type)
     {
+    case VMA_SUBALLOCATION_TYPE_BUFFER:
+    case VMA_SUBALLOCATION_TYPE_IMAGE_LINEAR:
+        return 0;
+    case VMA_SUBALLOCATION_TYPE_IMAGE_OPTIMAL:
+        return 1;
     default:
-        VMA_ASSERT(0);
-    case 0:
-        m_Metadata = vma_new(GetAllocationCallbacks(), VmaBlockMetadata_TLSF)(VK_NULL_HANDLE, 1, true);
-        break;
-    case VMA_VIRTUAL_BLOCK_CREATE_LINEAR_ALGORITHM_BIT:
-        m_Metadata = vma_new(GetAllocationCallbacks(), VmaBlockMetadata_Linear)(VK_NULL_HANDLE, 1, true);
-        break;
+        return GRANULARITY_KIND_COUNT - 1;
     }
+}
 
-    m_Metadata->Init(createInfo.size);
+VkDeviceSize VmaBlockMetadata_Slab::GetSlotOffset(uint32_t slabIndex, uint32_t slot) const
+{
+    return ((VkDeviceSize)slabIndex << m_SlabSizeShift) + slot * GetClassSize(m_Slabs[slabIndex].sizeClass);
 }
 
-VmaVirtualBlock_T::~VmaVirtualBlock_T()
+void VmaBlockMetadata_Slab::FindSlot(VmaAllocHandle allocHandle, uint32_t& outSlabIndex, uint32_t& outSlot) const
 {
-    // Define macro VMA_DEBUG_LOG to receive the list of the unfreed allocations
-    if (!m_Metadata->IsEmpty())
-        m_Metadata->DebugLogAllAllocations();
-    // This is the most important assert in the entire library.
-    // Hitting it means you have some memory leak - unreleased virtual allocations.
-    VMA_ASSERT(m_Metadata->IsEmpty() && "Some virtual allocations were not freed before destruction of this virtual block!");
+    const VkDeviceSize offset = GetAllocationOffset(allocHandle);
+    outSlabIndex = (uint32_t)(offset >> m_SlabSizeShift);
+    VMA_ASSERT(outSlabIndex < m_SlabCount);
 
-    vma_delete(GetAllocationCallbacks(), m_Metadata);
+    const Slab& slab = m_Slabs[outSlabIndex];
+    const VkDeviceSize offsetInSlab = offset - ((VkDeviceSize)outSlabIndex << m_SlabSizeShift);
+    // Free slab gets its size class when first slot is allocated from it.
+    outSlot = slab.sizeClass == FREE_SLAB ? 0 : (uint32_t)(offsetInSlab / GetClassSize(slab.sizeClass));
 }
 
-const VkAllocationCallbacks* VmaVirtualBlock_T::GetAllocationCallbacks() const
+uint32_t VmaBlockMetadata_Slab::FindFreeSlot(const Slab& slab) const
 {
-    return m_AllocationCallbacksSpecified ? &m_AllocationCallbacks : VMA_NULL;
+    VMA_ASSERT(slab.freeSlotCount > 0);
+    for (uint32_t word = slab.firstFreeWord; ; ++word)
+    {
+        VMA_HEAVY_ASSERT(word < (slab.slotCount + 63) / 64);
+        if (slab.freeMask[word] != 0)
+            return word * 64 + VMA_BITSCAN_LSB(slab.freeMask[word]);
+    }
 }
 
-void VmaVirtualBlock_T::GetAllocationInfo(VmaVirtualAllocation allocation, VmaVirtualAllocationInfo& outInfo)
+VmaAllocHandle VmaBlockMetadata_Slab::FindAllocation(uint32_t slabIndex, uint32_t slot) const
 {
-    m_Metadata->GetAllocationInfo((VmaAllocHandle)allocation, outInfo);
+    for (; slabIndex < m_SlabCount; ++slabIndex, slot = 0)
+    {
+        const Slab& slab = m_Slabs[slabIndex];
+        if (slab.sizeClass == FREE_SLAB)
+            continue;
+        for (; slot < slab.slotCount; ++slot)
+        {
+            if (!IsSlotFree(slab, slot))
+                return (VmaAllocHandle)(GetSlotOffset(slabIndex, slot) + 1);
+        }
+    }
+    return VK_NULL_HANDLE;
 }
 
-VkResult VmaVirtualBlock_T::Allocate(const VmaVirtualAllocationCreateInfo& createInfo, VmaVirtualAllocation& outAllocation,
-    VkDeviceSize* outOffset)
+void VmaBlockMetadata_Slab::InitSlab(Slab& slab, uint8_t sizeClass, uint8_t granularityKind)
 {
-    VmaAllocationRequest request = {};
-    if (m_Metadata->CreateAllocationRequest(
-        createInfo.size, // allocSize
-        VMA_MAX(createInfo.alignment, (VkDeviceSize)1), // allocAlignment
-        (createInfo.flags & VMA_VIRTUAL_ALLOCATION_CREATE_UPPER_ADDRESS_BIT) != 0, // upperAddress
-        VMA_SUBALLOCATION_TYPE_UNKNOWN, // allocType - unimportant
-        createInfo.flags & VMA_VIRTUAL_ALLOCATION_CREATE_STRATEGY_MASK, // strategy
-        &request))
+    const uint32_t slotCount = (uint32_t)(m_SlabSize / GetClassSize(sizeClass));
+    const uint32_t wordCount = (slotCount + 63) / 64;
+    // Slot arrays are kept when slab is freed and only grow when it is reused for a smaller size class.
+    if (slotCount > slab.slotCapacity)
     {
-        m_Metadata->Alloc(request,
-            VMA_SUBALLOCATION_TYPE_UNKNOWN, // type - unimportant
-            createInfo.pUserData);
-        outAllocation = (VmaVirtualAllocation)request.allocHandle;
-        if(outOffset)
-            *outOffset = m_Metadata->GetAllocationOffset(request.allocHandle);
-        return VK_SUCCESS;
+        if (slab.slotCapacity > 0)
+        {
+            vma_delete_array(GetAllocationCallbacks(), slab.freeMask, (slab.slotCapacity + 63) / 64);
+            vma_delete_array(GetAllocationCallbacks(), slab.userData, slab.slotCapacity);
+        }
+        slab.freeMask = vma_new_array(GetAllocationCallbacks(), uint64_t, wordCount);
+        slab.userData = vma_new_array(GetAllocationCallbacks(), void*, slotCount);
+        slab.slotCapacity = slotCount;
     }
-    outAllocation = (VmaVirtualAllocation)VK_NULL_HANDLE;
-    if (outOffset)
-        *outOffset = UINT64_MAX;
-    return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+
+    memset(slab.freeMask, 0xFF, wordCount * sizeof(uint64_t));
+    if (slotCount % 64 != 0)
+        slab.freeMask[wordCount - 1] = (1ULL << (slotCount % 64)) - 1;
+    slab.slotCount = slotCount;
+    slab.freeSlotCount = slotCount;
+    slab.firstFreeWord = 0;
+    slab.sizeClass = sizeClass;
+    slab.granularityKind = granularityKind;
 }
 
-void VmaVirtualBlock_T::GetStatistics(VmaStatistics& outStats) const
+void VmaBlockMetadata_Slab::PushSlab(uint32_t& listHead, uint32_t slabIndex)
 {
-    VmaClearStatistics(outStats);
-    m_Metadata->AddStatistics(outStats);
+    Slab& slab = m_Slabs[slabIndex];
+    slab.prev = INVALID_SLAB;
+    slab.next = listHead;
+    if (listHead != INVALID_SLAB)
+        m_Slabs[listHead].prev = slabIndex;
+    listHead = slabIndex;
 }
 
-void VmaVirtualBlock_T::CalculateDetailedStatistics(VmaDetailedStatistics& outStats) const
+void VmaBlockMetadata_Slab::RemoveSlab(uint32_t& listHead, uint32_t slabIndex)
 {
-    VmaClearDetailedStatistics(outStats);
-    m_Metadata->AddDetailedStatistics(outStats);
+    Slab& slab = m_Slabs[slabIndex];
+    if (slab.prev != INVALID_SLAB)
+        m_Slabs[slab.prev].next = slab.next;
+    else
+    {
+        VMA_ASSERT(listHead == slabIndex);
+        listHead = slab.next;
+    }
+    if (slab.next != INVALID_SLAB)
+        m_Slabs[slab.next].prev = slab.prev;
+    slab.prev = INVALID_SLAB;
+    slab.next = INVALID_SLAB;
 }
 
-#if VMA_STATS_STRING_ENABLED
-void VmaVirtualBlock_T::BuildStatsString(bool detailedMap, VmaStringBuilder& sb) const
+void VmaBlockMetadata_Slab::ResetSlabs()
 {
-    VmaJsonWriter json(GetAllocationCallbacks(), sb);
-    json.BeginObject();
-
-    VmaDetailedStatistics stats;
-    CalculateDetailedStatistics(stats);
-
-    json.WriteString("Stats");
-    VmaPrintDetailedStatistics(json, stats);
-
-    if (detailedMap)
+    // Free list goes in order of offsets so slabs are taken from the beginning of the block first.
+    for (uint32_t i = 0; i < m_SlabCount; ++i)
     {
-        json.WriteString("Details");
-        json.BeginObject();
-        m_Metadata->PrintDetailedMap(json);
-        json.EndObject();
+        Slab& slab = m_Slabs[i];
+        slab.sizeClass = FREE_SLAB;
+        slab.prev = i > 0 ? i - 1 : INVALID_SLAB;
+        slab.next = i + 1 < m_SlabCount ? i + 1 : INVALID_SLAB;
     }
-
-    json.EndObject();
+    m_FreeSlabs = m_SlabCount > 0 ? 0 : INVALID_SLAB;
+    m_FreeSlabCount = m_SlabCount;
+    for (uint32_t listIndex = 0; listIndex < SIZE_CLASS_COUNT * GRANULARITY_KIND_COUNT; ++listIndex)
+        m_PartialSlabs[listIndex] = INVALID_SLAB;
 }
-#endif // VMA_STATS_STRING_ENABLED
-#endif // _VMA_VIRTUAL_BLOCK_T_FUNCTIONS
-#endif // _VMA_VIRTUAL_BLOCK_T
 
+#endif // _VMA_BLOCK_METADATA_SLAB_FUNCTIONS
+#endif // _VMA_BLOCK_METADATA_SLAB
 
-// Main allocator object.
-struct VmaAllocator_T
+#ifndef _VMA_BLOCK_VECTOR
+/*
+Sequence of VmaDeviceMemoryBlock. Represents memory blocks allocated for a specific
+Vulkan memory type.
+
+Synchronized internally with a mutex.
+*/
+class VmaBlockVector
 {
-    VMA_CLASS_NO_COPY(VmaAllocator_T)
+    friend struct VmaDefragmentationContext_T;
+    VMA_CLASS_NO_COPY(VmaBlockVector)
 public:
-    bool m_UseMutex;
-    uint32_t m_VulkanApiVersion;
-    bool m_UseKhrDedicatedAllocation; // Can be set only if m_VulkanApiVersion < VK_MAKE_VERSION(1, 1, 0).
-    bool m_UseKhrBindMemory2; // Can be set only if m_VulkanApiVersion < VK_MAKE_VERSION(1, 1, 0).
-    bool m_UseExtMemoryBudget;
-    bool m_UseAmdDeviceCoherentMemory;
-    bool m_UseKhrBufferDeviceAddress;
-    bool m_UseExtMemoryPriority;
-    VkDevice m_hDevice;
-    VkInstance m_hInstance;
-    bool m_AllocationCallbacksSpecified;
-    VkAllocationCallbacks m_AllocationCallbacks;
-    VmaDeviceMemoryCallbacks m_DeviceMemoryCallbacks;
-    VmaAllocationObjectAllocator m_AllocationObjectAllocator;
+    VmaBlockVector(
+        VmaAllocator hAllocator,
+        VmaPool hParentPool,
+        uint32_t memoryTypeIndex,
+        VkDeviceSize preferredBlockSize,
+        size_t minBlockCount,
+        size_t maxBlockCount,
+        VkDeviceSize bufferImageGranularity,
+        bool explicitBlockSize,
+        uint32_t algorithm,
+        float priority,
+        VkDeviceSize minAllocationAlignment,
+        void* pMemoryAllocateNext);
+    ~VmaBlockVector();
 
-    // Each bit (1 << i) is set if HeapSizeLimit is enabled for that heap, so cannot allocate more than the heap size.
-    uint32_t m_HeapSizeLimitMask;
+    VmaAllocator GetAllocator() const { return m_hAllocator; }
+    VmaPool GetParentPool() const { return m_hParentPool; }
+    bool IsCustomPool() const { return m_hParentPool != VMA_NULL; }
+    uint32_t GetMemoryTypeIndex() const { return m_MemoryTypeIndex; }
+    VkDeviceSize GetPreferredBlockSize() const { return m_PreferredBlockSize; }
+    VkDeviceSize GetBufferImageGranularity() const { return m_BufferImageGranularity; }
+    uint32_t GetAlgorithm() const { return m_Algorithm; }
+    bool HasExplicitBlockSize() const { return m_ExplicitBlockSize; }
+    float GetPriority() const { return m_Priority; }
+    const void* GetAllocationNextPtr() const { return m_pMemoryAllocateNext; }
+    // To be used only while the m_Mutex is locked. Used during defragmentation.
+    size_t GetBlockCount() const { return m_Blocks.size(); }
+    // To be used only while the m_Mutex is locked. Used during defragmentation.
+    VmaDeviceMemoryBlock* GetBlock(size_t index) const { return m_Blocks[index]; }
+    VMA_RW_MUTEX &GetMutex() { return m_Mutex; }
 
-    VkPhysicalDeviceProperties m_PhysicalDeviceProperties;
-    VkPhysicalDeviceMemoryProperties m_MemProps;
+    VkResult CreateMinBlocks();
+    void AddStatistics(VmaStatistics& inoutStats);
+    void AddDetailedStatistics(VmaDetailedStatistics& inoutStats);
+    bool IsEmpty();
+    bool IsCorruptionDetectionEnabled() const;
 
-    // Default pools.
-    VmaBlockVector* m_pBlockVectors[VK_MAX_MEMORY_TYPES];
-    VmaDedicatedAllocationList m_DedicatedAllocations[VK_MAX_MEMORY_TYPES];
+    VkResult Allocate(
+        VkDeviceSize size,
+        VkDeviceSize alignment,
+        const VmaAllocationCreateInfo& createInfo,
+        VmaSuballocationType suballocType,
+        size_t allocationCount,
+        VmaAllocation* pAllocations);
 
-    VmaCurrentBudgetData m_Budget;
-    VMA_ATOMIC_UINT32 m_DeviceMemoryCount; // Total number of VkDeviceMemory objects.
+    void Free(const VmaAllocation hAllocation) { Free(1, &hAllocation); }
+    // Frees multiple allocations under a single lock of the mutex.
+    void Free(size_t allocationCount, const VmaAllocation* pAllocations);
 
-    VmaAllocator_T(const VmaAllocatorCreateInfo* pCreateInfo);
-    VkResult Init(const VmaAllocatorCreateInfo* pCreateInfo);
-    ~VmaAllocator_T();
+#if VMA_STATS_STRING_ENABLED
+    void PrintDetailedMap(class VmaJsonWriter& json);
+#endif
 
-    const VkAllocationCallbacks* GetAllocationCallbacks() const
-    {
-        return m_AllocationCallbacksSpecified ? &m_AllocationCallbacks : VMA_NULL;
-    }
-    const VmaVulkanFunctions& GetVulkanFunctions() const
-    {
-        return m_VulkanFunctions;
-    }
+    VkResult CheckCorruption();
 
-    VkPhysicalDevice GetPhysicalDevice() const { return m_PhysicalDevice; }
+    // Peak number of blocks, peak sum of their sizes and size of the largest block created so far.
+    void GetBlockProfile(size_t& outPeakBlockCount, VkDeviceSize& outPeakBlockBytes, VkDeviceSize& outMaxBlockSize);
+    /*
+    Creates blocks of up to blockSize until there are blockCount of them or they sum up to totalBytes,
+    as long as heap budget allows. They are not deleted when empty, like the ones of m_MinBlockCount.
+    vkAllocateMemory is called without m_Mutex locked.
+    */
+    VkResult CreateProfileBlocks(size_t blockCount, VkDeviceSize blockSize, VkDeviceSize totalBytes);
+    /*
+    Creates a spare block of the next size if the vector has at least one block, none of them is empty,
+    their free space is below minFreeSize, and heap budget allows. vkAllocateMemory is called without m_Mutex locked.
+    */
+    VkResult PreallocateBlock(VkDeviceSize minFreeSize, bool& outAllocated);
 
-    VkDeviceSize GetBufferImageGranularity() const
-    {
-        return VMA_MAX(
-            static_cast<VkDeviceSize>(VMA_DEBUG_MIN_BUFFER_IMAGE_GRANULARITY),
-            m_PhysicalDeviceProperties.limits.bufferImageGranularity);
-    }
+private:
+    const VmaAllocator m_hAllocator;
+    const VmaPool m_hParentPool;
+    const uint32_t m_MemoryTypeIndex;
+    const VkDeviceSize m_PreferredBlockSize;
+    const size_t m_MinBlockCount;
+    const size_t m_MaxBlockCount;
+    const VkDeviceSize m_BufferImageGranularity;
+    const bool m_ExplicitBlockSize;
+    const uint32_t m_Algorithm;
+    const float m_Priority;
+    const VkDeviceSize m_MinAllocationAlignment;
 
-    uint32_t GetMemoryHeapCount() const { return m_MemProps.memoryHeapCount; }
-    uint32_t GetMemoryTypeCount() const { return m_MemProps.memoryTypeCount; }
+    void* const m_pMemoryAllocateNext;
+    /*
+    Protects m_Blocks and m_BlockVectorIndex of the blocks.
+    Read lock is enough to allocate from or free to an existing block, together with its VmaDeviceMemoryBlock::m_MetadataMutex.
+    Write lock is needed to create, delete, or reorder blocks.
+    */
+    VMA_RW_MUTEX m_Mutex;
+    // Incrementally sorted by sumFreeSize, ascending.
+    VmaVector<VmaDeviceMemoryBlock*, VmaStlAllocator<VmaDeviceMemoryBlock*>> m_Blocks;
+    // Number of blocks in m_Blocks with empty metadata.
+    VMA_ATOMIC_UINT32 m_EmptyBlockCount;
+    /*
+    Segment tree of VmaBlockMetadata::GetMaxFreeRegionSize() of m_Blocks, to find blocks
+    that can fit an allocation in O(log n) instead of trying them all.
+    Node 1 is the root, children of node i are 2i and 2i+1, block i is at leaf m_MaxFreeTreeLeafCount + i.
+    Leaves past m_Blocks.size() are 0.
+    */
+    VmaVector<VkDeviceSize, VmaStlAllocator<VkDeviceSize>> m_MaxFreeTree;
+    size_t m_MaxFreeTreeLeafCount;
+    // Protects m_MaxFreeTree when updated under read lock of m_Mutex.
+    VMA_MUTEX m_MaxFreeTreeMutex;
+    uint32_t m_NextBlockId;
+    bool m_IncrementalSort = true;
+    // Running statistics of all m_Blocks, or null if the algorithm doesn't maintain them.
+    VmaStatisticsCounters* m_pStatisticsCounters;
+    // Members below are protected by m_Mutex.
+    // Number of blocks created by CreateProfileBlocks(), kept even when empty on top of m_MinBlockCount.
+    size_t m_ProfileBlockCount = 0;
+    size_t m_PeakBlockCount = 0;
+    VkDeviceSize m_PeakBlockBytes = 0;
+    VkDeviceSize m_MaxCreatedBlockSize = 0;
+    // Last block created by PreallocateBlock(). Kept as the empty block when a free leaves no other one,
+    // as long as it hasn't been used yet. When a free empties another block, that one is kept
+    // and this one is deleted by RemoveEmptyBlocks().
+    VmaDeviceMemoryBlock* m_pPreallocatedBlock = VMA_NULL;
 
-    uint32_t MemoryTypeIndexToHeapIndex(uint32_t memTypeIndex) const
+    void SetIncrementalSort(bool val) { m_IncrementalSort = val; }
+    size_t GetMinBlockCount() const { return m_MinBlockCount + m_ProfileBlockCount; }
+
+    VkDeviceSize CalcMaxBlockSize() const;
+    // Compares m_pStatisticsCounters with statistics calculated from all the blocks.
+    bool ValidateStatisticsCounters();
+    // Performs single step in sorting m_Blocks. They may not be fully sorted
+    // after this call.
+    void IncrementallySortBlocks();
+    // Calls IncrementallySortBlocks() if m_Mutex can be locked for writing without waiting. Call without m_Mutex locked.
+    void TryIncrementallySortBlocks();
+    void SortByFreeSize();
+    void SwapBlocks(size_t index1, size_t index2);
+
+    // Recalculates m_MaxFreeTree and m_BlockVectorIndex of all blocks. Call after m_Blocks was reordered or shrunk.
+    void RebuildMaxFreeTree();
+    // Updates m_MaxFreeTree after a change of m_Blocks[index] or of its metadata.
+    void UpdateMaxFreeTree(size_t index);
+    // Returns index of the first block at or after firstIndex that may fit size, or SIZE_MAX.
+    size_t FindNextBlockWithFreeRegion(size_t firstIndex, VkDeviceSize size);
+    // Returns index of the last block before endIndex that may fit size, or SIZE_MAX.
+    size_t FindPrevBlockWithFreeRegion(size_t endIndex, VkDeviceSize size);
+
+    // Tries only blocks that already exist. Requires m_Mutex locked at least for reading.
+    VkResult AllocateFromExistingBlocks(
+        VkDeviceSize size,
+        VkDeviceSize alignment,
+        const VmaAllocationCreateInfo& createInfo,
+        VmaSuballocationType suballocType,
+        VmaAllocation* pAllocation);
+
+    // Requires m_Mutex locked for writing.
+    VkResult AllocatePage(
+        VkDeviceSize size,
+        VkDeviceSize alignment,
+        const VmaAllocationCreateInfo& createInfo,
+        VmaSuballocationType suballocType,
+        VmaAllocation* pAllocation);
+
+    VkResult AllocateFromBlock(
+        VmaDeviceMemoryBlock* pBlock,
+        VkDeviceSize size,
+        VkDeviceSize alignment,
+        VmaAllocationCreateFlags allocFlags,
+        void* pUserData,
+        VmaSuballocationType suballocType,
+        uint32_t strategy,
+        VmaAllocation* pAllocation);
+
+    VkResult CommitAllocationRequest(
+        VmaAllocationRequest& allocRequest,
+        VmaDeviceMemoryBlock* pBlock,
+        VkDeviceSize alignment,
+        VmaAllocationCreateFlags allocFlags,
+        void* pUserData,
+        VmaSuballocationType suballocType,
+        VmaAllocation* pAllocation);
+
+    VkResult CreateBlock(VkDeviceSize blockSize, size_t* pNewBlockIndex);
+    // Calls vkAllocateMemory for a new block. Doesn't need m_Mutex locked.
+    VkResult AllocateBlockMemory(VkDeviceSize blockSize, VkDeviceMemory* pMemory);
+    // Wraps memory allocated by AllocateBlockMemory() in a new block. Requires m_Mutex locked for writing.
+    void AddBlock(VkDeviceMemory memory, VkDeviceSize blockSize, size_t* pNewBlockIndex);
+    /*
+    Deletes empty blocks above GetMinBlockCount(), except pKeepBlock if it is empty and heap budget is not exceeded.
+    Requires m_Mutex locked for writing. Blocks are moved to blocksToDelete, to be destroyed after unlocking.
+    */
+    void RemoveEmptyBlocks(
+        const VmaDeviceMemoryBlock* pKeepBlock,
+        VmaSmallVector<VmaDeviceMemoryBlock*, VmaStlAllocator<VmaDeviceMemoryBlock*>, 4>& blocksToDelete);
+    bool IsHeapBudgetExceeded() const;
+    // Returns true if m_pPreallocatedBlock exists and is still empty. Requires m_Mutex locked at least for reading.
+    bool IsPreallocatedBlockEmpty();
+};
+#endif // _VMA_BLOCK_VECTOR
+
+#ifndef _VMA_DEFRAGMENTATION_CONTEXT
+struct VmaDefragmentationContext_T
+{
+    VMA_CLASS_NO_COPY(VmaDefragmentationContext_T)
+public:
+    VmaDefragmentationContext_T(
+        VmaAllocator hAllocator,
+        const VmaDefragmentationInfo& info);
+    ~VmaDefragmentationContext_T();
+
+    void GetStats(VmaDefragmentationStats& outStats) { outStats = m_GlobalStats; }
+    bool IsForDefaultPools() const { return m_PoolBlockVector == VMA_NULL; }
+
+    VkResult DefragmentPassBegin(VmaDefragmentationPassMoveInfo& moveInfo);
+    /*
+    If pOldPlaces is not null, old places of copied allocations are appended to it instead of being freed.
+    They must be freed later with FreeOldPlaces(), before the context is destroyed.
+    */
+    VkResult DefragmentPassEnd(VmaDefragmentationPassMoveInfo& moveInfo,
+        VmaVector<VmaAllocation, VmaStlAllocator<VmaAllocation>>* pOldPlaces = VMA_NULL);
+    void FreeOldPlaces(size_t count, const VmaAllocation* pOldPlaces);
+
+private:
+    // Max number of allocations to ignore due to size constraints before ending single pass
+    static const uint8_t MAX_ALLOCS_TO_IGNORE = 16;
+    enum class CounterStatus { Pass, Ignore, End };
+
+    struct FragmentedBlock
+    {
+        uint32_t data;
+        VmaDeviceMemoryBlock* block;
+    };
+    struct StateBalanced
+    {
+        VkDeviceSize avgFreeSize = 0;
+        VkDeviceSize avgAllocSize = UINT64_MAX;
+    };
+    struct StateExtensive
+    {
+        enum class Operation : uint8_t
+        {
+            FindFreeBlockBuffer, FindFreeBlockTexture, FindFreeBlockAll,
+            MoveBuffers, MoveTextures, MoveAll,
+            Cleanup, Done
+        };
+
+        Operation operation = Operation::FindFreeBlockTexture;
+        size_t firstFreeBlock = SIZE_MAX;
+    };
+    struct MoveAllocationData
+    {
+        VkDeviceSize size;
+        VkDeviceSize alignment;
+        VmaSuballocationType type;
+        VmaAllocationCreateFlags flags;
+        VmaDefragmentationMove move = {};
+    };
+
+    const VkDeviceSize m_MaxPassBytes;
+    const uint32_t m_MaxPassAllocations;
+
+    VmaStlAllocator<VmaDefragmentationMove> m_MoveAllocator;
+    VmaVector<VmaDefragmentationMove, VmaStlAllocator<VmaDefragmentationMove>> m_Moves;
+
+    uint8_t m_IgnoredAllocs = 0;
+    uint32_t m_Algorithm;
+    uint32_t m_BlockVectorCount;
+    VmaBlockVector* m_PoolBlockVector;
+    VmaBlockVector** m_pBlockVectors;
+    size_t m_ImmovableBlockCount = 0;
+    VmaDefragmentationStats m_GlobalStats = { 0 };
+    VmaDefragmentationStats m_PassStats = { 0 };
+    void* m_AlgorithmState = VMA_NULL;
+
+    static MoveAllocationData GetMoveData(VmaAllocHandle handle, VmaBlockMetadata* metadata);
+    CounterStatus CheckCounters(VkDeviceSize bytes);
+    bool IncrementCounters(VkDeviceSize bytes);
+    bool ReallocWithinBlock(VmaBlockVector& vector, VmaDeviceMemoryBlock* block);
+    bool AllocInOtherBlock(size_t start, size_t end, MoveAllocationData& data, VmaBlockVector& vector);
+
+    bool ComputeDefragmentation(VmaBlockVector& vector, size_t index);
+    bool ComputeDefragmentation_Fast(VmaBlockVector& vector);
+    bool ComputeDefragmentation_Balanced(VmaBlockVector& vector, size_t index, bool update);
+    bool ComputeDefragmentation_Full(VmaBlockVector& vector);
+    bool ComputeDefragmentation_Extensive(VmaBlockVector& vector, size_t index);
+    // Updates algorithm state after blocks of given vector might have been freed.
+    void UpdateFreedBlocks(uint32_t vectorIndex, VmaBlockVector* vector, size_t prevCount, size_t currentCount);
+
+    void UpdateVectorStatistics(VmaBlockVector& vector, StateBalanced& state);
+    bool MoveDataToFreeBlocks(VmaSuballocationType currentType,
+        VmaBlockVector& vector, size_t firstFreeBlock,
+        bool& texturePresent, bool& bufferPresent, bool& otherPresent);
+};
+#endif // _VMA_DEFRAGMENTATION_CONTEXT
+
+#if VMA_TIMELINE_SEMAPHORE
+#ifndef _VMA_DEFRAGMENTATION_EXECUTOR
+/*
+Drives VmaDefragmentationContext_T one pass at a time. Data of moved allocations is copied
+with vkCmdCopyBuffer between temporary buffers spanning whole source and destination
+VkDeviceMemory blocks, on the queue given by the user, and completion is tracked with
+a timeline semaphore polled in Step(). Copies of a pass may be split across several steps
+to respect the time budget. Old places of moved allocations are freed frameInUseCount
+frames after the pass is committed.
+*/
+struct VmaDefragmentationExecutor_T
+{
+    VMA_CLASS_NO_COPY(VmaDefragmentationExecutor_T)
+public:
+    VmaDefragmentationExecutor_T(
+        VmaAllocator hAllocator,
+        const VmaDefragmentationExecutorCreateInfo& createInfo);
+    ~VmaDefragmentationExecutor_T();
+
+    VkResult Init();
+    VkResult Step();
+    // Waits for the copies in flight and ends whole defragmentation.
+    void Finish(VmaDefragmentationStats* pStats);
+    void GetSemaphore(VkSemaphore& outSemaphore, uint64_t& outValue) const { outSemaphore = m_Semaphore; outValue = m_SubmittedValue; }
+
+private:
+    struct BlockBuffer
+    {
+        VkDeviceMemory memory;
+        // Null if memory type of the block doesn't support transfer buffers.
+        VkBuffer buffer;
+    };
+    struct OldPlace
+    {
+        VmaAllocation allocation;
+        // Frame index when the pass that moved the allocation out of it was committed.
+        uint32_t frameIndex;
+    };
+
+    const VmaAllocator m_hAllocator;
+    const VmaDefragmentationInfo m_DefragmentationInfo;
+    const VkQueue m_Queue;
+    const uint32_t m_QueueFamilyIndex;
+    const uint64_t m_MaxStepDuration;
+    const uint32_t m_FrameInUseCount;
+    const PFN_vmaDefragmentationMoveCallback m_pfnAllocationMoved;
+    void* const m_pUserData;
+
+    VmaDefragmentationContext m_Context = VMA_NULL;
+    VkCommandPool m_CommandPool = VK_NULL_HANDLE;
+    VkCommandBuffer m_CommandBuffer = VK_NULL_HANDLE;
+    VkSemaphore m_Semaphore = VK_NULL_HANDLE;
+    uint64_t m_SubmittedValue = 0;
+    bool m_CopiesInFlight = false;
+    bool m_PassOpen = false;
+    bool m_Done = false;
+    VmaDefragmentationPassMoveInfo m_PassInfo = {};
+    // Moves of the open pass before this index have been recorded already.
+    uint32_t m_NextMoveIndex = 0;
+    VmaVector<BlockBuffer, VmaStlAllocator<BlockBuffer>> m_BlockBuffers;
+    VmaVector<VmaAllocation, VmaStlAllocator<VmaAllocation>> m_MovedAllocations;
+    VmaVector<VmaAllocation, VmaStlAllocator<VmaAllocation>> m_PassOldPlaces;
+    // Sorted by frameIndex, as passes are committed in order.
+    VmaVector<OldPlace, VmaStlAllocator<OldPlace>> m_OldPlaces;
+
+    VkResult BeginPass(uint64_t stepStartTime);
+    // Records and submits copies of the open pass starting at m_NextMoveIndex, as many as the time budget allows.
+    VkResult SubmitCopies(uint64_t stepStartTime);
+    VkResult EndPass();
+    // Frees old places that are not in use anymore, or all of them.
+    void FreeOldPlaces(bool freeAll);
+    VkBuffer GetBlockBuffer(VmaDeviceMemoryBlock* block);
+    void DestroyBlockBuffers();
+};
+#endif // _VMA_DEFRAGMENTATION_EXECUTOR
+#endif // #if VMA_TIMELINE_SEMAPHORE
+
+#ifndef _VMA_RESIDENCY_MANAGER
+/*
+Moves allocations created with VMA_ALLOCATION_CREATE_CAN_BE_DEMOTED_BIT between default pools
+of DEVICE_LOCAL heaps and other heaps, least recently used first, reusing the structures
+of manual defragmentation passes.
+*/
+struct VmaResidencyManager_T
+{
+    VMA_CLASS_NO_COPY(VmaResidencyManager_T)
+public:
+    VmaResidencyManager_T(
+        VmaAllocator hAllocator,
+        const VmaResidencyManagerCreateInfo& createInfo);
+    ~VmaResidencyManager_T();
+
+    VkResult PassBegin(VmaDefragmentationPassMoveInfo& moveInfo);
+    void PassEnd(VmaDefragmentationPassMoveInfo& moveInfo);
+    void GetStats(VmaResidencyStats* pFrameStats, VmaResidencyStats* pTotalStats);
+
+private:
+    struct Candidate
+    {
+        VmaAllocation allocation;
+        uint32_t lastUseFrameIndex;
+    };
+
+    const VmaAllocator m_hAllocator;
+    const float m_DemoteThreshold;
+    const float m_PromoteThreshold;
+    const uint32_t m_MinIdleFrameCount;
+    const VkDeviceSize m_MaxPassBytes;
+    const uint32_t m_MaxPassAllocations;
+
+    VmaVector<VmaDefragmentationMove, VmaStlAllocator<VmaDefragmentationMove>> m_Moves;
+    VmaVector<Candidate, VmaStlAllocator<Candidate>> m_Candidates;
+    VkDeviceSize m_PassBytes = 0;
+
+    uint32_t m_StatsFrameIndex = 0;
+    VmaResidencyStats m_FrameStats = {};
+    VmaResidencyStats m_TotalStats = {};
+
+    bool IsHeapDeviceLocal(uint32_t heapIndex) const;
+    bool IsPassFull(VkDeviceSize size) const;
+    // Memory types of given heap and of all heaps that are not DEVICE_LOCAL.
+    void GetMemoryTypeBits(uint32_t heapIndex, uint32_t& outHeapMemTypeBits, uint32_t& outOtherMemTypeBits) const;
+    // Appends candidates from default pools of memory types in memTypeBits, in any order.
+    void CollectCandidates(uint32_t memTypeBits, uint32_t frameIndex, bool idle);
+    void Demote(uint32_t heapIndex, VkDeviceSize bytesToFree, uint32_t frameIndex);
+    void Promote(uint32_t heapIndex, VkDeviceSize bytesToAdd, uint32_t frameIndex);
+    bool AddMove(VmaAllocation allocation, uint32_t dstMemTypeIndex);
+    void UpdateFrameStats();
+};
+#endif // _VMA_RESIDENCY_MANAGER
+
+#ifndef _VMA_SPARSE_RESOURCE
+/*
+Tracks allocations backing pages of a sparse buffer or image. Each page is a separate allocation
+of size and alignment equal to the sparse block size, so pages come from the regular block vectors.
+Tiles of images created with VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT are allocations of the same size.
+Changes are only recorded in m_DirtyPages and m_DirtyTiles and applied to the resource by Bind().
+Memory of decommitted pages is freed only after Bind() submits their unbinding,
+through deferred freeing or FreeUnboundPages().
+*/
+struct VmaSparseResource_T
+{
+    VMA_CLASS_NO_COPY(VmaSparseResource_T)
+public:
+    VmaSparseResource_T(
+        VmaAllocator hAllocator,
+        VkBuffer buffer,
+        VkImage image,
+        const VkMemoryRequirements& memReq,
+        VkFlags bufferImageUsage,
+        const VmaAllocationCreateInfo& createInfo,
+        VmaSuballocationType suballocType);
+    ~VmaSparseResource_T();
+
+    VkBuffer GetBuffer() const { return m_Buffer; }
+    VkImage GetImage() const { return m_Image; }
+    void GetInfo(VmaSparseResourceInfo& outInfo) const;
+
+    // Takes sparse memory requirements of an image created with VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT.
+    void InitImageTiles(
+        const VkImageCreateInfo& createInfo,
+        uint32_t requirementCount,
+        const VkSparseImageMemoryRequirements* pRequirements);
+
+    VkResult Commit(VkDeviceSize firstPage, VkDeviceSize pageCount);
+    void Decommit(VkDeviceSize firstPage, VkDeviceSize pageCount);
+    VkResult CommitRegion(const VmaSparseImageRegion& region);
+    void DecommitRegion(const VmaSparseImageRegion& region);
+    // Frees memory of pages and tiles unbound by previous Bind().
+    void FreeUnboundPages();
+
+    static VkResult Bind(
+        VmaAllocator hAllocator,
+        VkQueue queue,
+        uint32_t resourceCount,
+        const VmaSparseResource* pResources,
+        const VmaSparseBindSubmitInfo* pSubmitInfo);
+
+private:
+    struct Page
+    {
+        VkDeviceSize index;
+        VmaAllocation allocation;
+    };
+    struct PageLess
+    {
+        bool operator()(const Page& lhs, VkDeviceSize rhsIndex) const { return lhs.index < rhsIndex; }
+        bool operator()(const Page& lhs, const Page& rhs) const { return lhs.index < rhs.index; }
+    };
+    struct Tile
+    {
+        VkImageAspectFlags aspectMask;
+        uint32_t mipLevel;
+        uint32_t arrayLayer;
+        // Coordinates in units of imageGranularity of the aspect.
+        uint32_t x, y, z;
+        VmaAllocation allocation;
+    };
+    // Orders tiles of every subresource by z, y, x.
+    struct TileLess
+    {
+        bool operator()(const Tile& lhs, const Tile& rhs) const;
+    };
+
+    const VmaAllocator m_hAllocator;
+    const VkBuffer m_Buffer;
+    const VkImage m_Image;
+    const VkDeviceSize m_Size;
+    const VkDeviceSize m_PageSize;
+    const uint32_t m_MemoryTypeBits;
+    // Needed to choose memory type for VMA_MEMORY_USAGE_AUTO*.
+    const VkFlags m_BufferImageUsage;
+    const VmaAllocationCreateInfo m_CreateInfo;
+    const VmaSuballocationType m_SuballocType;
+
+    VkExtent3D m_ImageExtent;
+    uint32_t m_ImageArrayLayers;
+
+    // Committed pages, sorted by index.
+    VmaVector<Page, VmaStlAllocator<Page>> m_Pages;
+    // Indices of pages changed since the last Bind(), may contain duplicates.
+    VmaVector<VkDeviceSize, VmaStlAllocator<VkDeviceSize>> m_DirtyPages;
+    // Empty unless the image was created with VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT, one element per aspect.
+    VmaVector<VkSparseImageMemoryRequirements, VmaStlAllocator<VkSparseImageMemoryRequirements>> m_ImageRequirements;
+    // Committed tiles, sorted by TileLess.
+    VmaVector<Tile, VmaStlAllocator<Tile>> m_Tiles;
+    // Tiles changed since the last Bind(), may contain duplicates. Their allocation is not used.
+    VmaVector<Tile, VmaStlAllocator<Tile>> m_DirtyTiles;
+    // Allocations of decommitted pages and tiles, waiting until their unbinding is submitted.
+    VmaVector<VmaAllocation, VmaStlAllocator<VmaAllocation>> m_PendingFree;
+    // Allocations of pages and tiles whose unbinding was submitted, waiting for FreeUnboundPages().
+    VmaVector<VmaAllocation, VmaStlAllocator<VmaAllocation>> m_Unbound;
+
+    VkDeviceSize GetPageCount() const { return (m_Size + m_PageSize - 1) / m_PageSize; }
+    // Allocates memory for allocationCount pages or tiles and protects it from defragmentation.
+    VkResult AllocatePages(size_t allocationCount, VmaAllocation* pAllocations);
+    // Returns requirements of the element covering given aspect, or null.
+    const VkSparseImageMemoryRequirements* FindImageRequirements(VkImageAspectFlags aspectMask) const;
+    // Returns first and one past last tile covered by the region, in all 3 coordinates.
+    void GetRegionTiles(const VmaSparseImageRegion& region, Tile& outBegin, Tile& outEnd) const;
+    // Appends binds of dirty pages to outBinds, merging contiguous ones.
+    void AppendBinds(VmaVector<VkSparseMemoryBind, VmaStlAllocator<VkSparseMemoryBind>>& outBinds);
+    void AppendImageBinds(VmaVector<VkSparseImageMemoryBind, VmaStlAllocator<VkSparseImageMemoryBind>>& outBinds);
+    // Called after the unbinding of m_PendingFree was submitted.
+    void RetirePendingPages();
+};
+#endif // _VMA_SPARSE_RESOURCE
+
+#ifndef _VMA_CACHE_RANGE_BATCH
+// Ranges of non-coherent memory collected until they are flushed or invalidated together.
+struct VmaCacheRangeBatch_T
+{
+    VMA_CLASS_NO_COPY(VmaCacheRangeBatch_T)
+public:
+    VmaCacheRangeBatch_T(VmaAllocator hAllocator);
+
+    void Add(VmaAllocation allocation, VkDeviceSize offset, VkDeviceSize size);
+    VkResult Submit(VMA_CACHE_OPERATION op);
+    void GetStats(VmaCacheRangeBatchStats& outStats) const { outStats = m_Stats; }
+
+private:
+    const VmaAllocator m_hAllocator;
+    VmaVector<VkMappedMemoryRange, VmaStlAllocator<VkMappedMemoryRange>> m_Ranges;
+    VmaCacheRangeBatchStats m_Stats;
+};
+#endif // _VMA_CACHE_RANGE_BATCH
+
+#ifndef _VMA_POOL_T
+struct VmaPool_T
+{
+    friend struct VmaPoolListItemTraits;
+    VMA_CLASS_NO_COPY(VmaPool_T)
+public:
+    VmaBlockVector m_BlockVector;
+    VmaDedicatedAllocationList m_DedicatedAllocations;
+
+    VmaPool_T(
+        VmaAllocator hAllocator,
+        const VmaPoolCreateInfo& createInfo,
+        VkDeviceSize preferredBlockSize);
+    ~VmaPool_T();
+
+    uint32_t GetId() const { return m_Id; }
+    void SetId(uint32_t id) { VMA_ASSERT(m_Id == 0); m_Id = id; }
+
+    const char* GetName() const { return m_Name; }
+    void SetName(const char* pName);
+
+#if VMA_STATS_STRING_ENABLED
+    //void PrintDetailedMap(class VmaStringBuilder& sb);
+#endif
+
+private:
+    uint32_t m_Id;
+    char* m_Name;
+    VmaPool_T* m_PrevPool = VMA_NULL;
+    VmaPool_T* m_NextPool = VMA_NULL;
+};
+
+struct VmaPoolListItemTraits
+{
+    typedef VmaPool_T ItemType;
+
+    static ItemType* GetPrev(const ItemType* item) { return item->m_PrevPool; }
+    static ItemType* GetNext(const ItemType* item) { return item->m_NextPool; }
+    static ItemType*& AccessPrev(ItemType* item) { return item->m_PrevPool; }
+    static ItemType*& AccessNext(ItemType* item) { return item->m_NextPool; }
+};
+#endif // _VMA_POOL_T
+
+#ifndef _VMA_CURRENT_BUDGET_DATA
+// Round-robin assignment of threads to shards of VmaCurrentBudgetData.
+static VMA_ATOMIC_UINT32 VmaNextBudgetShardIndex{ 0 };
+static thread_local uint32_t VmaThreadBudgetShardIndex = UINT32_MAX;
+
+/*
+Counters of allocations are updated by every allocation and free, so they are split
+into shards, each in its own cache lines, to avoid false sharing between threads.
+Every thread updates only its own shard. Readers sum all shards. A shard goes below zero
+when an allocation is freed by another thread than the one that created it, so shards are
+read as signed deltas in two's complement. Readers don't synchronize with writers, so a free
+may be seen without its allocation - the sum is then clamped at 0 instead of wrapping around.
+*/
+struct VmaCurrentBudgetData
+{
+    struct alignas(VMA_CACHE_LINE_SIZE) Shard
+    {
+        VMA_ATOMIC_UINT64 m_AllocationBytes[VK_MAX_MEMORY_HEAPS];
+        VMA_ATOMIC_UINT32 m_AllocationCount[VK_MAX_MEMORY_HEAPS];
+#if VMA_MEMORY_BUDGET
+        // Only grows.
+        VMA_ATOMIC_UINT32 m_OperationCount;
+#endif
+    };
+
+    // Blocks are created rarely and HeapSizeLimit needs exact m_BlockBytes, so these are not sharded.
+    VMA_ATOMIC_UINT32 m_BlockCount[VK_MAX_MEMORY_HEAPS];
+    VMA_ATOMIC_UINT64 m_BlockBytes[VK_MAX_MEMORY_HEAPS];
+    Shard m_Shards[VMA_BUDGET_SHARD_COUNT];
+
+#if VMA_MEMORY_BUDGET
+    // Sum of Shard::m_OperationCount at the time of last budget fetch.
+    VMA_ATOMIC_UINT32 m_OperationCountAtBudgetFetch;
+    VMA_RW_MUTEX m_BudgetMutex;
+    uint64_t m_VulkanUsage[VK_MAX_MEMORY_HEAPS];
+    uint64_t m_VulkanBudget[VK_MAX_MEMORY_HEAPS];
+    uint64_t m_BlockBytesAtBudgetFetch[VK_MAX_MEMORY_HEAPS];
+#endif // VMA_MEMORY_BUDGET
+
+    VmaCurrentBudgetData();
+
+    void AddAllocation(uint32_t heapIndex, VkDeviceSize allocationSize);
+    void RemoveAllocation(uint32_t heapIndex, VkDeviceSize allocationSize);
+
+    uint32_t GetAllocationCount(uint32_t heapIndex) const;
+    uint64_t GetAllocationBytes(uint32_t heapIndex) const;
+
+#if VMA_MEMORY_BUDGET
+    void AddOperation() { ++GetThreadShard().m_OperationCount; }
+    uint32_t GetOperationsSinceBudgetFetch() const { return GetOperationCount() - m_OperationCountAtBudgetFetch; }
+    void ResetOperationsSinceBudgetFetch() { m_OperationCountAtBudgetFetch = GetOperationCount(); }
+#endif
+
+private:
+    Shard& GetThreadShard();
+#if VMA_MEMORY_BUDGET
+    uint32_t GetOperationCount() const;
+#endif
+};
+
+#ifndef _VMA_CURRENT_BUDGET_DATA_FUNCTIONS
+VmaCurrentBudgetData::VmaCurrentBudgetData()
+{
+    for (uint32_t heapIndex = 0; heapIndex < VK_MAX_MEMORY_HEAPS; ++heapIndex)
+    {
+        m_BlockCount[heapIndex] = 0;
+        m_BlockBytes[heapIndex] = 0;
+#if VMA_MEMORY_BUDGET
+        m_VulkanUsage[heapIndex] = 0;
+        m_VulkanBudget[heapIndex] = 0;
+        m_BlockBytesAtBudgetFetch[heapIndex] = 0;
+#endif
+    }
+
+    for (uint32_t shardIndex = 0; shardIndex < VMA_BUDGET_SHARD_COUNT; ++shardIndex)
+    {
+        Shard& shard = m_Shards[shardIndex];
+        for (uint32_t heapIndex = 0; heapIndex < VK_MAX_MEMORY_HEAPS; ++heapIndex)
+        {
+            shard.m_AllocationBytes[heapIndex] = 0;
+            shard.m_AllocationCount[heapIndex] = 0;
+        }
+#if VMA_MEMORY_BUDGET
+        shard.m_OperationCount = 0;
+#endif
+    }
+
+#if VMA_MEMORY_BUDGET
+    m_OperationCountAtBudgetFetch = 0;
+#endif
+}
+
+void VmaCurrentBudgetData::AddAllocation(uint32_t heapIndex, VkDeviceSize allocationSize)
+{
+    Shard& shard = GetThreadShard();
+    shard.m_AllocationBytes[heapIndex] += allocationSize;
+    ++shard.m_AllocationCount[heapIndex];
+#if VMA_MEMORY_BUDGET
+    ++shard.m_OperationCount;
+#endif
+}
+
+void VmaCurrentBudgetData::RemoveAllocation(uint32_t heapIndex, VkDeviceSize allocationSize)
+{
+    Shard& shard = GetThreadShard();
+    // May go below zero, see the comment of this struct.
+    shard.m_AllocationBytes[heapIndex] -= allocationSize;
+    --shard.m_AllocationCount[heapIndex];
+#if VMA_MEMORY_BUDGET
+    ++shard.m_OperationCount;
+#endif
+}
+
+uint32_t VmaCurrentBudgetData::GetAllocationCount(uint32_t heapIndex) const
+{
+    int64_t result = 0;
+    for (uint32_t shardIndex = 0; shardIndex < VMA_BUDGET_SHARD_COUNT; ++shardIndex)
+        result += static_cast<int32_t>(m_Shards[shardIndex].m_AllocationCount[heapIndex].load());
+    return result > 0 ? static_cast<uint32_t>(result) : 0;
+}
+
+uint64_t VmaCurrentBudgetData::GetAllocationBytes(uint32_t heapIndex) const
+{
+    int64_t result = 0;
+    for (uint32_t shardIndex = 0; shardIndex < VMA_BUDGET_SHARD_COUNT; ++shardIndex)
+        result += static_cast<int64_t>(m_Shards[shardIndex].m_AllocationBytes[heapIndex].load());
+    return result > 0 ? static_cast<uint64_t>(result) : 0;
+}
+
+VmaCurrentBudgetData::Shard& VmaCurrentBudgetData::GetThreadShard()
+{
+    if (VmaThreadBudgetShardIndex == UINT32_MAX)
+        VmaThreadBudgetShardIndex = VmaNextBudgetShardIndex++ % VMA_BUDGET_SHARD_COUNT;
+    return m_Shards[VmaThreadBudgetShardIndex];
+}
+
+#if VMA_MEMORY_BUDGET
+uint32_t VmaCurrentBudgetData::GetOperationCount() const
+{
+    uint32_t result = 0;
+    for (uint32_t shardIndex = 0; shardIndex < VMA_BUDGET_SHARD_COUNT; ++shardIndex)
+        result += m_Shards[shardIndex].m_OperationCount;
+    return result;
+}
+#endif // VMA_MEMORY_BUDGET
+#endif // _VMA_CURRENT_BUDGET_DATA_FUNCTIONS
+#endif // _VMA_CURRENT_BUDGET_DATA
+
+#ifndef _VMA_ALLOCATION_OBJECT_ALLOCATOR
+// Identifies owners of per-thread data in thread-local slot tables. Never reused,
+// so slots left by a destroyed owner never match a new one.
+static VMA_ATOMIC_UINT64 VmaNextThreadLocalOwnerId{ 1 };
+
+// Recycled VmaAllocation_T object, placed in its memory.
+struct VmaAllocationObjectFreeItem
+{
+    VmaAllocationObjectFreeItem* pNext;
+    // Used only by the first item of a batch in the overflow stack.
+    VmaAllocationObjectFreeItem* pNextBatch;
+};
+
+// Free list of a single thread. Used without locking only by its owning thread.
+struct VmaAllocationObjectFreeList
+{
+    const void* pOwnerThread;
+    VmaAllocationObjectFreeItem* pFirst;
+    uint32_t count;
+    VmaAllocationObjectFreeList* pNextList;
+};
+
+struct VmaAllocationObjectSlot
+{
+    uint64_t ownerId;
+    VmaAllocationObjectFreeList* pList;
+};
+
+static thread_local VmaAllocationObjectSlot VmaAllocationObjectSlots[VMA_THREAD_LOCAL_SLOT_COUNT] = {};
+
+/*
+Thread-safe allocator of VmaAllocation_T objects on top of VmaPoolAllocator.
+
+Every thread recycles objects through its own free list, found through a small
+thread-local table, so allocating and freeing an object normally takes no lock.
+A thread that frees more than it allocates moves batches of objects to a lock-free
+overflow stack, from which threads with an empty free list take them. Only when both
+are empty, a batch of new objects is taken from VmaPoolAllocator under the mutex.
+*/
+class VmaAllocationObjectAllocator
+{
+    VMA_CLASS_NO_COPY(VmaAllocationObjectAllocator)
+public:
+    VmaAllocationObjectAllocator(const VkAllocationCallbacks* pAllocationCallbacks);
+    ~VmaAllocationObjectAllocator();
+
+    template<typename... Types> VmaAllocation Allocate(Types&&... args);
+    void Free(VmaAllocation hAlloc);
+
+private:
+    static const uint32_t BATCH_SIZE = 32;
+
+    const VkAllocationCallbacks* const m_pAllocationCallbacks;
+    const uint64_t m_Id;
+    // Protects m_Allocator and m_pThreadLists.
+    VMA_MUTEX m_Mutex;
+    VmaPoolAllocator<VmaAllocation_T> m_Allocator;
+    // Singly-linked list of free lists of all threads that ever used this allocator.
+    VmaAllocationObjectFreeList* m_pThreadLists;
+    // Lock-free stack of batches of BATCH_SIZE items linked by pNextBatch. Holds VmaAllocationObjectFreeItem*.
+    VMA_ATOMIC_UINT64 m_OverflowBatches;
+
+    VmaAllocationObjectFreeList* GetThreadFreeList();
+    VmaAllocationObjectFreeList* CreateThreadFreeList(VmaAllocationObjectSlot& slot);
+    void Refill(VmaAllocationObjectFreeList& list);
+    void PushOverflowBatches(VmaAllocationObjectFreeItem* pFirstBatch, VmaAllocationObjectFreeItem* pLastBatch);
+};
+
+VmaAllocationObjectAllocator::VmaAllocationObjectAllocator(const VkAllocationCallbacks* pAllocationCallbacks)
+    : m_pAllocationCallbacks(pAllocationCallbacks),
+    m_Id(VmaNextThreadLocalOwnerId++),
+    m_Allocator(pAllocationCallbacks, 1024),
+    m_pThreadLists(VMA_NULL),
+    m_OverflowBatches(0) {}
+
+VmaAllocationObjectAllocator::~VmaAllocationObjectAllocator()
+{
+    // Items in free lists and the overflow stack are released together with blocks of m_Allocator.
+    while (m_pThreadLists != VMA_NULL)
+    {
+        VmaAllocationObjectFreeList* const pNextList = m_pThreadLists->pNextList;
+        vma_delete(m_pAllocationCallbacks, m_pThreadLists);
+        m_pThreadLists = pNextList;
+    }
+}
+
+template<typename... Types>
+VmaAllocation VmaAllocationObjectAllocator::Allocate(Types&&... args)
+{
+    VmaAllocationObjectFreeList* const pList = GetThreadFreeList();
+    if (pList->pFirst == VMA_NULL)
+        Refill(*pList);
+
+    VmaAllocationObjectFreeItem* const pItem = pList->pFirst;
+    pList->pFirst = pItem->pNext;
+    --pList->count;
+    void* const pMemory = pItem;
+    return new(pMemory) VmaAllocation_T(std::forward<Types>(args)...); // Explicit constructor call.
+}
+
+void VmaAllocationObjectAllocator::Free(VmaAllocation hAlloc)
+{
+    hAlloc->~VmaAllocation_T(); // Explicit destructor call.
+    void* const pMemory = hAlloc;
+    VmaAllocationObjectFreeItem* const pItem = new(pMemory) VmaAllocationObjectFreeItem();
+
+    VmaAllocationObjectFreeList* const pList = GetThreadFreeList();
+    pItem->pNext = pList->pFirst;
+    pList->pFirst = pItem;
+    if (++pList->count >= 2 * BATCH_SIZE)
+    {
+        // Give a batch of the most recently freed items to other threads.
+        VmaAllocationObjectFreeItem* pLast = pItem;
+        for (uint32_t i = 1; i < BATCH_SIZE; ++i)
+            pLast = pLast->pNext;
+        pList->pFirst = pLast->pNext;
+        pList->count -= BATCH_SIZE;
+        pLast->pNext = VMA_NULL;
+        PushOverflowBatches(pItem, pItem);
+    }
+}
+
+VmaAllocationObjectFreeList* VmaAllocationObjectAllocator::GetThreadFreeList()
+{
+    VmaAllocationObjectSlot& slot = VmaAllocationObjectSlots[m_Id % VMA_THREAD_LOCAL_SLOT_COUNT];
+    if (slot.ownerId == m_Id)
+        return slot.pList;
+    return CreateThreadFreeList(slot);
+}
+
+VmaAllocationObjectFreeList* VmaAllocationObjectAllocator::CreateThreadFreeList(VmaAllocationObjectSlot& slot)
+{
+    // Address of thread-local data identifies the calling thread among all live threads.
+    // A free list left by an exited thread with the same address is adopted.
+    const void* const pThread = VmaAllocationObjectSlots;
+
+    VmaMutexLock lock(m_Mutex);
+    VmaAllocationObjectFreeList* pList = m_pThreadLists;
+    while (pList != VMA_NULL && pList->pOwnerThread != pThread)
+        pList = pList->pNextList;
+    if (pList == VMA_NULL)
+    {
+        pList = vma_new(m_pAllocationCallbacks, VmaAllocationObjectFreeList)();
+        pList->pOwnerThread = pThread;
+        pList->pFirst = VMA_NULL;
+        pList->count = 0;
+        pList->pNextList = m_pThreadLists;
+        m_pThreadLists = pList;
+    }
+    slot.ownerId = m_Id;
+    slot.pList = pList;
+    return pList;
+}
+
+void VmaAllocationObjectAllocator::Refill(VmaAllocationObjectFreeList& list)
+{
+    VMA_ASSERT(list.pFirst == VMA_NULL && list.count == 0);
+
+    // Take all batches from the overflow stack at once and return the ones not needed.
+    // Unlike popping a single batch, exchange of the whole stack is free of the ABA problem.
+    VmaAllocationObjectFreeItem* const pBatch = (VmaAllocationObjectFreeItem*)(uintptr_t)m_OverflowBatches.exchange(0);
+    if (pBatch != VMA_NULL)
+    {
+        VmaAllocationObjectFreeItem* const pRest = pBatch->pNextBatch;
+        if (pRest != VMA_NULL)
+        {
+            VmaAllocationObjectFreeItem* pLastBatch = pRest;
+            while (pLastBatch->pNextBatch != VMA_NULL)
+                pLastBatch = pLastBatch->pNextBatch;
+            PushOverflowBatches(pRest, pLastBatch);
+        }
+        list.pFirst = pBatch;
+        list.count = BATCH_SIZE;
+        return;
+    }
+
+    VmaMutexLock lock(m_Mutex);
+    for (uint32_t i = 0; i < BATCH_SIZE; ++i)
+    {
+        VmaAllocation hAlloc = m_Allocator.Alloc(false);
+        hAlloc->~VmaAllocation_T(); // Only the memory is needed.
+        void* const pMemory = hAlloc;
+        VmaAllocationObjectFreeItem* const pItem = new(pMemory) VmaAllocationObjectFreeItem();
+        pItem->pNext = list.pFirst;
+        list.pFirst = pItem;
+    }
+    list.count = BATCH_SIZE;
+}
+
+void VmaAllocationObjectAllocator::PushOverflowBatches(VmaAllocationObjectFreeItem* pFirstBatch, VmaAllocationObjectFreeItem* pLastBatch)
+{
+    uint64_t head = m_OverflowBatches.load();
+    do
+    {
+        pLastBatch->pNextBatch = (VmaAllocationObjectFreeItem*)(uintptr_t)head;
+    } while (!m_OverflowBatches.compare_exchange_weak(head, (uint64_t)(uintptr_t)pFirstBatch));
+}
+#endif // _VMA_ALLOCATION_OBJECT_ALLOCATOR
+
+#ifndef _VMA_THREAD_CACHE
+// Size classes go in steps of 1x and 1.5x of consecutive powers of 2, starting at VMA_THREAD_CACHE_MIN_CLASS_SIZE.
+static inline VkDeviceSize VmaThreadCacheClassSize(uint32_t sizeClass)
+{
+    const VkDeviceSize base = VMA_THREAD_CACHE_MIN_CLASS_SIZE << (sizeClass / 2);
+    return (sizeClass & 1) ? base + base / 2 : base;
+}
+
+// Alignment guaranteed for every suballocation of given size class - its lowest set bit.
+static inline VkDeviceSize VmaThreadCacheClassAlignment(uint32_t sizeClass)
+{
+    const VkDeviceSize base = VMA_THREAD_CACHE_MIN_CLASS_SIZE << (sizeClass / 2);
+    return (sizeClass & 1) ? base / 2 : base;
+}
+
+// Returns the smallest size class that can hold given size.
+static inline uint32_t VmaThreadCacheSizeToClass(VkDeviceSize size)
+{
+    if (size <= VMA_THREAD_CACHE_MIN_CLASS_SIZE)
+        return 0;
+    // 2^msb < size <= 2^(msb+1)
+    const uint32_t msb = VmaBitScanMSB((uint64_t)(size - 1));
+    const uint32_t minMsb = VmaBitScanMSB((uint64_t)VMA_THREAD_CACHE_MIN_CLASS_SIZE);
+    return 2 * (msb - minMsb) + (size <= (3ull << (msb - 1)) ? 1 : 2);
+}
+
+/*
+Stack of suballocations of one memory type and size class, parked in a
+VmaThreadCache. They are fully allocated in their VmaDeviceMemoryBlock.
+*/
+struct VmaThreadCacheMagazine
+{
+    uint32_t m_Count;
+    uint32_t m_Capacity;
+    VmaAllocation m_Allocations[VMA_THREAD_CACHE_MAX_MAGAZINE_CAPACITY];
+};
+
+/*
+Per-thread cache of small suballocations in default pools, used with
+VMA_ALLOCATOR_CREATE_THREAD_CACHE_BIT. Owned by the allocator, used by a single thread.
+
+Its mutex is locked by the owning thread on every access, so it is normally
+uncontended. Only Flush() may be called from other threads.
+*/
+class VmaThreadCache
+{
+    VMA_CLASS_NO_COPY(VmaThreadCache)
+public:
+    VmaThreadCache(VmaAllocator hAllocator, const void* pOwnerThread);
+    ~VmaThreadCache();
+
+    const void* GetOwnerThread() const { return m_pOwnerThread; }
+
+    // Pops a suballocation of given size class. Refills an empty magazine from blockVector.
+    // Returns null if blockVector is out of memory or defragmentation is in progress.
+    VmaAllocation Allocate(VmaBlockVector& blockVector, uint32_t sizeClass);
+    // Pushes a suballocation of given size class. Flushes half of a full magazine to blockVector.
+    // Returns false if defragmentation is in progress, so the allocation must be freed normally.
+    bool Free(VmaBlockVector& blockVector, uint32_t sizeClass, VmaAllocation hAllocation);
+    // Returns all parked suballocations to their block vectors.
+    void Flush();
+
+private:
+    const VmaAllocator m_hAllocator;
+    const void* const m_pOwnerThread;
+    VMA_MUTEX m_Mutex;
+    // Created on first use.
+    VmaThreadCacheMagazine* m_Magazines[VK_MAX_MEMORY_TYPES][VMA_THREAD_CACHE_MAX_CLASS_COUNT];
+
+    VmaThreadCacheMagazine* GetMagazine(uint32_t memTypeIndex, uint32_t sizeClass);
+};
+
+/*
+Entry of a small direct-mapped table, private to every thread, which finds
+VmaThreadCache of an allocator without any locking.
+*/
+struct VmaThreadCacheSlot
+{
+    uint64_t allocatorId;
+    VmaThreadCache* pCache;
+};
+
+static thread_local VmaThreadCacheSlot VmaThreadCacheSlots[VMA_THREAD_LOCAL_SLOT_COUNT] = {};
+#endif // _VMA_THREAD_CACHE
+
+#ifndef _VMA_DEFERRED_FREE
+// Allocation, buffer, or image waiting for the GPU to finish using it. Any of the handles can be null.
+struct VmaDeferredFree
+{
+    VmaAllocation allocation;
+    VkBuffer buffer;
+    VkImage image;
+    uint32_t frameIndex;
+};
+
+// Deferred frees made by a single thread, in order of their frame index.
+struct VmaDeferredFreeList
+{
+    VMA_CLASS_NO_COPY(VmaDeferredFreeList)
+public:
+    // Address of thread-local data of the thread that owns the list.
+    const void* const m_pOwnerThread;
+    // Taken by the owner thread when adding and by VmaAllocator_T::ReleaseDeferredFrees, so it is rarely contended.
+    VMA_MUTEX m_Mutex;
+    VmaVector<VmaDeferredFree, VmaStlAllocator<VmaDeferredFree>> m_Items;
+
+    VmaDeferredFreeList(const VkAllocationCallbacks* pAllocationCallbacks, const void* pOwnerThread)
+        : m_pOwnerThread(pOwnerThread),
+        m_Items(VmaStlAllocator<VmaDeferredFree>(pAllocationCallbacks)) {}
+};
+
+// Like VmaThreadCacheSlot, finds VmaDeferredFreeList of an allocator without any locking.
+struct VmaDeferredFreeSlot
+{
+    uint64_t allocatorId;
+    VmaDeferredFreeList* pList;
+};
+
+static thread_local VmaDeferredFreeSlot VmaDeferredFreeSlots[VMA_THREAD_LOCAL_SLOT_COUNT] = {};
+
+// Orders allocations so that those freed to the same VmaBlockVector are next to each other.
+struct VmaAllocationBlockVectorLess
+{
+    bool operator()(const VmaAllocation lhs, const VmaAllocation rhs) const
+    {
+        if (lhs->GetType() != rhs->GetType())
+            return lhs->GetType() < rhs->GetType();
+        if (lhs->GetParentPool() != rhs->GetParentPool())
+            return reinterpret_cast<uintptr_t>(lhs->GetParentPool()) < reinterpret_cast<uintptr_t>(rhs->GetParentPool());
+        return lhs->GetMemoryTypeIndex() < rhs->GetMemoryTypeIndex();
+    }
+};
+#endif // _VMA_DEFERRED_FREE
+
+#ifndef _VMA_VIRTUAL_BLOCK_T
+struct VmaVirtualBlock_T
+{
+    VMA_CLASS_NO_COPY(VmaVirtualBlock_T)
+public:
+    const bool m_AllocationCallbacksSpecified;
+    const VkAllocationCallbacks m_AllocationCallbacks;
+
+    VmaVirtualBlock_T(const VmaVirtualBlockCreateInfo& createInfo);
+    ~VmaVirtualBlock_T();
+
+    VkResult Init() { return VK_SUCCESS; }
+    bool IsEmpty() const { return m_Metadata->IsEmpty(); }
+    void Free(VmaVirtualAllocation allocation) { m_Metadata->Free((VmaAllocHandle)allocation); }
+    void SetAllocationUserData(VmaVirtualAllocation allocation, void* userData) { m_Metadata->SetAllocationUserData((VmaAllocHandle)allocation, userData); }
+    void Clear() { m_Metadata->Clear(); m_DefragmentationMoves.clear(); }
+
+    const VkAllocationCallbacks* GetAllocationCallbacks() const;
+    void GetAllocationInfo(VmaVirtualAllocation allocation, VmaVirtualAllocationInfo& outInfo);
+    VkResult Allocate(const VmaVirtualAllocationCreateInfo& createInfo, VmaVirtualAllocation& outAllocation,
+        VkDeviceSize* outOffset);
+    void GetStatistics(VmaStatistics& outStats) const;
+    void CalculateDetailedStatistics(VmaDetailedStatistics& outStats) const;
+    VkResult BeginDefragmentationPass(const VmaVirtualDefragmentationInfo& info, VmaVirtualDefragmentationPassMoveInfo& outPassInfo);
+    void EndDefragmentationPass(VmaVirtualDefragmentationPassMoveInfo& passInfo);
+#if VMA_STATS_STRING_ENABLED
+    void BuildStatsString(bool detailedMap, VmaStringBuilder& sb) const;
+#endif
+
+private:
+    struct DefragmentationCandidate
+    {
+        VmaAllocHandle handle;
+        VkDeviceSize offset;
+        VkDeviceSize size;
+        void* userData;
+    };
+    struct DefragmentationCandidateOffsetGreater
+    {
+        bool operator()(const DefragmentationCandidate& lhs, const DefragmentationCandidate& rhs) const
+        {
+            return lhs.offset > rhs.offset;
+        }
+    };
+
+    const uint32_t m_Algorithm;
+    VmaBlockMetadata* m_Metadata;
+    // Moves of the pass in progress, with their destinations already allocated.
+    VmaVector<VmaVirtualDefragmentationMove, VmaStlAllocator<VmaVirtualDefragmentationMove>> m_DefragmentationMoves;
+};
+
+#ifndef _VMA_VIRTUAL_BLOCK_T_FUNCTIONS
+VmaVirtualBlock_T::VmaVirtualBlock_T(const VmaVirtualBlockCreateInfo& createInfo)
+    : m_AllocationCallbacksSpecified(createInfo.pAllocationCallbacks != VMA_NULL),
+    m_AllocationCallbacks(createInfo.pAllocationCallbacks != VMA_NULL ? *createInfo.pAllocationCallbacks : VmaEmptyAllocationCallbacks),
+    m_Algorithm(createInfo.flags & VMA_VIRTUAL_BLOCK_CREATE_ALGORITHM_MASK),
+    m_DefragmentationMoves(VmaStlAllocator<VmaVirtualDefragmentationMove>(GetAllocationCallbacks()))
+{
+    switch (m_Algorithm)
+    {
+    default:
+        VMA_ASSERT(0);
+    case 0:
+        m_Metadata = vma_new(GetAllocationCallbacks(), VmaBlockMetadata_TLSF)(VK_NULL_HANDLE, 1, true);
+        break;
+    case VMA_VIRTUAL_BLOCK_CREATE_LINEAR_ALGORITHM_BIT:
+        m_Metadata = vma_new(GetAllocationCallbacks(), VmaBlockMetadata_Linear)(VK_NULL_HANDLE, 1, true);
+        break;
+    case VMA_VIRTUAL_BLOCK_CREATE_SLAB_ALGORITHM_BIT:
+        m_Metadata = vma_new(GetAllocationCallbacks(), VmaBlockMetadata_Slab)(VK_NULL_HANDLE, 1, true);
+        break;
+    case VMA_VIRTUAL_BLOCK_CREATE_BUDDY_ALGORITHM_BIT:
+        m_Metadata = vma_new(GetAllocationCallbacks(), VmaBlockMetadata_Buddy)(VK_NULL_HANDLE, 1, true);
+        break;
+    }
+
+    m_Metadata->Init(createInfo.size);
+}
+
+VmaVirtualBlock_T::~VmaVirtualBlock_T()
+{
+    // Define macro VMA_DEBUG_LOG to receive the list of the unfreed allocations
+    if (!m_Metadata->IsEmpty())
+        m_Metadata->DebugLogAllAllocations();
+    // This is the most important assert in the entire library.
+    // Hitting it means you have some memory leak - unreleased virtual allocations.
+    VMA_ASSERT(m_Metadata->IsEmpty() && "Some virtual allocations were not freed before destruction of this virtual block!");
+
+    vma_delete(GetAllocationCallbacks(), m_Metadata);
+}
+
+const VkAllocationCallbacks* VmaVirtualBlock_T::GetAllocationCallbacks() const
+{
+    return m_AllocationCallbacksSpecified ? &m_AllocationCallbacks : VMA_NULL;
+}
+
+void VmaVirtualBlock_T::GetAllocationInfo(VmaVirtualAllocation allocation, VmaVirtualAllocationInfo& outInfo)
+{
+    m_Metadata->GetAllocationInfo((VmaAllocHandle)allocation, outInfo);
+}
+
+VkResult VmaVirtualBlock_T::Allocate(const VmaVirtualAllocationCreateInfo& createInfo, VmaVirtualAllocation& outAllocation,
+    VkDeviceSize* outOffset)
+{
+    VmaAllocationRequest request = {};
+    if (m_Metadata->CreateAllocationRequest(
+        createInfo.size, // allocSize
+        VMA_MAX(createInfo.alignment, (VkDeviceSize)1), // allocAlignment
+        (createInfo.flags & VMA_VIRTUAL_ALLOCATION_CREATE_UPPER_ADDRESS_BIT) != 0, // upperAddress
+        VMA_SUBALLOCATION_TYPE_UNKNOWN, // allocType - unimportant
+        createInfo.flags & VMA_VIRTUAL_ALLOCATION_CREATE_STRATEGY_MASK, // strategy
+        &request))
+    {
+        m_Metadata->Alloc(request,
+            VMA_SUBALLOCATION_TYPE_UNKNOWN, // type - unimportant
+            createInfo.pUserData);
+        outAllocation = (VmaVirtualAllocation)request.allocHandle;
+        if(outOffset)
+            *outOffset = m_Metadata->GetAllocationOffset(request.allocHandle);
+        return VK_SUCCESS;
+    }
+    outAllocation = (VmaVirtualAllocation)VK_NULL_HANDLE;
+    if (outOffset)
+        *outOffset = UINT64_MAX;
+    return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+}
+
+void VmaVirtualBlock_T::GetStatistics(VmaStatistics& outStats) const
+{
+    VmaClearStatistics(outStats);
+    m_Metadata->AddStatistics(outStats);
+}
+
+void VmaVirtualBlock_T::CalculateDetailedStatistics(VmaDetailedStatistics& outStats) const
+{
+    VmaClearDetailedStatistics(outStats);
+    m_Metadata->AddDetailedStatistics(outStats);
+}
+
+VkResult VmaVirtualBlock_T::BeginDefragmentationPass(const VmaVirtualDefragmentationInfo& info, VmaVirtualDefragmentationPassMoveInfo& outPassInfo)
+{
+    VMA_ASSERT(m_DefragmentationMoves.empty() && "Previous defragmentation pass of the virtual block was not ended!");
+    VMA_ASSERT(info.maxAlignment == 0 || VmaIsPow2(info.maxAlignment));
+
+    // Linear algorithm never places new allocations before existing ones.
+    if (m_Algorithm == VMA_VIRTUAL_BLOCK_CREATE_LINEAR_ALGORITHM_BIT)
+    {
+        outPassInfo.moveCount = 0;
+        outPassInfo.pMoves = VMA_NULL;
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+    }
+
+    const VkDeviceSize maxBytes = info.maxBytesPerPass == 0 ? VK_WHOLE_SIZE : info.maxBytesPerPass;
+    const uint32_t maxAllocations = info.maxAllocationsPerPass == 0 ? UINT32_MAX : info.maxAllocationsPerPass;
+    const VkDeviceSize maxAlignment = info.maxAlignment == 0 ? VK_WHOLE_SIZE : info.maxAlignment;
+
+    // Allocations from the end of the block go first, so free space gathers there.
+    typedef VmaVector<DefragmentationCandidate, VmaStlAllocator<DefragmentationCandidate>> CandidateVector;
+    CandidateVector candidates = CandidateVector(VmaStlAllocator<DefragmentationCandidate>(GetAllocationCallbacks()));
+    for (VmaAllocHandle handle = m_Metadata->GetAllocationListBegin();
+        handle != VK_NULL_HANDLE;
+        handle = m_Metadata->GetNextAllocation(handle))
+    {
+        VmaVirtualAllocationInfo allocInfo = {};
+        m_Metadata->GetAllocationInfo(handle, allocInfo);
+        if (allocInfo.offset != 0)
+            candidates.push_back({ handle, allocInfo.offset, allocInfo.size, allocInfo.pUserData });
+    }
+    VMA_SORT(candidates.begin(), candidates.end(), DefragmentationCandidateOffsetGreater());
+
+    VkDeviceSize bytesMoved = 0;
+    for (size_t i = 0; i < candidates.size() && m_DefragmentationMoves.size() < maxAllocations; ++i)
+    {
+        const DefragmentationCandidate& candidate = candidates[i];
+        // Smaller allocations may still fit into remaining budget.
+        if (bytesMoved + candidate.size > maxBytes || m_Metadata->GetSumFreeSize() < candidate.size)
+            continue;
+
+        // Any power-of-two alignment the allocation was made with divides its offset.
+        const VkDeviceSize alignment = VMA_MIN(candidate.offset & (~candidate.offset + 1), maxAlignment);
+        VmaAllocationRequest request = {};
+        if (!m_Metadata->CreateAllocationRequest(
+            candidate.size,
+            alignment,
+            false,
+            VMA_SUBALLOCATION_TYPE_UNKNOWN,
+            VMA_ALLOCATION_CREATE_STRATEGY_MIN_OFFSET_BIT,
+            &request))
+        {
+            continue;
+        }
+        m_Metadata->Alloc(request, VMA_SUBALLOCATION_TYPE_UNKNOWN, candidate.userData);
+
+        // Final offset is known only after the request is committed.
+        const VkDeviceSize dstOffset = m_Metadata->GetAllocationOffset(request.allocHandle);
+        if (dstOffset >= candidate.offset)
+        {
+            m_Metadata->Free(request.allocHandle);
+            continue;
+        }
+
+        VmaVirtualDefragmentationMove move = {};
+        move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_COPY;
+        move.srcAllocation = (VmaVirtualAllocation)candidate.handle;
+        move.dstAllocation = (VmaVirtualAllocation)request.allocHandle;
+        move.srcOffset = candidate.offset;
+        move.dstOffset = dstOffset;
+        move.size = candidate.size;
+        m_DefragmentationMoves.push_back(move);
+        bytesMoved += candidate.size;
+    }
+
+    outPassInfo.moveCount = static_cast<uint32_t>(m_DefragmentationMoves.size());
+    if (outPassInfo.moveCount == 0)
+    {
+        outPassInfo.pMoves = VMA_NULL;
+        return VK_SUCCESS;
+    }
+    outPassInfo.pMoves = m_DefragmentationMoves.data();
+    return VK_INCOMPLETE;
+}
+
+void VmaVirtualBlock_T::EndDefragmentationPass(VmaVirtualDefragmentationPassMoveInfo& passInfo)
+{
+    VMA_ASSERT(passInfo.moveCount == m_DefragmentationMoves.size() &&
+        (passInfo.moveCount == 0 || passInfo.pMoves == m_DefragmentationMoves.data()));
+
+    for (uint32_t i = 0; i < passInfo.moveCount; ++i)
+    {
+        const VmaVirtualDefragmentationMove& move = passInfo.pMoves[i];
+        switch (move.operation)
+        {
+        case VMA_DEFRAGMENTATION_MOVE_OPERATION_COPY:
+            m_Metadata->Free((VmaAllocHandle)move.srcAllocation);
+            break;
+        case VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE:
+            m_Metadata->Free((VmaAllocHandle)move.dstAllocation);
+            break;
+        case VMA_DEFRAGMENTATION_MOVE_OPERATION_DESTROY:
+            m_Metadata->Free((VmaAllocHandle)move.srcAllocation);
+            m_Metadata->Free((VmaAllocHandle)move.dstAllocation);
+            break;
+        default:
+            VMA_ASSERT(0);
+        }
+    }
+    m_DefragmentationMoves.clear();
+    passInfo.moveCount = 0;
+    passInfo.pMoves = VMA_NULL;
+}
+
+#if VMA_STATS_STRING_ENABLED
+void VmaVirtualBlock_T::BuildStatsString(bool detailedMap, VmaStringBuilder& sb) const
+{
+    VmaJsonWriter json(GetAllocationCallbacks(), sb);
+    json.BeginObject();
+
+    VmaDetailedStatistics stats;
+    CalculateDetailedStatistics(stats);
+
+    json.WriteString("Stats");
+    VmaPrintDetailedStatistics(json, stats);
+
+    if (detailedMap)
+    {
+        json.WriteString("Details");
+        json.BeginObject();
+        VmaBlockDetailedMap map(json);
+        m_Metadata->PrintDetailedMap(map);
+        json.EndObject();
+    }
+
+    json.EndObject();
+}
+#endif // VMA_STATS_STRING_ENABLED
+#endif // _VMA_VIRTUAL_BLOCK_T_FUNCTIONS
+#endif // _VMA_VIRTUAL_BLOCK_T
+
+#if VMA_RECORDING_ENABLED
+#ifndef _VMA_RECORDER
+/*
+Writes calls of the allocator to a binary file. See \ref record_and_replay for the format.
+Records are gathered in memory and written in chunks, or after every call with
+VMA_RECORD_FLUSH_AFTER_CALL_BIT. Handles are recorded as their values, so Free*
+and DestroyPool must be recorded before the object is released and its address
+can be reused by another thread.
+*/
+class VmaRecorder
+{
+    VMA_CLASS_NO_COPY(VmaRecorder)
+public:
+    VmaRecorder(const VkAllocationCallbacks* pAllocationCallbacks);
+    ~VmaRecorder();
+
+    VkResult Init(const VmaRecordSettings& settings, bool useMutex);
+    void WriteConfiguration(
+        uint32_t vulkanApiVersion,
+        VmaAllocatorCreateFlags allocatorFlags,
+        VkDeviceSize preferredLargeHeapBlockSize,
+        const VkPhysicalDeviceProperties& devProps,
+        const VkPhysicalDeviceMemoryProperties& memProps);
+    // Nanoseconds since creation of the recorder.
+    uint64_t GetTime() const { return VMA_TIME_NANOSECONDS() - m_StartTime; }
+
+    void RecordCreatePool(uint32_t frameIndex, const VmaPoolCreateInfo& createInfo, VmaPool pool);
+    void RecordDestroyPool(uint32_t frameIndex, VmaPool pool);
+    void RecordAllocateMemory(
+        uint32_t frameIndex,
+        uint64_t startTime,
+        const VkMemoryRequirements& vkMemReq,
+        bool requiresDedicatedAllocation,
+        bool prefersDedicatedAllocation,
+        VkBuffer dedicatedBuffer,
+        VkImage dedicatedImage,
+        VkFlags dedicatedBufferImageUsage,
+        const VmaAllocationCreateInfo& createInfo,
+        VmaSuballocationType suballocType,
+        size_t allocationCount,
+        const VmaAllocation* pAllocations,
+        VkResult result);
+    void RecordFreeMemory(uint32_t frameIndex, size_t allocationCount, const VmaAllocation* pAllocations);
+    void RecordSetCurrentFrameIndex(uint32_t frameIndex);
+
+private:
+    enum CALL
+    {
+        CALL_CREATE_POOL = 1,
+        CALL_DESTROY_POOL = 2,
+        CALL_ALLOCATE_MEMORY = 3,
+        CALL_FREE_MEMORY = 4,
+        CALL_SET_CURRENT_FRAME_INDEX = 5,
+    };
+    static const uint32_t FORMAT_VERSION = 1;
+    // Gathered records are written to the file when they exceed this size.
+    static const size_t CHUNK_SIZE = 64 * 1024;
+
+    VmaRecordFlags m_Flags;
+    FILE* m_File;
+    bool m_UseMutex;
+    VMA_MUTEX m_Mutex;
+    uint64_t m_StartTime;
+    VmaVector<char, VmaStlAllocator<char>> m_Data;
+
+    template<typename T>
+    void Write(T value);
+    void WriteHandle(const void* handle) { Write<uint64_t>((uint64_t)(uintptr_t)handle); }
+    void BeginRecord(CALL call, uint64_t time, uint32_t frameIndex);
+    void EndRecord();
+    void Flush();
+};
+#endif // _VMA_RECORDER
+#endif // #if VMA_RECORDING_ENABLED
+
+
+// Main allocator object.
+struct VmaAllocator_T
+{
+    VMA_CLASS_NO_COPY(VmaAllocator_T)
+public:
+    bool m_UseMutex;
+    bool m_UseThreadCache;
+    bool m_UseIncrementalStatistics;
+    // Number of defragmentation contexts of default pools. Thread caches are bypassed while it is not 0.
+    VMA_ATOMIC_UINT32 m_DefragmentationContextCount;
+    uint32_t m_VulkanApiVersion;
+    bool m_UseKhrDedicatedAllocation; // Can be set only if m_VulkanApiVersion < VK_MAKE_VERSION(1, 1, 0).
+    bool m_UseKhrBindMemory2; // Can be set only if m_VulkanApiVersion < VK_MAKE_VERSION(1, 1, 0).
+    bool m_UseExtMemoryBudget;
+    bool m_UseAmdDeviceCoherentMemory;
+    bool m_UseKhrBufferDeviceAddress;
+    bool m_UseExtMemoryPriority;
+    VkDevice m_hDevice;
+    VkInstance m_hInstance;
+    bool m_AllocationCallbacksSpecified;
+    VkAllocationCallbacks m_AllocationCallbacks;
+    VmaDeviceMemoryCallbacks m_DeviceMemoryCallbacks;
+    VmaAllocationObjectAllocator m_AllocationObjectAllocator;
+
+    // Each bit (1 << i) is set if HeapSizeLimit is enabled for that heap, so cannot allocate more than the heap size.
+    uint32_t m_HeapSizeLimitMask;
+
+    VkPhysicalDeviceProperties m_PhysicalDeviceProperties;
+    VkPhysicalDeviceMemoryProperties m_MemProps;
+
+    // Default pools.
+    VmaBlockVector* m_pBlockVectors[VK_MAX_MEMORY_TYPES];
+    VmaDedicatedAllocationList m_DedicatedAllocations[VK_MAX_MEMORY_TYPES];
+
+    VmaCurrentBudgetData m_Budget;
+    VMA_ATOMIC_UINT32 m_DeviceMemoryCount; // Total number of VkDeviceMemory objects.
+
+    VmaAllocator_T(const VmaAllocatorCreateInfo* pCreateInfo);
+    VkResult Init(const VmaAllocatorCreateInfo* pCreateInfo);
+    ~VmaAllocator_T();
+
+    const VkAllocationCallbacks* GetAllocationCallbacks() const
+    {
+        return m_AllocationCallbacksSpecified ? &m_AllocationCallbacks : VMA_NULL;
+    }
+    const VmaVulkanFunctions& GetVulkanFunctions() const
+    {
+        return m_VulkanFunctions;
+    }
+
+    VkPhysicalDevice GetPhysicalDevice() const { return m_PhysicalDevice; }
+
+    VkDeviceSize GetBufferImageGranularity() const
+    {
+        return VMA_MAX(
+            static_cast<VkDeviceSize>(VMA_DEBUG_MIN_BUFFER_IMAGE_GRANULARITY),
+            m_PhysicalDeviceProperties.limits.bufferImageGranularity);
+    }
+
+    uint32_t GetMemoryHeapCount() const { return m_MemProps.memoryHeapCount; }
+    uint32_t GetMemoryTypeCount() const { return m_MemProps.memoryTypeCount; }
+
+    uint32_t MemoryTypeIndexToHeapIndex(uint32_t memTypeIndex) const
     {
         VMA_ASSERT(memTypeIndex < m_MemProps.memoryTypeCount);
         return m_MemProps.memoryTypes[memTypeIndex].heapIndex;
@@ -11525,9 +14925,29 @@ public:
     void SetCurrentFrameIndex(uint32_t frameIndex);
     uint32_t GetCurrentFrameIndex() const { return m_CurrentFrameIndex.load(); }
 
+#if VMA_RECORDING_ENABLED
+    VmaRecorder* GetRecorder() const { return m_pRecorder; }
+#endif
+
+    // Returns suballocations parked in all per-thread caches to their block vectors.
+    void FlushThreadCaches();
+
+    bool IsDeferredFreeEnabled() const { return m_DeferredFreeFrameCount != 0; }
+    // Queues resources to the list of the calling thread. pBuffers and pImages can be null.
+    void DeferFree(size_t count, const VmaAllocation* pAllocations, const VkBuffer* pBuffers, const VkImage* pImages);
+    /*
+    Destroys queued resources older than m_DeferredFreeFrameCount frames,
+    all of them if releaseAll, and those from hPool if it is not null.
+    */
+    void ReleaseDeferredFrees(bool releaseAll, VmaPool hPool);
+
     VkResult CheckPoolCorruption(VmaPool hPool);
     VkResult CheckCorruption(uint32_t memoryTypeBits);
 
+    VkResult ExportProfile(size_t* pDataSize, void* pData);
+    VkResult ImportProfile(size_t dataSize, const void* pData);
+    VkResult PreallocateBlocks(uint32_t memoryTypeBits, VkDeviceSize minFreeSize, uint32_t* pAllocatedBlockCount);
+
     // Call to Vulkan function vkAllocateMemory with accompanying bookkeeping.
     VkResult AllocateVulkanMemory(const VkMemoryAllocateInfo* pAllocateInfo, VkDeviceMemory* pMemory);
     // Call to Vulkan function vkFreeMemory with accompanying bookkeeping.
@@ -11553,6 +14973,11 @@ public:
         VkDeviceSize allocationLocalOffset,
         VkBuffer hBuffer,
         const void* pNext);
+    // Binds pBuffers[i] to pAllocations[i], using one vkBindBufferMemory2 call per memory block if available.
+    VkResult BindBufferMemories(
+        size_t count,
+        const VmaAllocation* pAllocations,
+        const VkBuffer* pBuffers);
     VkResult BindImageMemory(
         VmaAllocation hAllocation,
         VkDeviceSize allocationLocalOffset,
@@ -11568,6 +14993,16 @@ public:
         const VmaAllocation* allocations,
         const VkDeviceSize* offsets, const VkDeviceSize* sizes,
         VMA_CACHE_OPERATION op);
+    // Returns false if the range doesn't need to be flushed or invalidated.
+    bool GetFlushOrInvalidateRange(
+        VmaAllocation allocation,
+        VkDeviceSize offset, VkDeviceSize size,
+        VkMappedMemoryRange& outRange) const;
+    /*
+    Sorts pRanges by memory and offset and merges adjacent and overlapping ones in place,
+    leaving the merged count in inoutRangeCount, then passes them to a single Vulkan call.
+    */
+    VkResult FlushOrInvalidateRanges(uint32_t& inoutRangeCount, VkMappedMemoryRange* pRanges, VMA_CACHE_OPERATION op);
 
     void FillAllocation(const VmaAllocation hAllocation, uint8_t pattern);
 
@@ -11605,6 +15040,24 @@ private:
     // Global bit mask AND-ed with any memoryTypeBits to disallow certain memory types.
     uint32_t m_GlobalMemoryTypeBits;
 
+    // Identifies this allocator in thread-local tables of VmaThreadCacheSlots, VmaDeferredFreeSlots.
+    const uint64_t m_ThreadLocalOwnerId;
+    // Number of size classes not larger than VMA_THREAD_CACHE_MAX_ALLOCATION_SIZE.
+    uint32_t m_ThreadCacheClassCount;
+    VMA_MUTEX m_ThreadCachesMutex;
+    // Protected by m_ThreadCachesMutex. Caches are never destroyed before the allocator.
+    VmaVector<VmaThreadCache*, VmaStlAllocator<VmaThreadCache*>> m_ThreadCaches;
+
+    // 0 if deferred freeing is disabled.
+    const uint32_t m_DeferredFreeFrameCount;
+    VMA_MUTEX m_DeferredFreeListsMutex;
+    // Protected by m_DeferredFreeListsMutex. Lists are never destroyed before the allocator.
+    VmaVector<VmaDeferredFreeList*, VmaStlAllocator<VmaDeferredFreeList*>> m_DeferredFreeLists;
+
+#if VMA_RECORDING_ENABLED
+    VmaRecorder* m_pRecorder = VMA_NULL;
+#endif
+
     void ImportVulkanFunctions(const VmaVulkanFunctions* pVulkanFunctions);
 
 #if VMA_STATIC_VULKAN_FUNCTIONS == 1
@@ -11621,6 +15074,19 @@ private:
 
     VkDeviceSize CalcPreferredBlockSize(uint32_t memTypeIndex);
 
+    // AllocateMemory() without recording.
+    VkResult AllocateMemoryImpl(
+        const VkMemoryRequirements& vkMemReq,
+        bool requiresDedicatedAllocation,
+        bool prefersDedicatedAllocation,
+        VkBuffer dedicatedBuffer,
+        VkImage dedicatedImage,
+        VkFlags dedicatedBufferImageUsage,
+        const VmaAllocationCreateInfo& createInfo,
+        VmaSuballocationType suballocType,
+        size_t allocationCount,
+        VmaAllocation* pAllocations);
+
     VkResult AllocateMemoryOfType(
         VmaPool pool,
         VkDeviceSize size,
@@ -11672,6 +15138,21 @@ private:
 
     void FreeDedicatedMemory(const VmaAllocation allocation);
 
+    // Returns VmaThreadCache of the calling thread, creating it on first use.
+    VmaThreadCache* GetThreadCache();
+    // Returns list of deferred frees of the calling thread, creating it on first use.
+    VmaDeferredFreeList* GetDeferredFreeList();
+    // Tries to serve an allocation from VmaThreadCache of the calling thread. Returns false if not eligible or out of memory.
+    bool AllocateFromThreadCache(
+        VkDeviceSize size,
+        VkDeviceSize alignment,
+        const VmaAllocationCreateInfo& createInfo,
+        VmaSuballocationType suballocType,
+        VmaBlockVector& blockVector,
+        VmaAllocation* pAllocation);
+    // Tries to park an allocation in VmaThreadCache of the calling thread. Returns false if it must be freed normally.
+    bool FreeToThreadCache(VmaAllocation allocation, VmaBlockVector& blockVector);
+
     VkResult CalcMemTypeParams(
         VmaAllocationCreateInfo& outCreateInfo,
         uint32_t memTypeIndex,
@@ -11681,6 +15162,12 @@ private:
         VmaAllocationCreateInfo& outCreateInfo,
         bool dedicatedRequired,
         bool dedicatedPreferred);
+    // Marks block allocations made with VMA_ALLOCATION_CREATE_CAN_BE_DEMOTED_BIT as movable by VmaResidencyManager_T.
+    void InitResidency(
+        uint32_t memoryTypeBits,
+        const VmaAllocationCreateInfo& createInfo,
+        size_t allocationCount,
+        const VmaAllocation* pAllocations);
 
     /*
     Calculates and returns bit mask of memory types that can support defragmentation
@@ -11689,11 +15176,6 @@ private:
     uint32_t CalculateGpuDefragmentationMemoryTypeBits() const;
     uint32_t CalculateGlobalMemoryTypeBits() const;
 
-    bool GetFlushOrInvalidateRange(
-        VmaAllocation allocation,
-        VkDeviceSize offset, VkDeviceSize size,
-        VkMappedMemoryRange& outRange) const;
-
 #if VMA_MEMORY_BUDGET
     void UpdateVulkanBudget();
 #endif // #if VMA_MEMORY_BUDGET
@@ -11748,6 +15230,7 @@ static void vma_delete_array(VmaAllocator hAllocator, T* ptr, size_t count)
 #ifndef _VMA_DEVICE_MEMORY_BLOCK_FUNCTIONS
 VmaDeviceMemoryBlock::VmaDeviceMemoryBlock(VmaAllocator hAllocator)
     : m_pMetadata(VMA_NULL),
+    m_BlockVectorIndex(SIZE_MAX),
     m_MemoryTypeIndex(UINT32_MAX),
     m_Id(0),
     m_hMemory(VK_NULL_HANDLE),
@@ -11768,7 +15251,8 @@ void VmaDeviceMemoryBlock::Init(
     VkDeviceSize newSize,
     uint32_t id,
     uint32_t algorithm,
-    VkDeviceSize bufferImageGranularity)
+    VkDeviceSize bufferImageGranularity,
+    VmaStatisticsCounters* pStatisticsCounters)
 {
     VMA_ASSERT(m_hMemory == VK_NULL_HANDLE);
 
@@ -11783,6 +15267,14 @@ void VmaDeviceMemoryBlock::Init(
         m_pMetadata = vma_new(hAllocator, VmaBlockMetadata_Linear)(hAllocator->GetAllocationCallbacks(),
             bufferImageGranularity, false); // isVirtual
         break;
+    case VMA_POOL_CREATE_SLAB_ALGORITHM_BIT:
+        m_pMetadata = vma_new(hAllocator, VmaBlockMetadata_Slab)(hAllocator->GetAllocationCallbacks(),
+            bufferImageGranularity, false); // isVirtual
+        break;
+    case VMA_POOL_CREATE_BUDDY_ALGORITHM_BIT:
+        m_pMetadata = vma_new(hAllocator, VmaBlockMetadata_Buddy)(hAllocator->GetAllocationCallbacks(),
+            bufferImageGranularity, false); // isVirtual
+        break;
     default:
         VMA_ASSERT(0);
         // Fall-through.
@@ -11790,6 +15282,7 @@ void VmaDeviceMemoryBlock::Init(
         m_pMetadata = vma_new(hAllocator, VmaBlockMetadata_TLSF)(hAllocator->GetAllocationCallbacks(),
             bufferImageGranularity, false); // isVirtual
     }
+    m_pMetadata->SetStatisticsCounters(pStatisticsCounters);
     m_pMetadata->Init(newSize);
 }
 
@@ -11876,18 +15369,20 @@ VkResult VmaDeviceMemoryBlock::Map(VmaAllocator hAllocator, uint32_t count, void
     }
     else
     {
+        void* pMappedData = VMA_NULL;
         VkResult result = (*hAllocator->GetVulkanFunctions().vkMapMemory)(
             hAllocator->m_hDevice,
             m_hMemory,
             0, // offset
             VK_WHOLE_SIZE,
             0, // flags
-            &m_pMappedData);
+            &pMappedData);
         if (result == VK_SUCCESS)
         {
+            m_pMappedData = pMappedData;
             if (ppData != VMA_NULL)
             {
-                *ppData = m_pMappedData;
+                *ppData = pMappedData;
             }
             m_MapCount = count;
         }
@@ -11974,6 +15469,23 @@ VkResult VmaDeviceMemoryBlock::BindBufferMemory(
     return hAllocator->BindVulkanBuffer(m_hMemory, memoryOffset, hBuffer, pNext);
 }
 
+#if VMA_VULKAN_VERSION >= 1001000 || VMA_BIND_MEMORY2
+VkResult VmaDeviceMemoryBlock::BindBufferMemories(
+    const VmaAllocator hAllocator,
+    uint32_t bindInfoCount,
+    const VkBindBufferMemoryInfoKHR* pBindInfos)
+{
+    VMA_ASSERT(hAllocator->GetVulkanFunctions().vkBindBufferMemory2KHR != VMA_NULL);
+    for (uint32_t i = 0; i < bindInfoCount; ++i)
+    {
+        VMA_ASSERT(pBindInfos[i].memory == m_hMemory);
+    }
+    // This lock is important so that we don't call vkBind... and/or vkMap... simultaneously on the same VkDeviceMemory from multiple threads.
+    VmaMutexLock lock(m_MapAndBindMutex, hAllocator->m_UseMutex);
+    return (*hAllocator->GetVulkanFunctions().vkBindBufferMemory2KHR)(hAllocator->m_hDevice, bindInfoCount, pBindInfos);
+}
+#endif // #if VMA_VULKAN_VERSION >= 1001000 || VMA_BIND_MEMORY2
+
 VkResult VmaDeviceMemoryBlock::BindImageMemory(
     const VmaAllocator hAllocator,
     const VmaAllocation hAllocation,
@@ -12002,7 +15514,9 @@ VmaAllocation_T::VmaAllocation_T(bool mappingAllowed)
     m_Type{ (uint8_t)ALLOCATION_TYPE_NONE },
     m_SuballocationType{ (uint8_t)VMA_SUBALLOCATION_TYPE_UNKNOWN },
     m_MapCount{ 0 },
-    m_Flags{ 0 }
+    m_Flags{ 0 },
+    m_LastUseFrameIndex{ 0 },
+    m_ResidencyMemoryTypeBits{ 0 }
 {
     if(mappingAllowed)
         m_Flags |= (uint8_t)FLAG_MAPPING_ALLOWED;
@@ -12045,6 +15559,30 @@ void VmaAllocation_T::InitBlockAllocation(
     m_BlockAllocation.m_AllocHandle = allocHandle;
 }
 
+void VmaAllocation_T::InitResidency(uint32_t memoryTypeBits, uint32_t frameIndex)
+{
+    VMA_ASSERT(m_Type == ALLOCATION_TYPE_BLOCK);
+    m_Flags |= (uint8_t)FLAG_CAN_BE_DEMOTED;
+    m_ResidencyMemoryTypeBits = memoryTypeBits;
+    m_LastUseFrameIndex = frameIndex;
+}
+
+void VmaAllocation_T::ResetCachedBlockAllocation(bool mappingAllowed)
+{
+    VMA_ASSERT(m_Type == ALLOCATION_TYPE_BLOCK);
+    VMA_ASSERT(m_MapCount == 0 && !IsPersistentMap());
+    VMA_ASSERT(m_pName == VMA_NULL);
+    m_pUserData = VMA_NULL;
+    m_Flags &= (uint8_t)~FLAG_NOT_MOVABLE;
+    if (mappingAllowed)
+        m_Flags |= (uint8_t)FLAG_MAPPING_ALLOWED;
+    else
+        m_Flags &= (uint8_t)~FLAG_MAPPING_ALLOWED;
+#if VMA_STATS_STRING_ENABLED
+    m_BufferImageUsage = 0;
+#endif
+}
+
 void VmaAllocation_T::InitDedicatedAllocation(
     VmaPool hParentPool,
     uint32_t memoryTypeIndex,
@@ -12093,6 +15631,8 @@ uint8_t VmaAllocation_T::SwapBlockAllocation(VmaAllocator hAllocator, VmaAllocat
 
     m_BlockAllocation.m_Block->m_pMetadata->SetAllocationUserData(m_BlockAllocation.m_AllocHandle, allocation);
     VMA_SWAP(m_BlockAllocation, allocation->m_BlockAllocation);
+    // Differs when VmaResidencyManager_T moves the allocation to another memory type.
+    VMA_SWAP(m_MemoryTypeIndex, allocation->m_MemoryTypeIndex);
     m_BlockAllocation.m_Block->m_pMetadata->SetAllocationUserData(m_BlockAllocation.m_AllocHandle, this);
 
 #if VMA_STATS_STRING_ENABLED
@@ -12339,7 +15879,18 @@ VmaBlockVector::VmaBlockVector(
     m_MinAllocationAlignment(minAllocationAlignment),
     m_pMemoryAllocateNext(pMemoryAllocateNext),
     m_Blocks(VmaStlAllocator<VmaDeviceMemoryBlock*>(hAllocator->GetAllocationCallbacks())),
-    m_NextBlockId(0) {}
+    m_EmptyBlockCount(0),
+    m_MaxFreeTree(VmaStlAllocator<VkDeviceSize>(hAllocator->GetAllocationCallbacks())),
+    m_MaxFreeTreeLeafCount(0),
+    m_NextBlockId(0),
+    m_pStatisticsCounters(VMA_NULL)
+{
+    if (hAllocator->m_UseIncrementalStatistics &&
+        (algorithm == 0 || algorithm == VMA_POOL_CREATE_BUDDY_ALGORITHM_BIT))
+    {
+        m_pStatisticsCounters = vma_new(hAllocator, VmaStatisticsCounters)();
+    }
+}
 
 VmaBlockVector::~VmaBlockVector()
 {
@@ -12348,6 +15899,7 @@ VmaBlockVector::~VmaBlockVector()
         m_Blocks[i]->Destroy(m_hAllocator);
         vma_delete(m_hAllocator, m_Blocks[i]);
     }
+    vma_delete(m_hAllocator, m_pStatisticsCounters);
 }
 
 VkResult VmaBlockVector::CreateMinBlocks()
@@ -12365,13 +15917,21 @@ VkResult VmaBlockVector::CreateMinBlocks()
 
 void VmaBlockVector::AddStatistics(VmaStatistics& inoutStats)
 {
+    if (m_pStatisticsCounters)
+    {
+        VMA_HEAVY_ASSERT(ValidateStatisticsCounters());
+        m_pStatisticsCounters->AddStatistics(inoutStats);
+        return;
+    }
+
     VmaMutexLockRead lock(m_Mutex, m_hAllocator->m_UseMutex);
 
     const size_t blockCount = m_Blocks.size();
     for (uint32_t blockIndex = 0; blockIndex < blockCount; ++blockIndex)
     {
-        const VmaDeviceMemoryBlock* const pBlock = m_Blocks[blockIndex];
+        VmaDeviceMemoryBlock* const pBlock = m_Blocks[blockIndex];
         VMA_ASSERT(pBlock);
+        VmaMutexLock blockLock(pBlock->GetMetadataMutex(), m_hAllocator->m_UseMutex);
         VMA_HEAVY_ASSERT(pBlock->Validate());
         pBlock->m_pMetadata->AddStatistics(inoutStats);
     }
@@ -12379,13 +15939,21 @@ void VmaBlockVector::AddStatistics(VmaStatistics& inoutStats)
 
 void VmaBlockVector::AddDetailedStatistics(VmaDetailedStatistics& inoutStats)
 {
+    if (m_pStatisticsCounters)
+    {
+        VMA_HEAVY_ASSERT(ValidateStatisticsCounters());
+        m_pStatisticsCounters->AddDetailedStatistics(inoutStats);
+        return;
+    }
+
     VmaMutexLockRead lock(m_Mutex, m_hAllocator->m_UseMutex);
 
     const size_t blockCount = m_Blocks.size();
     for (uint32_t blockIndex = 0; blockIndex < blockCount; ++blockIndex)
     {
-        const VmaDeviceMemoryBlock* const pBlock = m_Blocks[blockIndex];
+        VmaDeviceMemoryBlock* const pBlock = m_Blocks[blockIndex];
         VMA_ASSERT(pBlock);
+        VmaMutexLock blockLock(pBlock->GetMetadataMutex(), m_hAllocator->m_UseMutex);
         VMA_HEAVY_ASSERT(pBlock->Validate());
         pBlock->m_pMetadata->AddDetailedStatistics(inoutStats);
     }
@@ -12402,7 +15970,8 @@ bool VmaBlockVector::IsCorruptionDetectionEnabled() const
     const uint32_t requiredMemFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
     return (VMA_DEBUG_DETECT_CORRUPTION != 0) &&
         (VMA_DEBUG_MARGIN > 0) &&
-        (m_Algorithm == 0 || m_Algorithm == VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT) &&
+        (m_Algorithm == 0 || m_Algorithm == VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT ||
+            m_Algorithm == VMA_POOL_CREATE_SLAB_ALGORITHM_BIT || m_Algorithm == VMA_POOL_CREATE_BUDDY_ALGORITHM_BIT) &&
         (m_hAllocator->m_MemProps.memoryTypes[m_MemoryTypeIndex].propertyFlags & requiredMemFlags) == requiredMemFlags;
 }
 
@@ -12414,7 +15983,7 @@ VkResult VmaBlockVector::Allocate(
     size_t allocationCount,
     VmaAllocation* pAllocations)
 {
-    size_t allocIndex;
+    size_t allocIndex = 0;
     VkResult res = VK_SUCCESS;
 
     alignment = VMA_MAX(alignment, m_MinAllocationAlignment);
@@ -12425,19 +15994,84 @@ VkResult VmaBlockVector::Allocate(
         alignment = VmaAlignUp<VkDeviceSize>(alignment, sizeof(VMA_CORRUPTION_DETECTION_MAGIC_VALUE));
     }
 
+    // Upper address can only be used with linear allocator and within single memory block.
+    const bool isUpperAddress = (createInfo.flags & VMA_ALLOCATION_CREATE_UPPER_ADDRESS_BIT) != 0;
+    if (isUpperAddress &&
+        (m_Algorithm != VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT || m_MaxBlockCount > 1))
     {
-        VmaMutexLockWrite lock(m_Mutex, m_hAllocator->m_UseMutex);
-        for (allocIndex = 0; allocIndex < allocationCount; ++allocIndex)
+        res = VK_ERROR_FEATURE_NOT_PRESENT;
+    }
+    // Early reject: requested allocation size is larger that maximum block size for this block vector.
+    else if (size + VMA_DEBUG_MARGIN > m_PreferredBlockSize)
+    {
+        res = VK_ERROR_OUT_OF_DEVICE_MEMORY;
+    }
+    // Early reject: slab algorithm has no size class for this allocation, so new block wouldn't help either.
+    else if (m_Algorithm == VMA_POOL_CREATE_SLAB_ALGORITHM_BIT &&
+        !VmaBlockMetadata_Slab::IsAllocationSupported(size, VMA_DEBUG_MARGIN, alignment, suballocType, m_BufferImageGranularity))
+    {
+        res = VK_ERROR_OUT_OF_DEVICE_MEMORY;
+    }
+    // Early reject: buddy algorithm uses only power-of-2 part of the block and rounds allocations up to power of 2.
+    else if (m_Algorithm == VMA_POOL_CREATE_BUDDY_ALGORITHM_BIT &&
+        VmaNextPow2(size + VMA_DEBUG_MARGIN) > VmaPrevPow2(m_PreferredBlockSize))
+    {
+        res = VK_ERROR_OUT_OF_DEVICE_MEMORY;
+    }
+    else
+    {
+        const uint32_t strategy = createInfo.flags & VMA_ALLOCATION_CREATE_STRATEGY_MASK;
+        // First try existing blocks under read lock, so threads allocating from different blocks run in parallel.
         {
-            res = AllocatePage(
-                size,
-                alignment,
-                createInfo,
-                suballocType,
-                pAllocations + allocIndex);
-            if (res != VK_SUCCESS)
+            VmaMutexLockRead lock(m_Mutex, m_hAllocator->m_UseMutex);
+            for (; allocIndex < allocationCount; ++allocIndex)
             {
-                break;
+                // All pages have the same parameters - continue in the block that served the previous one,
+                // to keep them together in as few blocks as possible without searching again.
+                if (allocIndex > 0 && AllocateFromBlock(
+                    pAllocations[allocIndex - 1]->GetBlock(),
+                    size,
+                    alignment,
+                    createInfo.flags,
+                    createInfo.pUserData,
+                    suballocType,
+                    strategy,
+                    pAllocations + allocIndex) == VK_SUCCESS)
+                {
+                    continue;
+                }
+                if (AllocateFromExistingBlocks(
+                    size,
+                    alignment,
+                    createInfo,
+                    suballocType,
+                    pAllocations + allocIndex) != VK_SUCCESS)
+                {
+                    break;
+                }
+            }
+        }
+        if (allocIndex > 0)
+        {
+            TryIncrementallySortBlocks();
+        }
+
+        // Creating new blocks needs exclusive access.
+        if (allocIndex < allocationCount)
+        {
+            VmaMutexLockWrite lock(m_Mutex, m_hAllocator->m_UseMutex);
+            for (; allocIndex < allocationCount; ++allocIndex)
+            {
+                res = AllocatePage(
+                    size,
+                    alignment,
+                    createInfo,
+                    suballocType,
+                    pAllocations + allocIndex);
+                if (res != VK_SUCCESS)
+                {
+                    break;
+                }
             }
         }
     }
@@ -12453,45 +16087,15 @@ VkResult VmaBlockVector::Allocate(
     return res;
 }
 
-VkResult VmaBlockVector::AllocatePage(
+VkResult VmaBlockVector::AllocateFromExistingBlocks(
     VkDeviceSize size,
     VkDeviceSize alignment,
     const VmaAllocationCreateInfo& createInfo,
     VmaSuballocationType suballocType,
     VmaAllocation* pAllocation)
 {
-    const bool isUpperAddress = (createInfo.flags & VMA_ALLOCATION_CREATE_UPPER_ADDRESS_BIT) != 0;
-
-    VkDeviceSize freeMemory;
-    {
-        const uint32_t heapIndex = m_hAllocator->MemoryTypeIndexToHeapIndex(m_MemoryTypeIndex);
-        VmaBudget heapBudget = {};
-        m_hAllocator->GetHeapBudgets(&heapBudget, heapIndex, 1);
-        freeMemory = (heapBudget.usage < heapBudget.budget) ? (heapBudget.budget - heapBudget.usage) : 0;
-    }
-
-    const bool canFallbackToDedicated = !HasExplicitBlockSize() &&
-        (createInfo.flags & VMA_ALLOCATION_CREATE_NEVER_ALLOCATE_BIT) == 0;
-    const bool canCreateNewBlock =
-        ((createInfo.flags & VMA_ALLOCATION_CREATE_NEVER_ALLOCATE_BIT) == 0) &&
-        (m_Blocks.size() < m_MaxBlockCount) &&
-        (freeMemory >= size || !canFallbackToDedicated);
-    uint32_t strategy = createInfo.flags & VMA_ALLOCATION_CREATE_STRATEGY_MASK;
-
-    // Upper address can only be used with linear allocator and within single memory block.
-    if (isUpperAddress &&
-        (m_Algorithm != VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT || m_MaxBlockCount > 1))
-    {
-        return VK_ERROR_FEATURE_NOT_PRESENT;
-    }
-
-    // Early reject: requested allocation size is larger that maximum block size for this block vector.
-    if (size + VMA_DEBUG_MARGIN > m_PreferredBlockSize)
-    {
-        return VK_ERROR_OUT_OF_DEVICE_MEMORY;
-    }
+    const uint32_t strategy = createInfo.flags & VMA_ALLOCATION_CREATE_STRATEGY_MASK;
 
-    // 1. Search existing allocations. Try to allocate.
     if (m_Algorithm == VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT)
     {
         // Use only last block.
@@ -12504,7 +16108,6 @@ VkResult VmaBlockVector::AllocatePage(
             if (res == VK_SUCCESS)
             {
                 VMA_DEBUG_LOG("    Returned from last block #%u", pCurrBlock->GetId());
-                IncrementallySortBlocks();
                 return VK_SUCCESS;
             }
         }
@@ -12528,7 +16131,8 @@ VkResult VmaBlockVector::AllocatePage(
                 for(size_t mappingI = 0; mappingI < 2; ++mappingI)
                 {
                     // Forward order in m_Blocks - prefer blocks with smallest amount of free space.
-                    for (size_t blockIndex = 0; blockIndex < m_Blocks.size(); ++blockIndex)
+                    for (size_t blockIndex = FindNextBlockWithFreeRegion(0, size); blockIndex != SIZE_MAX;
+                        blockIndex = FindNextBlockWithFreeRegion(blockIndex + 1, size))
                     {
                         VmaDeviceMemoryBlock* const pCurrBlock = m_Blocks[blockIndex];
                         VMA_ASSERT(pCurrBlock);
@@ -12540,7 +16144,6 @@ VkResult VmaBlockVector::AllocatePage(
                             if (res == VK_SUCCESS)
                             {
                                 VMA_DEBUG_LOG("    Returned from existing block #%u", pCurrBlock->GetId());
-                                IncrementallySortBlocks();
                                 return VK_SUCCESS;
                             }
                         }
@@ -12550,7 +16153,8 @@ VkResult VmaBlockVector::AllocatePage(
             else
             {
                 // Forward order in m_Blocks - prefer blocks with smallest amount of free space.
-                for (size_t blockIndex = 0; blockIndex < m_Blocks.size(); ++blockIndex)
+                for (size_t blockIndex = FindNextBlockWithFreeRegion(0, size); blockIndex != SIZE_MAX;
+                    blockIndex = FindNextBlockWithFreeRegion(blockIndex + 1, size))
                 {
                     VmaDeviceMemoryBlock* const pCurrBlock = m_Blocks[blockIndex];
                     VMA_ASSERT(pCurrBlock);
@@ -12559,7 +16163,6 @@ VkResult VmaBlockVector::AllocatePage(
                     if (res == VK_SUCCESS)
                     {
                         VMA_DEBUG_LOG("    Returned from existing block #%u", pCurrBlock->GetId());
-                        IncrementallySortBlocks();
                         return VK_SUCCESS;
                     }
                 }
@@ -12568,7 +16171,8 @@ VkResult VmaBlockVector::AllocatePage(
         else // VMA_ALLOCATION_CREATE_STRATEGY_MIN_TIME_BIT
         {
             // Backward order in m_Blocks - prefer blocks with largest amount of free space.
-            for (size_t blockIndex = m_Blocks.size(); blockIndex--; )
+            for (size_t blockIndex = FindPrevBlockWithFreeRegion(m_Blocks.size(), size); blockIndex != SIZE_MAX;
+                blockIndex = FindPrevBlockWithFreeRegion(blockIndex, size))
             {
                 VmaDeviceMemoryBlock* const pCurrBlock = m_Blocks[blockIndex];
                 VMA_ASSERT(pCurrBlock);
@@ -12576,14 +16180,49 @@ VkResult VmaBlockVector::AllocatePage(
                 if (res == VK_SUCCESS)
                 {
                     VMA_DEBUG_LOG("    Returned from existing block #%u", pCurrBlock->GetId());
-                    IncrementallySortBlocks();
                     return VK_SUCCESS;
                 }
             }
         }
     }
 
-    // 2. Try to create new block.
+    return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+}
+
+VkResult VmaBlockVector::AllocatePage(
+    VkDeviceSize size,
+    VkDeviceSize alignment,
+    const VmaAllocationCreateInfo& createInfo,
+    VmaSuballocationType suballocType,
+    VmaAllocation* pAllocation)
+{
+    const uint32_t strategy = createInfo.flags & VMA_ALLOCATION_CREATE_STRATEGY_MASK;
+
+    // 1. Search existing allocations. Try to allocate.
+    // Tried again, as another thread could free memory since the attempt made under read lock.
+    if (AllocateFromExistingBlocks(size, alignment, createInfo, suballocType, pAllocation) == VK_SUCCESS)
+    {
+        IncrementallySortBlocks();
+        return VK_SUCCESS;
+    }
+
+    // 2. Try to create new block.
+    // Budget is queried only here, so allocations served from existing blocks never touch budget state.
+    const bool canFallbackToDedicated = !HasExplicitBlockSize() &&
+        (createInfo.flags & VMA_ALLOCATION_CREATE_NEVER_ALLOCATE_BIT) == 0;
+    VkDeviceSize freeMemory = 0;
+    bool canCreateNewBlock =
+        ((createInfo.flags & VMA_ALLOCATION_CREATE_NEVER_ALLOCATE_BIT) == 0) &&
+        (m_Blocks.size() < m_MaxBlockCount);
+    if (canCreateNewBlock)
+    {
+        const uint32_t heapIndex = m_hAllocator->MemoryTypeIndexToHeapIndex(m_MemoryTypeIndex);
+        VmaBudget heapBudget = {};
+        m_hAllocator->GetHeapBudgets(&heapBudget, heapIndex, 1);
+        freeMemory = (heapBudget.usage < heapBudget.budget) ? (heapBudget.budget - heapBudget.usage) : 0;
+        canCreateNewBlock = freeMemory >= size || !canFallbackToDedicated;
+    }
+
     if (canCreateNewBlock)
     {
         // Calculate optimal size for new block.
@@ -12610,6 +16249,7 @@ VkResult VmaBlockVector::AllocatePage(
             }
         }
 
+        // vkAllocateMemory runs under the write lock here. Only PreallocateBlock() calls it without the lock.
         size_t newBlockIndex = 0;
         VkResult res = (newBlockSize <= freeMemory || !canFallbackToDedicated) ?
             CreateBlock(newBlockSize, &newBlockIndex) : VK_ERROR_OUT_OF_DEVICE_MEMORY;
@@ -12657,80 +16297,108 @@ VkResult VmaBlockVector::AllocatePage(
     return VK_ERROR_OUT_OF_DEVICE_MEMORY;
 }
 
-void VmaBlockVector::Free(const VmaAllocation hAllocation)
+void VmaBlockVector::Free(size_t allocationCount, const VmaAllocation* pAllocations)
 {
-    VmaDeviceMemoryBlock* pBlockToDelete = VMA_NULL;
-
-    bool budgetExceeded = false;
-    {
-        const uint32_t heapIndex = m_hAllocator->MemoryTypeIndexToHeapIndex(m_MemoryTypeIndex);
-        VmaBudget heapBudget = {};
-        m_hAllocator->GetHeapBudgets(&heapBudget, heapIndex, 1);
-        budgetExceeded = heapBudget.usage >= heapBudget.budget;
-    }
+    VmaSmallVector<VmaDeviceMemoryBlock*, VmaStlAllocator<VmaDeviceMemoryBlock*>, 4> blocksToDelete(
+        VmaStlAllocator<VmaDeviceMemoryBlock*>(m_hAllocator->GetAllocationCallbacks()));
+    // Last block that became empty. Kept as a hysteresis, while other empty blocks are deleted.
+    VmaDeviceMemoryBlock* pEmptiedBlock = VMA_NULL;
+    bool removeEmptyBlocks = false;
 
-    // Scope for lock.
+    // Scope for read lock. Frees to different blocks proceed in parallel.
     {
-        VmaMutexLockWrite lock(m_Mutex, m_hAllocator->m_UseMutex);
-
-        VmaDeviceMemoryBlock* pBlock = hAllocation->GetBlock();
-
-        if (IsCorruptionDetectionEnabled())
-        {
-            VkResult res = pBlock->ValidateMagicValueAfterAllocation(m_hAllocator, hAllocation->GetOffset(), hAllocation->GetSize());
-            VMA_ASSERT(res == VK_SUCCESS && "Couldn't map block memory to validate magic value.");
-        }
+        VmaMutexLockRead lock(m_Mutex, m_hAllocator->m_UseMutex);
 
-        if (hAllocation->IsPersistentMap())
+        for (size_t allocIndex = 0; allocIndex < allocationCount; ++allocIndex)
         {
-            pBlock->Unmap(m_hAllocator, 1);
-        }
+            const VmaAllocation hAllocation = pAllocations[allocIndex];
+            VmaDeviceMemoryBlock* pBlock = hAllocation->GetBlock();
 
-        const bool hadEmptyBlockBeforeFree = HasEmptyBlock();
-        pBlock->m_pMetadata->Free(hAllocation->GetAllocHandle());
-        pBlock->PostFree(m_hAllocator);
-        VMA_HEAVY_ASSERT(pBlock->Validate());
+            if (IsCorruptionDetectionEnabled())
+            {
+                VkResult res = pBlock->ValidateMagicValueAfterAllocation(m_hAllocator, hAllocation->GetOffset(), hAllocation->GetSize());
+                VMA_ASSERT(res == VK_SUCCESS && "Couldn't map block memory to validate magic value.");
+            }
 
-        VMA_DEBUG_LOG("  Freed from MemoryTypeIndex=%u", m_MemoryTypeIndex);
+            if (hAllocation->IsPersistentMap())
+            {
+                pBlock->Unmap(m_hAllocator, 1);
+            }
 
-        const bool canDeleteBlock = m_Blocks.size() > m_MinBlockCount;
-        // pBlock became empty after this deallocation.
-        if (pBlock->m_pMetadata->IsEmpty())
-        {
-            // Already had empty block. We don't want to have two, so delete this one.
-            if ((hadEmptyBlockBeforeFree || budgetExceeded) && canDeleteBlock)
+            // Scope for block lock.
             {
-                pBlockToDelete = pBlock;
-                Remove(pBlock);
+                VmaMutexLock blockLock(pBlock->GetMetadataMutex(), m_hAllocator->m_UseMutex);
+                pBlock->m_pMetadata->Free(hAllocation->GetAllocHandle());
+                pBlock->PostFree(m_hAllocator);
+                UpdateMaxFreeTree(pBlock->m_BlockVectorIndex);
+                VMA_HEAVY_ASSERT(pBlock->Validate());
+                // pBlock became empty after this deallocation.
+                if (pBlock->m_pMetadata->IsEmpty())
+                {
+                    ++m_EmptyBlockCount;
+                    pEmptiedBlock = pBlock;
+                }
             }
-            // else: We now have one empty block - leave it. A hysteresis to avoid allocating whole block back and forth.
+
+            VMA_DEBUG_LOG("  Freed from MemoryTypeIndex=%u", m_MemoryTypeIndex);
+        }
+
+        // Already had empty block and now there is another one, or no block became empty but there is
+        // one left from before - delete the extra ones. Also the only empty block if heap budget is exceeded.
+        // A preallocated block is meant to stay empty until needed, so the one left from before is kept then.
+        if (m_Blocks.size() > GetMinBlockCount())
+        {
+            const uint32_t emptyBlockCount = m_EmptyBlockCount;
+            removeEmptyBlocks = emptyBlockCount > 1 ||
+                (emptyBlockCount == 1 &&
+                    ((pEmptiedBlock == VMA_NULL && !IsPreallocatedBlockEmpty()) || IsHeapBudgetExceeded()));
         }
-        // pBlock didn't become empty, but we have another empty block - find and free that one.
-        // (This is optional, heuristics.)
-        else if (hadEmptyBlockBeforeFree && canDeleteBlock)
+    }
+
+    // Deleting blocks needs exclusive access. Only the rare frees that leave an extra empty block get here.
+    if (removeEmptyBlocks)
+    {
+        VmaMutexLockWrite lock(m_Mutex, m_hAllocator->m_UseMutex);
+        // The decision was made under read lock. Frees on other threads might have emptied more blocks
+        // or already removed some, pEmptiedBlock included - then another empty block is kept instead.
+        const VmaDeviceMemoryBlock* pKeepBlock = VMA_NULL;
+        if (pEmptiedBlock != VMA_NULL || m_EmptyBlockCount > 1)
         {
-            VmaDeviceMemoryBlock* pLastBlock = m_Blocks.back();
-            if (pLastBlock->m_pMetadata->IsEmpty())
+            for (size_t blockIndex = m_Blocks.size(); blockIndex--; )
             {
-                pBlockToDelete = pLastBlock;
-                m_Blocks.pop_back();
+                if (m_Blocks[blockIndex] == pEmptiedBlock)
+                {
+                    pKeepBlock = pEmptiedBlock;
+                    break;
+                }
+                if (pKeepBlock == VMA_NULL && m_Blocks[blockIndex]->m_pMetadata->IsEmpty())
+                    pKeepBlock = m_Blocks[blockIndex];
             }
         }
-
+        RemoveEmptyBlocks(pKeepBlock, blocksToDelete);
         IncrementallySortBlocks();
     }
+    else
+    {
+        TryIncrementallySortBlocks();
+    }
 
-    // Destruction of a free block. Deferred until this point, outside of mutex
+    // Destruction of free blocks. Deferred until this point, outside of mutex
     // lock, for performance reason.
-    if (pBlockToDelete != VMA_NULL)
+    for (size_t i = 0; i < blocksToDelete.size(); ++i)
     {
+        VmaDeviceMemoryBlock* const pBlockToDelete = blocksToDelete[i];
         VMA_DEBUG_LOG("    Deleted empty block #%u", pBlockToDelete->GetId());
         pBlockToDelete->Destroy(m_hAllocator);
         vma_delete(m_hAllocator, pBlockToDelete);
     }
 
-    m_hAllocator->m_Budget.RemoveAllocation(m_hAllocator->MemoryTypeIndexToHeapIndex(m_MemoryTypeIndex), hAllocation->GetSize());
-    m_hAllocator->m_AllocationObjectAllocator.Free(hAllocation);
+    const uint32_t heapIndex = m_hAllocator->MemoryTypeIndexToHeapIndex(m_MemoryTypeIndex);
+    for (size_t allocIndex = 0; allocIndex < allocationCount; ++allocIndex)
+    {
+        m_hAllocator->m_Budget.RemoveAllocation(heapIndex, pAllocations[allocIndex]->GetSize());
+        m_hAllocator->m_AllocationObjectAllocator.Free(pAllocations[allocIndex]);
+    }
 }
 
 VkDeviceSize VmaBlockVector::CalcMaxBlockSize() const
@@ -12747,17 +16415,40 @@ VkDeviceSize VmaBlockVector::CalcMaxBlockSize() const
     return result;
 }
 
-void VmaBlockVector::Remove(VmaDeviceMemoryBlock* pBlock)
+bool VmaBlockVector::ValidateStatisticsCounters()
 {
-    for (uint32_t blockIndex = 0; blockIndex < m_Blocks.size(); ++blockIndex)
+    VmaMutexLockWrite lock(m_Mutex, m_hAllocator->m_UseMutex);
+
+    VmaDetailedStatistics calculated, counted;
+    VmaClearDetailedStatistics(calculated);
+    VmaClearDetailedStatistics(counted);
+    for (size_t i = 0; i < m_Blocks.size(); ++i)
     {
-        if (m_Blocks[blockIndex] == pBlock)
-        {
-            VmaVectorRemove(m_Blocks, blockIndex);
-            return;
-        }
+        VmaMutexLock blockLock(m_Blocks[i]->GetMetadataMutex(), m_hAllocator->m_UseMutex);
+        m_Blocks[i]->m_pMetadata->AddDetailedStatistics(calculated);
     }
-    VMA_ASSERT(0);
+    m_pStatisticsCounters->AddDetailedStatistics(counted);
+
+    VMA_VALIDATE(counted.statistics.blockCount == calculated.statistics.blockCount);
+    VMA_VALIDATE(counted.statistics.allocationCount == calculated.statistics.allocationCount);
+    VMA_VALIDATE(counted.statistics.blockBytes == calculated.statistics.blockBytes);
+    VMA_VALIDATE(counted.statistics.allocationBytes == calculated.statistics.allocationBytes);
+    VMA_VALIDATE(counted.unusedRangeCount == calculated.unusedRangeCount);
+    if (calculated.statistics.allocationCount > 0)
+    {
+        VMA_VALIDATE(counted.allocationSizeMin == VmaStatisticsCounters::ClassToSize(
+            VmaStatisticsCounters::SizeToClass(calculated.allocationSizeMin)));
+        VMA_VALIDATE(counted.allocationSizeMax == VmaStatisticsCounters::ClassToSize(
+            VmaStatisticsCounters::SizeToClass(calculated.allocationSizeMax)));
+    }
+    if (calculated.unusedRangeCount > 0)
+    {
+        VMA_VALIDATE(counted.unusedRangeSizeMin == VmaStatisticsCounters::ClassToSize(
+            VmaStatisticsCounters::SizeToClass(calculated.unusedRangeSizeMin)));
+        VMA_VALIDATE(counted.unusedRangeSizeMax == VmaStatisticsCounters::ClassToSize(
+            VmaStatisticsCounters::SizeToClass(calculated.unusedRangeSizeMax)));
+    }
+    return true;
 }
 
 void VmaBlockVector::IncrementallySortBlocks()
@@ -12771,13 +16462,28 @@ void VmaBlockVector::IncrementallySortBlocks()
         {
             if (m_Blocks[i - 1]->m_pMetadata->GetSumFreeSize() > m_Blocks[i]->m_pMetadata->GetSumFreeSize())
             {
-                VMA_SWAP(m_Blocks[i - 1], m_Blocks[i]);
+                SwapBlocks(i - 1, i);
                 return;
             }
         }
     }
 }
 
+void VmaBlockVector::TryIncrementallySortBlocks()
+{
+    if (!m_IncrementalSort)
+        return;
+    if (!m_hAllocator->m_UseMutex)
+    {
+        IncrementallySortBlocks();
+    }
+    else if (m_Mutex.TryLockWrite())
+    {
+        IncrementallySortBlocks();
+        m_Mutex.UnlockWrite();
+    }
+}
+
 void VmaBlockVector::SortByFreeSize()
 {
     VMA_SORT(m_Blocks.begin(), m_Blocks.end(),
@@ -12785,6 +16491,108 @@ void VmaBlockVector::SortByFreeSize()
         {
             return b1->m_pMetadata->GetSumFreeSize() < b2->m_pMetadata->GetSumFreeSize();
         });
+    RebuildMaxFreeTree();
+}
+
+void VmaBlockVector::SwapBlocks(size_t index1, size_t index2)
+{
+    VMA_SWAP(m_Blocks[index1], m_Blocks[index2]);
+    UpdateMaxFreeTree(index1);
+    UpdateMaxFreeTree(index2);
+}
+
+void VmaBlockVector::RebuildMaxFreeTree()
+{
+    size_t leafCount = 1;
+    while (leafCount < m_Blocks.size())
+        leafCount *= 2;
+    m_MaxFreeTreeLeafCount = leafCount;
+    m_MaxFreeTree.resize(leafCount * 2);
+    memset(m_MaxFreeTree.data(), 0, m_MaxFreeTree.size() * sizeof(VkDeviceSize));
+
+    for (size_t i = 0; i < m_Blocks.size(); ++i)
+    {
+        m_Blocks[i]->m_BlockVectorIndex = i;
+        m_MaxFreeTree[leafCount + i] = m_Blocks[i]->m_pMetadata->GetMaxFreeRegionSize();
+    }
+    for (size_t node = leafCount; --node > 0; )
+        m_MaxFreeTree[node] = VMA_MAX(m_MaxFreeTree[node * 2], m_MaxFreeTree[node * 2 + 1]);
+}
+
+void VmaBlockVector::UpdateMaxFreeTree(size_t index)
+{
+    VmaMutexLock lock(m_MaxFreeTreeMutex, m_hAllocator->m_UseMutex);
+    VMA_ASSERT(index < m_MaxFreeTreeLeafCount);
+    size_t node = m_MaxFreeTreeLeafCount + index;
+    if (index < m_Blocks.size())
+    {
+        m_Blocks[index]->m_BlockVectorIndex = index;
+        m_MaxFreeTree[node] = m_Blocks[index]->m_pMetadata->GetMaxFreeRegionSize();
+    }
+    else
+        m_MaxFreeTree[node] = 0;
+
+    for (node /= 2; node > 0; node /= 2)
+    {
+        const VkDeviceSize newValue = VMA_MAX(m_MaxFreeTree[node * 2], m_MaxFreeTree[node * 2 + 1]);
+        if (m_MaxFreeTree[node] == newValue)
+            break;
+        m_MaxFreeTree[node] = newValue;
+    }
+}
+
+size_t VmaBlockVector::FindNextBlockWithFreeRegion(size_t firstIndex, VkDeviceSize size)
+{
+    if (firstIndex >= m_Blocks.size())
+        return SIZE_MAX;
+
+    VmaMutexLock lock(m_MaxFreeTreeMutex, m_hAllocator->m_UseMutex);
+    // Go up and right until reaching a subtree that contains a fitting block.
+    size_t node = m_MaxFreeTreeLeafCount + firstIndex;
+    while (m_MaxFreeTree[node] < size)
+    {
+        while (node & 1)
+            node /= 2;
+        // Went up from the rightmost leaf past the root.
+        if (node == 0)
+            return SIZE_MAX;
+        ++node;
+    }
+    // Go down to the leftmost fitting leaf.
+    while (node < m_MaxFreeTreeLeafCount)
+    {
+        node *= 2;
+        if (m_MaxFreeTree[node] < size)
+            ++node;
+    }
+    return node - m_MaxFreeTreeLeafCount;
+}
+
+size_t VmaBlockVector::FindPrevBlockWithFreeRegion(size_t endIndex, VkDeviceSize size)
+{
+    if (endIndex == 0)
+        return SIZE_MAX;
+
+    VmaMutexLock lock(m_MaxFreeTreeMutex, m_hAllocator->m_UseMutex);
+    // Go up and left until reaching a subtree that contains a fitting block.
+    size_t node = m_MaxFreeTreeLeafCount + endIndex - 1;
+    while (m_MaxFreeTree[node] < size)
+    {
+        while (node > 1 && (node & 1) == 0)
+            node /= 2;
+        // Went up from the leftmost leaf to the root.
+        if (node == 1)
+            return SIZE_MAX;
+        --node;
+    }
+    // Go down to the rightmost fitting leaf.
+    while (node < m_MaxFreeTreeLeafCount)
+    {
+        node = node * 2 + 1;
+        if (m_MaxFreeTree[node] < size)
+            --node;
+    }
+    return node - m_MaxFreeTreeLeafCount;
 }
 
 VkResult VmaBlockVector::AllocateFromBlock(
@@ -12799,6 +16607,7 @@ VkResult VmaBlockVector::AllocateFromBlock(
 {
     const bool isUpperAddress = (allocFlags & VMA_ALLOCATION_CREATE_UPPER_ADDRESS_BIT) != 0;
 
+    VmaMutexLock lock(pBlock->GetMetadataMutex(), m_hAllocator->m_UseMutex);
     VmaAllocationRequest currRequest = {};
     if (pBlock->m_pMetadata->CreateAllocationRequest(
         size,
@@ -12839,7 +16648,12 @@ VkResult VmaBlockVector::CommitAllocationRequest(
     }
 
     *pAllocation = m_hAllocator->m_AllocationObjectAllocator.Allocate(isMappingAllowed);
+    if (pBlock->m_pMetadata->IsEmpty())
+    {
+        --m_EmptyBlockCount;
+    }
     pBlock->m_pMetadata->Alloc(allocRequest, suballocType, *pAllocation);
+    UpdateMaxFreeTree(pBlock->m_BlockVectorIndex);
     (*pAllocation)->InitBlockAllocation(
         pBlock,
         allocRequest.allocHandle,
@@ -12867,6 +16681,20 @@ VkResult VmaBlockVector::CommitAllocationRequest(
 }
 
 VkResult VmaBlockVector::CreateBlock(VkDeviceSize blockSize, size_t* pNewBlockIndex)
+{
+    VkDeviceMemory mem = VK_NULL_HANDLE;
+    VkResult res = AllocateBlockMemory(blockSize, &mem);
+    if (res < 0)
+    {
+        return res;
+    }
+
+    // New VkDeviceMemory successfully created.
+    AddBlock(mem, blockSize, pNewBlockIndex);
+    return VK_SUCCESS;
+}
+
+VkResult VmaBlockVector::AllocateBlockMemory(VkDeviceSize blockSize, VkDeviceMemory* pMemory)
 {
     VkMemoryAllocateInfo allocInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
     allocInfo.pNext = m_pMemoryAllocateNext;
@@ -12903,95 +16731,397 @@ VkResult VmaBlockVector::CreateBlock(VkDeviceSize blockSize, size_t* pNewBlockIn
     }
 #endif // VMA_EXTERNAL_MEMORY
 
-    VkDeviceMemory mem = VK_NULL_HANDLE;
-    VkResult res = m_hAllocator->AllocateVulkanMemory(&allocInfo, &mem);
-    if (res < 0)
-    {
-        return res;
-    }
-
-    // New VkDeviceMemory successfully created.
+    return m_hAllocator->AllocateVulkanMemory(&allocInfo, pMemory);
+}
 
-    // Create new Allocation for it.
+void VmaBlockVector::AddBlock(VkDeviceMemory memory, VkDeviceSize blockSize, size_t* pNewBlockIndex)
+{
     VmaDeviceMemoryBlock* const pBlock = vma_new(m_hAllocator, VmaDeviceMemoryBlock)(m_hAllocator);
     pBlock->Init(
         m_hAllocator,
         m_hParentPool,
         m_MemoryTypeIndex,
-        mem,
-        allocInfo.allocationSize,
+        memory,
+        blockSize,
         m_NextBlockId++,
         m_Algorithm,
-        m_BufferImageGranularity);
+        m_BufferImageGranularity,
+        m_pStatisticsCounters);
+
+    m_Blocks.push_back(pBlock);
+    ++m_EmptyBlockCount;
+    if (m_Blocks.size() > m_MaxFreeTreeLeafCount)
+        RebuildMaxFreeTree();
+    else
+        UpdateMaxFreeTree(m_Blocks.size() - 1);
+
+    VkDeviceSize blockBytes = 0;
+    for (size_t i = 0; i < m_Blocks.size(); ++i)
+        blockBytes += m_Blocks[i]->m_pMetadata->GetSize();
+    m_PeakBlockCount = VMA_MAX(m_PeakBlockCount, m_Blocks.size());
+    m_PeakBlockBytes = VMA_MAX(m_PeakBlockBytes, blockBytes);
+    m_MaxCreatedBlockSize = VMA_MAX(m_MaxCreatedBlockSize, blockSize);
+    if (pNewBlockIndex != VMA_NULL)
+    {
+        *pNewBlockIndex = m_Blocks.size() - 1;
+    }
+}
+
+bool VmaBlockVector::IsHeapBudgetExceeded() const
+{
+    const uint32_t heapIndex = m_hAllocator->MemoryTypeIndexToHeapIndex(m_MemoryTypeIndex);
+    VmaBudget heapBudget = {};
+    m_hAllocator->GetHeapBudgets(&heapBudget, heapIndex, 1);
+    return heapBudget.usage >= heapBudget.budget;
+}
+
+bool VmaBlockVector::IsPreallocatedBlockEmpty()
+{
+    if (m_pPreallocatedBlock == VMA_NULL)
+        return false;
+    VmaMutexLock blockLock(m_pPreallocatedBlock->GetMetadataMutex(), m_hAllocator->m_UseMutex);
+    return m_pPreallocatedBlock->m_pMetadata->IsEmpty();
+}
+
+void VmaBlockVector::RemoveEmptyBlocks(
+    const VmaDeviceMemoryBlock* pKeepBlock,
+    VmaSmallVector<VmaDeviceMemoryBlock*, VmaStlAllocator<VmaDeviceMemoryBlock*>, 4>& blocksToDelete)
+{
+    // Once the preallocated block took an allocation, it is an ordinary block.
+    // While still empty, it gets no protection here: only pKeepBlock survives,
+    // so another block emptied by a free replaces it.
+    if (m_pPreallocatedBlock != VMA_NULL && !m_pPreallocatedBlock->m_pMetadata->IsEmpty())
+        m_pPreallocatedBlock = VMA_NULL;
+
+    bool removed = false;
+    // Backward order - empty blocks are sorted towards the end.
+    for (size_t blockIndex = m_Blocks.size(); blockIndex-- && m_EmptyBlockCount > 0 && m_Blocks.size() > GetMinBlockCount(); )
+    {
+        VmaDeviceMemoryBlock* const pBlock = m_Blocks[blockIndex];
+        if (!pBlock->m_pMetadata->IsEmpty())
+            continue;
+        // Keep one empty block - a hysteresis to avoid allocating whole block back and forth.
+        // Budget is queried only here, so most frees never touch budget state.
+        if (pBlock == pKeepBlock && !IsHeapBudgetExceeded())
+            continue;
+
+        blocksToDelete.push_back(pBlock);
+        VmaVectorRemove(m_Blocks, blockIndex);
+        --m_EmptyBlockCount;
+        if (pBlock == m_pPreallocatedBlock)
+            m_pPreallocatedBlock = VMA_NULL;
+        removed = true;
+    }
+    if (removed)
+    {
+        RebuildMaxFreeTree();
+    }
+}
+
+#if VMA_STATS_STRING_ENABLED
+void VmaBlockVector::PrintDetailedMap(class VmaJsonWriter& json)
+{
+    // Blocks are looked up again by id, as the locks are released between them.
+    typedef VmaVector<uint32_t, VmaStlAllocator<uint32_t>> BlockIdVector;
+    BlockIdVector blockIds = BlockIdVector(VmaStlAllocator<uint32_t>(m_hAllocator->GetAllocationCallbacks()));
+    {
+        VmaMutexLockRead lock(m_Mutex, m_hAllocator->m_UseMutex);
+        for (size_t i = 0; i < m_Blocks.size(); ++i)
+            blockIds.push_back(m_Blocks[i]->GetId());
+    }
+
+    // Each block is copied under its lock, then formatted and possibly flushed after the lock is released.
+    VmaBlockDetailedMap map(m_hAllocator->GetAllocationCallbacks());
+    json.BeginObject();
+    for (size_t idIndex = 0; idIndex < blockIds.size(); ++idIndex)
+    {
+        uint32_t mapRefCount = 0;
+        {
+            VmaMutexLockRead lock(m_Mutex, m_hAllocator->m_UseMutex);
+            VmaDeviceMemoryBlock* pBlock = VMA_NULL;
+            for (size_t i = 0; i < m_Blocks.size() && pBlock == VMA_NULL; ++i)
+            {
+                if (m_Blocks[i]->GetId() == blockIds[idIndex])
+                    pBlock = m_Blocks[i];
+            }
+            // Block was freed in the meantime.
+            if (pBlock == VMA_NULL)
+                continue;
+
+            mapRefCount = pBlock->GetMapRefCount();
+            VmaMutexLock blockLock(pBlock->GetMetadataMutex(), m_hAllocator->m_UseMutex);
+            pBlock->m_pMetadata->PrintDetailedMap(map);
+        }
+
+        json.BeginString();
+        json.ContinueString(blockIds[idIndex]);
+        json.EndString();
+
+        json.BeginObject();
+        json.WriteString("MapRefCount");
+        json.WriteNumber(mapRefCount);
+        map.Write(json);
+        json.EndObject();
+        json.FlushIfNeeded();
+    }
+    json.EndObject();
+}
+#endif // VMA_STATS_STRING_ENABLED
+
+VkResult VmaBlockVector::CheckCorruption()
+{
+    if (!IsCorruptionDetectionEnabled())
+    {
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+    }
+
+    VmaMutexLockRead lock(m_Mutex, m_hAllocator->m_UseMutex);
+    for (uint32_t blockIndex = 0; blockIndex < m_Blocks.size(); ++blockIndex)
+    {
+        VmaDeviceMemoryBlock* const pBlock = m_Blocks[blockIndex];
+        VMA_ASSERT(pBlock);
+        VmaMutexLock blockLock(pBlock->GetMetadataMutex(), m_hAllocator->m_UseMutex);
+        VkResult res = pBlock->CheckCorruption(m_hAllocator);
+        if (res != VK_SUCCESS)
+        {
+            return res;
+        }
+    }
+    return VK_SUCCESS;
+}
+
+void VmaBlockVector::GetBlockProfile(size_t& outPeakBlockCount, VkDeviceSize& outPeakBlockBytes, VkDeviceSize& outMaxBlockSize)
+{
+    VmaMutexLockRead lock(m_Mutex, m_hAllocator->m_UseMutex);
+    outPeakBlockCount = m_PeakBlockCount;
+    outPeakBlockBytes = m_PeakBlockBytes;
+    outMaxBlockSize = m_MaxCreatedBlockSize;
+}
+
+VkResult VmaBlockVector::CreateProfileBlocks(size_t blockCount, VkDeviceSize blockSize, VkDeviceSize totalBytes)
+{
+    // Preferred block size might have changed since the profile was exported.
+    const VkDeviceSize newBlockSize = m_ExplicitBlockSize ? m_PreferredBlockSize : VMA_MIN(blockSize, m_PreferredBlockSize);
+    if (newBlockSize == 0)
+        return VK_SUCCESS;
+    const uint32_t heapIndex = m_hAllocator->MemoryTypeIndexToHeapIndex(m_MemoryTypeIndex);
+
+    // Blocks of full size are created right away, so fewer of them may be needed than at the peak.
+    // Requires m_Mutex locked at least for reading.
+    auto needsBlock = [&]() -> bool
+    {
+        if (m_Blocks.size() >= VMA_MIN(blockCount, m_MaxBlockCount))
+            return false;
+        VkDeviceSize blockBytes = 0;
+        for (size_t i = 0; i < m_Blocks.size(); ++i)
+            blockBytes += m_Blocks[i]->m_pMetadata->GetSize();
+        return blockBytes < totalBytes;
+    };
+
+    VkResult res = VK_SUCCESS;
+    for (;;)
+    {
+        {
+            VmaMutexLockRead lock(m_Mutex, m_hAllocator->m_UseMutex);
+            if (!needsBlock())
+                break;
+        }
+        VmaBudget heapBudget = {};
+        m_hAllocator->GetHeapBudgets(&heapBudget, heapIndex, 1);
+        if (heapBudget.usage + newBlockSize > heapBudget.budget)
+            break;
+
+        // vkAllocateMemory is called without m_Mutex locked, so allocations from this vector are not blocked.
+        VkDeviceMemory mem = VK_NULL_HANDLE;
+        res = AllocateBlockMemory(newBlockSize, &mem);
+        if (res != VK_SUCCESS)
+            break;
+
+        bool added = false;
+        {
+            VmaMutexLockWrite lock(m_Mutex, m_hAllocator->m_UseMutex);
+            // Another thread might have created blocks in the meantime.
+            if (needsBlock())
+            {
+                AddBlock(mem, newBlockSize, VMA_NULL);
+                ++m_ProfileBlockCount;
+                added = true;
+            }
+        }
+        if (!added)
+        {
+            m_hAllocator->FreeVulkanMemory(m_MemoryTypeIndex, newBlockSize, mem);
+            break;
+        }
+    }
+    return res;
+}
+
+VkResult VmaBlockVector::PreallocateBlock(VkDeviceSize minFreeSize, bool& outAllocated)
+{
+    outAllocated = false;
+    const uint32_t heapIndex = m_hAllocator->MemoryTypeIndexToHeapIndex(m_MemoryTypeIndex);
+    VkDeviceSize newBlockSize = m_PreferredBlockSize;
+    {
+        VmaMutexLockRead lock(m_Mutex, m_hAllocator->m_UseMutex);
+        // Unused memory types don't get a block, and an empty block is already a spare.
+        if (m_Blocks.empty() || m_Blocks.size() >= m_MaxBlockCount || m_EmptyBlockCount > 0)
+            return VK_SUCCESS;
+
+        VkDeviceSize freeSize = 0;
+        for (size_t i = 0; i < m_Blocks.size() && freeSize < minFreeSize; ++i)
+        {
+            VmaMutexLock blockLock(m_Blocks[i]->GetMetadataMutex(), m_hAllocator->m_UseMutex);
+            freeSize += m_Blocks[i]->m_pMetadata->GetSumFreeSize();
+        }
+        if (freeSize >= minFreeSize)
+            return VK_SUCCESS;
+
+        // Same size as the next block AllocatePage() would create.
+        if (!m_ExplicitBlockSize)
+        {
+            const VkDeviceSize maxExistingBlockSize = CalcMaxBlockSize();
+            for (uint32_t i = 0; i < 3 && newBlockSize / 2 > maxExistingBlockSize; ++i)
+                newBlockSize /= 2;
+        }
+    }
+
+    VmaBudget heapBudget = {};
+    m_hAllocator->GetHeapBudgets(&heapBudget, heapIndex, 1);
+    if (heapBudget.usage + newBlockSize > heapBudget.budget)
+        return VK_SUCCESS;
+
+    VkDeviceMemory mem = VK_NULL_HANDLE;
+    VkResult res = AllocateBlockMemory(newBlockSize, &mem);
+    if (res < 0)
+        return res;
 
-    m_Blocks.push_back(pBlock);
-    if (pNewBlockIndex != VMA_NULL)
     {
-        *pNewBlockIndex = m_Blocks.size() - 1;
+        VmaMutexLockWrite lock(m_Mutex, m_hAllocator->m_UseMutex);
+        // Another thread might have created a block in the meantime.
+        if (m_Blocks.size() < m_MaxBlockCount && m_EmptyBlockCount == 0)
+        {
+            AddBlock(mem, newBlockSize, VMA_NULL);
+            m_pPreallocatedBlock = m_Blocks.back();
+            outAllocated = true;
+            VMA_DEBUG_LOG("    Preallocated block #%u Size=%llu", m_pPreallocatedBlock->GetId(), newBlockSize);
+            return VK_SUCCESS;
+        }
     }
-
+    m_hAllocator->FreeVulkanMemory(m_MemoryTypeIndex, newBlockSize, mem);
     return VK_SUCCESS;
 }
 
-bool VmaBlockVector::HasEmptyBlock()
+#endif // _VMA_BLOCK_VECTOR_FUNCTIONS
+
+#ifndef _VMA_THREAD_CACHE_FUNCTIONS
+VmaThreadCache::VmaThreadCache(VmaAllocator hAllocator, const void* pOwnerThread)
+    : m_hAllocator(hAllocator),
+    m_pOwnerThread(pOwnerThread)
+{
+    memset(m_Magazines, 0, sizeof(m_Magazines));
+}
+
+VmaThreadCache::~VmaThreadCache()
 {
-    for (size_t index = 0, count = m_Blocks.size(); index < count; ++index)
+    for (uint32_t memTypeIndex = 0; memTypeIndex < VK_MAX_MEMORY_TYPES; ++memTypeIndex)
     {
-        VmaDeviceMemoryBlock* const pBlock = m_Blocks[index];
-        if (pBlock->m_pMetadata->IsEmpty())
+        for (uint32_t sizeClass = 0; sizeClass < VMA_THREAD_CACHE_MAX_CLASS_COUNT; ++sizeClass)
         {
-            return true;
+            VmaThreadCacheMagazine* const pMagazine = m_Magazines[memTypeIndex][sizeClass];
+            if (pMagazine != VMA_NULL)
+            {
+                VMA_ASSERT(pMagazine->m_Count == 0 && "Thread cache destroyed without being flushed.");
+                vma_delete(m_hAllocator, pMagazine);
+            }
         }
     }
-    return false;
 }
 
-#if VMA_STATS_STRING_ENABLED
-void VmaBlockVector::PrintDetailedMap(class VmaJsonWriter& json)
+VmaAllocation VmaThreadCache::Allocate(VmaBlockVector& blockVector, uint32_t sizeClass)
 {
-    VmaMutexLockRead lock(m_Mutex, m_hAllocator->m_UseMutex);
-
+    VmaMutexLock lock(m_Mutex);
+    // Checked under m_Mutex, so nothing gets parked after vmaBeginDefragmentation() flushed this cache.
+    if (m_hAllocator->m_DefragmentationContextCount > 0)
+        return VK_NULL_HANDLE;
 
-    json.BeginObject();
-    for (size_t i = 0; i < m_Blocks.size(); ++i)
+    VmaThreadCacheMagazine* const pMagazine = GetMagazine(blockVector.GetMemoryTypeIndex(), sizeClass);
+    if (pMagazine->m_Count == 0)
     {
-        json.BeginString();
-        json.ContinueString(m_Blocks[i]->GetId());
-        json.EndString();
-
-        json.BeginObject();
-        json.WriteString("MapRefCount");
-        json.WriteNumber(m_Blocks[i]->GetMapRefCount());
-
-        m_Blocks[i]->m_pMetadata->PrintDetailedMap(json);
-        json.EndObject();
+        // Refill half of the magazine under a single lock of the block vector, or at least one item if memory is tight.
+        const VmaAllocationCreateInfo createInfo = {};
+        const VkDeviceSize size = VmaThreadCacheClassSize(sizeClass);
+        const VkDeviceSize alignment = VmaThreadCacheClassAlignment(sizeClass);
+        const uint32_t refillCount = VMA_MAX(pMagazine->m_Capacity / 2, 1u);
+        if (blockVector.Allocate(size, alignment, createInfo, VMA_SUBALLOCATION_TYPE_BUFFER,
+            refillCount, pMagazine->m_Allocations) == VK_SUCCESS)
+        {
+            pMagazine->m_Count = refillCount;
+        }
+        else if (refillCount > 1 && blockVector.Allocate(size, alignment, createInfo, VMA_SUBALLOCATION_TYPE_BUFFER,
+            1, pMagazine->m_Allocations) == VK_SUCCESS)
+        {
+            pMagazine->m_Count = 1;
+        }
+        else
+        {
+            return VK_NULL_HANDLE;
+        }
     }
-    json.EndObject();
+    return pMagazine->m_Allocations[--pMagazine->m_Count];
 }
-#endif // VMA_STATS_STRING_ENABLED
 
-VkResult VmaBlockVector::CheckCorruption()
+bool VmaThreadCache::Free(VmaBlockVector& blockVector, uint32_t sizeClass, VmaAllocation hAllocation)
 {
-    if (!IsCorruptionDetectionEnabled())
+    VmaMutexLock lock(m_Mutex);
+    if (m_hAllocator->m_DefragmentationContextCount > 0)
+        return false;
+
+    VmaThreadCacheMagazine* const pMagazine = GetMagazine(blockVector.GetMemoryTypeIndex(), sizeClass);
+    if (pMagazine->m_Count == pMagazine->m_Capacity)
     {
-        return VK_ERROR_FEATURE_NOT_PRESENT;
+        // Flush half of the magazine under a single lock of the block vector.
+        const uint32_t flushCount = VMA_MAX(pMagazine->m_Capacity / 2, 1u);
+        pMagazine->m_Count -= flushCount;
+        blockVector.Free(flushCount, pMagazine->m_Allocations + pMagazine->m_Count);
     }
+    pMagazine->m_Allocations[pMagazine->m_Count++] = hAllocation;
+    return true;
+}
 
-    VmaMutexLockRead lock(m_Mutex, m_hAllocator->m_UseMutex);
-    for (uint32_t blockIndex = 0; blockIndex < m_Blocks.size(); ++blockIndex)
+void VmaThreadCache::Flush()
+{
+    VmaMutexLock lock(m_Mutex);
+
+    for (uint32_t memTypeIndex = 0; memTypeIndex < m_hAllocator->GetMemoryTypeCount(); ++memTypeIndex)
     {
-        VmaDeviceMemoryBlock* const pBlock = m_Blocks[blockIndex];
-        VMA_ASSERT(pBlock);
-        VkResult res = pBlock->CheckCorruption(m_hAllocator);
-        if (res != VK_SUCCESS)
+        for (uint32_t sizeClass = 0; sizeClass < VMA_THREAD_CACHE_MAX_CLASS_COUNT; ++sizeClass)
         {
-            return res;
+            VmaThreadCacheMagazine* const pMagazine = m_Magazines[memTypeIndex][sizeClass];
+            if (pMagazine != VMA_NULL && pMagazine->m_Count > 0)
+            {
+                m_hAllocator->m_pBlockVectors[memTypeIndex]->Free(pMagazine->m_Count, pMagazine->m_Allocations);
+                pMagazine->m_Count = 0;
+            }
         }
     }
-    return VK_SUCCESS;
 }
 
-#endif // _VMA_BLOCK_VECTOR_FUNCTIONS
+VmaThreadCacheMagazine* VmaThreadCache::GetMagazine(uint32_t memTypeIndex, uint32_t sizeClass)
+{
+    VMA_ASSERT(memTypeIndex < VK_MAX_MEMORY_TYPES && sizeClass < VMA_THREAD_CACHE_MAX_CLASS_COUNT);
+    VmaThreadCacheMagazine*& pMagazine = m_Magazines[memTypeIndex][sizeClass];
+    if (pMagazine == VMA_NULL)
+    {
+        pMagazine = vma_new(m_hAllocator, VmaThreadCacheMagazine);
+        pMagazine->m_Count = 0;
+        // Bound the number of bytes a magazine can hold, but keep room for batching even in the largest classes.
+        const VkDeviceSize capacity = VMA_THREAD_CACHE_MAGAZINE_BYTES / VmaThreadCacheClassSize(sizeClass);
+        pMagazine->m_Capacity = (uint32_t)VMA_MAX(VMA_MIN(capacity, (VkDeviceSize)VMA_THREAD_CACHE_MAX_MAGAZINE_CAPACITY), (VkDeviceSize)2);
+    }
+    return pMagazine;
+}
+#endif // _VMA_THREAD_CACHE_FUNCTIONS
 
 #ifndef _VMA_DEFRAGMENTATION_CONTEXT_FUNCTIONS
 VmaDefragmentationContext_T::VmaDefragmentationContext_T(
@@ -13124,7 +17254,8 @@ VkResult VmaDefragmentationContext_T::DefragmentPassBegin(VmaDefragmentationPass
     return VK_SUCCESS;
 }
 
-VkResult VmaDefragmentationContext_T::DefragmentPassEnd(VmaDefragmentationPassMoveInfo& moveInfo)
+VkResult VmaDefragmentationContext_T::DefragmentPassEnd(VmaDefragmentationPassMoveInfo& moveInfo,
+    VmaVector<VmaAllocation, VmaStlAllocator<VmaAllocation>>* pOldPlaces)
 {
     VMA_ASSERT(moveInfo.moveCount > 0 ? moveInfo.pMoves != VMA_NULL : true);
 
@@ -13177,6 +17308,15 @@ VkResult VmaDefragmentationContext_T::DefragmentPassEnd(VmaDefragmentationPassMo
                     mappedBlocks.push_back({ mapCount, newMapBlock });
             }
 
+            if (pOldPlaces != VMA_NULL)
+            {
+                // Old place still holds the data, so it must not be picked as a move source.
+                move.dstTmpAllocation->SetNotMovable();
+                pOldPlaces->push_back(move.dstTmpAllocation);
+                result = VK_INCOMPLETE;
+                break;
+            }
+
             // Scope for locks, Free have it's own lock
             {
                 VmaMutexLockRead lock(vector->GetMutex(), vector->GetAllocator()->m_UseMutex);
@@ -13254,30 +17394,7 @@ VkResult VmaDefragmentationContext_T::DefragmentPassEnd(VmaDefragmentationPassMo
             m_PassStats.deviceMemoryBlocksFreed += static_cast<uint32_t>(freedBlocks);
             m_PassStats.bytesFreed += freedBlockSize;
         }
-
-        switch (m_Algorithm)
-        {
-        case VMA_DEFRAGMENTATION_FLAG_ALGORITHM_EXTENSIVE_BIT:
-        {
-            if (m_AlgorithmState != VMA_NULL)
-            {
-                // Avoid unnecessary tries to allocate when new free block is available
-                StateExtensive& state = reinterpret_cast<StateExtensive*>(m_AlgorithmState)[vectorIndex];
-                if (state.firstFreeBlock != SIZE_MAX)
-                {
-                    const size_t diff = prevCount - currentCount;
-                    if (state.firstFreeBlock >= diff)
-                    {
-                        state.firstFreeBlock -= diff;
-                        if (state.firstFreeBlock != 0)
-                            state.firstFreeBlock -= vector->GetBlock(state.firstFreeBlock - 1)->m_pMetadata->IsEmpty();
-                    }
-                    else
-                        state.firstFreeBlock = 0;
-                }
-            }
-        }
-        }
+        UpdateFreedBlocks(vectorIndex, vector, prevCount, currentCount);
     }
     moveInfo.moveCount = 0;
     moveInfo.pMoves = VMA_NULL;
@@ -13313,13 +17430,13 @@ VkResult VmaDefragmentationContext_T::DefragmentPassEnd(VmaDefragmentationPassMo
                         {
                             if (vector->GetBlock(i) == block.block)
                             {
-                                VMA_SWAP(vector->m_Blocks[i], vector->m_Blocks[vector->GetBlockCount() - ++m_ImmovableBlockCount]);
+                                vector->SwapBlocks(i, vector->GetBlockCount() - ++m_ImmovableBlockCount);
                                 if (state.firstFreeBlock != SIZE_MAX)
                                 {
                                     if (i + 1 < state.firstFreeBlock)
                                     {
                                         if (state.firstFreeBlock > 1)
-                                            VMA_SWAP(vector->m_Blocks[i], vector->m_Blocks[--state.firstFreeBlock]);
+                                            vector->SwapBlocks(i, --state.firstFreeBlock);
                                         else
                                             --state.firstFreeBlock;
                                     }
@@ -13347,7 +17464,7 @@ VkResult VmaDefragmentationContext_T::DefragmentPassEnd(VmaDefragmentationPassMo
                 {
                     if (vector->GetBlock(i) == block.block)
                     {
-                        VMA_SWAP(vector->m_Blocks[i], vector->m_Blocks[m_ImmovableBlockCount++]);
+                        vector->SwapBlocks(i, m_ImmovableBlockCount++);
                         break;
                     }
                 }
@@ -13383,6 +17500,75 @@ bool VmaDefragmentationContext_T::ComputeDefragmentation(VmaBlockVector& vector,
     }
 }
 
+void VmaDefragmentationContext_T::FreeOldPlaces(size_t count, const VmaAllocation* pOldPlaces)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        const VmaAllocation oldPlace = pOldPlaces[i];
+        uint32_t vectorIndex;
+        VmaBlockVector* vector;
+        if (m_PoolBlockVector != VMA_NULL)
+        {
+            vectorIndex = 0;
+            vector = m_PoolBlockVector;
+        }
+        else
+        {
+            vectorIndex = oldPlace->GetMemoryTypeIndex();
+            vector = m_pBlockVectors[vectorIndex];
+            VMA_ASSERT(vector != VMA_NULL);
+        }
+
+        size_t prevCount, currentCount;
+        VkDeviceSize freedBlockSize;
+        // Scope for locks, Free have it's own lock
+        {
+            VmaMutexLockRead lock(vector->GetMutex(), vector->GetAllocator()->m_UseMutex);
+            prevCount = vector->GetBlockCount();
+            freedBlockSize = oldPlace->GetBlock()->m_pMetadata->GetSize();
+        }
+        vector->Free(oldPlace);
+        {
+            VmaMutexLockRead lock(vector->GetMutex(), vector->GetAllocator()->m_UseMutex);
+            currentCount = vector->GetBlockCount();
+        }
+
+        if (prevCount > currentCount)
+        {
+            m_GlobalStats.deviceMemoryBlocksFreed += static_cast<uint32_t>(prevCount - currentCount);
+            m_GlobalStats.bytesFreed += freedBlockSize;
+        }
+        UpdateFreedBlocks(vectorIndex, vector, prevCount, currentCount);
+    }
+}
+
+void VmaDefragmentationContext_T::UpdateFreedBlocks(uint32_t vectorIndex, VmaBlockVector* vector, size_t prevCount, size_t currentCount)
+{
+    switch (m_Algorithm)
+    {
+    case VMA_DEFRAGMENTATION_FLAG_ALGORITHM_EXTENSIVE_BIT:
+    {
+        if (m_AlgorithmState != VMA_NULL)
+        {
+            // Avoid unnecessary tries to allocate when new free block is available
+            StateExtensive& state = reinterpret_cast<StateExtensive*>(m_AlgorithmState)[vectorIndex];
+            if (state.firstFreeBlock != SIZE_MAX)
+            {
+                const size_t diff = prevCount - currentCount;
+                if (state.firstFreeBlock >= diff)
+                {
+                    state.firstFreeBlock -= diff;
+                    if (state.firstFreeBlock != 0)
+                        state.firstFreeBlock -= vector->GetBlock(state.firstFreeBlock - 1)->m_pMetadata->IsEmpty();
+                }
+                else
+                    state.firstFreeBlock = 0;
+            }
+        }
+    }
+    }
+}
+
 VmaDefragmentationContext_T::MoveAllocationData VmaDefragmentationContext_T::GetMoveData(
     VmaAllocHandle handle, VmaBlockMetadata* metadata)
 {
@@ -13437,7 +17623,7 @@ bool VmaDefragmentationContext_T::ReallocWithinBlock(VmaBlockVector& vector, Vma
     {
         MoveAllocationData moveData = GetMoveData(handle, metadata);
         // Ignore newly created allocations by defragmentation algorithm
-        if (moveData.move.srcAllocation->GetUserData() == this)
+        if (moveData.move.srcAllocation->GetUserData() == this || !moveData.move.srcAllocation->IsMovable())
             continue;
         switch (CheckCounters(moveData.move.srcAllocation->GetSize()))
         {
@@ -13513,12 +17699,146 @@ bool VmaDefragmentationContext_T::AllocInOtherBlock(size_t start, size_t end, Mo
 
 bool VmaDefragmentationContext_T::ComputeDefragmentation_Fast(VmaBlockVector& vector)
 {
-    // Move only between blocks
+    // Move only between blocks
+
+    // Go through allocations in last blocks and try to fit them inside first ones
+    for (size_t i = vector.GetBlockCount() - 1; i > m_ImmovableBlockCount; --i)
+    {
+        VmaBlockMetadata* metadata = vector.GetBlock(i)->m_pMetadata;
+
+        for (VmaAllocHandle handle = metadata->GetAllocationListBegin();
+            handle != VK_NULL_HANDLE;
+            handle = metadata->GetNextAllocation(handle))
+        {
+            MoveAllocationData moveData = GetMoveData(handle, metadata);
+            // Ignore newly created allocations by defragmentation algorithm
+            if (moveData.move.srcAllocation->GetUserData() == this || !moveData.move.srcAllocation->IsMovable())
+                continue;
+            switch (CheckCounters(moveData.move.srcAllocation->GetSize()))
+            {
+            case CounterStatus::Ignore:
+                continue;
+            case CounterStatus::End:
+                return true;
+            default:
+                VMA_ASSERT(0);
+            case CounterStatus::Pass:
+                break;
+            }
+
+            // Check all previous blocks for free space
+            if (AllocInOtherBlock(0, i, moveData, vector))
+                return true;
+        }
+    }
+    return false;
+}
+
+bool VmaDefragmentationContext_T::ComputeDefragmentation_Balanced(VmaBlockVector& vector, size_t index, bool update)
+{
+    // Go over every allocation and try to fit it in previous blocks at lowest offsets,
+    // if not possible: realloc within single block to minimize offset (exclude offset == 0),
+    // but only if there are noticeable gaps between them (some heuristic, ex. average size of allocation in block)
+    VMA_ASSERT(m_AlgorithmState != VMA_NULL);
+
+    StateBalanced& vectorState = reinterpret_cast<StateBalanced*>(m_AlgorithmState)[index];
+    if (update && vectorState.avgAllocSize == UINT64_MAX)
+        UpdateVectorStatistics(vector, vectorState);
+
+    const size_t startMoveCount = m_Moves.size();
+    VkDeviceSize minimalFreeRegion = vectorState.avgFreeSize / 2;
+    for (size_t i = vector.GetBlockCount() - 1; i > m_ImmovableBlockCount; --i)
+    {
+        VmaDeviceMemoryBlock* block = vector.GetBlock(i);
+        VmaBlockMetadata* metadata = block->m_pMetadata;
+        VkDeviceSize prevFreeRegionSize = 0;
+
+        for (VmaAllocHandle handle = metadata->GetAllocationListBegin();
+            handle != VK_NULL_HANDLE;
+            handle = metadata->GetNextAllocation(handle))
+        {
+            MoveAllocationData moveData = GetMoveData(handle, metadata);
+            // Ignore newly created allocations by defragmentation algorithm
+            if (moveData.move.srcAllocation->GetUserData() == this || !moveData.move.srcAllocation->IsMovable())
+                continue;
+            switch (CheckCounters(moveData.move.srcAllocation->GetSize()))
+            {
+            case CounterStatus::Ignore:
+                continue;
+            case CounterStatus::End:
+                return true;
+            default:
+                VMA_ASSERT(0);
+            case CounterStatus::Pass:
+                break;
+            }
+
+            // Check all previous blocks for free space
+            const size_t prevMoveCount = m_Moves.size();
+            if (AllocInOtherBlock(0, i, moveData, vector))
+                return true;
+
+            VkDeviceSize nextFreeRegionSize = metadata->GetNextFreeRegionSize(handle);
+            // If no room found then realloc within block for lower offset
+            VkDeviceSize offset = moveData.move.srcAllocation->GetOffset();
+            if (prevMoveCount == m_Moves.size() && offset != 0 && metadata->GetSumFreeSize() >= moveData.size)
+            {
+                // Check if realloc will make sense
+                if (prevFreeRegionSize >= minimalFreeRegion ||
+                    nextFreeRegionSize >= minimalFreeRegion ||
+                    moveData.size <= vectorState.avgFreeSize ||
+                    moveData.size <= vectorState.avgAllocSize)
+                {
+                    VmaAllocationRequest request = {};
+                    if (metadata->CreateAllocationRequest(
+                        moveData.size,
+                        moveData.alignment,
+                        false,
+                        moveData.type,
+                        VMA_ALLOCATION_CREATE_STRATEGY_MIN_OFFSET_BIT,
+                        &request))
+                    {
+                        if (metadata->GetAllocationOffset(request.allocHandle) < offset)
+                        {
+                            if (vector.CommitAllocationRequest(
+                                request,
+                                block,
+                                moveData.alignment,
+                                moveData.flags,
+                                this,
+                                moveData.type,
+                                &moveData.move.dstTmpAllocation) == VK_SUCCESS)
+                            {
+                                m_Moves.push_back(moveData.move);
+                                if (IncrementCounters(moveData.size))
+                                    return true;
+                            }
+                        }
+                    }
+                }
+            }
+            prevFreeRegionSize = nextFreeRegionSize;
+        }
+    }
+
+    // No moves performed, update statistics to current vector state
+    if (startMoveCount == m_Moves.size() && !update)
+    {
+        vectorState.avgAllocSize = UINT64_MAX;
+        return ComputeDefragmentation_Balanced(vector, index, false);
+    }
+    return false;
+}
+
+bool VmaDefragmentationContext_T::ComputeDefragmentation_Full(VmaBlockVector& vector)
+{
+    // Go over every allocation and try to fit it in previous blocks at lowest offsets,
+    // if not possible: realloc within single block to minimize offset (exclude offset == 0)
 
-    // Go through allocations in last blocks and try to fit them inside first ones
     for (size_t i = vector.GetBlockCount() - 1; i > m_ImmovableBlockCount; --i)
     {
-        VmaBlockMetadata* metadata = vector.GetBlock(i)->m_pMetadata;
+        VmaDeviceMemoryBlock* block = vector.GetBlock(i);
+        VmaBlockMetadata* metadata = block->m_pMetadata;
 
         for (VmaAllocHandle handle = metadata->GetAllocationListBegin();
             handle != VK_NULL_HANDLE;
@@ -13526,7 +17846,7 @@ bool VmaDefragmentationContext_T::ComputeDefragmentation_Fast(VmaBlockVector& ve
         {
             MoveAllocationData moveData = GetMoveData(handle, metadata);
             // Ignore newly created allocations by defragmentation algorithm
-            if (moveData.move.srcAllocation->GetUserData() == this)
+            if (moveData.move.srcAllocation->GetUserData() == this || !moveData.move.srcAllocation->IsMovable())
                 continue;
             switch (CheckCounters(moveData.move.srcAllocation->GetSize()))
             {
@@ -13541,39 +17861,85 @@ bool VmaDefragmentationContext_T::ComputeDefragmentation_Fast(VmaBlockVector& ve
             }
 
             // Check all previous blocks for free space
+            const size_t prevMoveCount = m_Moves.size();
             if (AllocInOtherBlock(0, i, moveData, vector))
                 return true;
+
+            // If no room found then realloc within block for lower offset
+            VkDeviceSize offset = moveData.move.srcAllocation->GetOffset();
+            if (prevMoveCount == m_Moves.size() && offset != 0 && metadata->GetSumFreeSize() >= moveData.size)
+            {
+                VmaAllocationRequest request = {};
+                if (metadata->CreateAllocationRequest(
+                    moveData.size,
+                    moveData.alignment,
+                    false,
+                    moveData.type,
+                    VMA_ALLOCATION_CREATE_STRATEGY_MIN_OFFSET_BIT,
+                    &request))
+                {
+                    if (metadata->GetAllocationOffset(request.allocHandle) < offset)
+                    {
+                        if (vector.CommitAllocationRequest(
+                            request,
+                            block,
+                            moveData.alignment,
+                            moveData.flags,
+                            this,
+                            moveData.type,
+                            &moveData.move.dstTmpAllocation) == VK_SUCCESS)
+                        {
+                            m_Moves.push_back(moveData.move);
+                            if (IncrementCounters(moveData.size))
+                                return true;
+                        }
+                    }
+                }
+            }
         }
     }
     return false;
 }
 
-bool VmaDefragmentationContext_T::ComputeDefragmentation_Balanced(VmaBlockVector& vector, size_t index, bool update)
+bool VmaDefragmentationContext_T::ComputeDefragmentation_Extensive(VmaBlockVector& vector, size_t index)
 {
-    // Go over every allocation and try to fit it in previous blocks at lowest offsets,
-    // if not possible: realloc within single block to minimize offset (exclude offset == 0),
-    // but only if there are noticeable gaps between them (some heuristic, ex. average size of allocation in block)
+    // First free single block, then populate it to the brim, then free another block, and so on
+
+    // Fallback to previous algorithm since without granularity conflicts it can achieve max packing
+    if (vector.m_BufferImageGranularity == 1)
+        return ComputeDefragmentation_Full(vector);
+
     VMA_ASSERT(m_AlgorithmState != VMA_NULL);
 
-    StateBalanced& vectorState = reinterpret_cast<StateBalanced*>(m_AlgorithmState)[index];
-    if (update && vectorState.avgAllocSize == UINT64_MAX)
-        UpdateVectorStatistics(vector, vectorState);
+    StateExtensive& vectorState = reinterpret_cast<StateExtensive*>(m_AlgorithmState)[index];
 
-    const size_t startMoveCount = m_Moves.size();
-    VkDeviceSize minimalFreeRegion = vectorState.avgFreeSize / 2;
-    for (size_t i = vector.GetBlockCount() - 1; i > m_ImmovableBlockCount; --i)
+    bool texturePresent = false, bufferPresent = false, otherPresent = false;
+    switch (vectorState.operation)
     {
-        VmaDeviceMemoryBlock* block = vector.GetBlock(i);
-        VmaBlockMetadata* metadata = block->m_pMetadata;
-        VkDeviceSize prevFreeRegionSize = 0;
+    case StateExtensive::Operation::Done: // Vector defragmented
+        return false;
+    case StateExtensive::Operation::FindFreeBlockBuffer:
+    case StateExtensive::Operation::FindFreeBlockTexture:
+    case StateExtensive::Operation::FindFreeBlockAll:
+    {
+        // No more blocks to free, just perform fast realloc and move to cleanup
+        if (vectorState.firstFreeBlock == 0)
+        {
+            vectorState.operation = StateExtensive::Operation::Cleanup;
+            return ComputeDefragmentation_Fast(vector);
+        }
 
-        for (VmaAllocHandle handle = metadata->GetAllocationListBegin();
+        // No free blocks, have to clear last one
+        size_t last = (vectorState.firstFreeBlock == SIZE_MAX ? vector.GetBlockCount() : vectorState.firstFreeBlock) - 1;
+        VmaBlockMetadata* freeMetadata = vector.GetBlock(last)->m_pMetadata;
+
+        const size_t prevMoveCount = m_Moves.size();
+        for (VmaAllocHandle handle = freeMetadata->GetAllocationListBegin();
             handle != VK_NULL_HANDLE;
-            handle = metadata->GetNextAllocation(handle))
+            handle = freeMetadata->GetNextAllocation(handle))
         {
-            MoveAllocationData moveData = GetMoveData(handle, metadata);
-            // Ignore newly created allocations by defragmentation algorithm
-            if (moveData.move.srcAllocation->GetUserData() == this)
+            MoveAllocationData moveData = GetMoveData(handle, freeMetadata);
+            if (!moveData.move.srcAllocation->IsMovable())
                 continue;
             switch (CheckCounters(moveData.move.srcAllocation->GetSize()))
             {
@@ -13588,70 +17954,169 @@ bool VmaDefragmentationContext_T::ComputeDefragmentation_Balanced(VmaBlockVector
             }
 
             // Check all previous blocks for free space
-            const size_t prevMoveCount = m_Moves.size();
-            if (AllocInOtherBlock(0, i, moveData, vector))
+            if (AllocInOtherBlock(0, last, moveData, vector))
+            {
+                // Full clear performed already
+                if (prevMoveCount != m_Moves.size() && freeMetadata->GetNextAllocation(handle) == VK_NULL_HANDLE)
+                    reinterpret_cast<size_t*>(m_AlgorithmState)[index] = last;
                 return true;
+            }
+        }
 
-            VkDeviceSize nextFreeRegionSize = metadata->GetNextFreeRegionSize(handle);
-            // If no room found then realloc within block for lower offset
-            VkDeviceSize offset = moveData.move.srcAllocation->GetOffset();
-            if (prevMoveCount == m_Moves.size() && offset != 0 && metadata->GetSumFreeSize() >= moveData.size)
+        if (prevMoveCount == m_Moves.size())
+        {
+            // Cannot perform full clear, have to move data in other blocks around
+            if (last != 0)
             {
-                // Check if realloc will make sense
-                if (prevFreeRegionSize >= minimalFreeRegion ||
-                    nextFreeRegionSize >= minimalFreeRegion ||
-                    moveData.size <= vectorState.avgFreeSize ||
-                    moveData.size <= vectorState.avgAllocSize)
+                for (size_t i = last - 1; i; --i)
                 {
-                    VmaAllocationRequest request = {};
-                    if (metadata->CreateAllocationRequest(
-                        moveData.size,
-                        moveData.alignment,
-                        false,
-                        moveData.type,
-                        VMA_ALLOCATION_CREATE_STRATEGY_MIN_OFFSET_BIT,
-                        &request))
-                    {
-                        if (metadata->GetAllocationOffset(request.allocHandle) < offset)
-                        {
-                            if (vector.CommitAllocationRequest(
-                                request,
-                                block,
-                                moveData.alignment,
-                                moveData.flags,
-                                this,
-                                moveData.type,
-                                &moveData.move.dstTmpAllocation) == VK_SUCCESS)
-                            {
-                                m_Moves.push_back(moveData.move);
-                                if (IncrementCounters(moveData.size))
-                                    return true;
-                            }
-                        }
-                    }
+                    if (ReallocWithinBlock(vector, vector.GetBlock(i)))
+                        return true;
                 }
             }
-            prevFreeRegionSize = nextFreeRegionSize;
+
+            if (prevMoveCount == m_Moves.size())
+            {
+                // No possible reallocs within blocks, try to move them around fast
+                return ComputeDefragmentation_Fast(vector);
+            }
+        }
+        else
+        {
+            switch (vectorState.operation)
+            {
+            case StateExtensive::Operation::FindFreeBlockBuffer:
+                vectorState.operation = StateExtensive::Operation::MoveBuffers;
+                break;
+            default:
+                VMA_ASSERT(0);
+            case StateExtensive::Operation::FindFreeBlockTexture:
+                vectorState.operation = StateExtensive::Operation::MoveTextures;
+                break;
+            case StateExtensive::Operation::FindFreeBlockAll:
+                vectorState.operation = StateExtensive::Operation::MoveAll;
+                break;
+            }
+            vectorState.firstFreeBlock = last;
+            // Nothing done, block found without reallocations, can perform another reallocs in same pass
+            return ComputeDefragmentation_Extensive(vector, index);
+        }
+        break;
+    }
+    case StateExtensive::Operation::MoveTextures:
+    {
+        if (MoveDataToFreeBlocks(VMA_SUBALLOCATION_TYPE_IMAGE_OPTIMAL, vector,
+            vectorState.firstFreeBlock, texturePresent, bufferPresent, otherPresent))
+        {
+            if (texturePresent)
+            {
+                vectorState.operation = StateExtensive::Operation::FindFreeBlockTexture;
+                return ComputeDefragmentation_Extensive(vector, index);
+            }
+
+            if (!bufferPresent && !otherPresent)
+            {
+                vectorState.operation = StateExtensive::Operation::Cleanup;
+                break;
+            }
+
+            // No more textures to move, check buffers
+            vectorState.operation = StateExtensive::Operation::MoveBuffers;
+            bufferPresent = false;
+            otherPresent = false;
+        }
+        else
+            break;
+    }
+    case StateExtensive::Operation::MoveBuffers:
+    {
+        if (MoveDataToFreeBlocks(VMA_SUBALLOCATION_TYPE_BUFFER, vector,
+            vectorState.firstFreeBlock, texturePresent, bufferPresent, otherPresent))
+        {
+            if (bufferPresent)
+            {
+                vectorState.operation = StateExtensive::Operation::FindFreeBlockBuffer;
+                return ComputeDefragmentation_Extensive(vector, index);
+            }
+
+            if (!otherPresent)
+            {
+                vectorState.operation = StateExtensive::Operation::Cleanup;
+                break;
+            }
+
+            // No more buffers to move, check all others
+            vectorState.operation = StateExtensive::Operation::MoveAll;
+            otherPresent = false;
+        }
+        else
+            break;
+    }
+    case StateExtensive::Operation::MoveAll:
+    {
+        if (MoveDataToFreeBlocks(VMA_SUBALLOCATION_TYPE_FREE, vector,
+            vectorState.firstFreeBlock, texturePresent, bufferPresent, otherPresent))
+        {
+            if (otherPresent)
+            {
+                vectorState.operation = StateExtensive::Operation::FindFreeBlockBuffer;
+                return ComputeDefragmentation_Extensive(vector, index);
+            }
+            // Everything moved
+            vectorState.operation = StateExtensive::Operation::Cleanup;
+        }
+        break;
+    }
+    case StateExtensive::Operation::Cleanup:
+        // Cleanup is handled below so that other operations may reuse the cleanup code. This case is here to prevent the unhandled enum value warning (C4062).
+        break;
+    }
+
+    if (vectorState.operation == StateExtensive::Operation::Cleanup)
+    {
+        // All other work done, pack data in blocks even tighter if possible
+        const size_t prevMoveCount = m_Moves.size();
+        for (size_t i = 0; i < vector.GetBlockCount(); ++i)
+        {
+            if (ReallocWithinBlock(vector, vector.GetBlock(i)))
+                return true;
         }
+
+        if (prevMoveCount == m_Moves.size())
+            vectorState.operation = StateExtensive::Operation::Done;
     }
+    return false;
+}
+
+void VmaDefragmentationContext_T::UpdateVectorStatistics(VmaBlockVector& vector, StateBalanced& state)
+{
+    size_t allocCount = 0;
+    size_t freeCount = 0;
+    state.avgFreeSize = 0;
+    state.avgAllocSize = 0;
 
-    // No moves performed, update statistics to current vector state
-    if (startMoveCount == m_Moves.size() && !update)
+    for (size_t i = 0; i < vector.GetBlockCount(); ++i)
     {
-        vectorState.avgAllocSize = UINT64_MAX;
-        return ComputeDefragmentation_Balanced(vector, index, false);
+        VmaBlockMetadata* metadata = vector.GetBlock(i)->m_pMetadata;
+
+        allocCount += metadata->GetAllocationCount();
+        freeCount += metadata->GetFreeRegionsCount();
+        state.avgFreeSize += metadata->GetSumFreeSize();
+        state.avgAllocSize += metadata->GetSize();
     }
-    return false;
+
+    state.avgAllocSize = (state.avgAllocSize - state.avgFreeSize) / allocCount;
+    state.avgFreeSize /= freeCount;
 }
 
-bool VmaDefragmentationContext_T::ComputeDefragmentation_Full(VmaBlockVector& vector)
+bool VmaDefragmentationContext_T::MoveDataToFreeBlocks(VmaSuballocationType currentType,
+    VmaBlockVector& vector, size_t firstFreeBlock,
+    bool& texturePresent, bool& bufferPresent, bool& otherPresent)
 {
-    // Go over every allocation and try to fit it in previous blocks at lowest offsets,
-    // if not possible: realloc within single block to minimize offset (exclude offset == 0)
-
-    for (size_t i = vector.GetBlockCount() - 1; i > m_ImmovableBlockCount; --i)
+    const size_t prevMoveCount = m_Moves.size();
+    for (size_t i = firstFreeBlock ; i;)
     {
-        VmaDeviceMemoryBlock* block = vector.GetBlock(i);
+        VmaDeviceMemoryBlock* block = vector.GetBlock(--i);
         VmaBlockMetadata* metadata = block->m_pMetadata;
 
         for (VmaAllocHandle handle = metadata->GetAllocationListBegin();
@@ -13660,7 +18125,7 @@ bool VmaDefragmentationContext_T::ComputeDefragmentation_Full(VmaBlockVector& ve
         {
             MoveAllocationData moveData = GetMoveData(handle, metadata);
             // Ignore newly created allocations by defragmentation algorithm
-            if (moveData.move.srcAllocation->GetUserData() == this)
+            if (moveData.move.srcAllocation->GetUserData() == this || !moveData.move.srcAllocation->IsMovable())
                 continue;
             switch (CheckCounters(moveData.move.srcAllocation->GetSize()))
             {
@@ -13674,302 +18139,1126 @@ bool VmaDefragmentationContext_T::ComputeDefragmentation_Full(VmaBlockVector& ve
                 break;
             }
 
-            // Check all previous blocks for free space
-            const size_t prevMoveCount = m_Moves.size();
-            if (AllocInOtherBlock(0, i, moveData, vector))
-                return true;
-
-            // If no room found then realloc within block for lower offset
-            VkDeviceSize offset = moveData.move.srcAllocation->GetOffset();
-            if (prevMoveCount == m_Moves.size() && offset != 0 && metadata->GetSumFreeSize() >= moveData.size)
+            // Move only single type of resources at once
+            if (!VmaIsBufferImageGranularityConflict(moveData.type, currentType))
             {
-                VmaAllocationRequest request = {};
-                if (metadata->CreateAllocationRequest(
-                    moveData.size,
-                    moveData.alignment,
-                    false,
-                    moveData.type,
-                    VMA_ALLOCATION_CREATE_STRATEGY_MIN_OFFSET_BIT,
-                    &request))
-                {
-                    if (metadata->GetAllocationOffset(request.allocHandle) < offset)
-                    {
-                        if (vector.CommitAllocationRequest(
-                            request,
-                            block,
-                            moveData.alignment,
-                            moveData.flags,
-                            this,
-                            moveData.type,
-                            &moveData.move.dstTmpAllocation) == VK_SUCCESS)
-                        {
-                            m_Moves.push_back(moveData.move);
-                            if (IncrementCounters(moveData.size))
-                                return true;
-                        }
-                    }
-                }
+                // Try to fit allocation into free blocks
+                if (AllocInOtherBlock(firstFreeBlock, vector.GetBlockCount(), moveData, vector))
+                    return false;
             }
+
+            if (!VmaIsBufferImageGranularityConflict(moveData.type, VMA_SUBALLOCATION_TYPE_IMAGE_OPTIMAL))
+                texturePresent = true;
+            else if (!VmaIsBufferImageGranularityConflict(moveData.type, VMA_SUBALLOCATION_TYPE_BUFFER))
+                bufferPresent = true;
+            else
+                otherPresent = true;
         }
     }
-    return false;
+    return prevMoveCount == m_Moves.size();
 }
+#endif // _VMA_DEFRAGMENTATION_CONTEXT_FUNCTIONS
 
-bool VmaDefragmentationContext_T::ComputeDefragmentation_Extensive(VmaBlockVector& vector, size_t index)
+#if VMA_TIMELINE_SEMAPHORE
+#ifndef _VMA_DEFRAGMENTATION_EXECUTOR_FUNCTIONS
+VmaDefragmentationExecutor_T::VmaDefragmentationExecutor_T(
+    VmaAllocator hAllocator,
+    const VmaDefragmentationExecutorCreateInfo& createInfo)
+    : m_hAllocator(hAllocator),
+    m_DefragmentationInfo(createInfo.defragmentationInfo),
+    m_Queue(createInfo.transferQueue),
+    m_QueueFamilyIndex(createInfo.transferQueueFamilyIndex),
+    m_MaxStepDuration(createInfo.maxStepDuration),
+    m_FrameInUseCount(createInfo.frameInUseCount),
+    m_pfnAllocationMoved(createInfo.pfnAllocationMoved),
+    m_pUserData(createInfo.pUserData),
+    m_BlockBuffers(VmaStlAllocator<BlockBuffer>(hAllocator->GetAllocationCallbacks())),
+    m_MovedAllocations(VmaStlAllocator<VmaAllocation>(hAllocator->GetAllocationCallbacks())),
+    m_PassOldPlaces(VmaStlAllocator<VmaAllocation>(hAllocator->GetAllocationCallbacks())),
+    m_OldPlaces(VmaStlAllocator<OldPlace>(hAllocator->GetAllocationCallbacks())) {}
+
+VmaDefragmentationExecutor_T::~VmaDefragmentationExecutor_T()
+{
+    VMA_ASSERT(!m_CopiesInFlight && !m_PassOpen && m_BlockBuffers.empty() && m_OldPlaces.empty());
+
+    const VmaVulkanFunctions& funcs = m_hAllocator->GetVulkanFunctions();
+    if (m_Context != VMA_NULL)
+        vma_delete(m_hAllocator, m_Context);
+    if (m_Semaphore != VK_NULL_HANDLE)
+        funcs.vkDestroySemaphore(m_hAllocator->m_hDevice, m_Semaphore, m_hAllocator->GetAllocationCallbacks());
+    // Command buffer is freed together with its pool.
+    if (m_CommandPool != VK_NULL_HANDLE)
+        funcs.vkDestroyCommandPool(m_hAllocator->m_hDevice, m_CommandPool, m_hAllocator->GetAllocationCallbacks());
+}
+
+VkResult VmaDefragmentationExecutor_T::Init()
+{
+    // On Vulkan 1.1, semaphore functions come from VK_KHR_timeline_semaphore and are null if it's not enabled.
+    const VmaVulkanFunctions& funcs = m_hAllocator->GetVulkanFunctions();
+    if (funcs.vkCreateCommandPool == VMA_NULL || funcs.vkDestroyCommandPool == VMA_NULL ||
+        funcs.vkAllocateCommandBuffers == VMA_NULL || funcs.vkResetCommandPool == VMA_NULL ||
+        funcs.vkBeginCommandBuffer == VMA_NULL || funcs.vkEndCommandBuffer == VMA_NULL ||
+        funcs.vkCmdCopyBuffer == VMA_NULL || funcs.vkQueueSubmit == VMA_NULL ||
+        funcs.vkCreateSemaphore == VMA_NULL || funcs.vkDestroySemaphore == VMA_NULL ||
+        funcs.vkGetSemaphoreCounterValue == VMA_NULL || funcs.vkWaitSemaphores == VMA_NULL ||
+        funcs.vkCreateBuffer == VMA_NULL || funcs.vkDestroyBuffer == VMA_NULL ||
+        funcs.vkGetBufferMemoryRequirements == VMA_NULL || funcs.vkBindBufferMemory == VMA_NULL)
+    {
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+    }
+
+    VkCommandPoolCreateInfo poolCreateInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+    poolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolCreateInfo.queueFamilyIndex = m_QueueFamilyIndex;
+    VkResult res = funcs.vkCreateCommandPool(m_hAllocator->m_hDevice, &poolCreateInfo,
+        m_hAllocator->GetAllocationCallbacks(), &m_CommandPool);
+    if (res != VK_SUCCESS)
+        return res;
+
+    VkCommandBufferAllocateInfo commandBufferInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+    commandBufferInfo.commandPool = m_CommandPool;
+    commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    commandBufferInfo.commandBufferCount = 1;
+    res = funcs.vkAllocateCommandBuffers(m_hAllocator->m_hDevice, &commandBufferInfo, &m_CommandBuffer);
+    if (res != VK_SUCCESS)
+        return res;
+
+    VkSemaphoreTypeCreateInfoKHR semaphoreTypeInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR };
+    semaphoreTypeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+    semaphoreTypeInfo.initialValue = 0;
+    VkSemaphoreCreateInfo semaphoreCreateInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+    semaphoreCreateInfo.pNext = &semaphoreTypeInfo;
+    res = funcs.vkCreateSemaphore(m_hAllocator->m_hDevice, &semaphoreCreateInfo,
+        m_hAllocator->GetAllocationCallbacks(), &m_Semaphore);
+    if (res != VK_SUCCESS)
+        return res;
+
+    VmaDefragmentationContext context = VMA_NULL;
+    res = vmaBeginDefragmentation(m_hAllocator, &m_DefragmentationInfo, &context);
+    m_Context = context;
+    return res;
+}
+
+VkResult VmaDefragmentationExecutor_T::Step()
 {
-    // First free single block, then populate it to the brim, then free another block, and so on
+    const uint64_t stepStartTime = VMA_TIME_NANOSECONDS();
 
-    // Fallback to previous algorithm since without granularity conflicts it can achieve max packing
-    if (vector.m_BufferImageGranularity == 1)
-        return ComputeDefragmentation_Full(vector);
+    if (m_CopiesInFlight)
+    {
+        uint64_t completedValue = 0;
+        VkResult res = m_hAllocator->GetVulkanFunctions().vkGetSemaphoreCounterValue(
+            m_hAllocator->m_hDevice, m_Semaphore, &completedValue);
+        if (res != VK_SUCCESS)
+            return res;
+        if (completedValue < m_SubmittedValue)
+            return VK_NOT_READY;
+        m_CopiesInFlight = false;
+    }
 
-    VMA_ASSERT(m_AlgorithmState != VMA_NULL);
+    FreeOldPlaces(false);
 
-    StateExtensive& vectorState = reinterpret_cast<StateExtensive*>(m_AlgorithmState)[index];
+    if (m_PassOpen)
+    {
+        if (m_NextMoveIndex < m_PassInfo.moveCount)
+            return SubmitCopies(stepStartTime);
+        EndPass();
 
-    bool texturePresent = false, bufferPresent = false, otherPresent = false;
-    switch (vectorState.operation)
+        // Committing the pass might have used up the budget, so next one starts in the following step.
+        if (!m_Done && m_MaxStepDuration != 0 && VMA_TIME_NANOSECONDS() - stepStartTime >= m_MaxStepDuration)
+            return VK_INCOMPLETE;
+    }
+
+    if (m_Done)
+        return m_OldPlaces.empty() ? VK_SUCCESS : VK_INCOMPLETE;
+    return BeginPass(stepStartTime);
+}
+
+void VmaDefragmentationExecutor_T::Finish(VmaDefragmentationStats* pStats)
+{
+    if (m_CopiesInFlight)
     {
-    case StateExtensive::Operation::Done: // Vector defragmented
-        return false;
-    case StateExtensive::Operation::FindFreeBlockBuffer:
-    case StateExtensive::Operation::FindFreeBlockTexture:
-    case StateExtensive::Operation::FindFreeBlockAll:
+        VkSemaphoreWaitInfoKHR waitInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR };
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &m_Semaphore;
+        waitInfo.pValues = &m_SubmittedValue;
+        VkResult res = m_hAllocator->GetVulkanFunctions().vkWaitSemaphores(m_hAllocator->m_hDevice, &waitInfo, UINT64_MAX);
+        VMA_ASSERT(res == VK_SUCCESS);
+        (void)res;
+        m_CopiesInFlight = false;
+    }
+    if (m_PassOpen)
     {
-        // No more blocks to free, just perform fast realloc and move to cleanup
-        if (vectorState.firstFreeBlock == 0)
+        for (uint32_t i = m_NextMoveIndex; i < m_PassInfo.moveCount; ++i)
+            m_PassInfo.pMoves[i].operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+        m_NextMoveIndex = m_PassInfo.moveCount;
+        EndPass();
+    }
+
+    if (m_Context != VMA_NULL)
+    {
+        FreeOldPlaces(true);
+        if (pStats != VMA_NULL)
+            m_Context->GetStats(*pStats);
+        vma_delete(m_hAllocator, m_Context);
+        m_Context = VMA_NULL;
+    }
+    else if (pStats != VMA_NULL)
+        *pStats = {};
+}
+
+VkResult VmaDefragmentationExecutor_T::BeginPass(uint64_t stepStartTime)
+{
+    VkResult res = m_Context->DefragmentPassBegin(m_PassInfo);
+    if (res == VK_SUCCESS)
+    {
+        m_Done = true;
+        return m_OldPlaces.empty() ? VK_SUCCESS : VK_INCOMPLETE;
+    }
+    m_PassOpen = true;
+    m_NextMoveIndex = 0;
+    return SubmitCopies(stepStartTime);
+}
+
+VkResult VmaDefragmentationExecutor_T::SubmitCopies(uint64_t stepStartTime)
+{
+    const VmaVulkanFunctions& funcs = m_hAllocator->GetVulkanFunctions();
+    VkResult res = funcs.vkResetCommandPool(m_hAllocator->m_hDevice, m_CommandPool, 0);
+    if (res == VK_SUCCESS)
+    {
+        VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        res = funcs.vkBeginCommandBuffer(m_CommandBuffer, &beginInfo);
+    }
+
+    const uint32_t firstMoveIndex = m_NextMoveIndex;
+    uint32_t copyCount = 0;
+    for (; res == VK_SUCCESS && m_NextMoveIndex < m_PassInfo.moveCount; ++m_NextMoveIndex)
+    {
+        // Remaining moves keep their reserved places and get copied in following steps.
+        // At least one is copied per step, so the pass always makes progress.
+        if (copyCount > 0 && m_MaxStepDuration != 0 && VMA_TIME_NANOSECONDS() - stepStartTime >= m_MaxStepDuration)
+            break;
+
+        // Layout of images with optimal tiling may depend on the image, so they cannot be copied as raw bytes.
+        VmaDefragmentationMove& move = m_PassInfo.pMoves[m_NextMoveIndex];
+        const VmaSuballocationType type = move.srcAllocation->GetSuballocationType();
+        VkBuffer srcBuffer = VK_NULL_HANDLE;
+        VkBuffer dstBuffer = VK_NULL_HANDLE;
+        if (type != VMA_SUBALLOCATION_TYPE_IMAGE_OPTIMAL && type != VMA_SUBALLOCATION_TYPE_IMAGE_UNKNOWN)
         {
-            vectorState.operation = StateExtensive::Operation::Cleanup;
-            return ComputeDefragmentation_Fast(vector);
+            srcBuffer = GetBlockBuffer(move.srcAllocation->GetBlock());
+            dstBuffer = GetBlockBuffer(move.dstTmpAllocation->GetBlock());
+        }
+        if (srcBuffer == VK_NULL_HANDLE || dstBuffer == VK_NULL_HANDLE)
+        {
+            move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+            continue;
         }
 
-        // No free blocks, have to clear last one
-        size_t last = (vectorState.firstFreeBlock == SIZE_MAX ? vector.GetBlockCount() : vectorState.firstFreeBlock) - 1;
-        VmaBlockMetadata* freeMetadata = vector.GetBlock(last)->m_pMetadata;
+        VkBufferCopy region = {};
+        region.srcOffset = move.srcAllocation->GetOffset();
+        region.dstOffset = move.dstTmpAllocation->GetOffset();
+        region.size = move.srcAllocation->GetSize();
+        funcs.vkCmdCopyBuffer(m_CommandBuffer, srcBuffer, dstBuffer, 1, &region);
+        ++copyCount;
+    }
+
+    if (res == VK_SUCCESS)
+        res = funcs.vkEndCommandBuffer(m_CommandBuffer);
+    if (res == VK_SUCCESS && copyCount > 0)
+    {
+        const uint64_t signalValue = m_SubmittedValue + 1;
+        VkTimelineSemaphoreSubmitInfoKHR timelineInfo = { VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR };
+        timelineInfo.signalSemaphoreValueCount = 1;
+        timelineInfo.pSignalSemaphoreValues = &signalValue;
+        VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+        submitInfo.pNext = &timelineInfo;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &m_CommandBuffer;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &m_Semaphore;
+        res = funcs.vkQueueSubmit(m_Queue, 1, &submitInfo, VK_NULL_HANDLE);
+        if (res == VK_SUCCESS)
+        {
+            m_SubmittedValue = signalValue;
+            m_CopiesInFlight = true;
+            return VK_INCOMPLETE;
+        }
+    }
 
-        const size_t prevMoveCount = m_Moves.size();
-        for (VmaAllocHandle handle = freeMetadata->GetAllocationListBegin();
-            handle != VK_NULL_HANDLE;
-            handle = freeMetadata->GetNextAllocation(handle))
+    if (res != VK_SUCCESS)
+    {
+        // Nothing of this step was submitted, so its moves and the remaining ones are abandoned.
+        // Moves copied in previous steps of the pass are still committed.
+        for (uint32_t i = firstMoveIndex; i < m_PassInfo.moveCount; ++i)
+            m_PassInfo.pMoves[i].operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+        m_NextMoveIndex = m_PassInfo.moveCount;
+    }
+    // All remaining moves are ignored or abandoned, so the pass can end right away.
+    VMA_ASSERT(m_NextMoveIndex == m_PassInfo.moveCount);
+    const VkResult endResult = EndPass();
+    if (res != VK_SUCCESS)
+        return res;
+    return endResult == VK_SUCCESS && !m_OldPlaces.empty() ? VK_INCOMPLETE : endResult;
+}
+
+VkResult VmaDefragmentationExecutor_T::EndPass()
+{
+    // Copies are finished. Temporary buffers must go before empty blocks get freed.
+    DestroyBlockBuffers();
+
+    m_MovedAllocations.clear();
+    for (uint32_t i = 0; i < m_PassInfo.moveCount; ++i)
+    {
+        if (m_PassInfo.pMoves[i].operation == VMA_DEFRAGMENTATION_MOVE_OPERATION_COPY)
+            m_MovedAllocations.push_back(m_PassInfo.pMoves[i].srcAllocation);
+    }
+
+    m_PassOldPlaces.clear();
+    const VkResult res = m_Context->DefragmentPassEnd(m_PassInfo, &m_PassOldPlaces);
+    m_PassOpen = false;
+    if (res == VK_SUCCESS)
+        m_Done = true;
+
+    if (m_pfnAllocationMoved != VMA_NULL)
+    {
+        for (size_t i = 0; i < m_MovedAllocations.size(); ++i)
+            m_pfnAllocationMoved(m_hAllocator, m_MovedAllocations[i], m_pUserData);
+    }
+
+    // Buffers recreated by the callback use new places from now on, while work submitted before may still use old ones.
+    const uint32_t frameIndex = m_hAllocator->GetCurrentFrameIndex();
+    for (size_t i = 0; i < m_PassOldPlaces.size(); ++i)
+        m_OldPlaces.push_back({ m_PassOldPlaces[i], frameIndex });
+    if (m_FrameInUseCount == 0)
+        FreeOldPlaces(true);
+    return m_Done ? VK_SUCCESS : VK_INCOMPLETE;
+}
+
+void VmaDefragmentationExecutor_T::FreeOldPlaces(bool freeAll)
+{
+    const uint32_t frameIndex = m_hAllocator->GetCurrentFrameIndex();
+    size_t freeCount = 0;
+    // Unsigned subtraction handles wraparound of the frame index.
+    while (freeCount < m_OldPlaces.size() &&
+        (freeAll || frameIndex - m_OldPlaces[freeCount].frameIndex >= m_FrameInUseCount))
+    {
+        ++freeCount;
+    }
+    if (freeCount == 0)
+        return;
+
+    m_PassOldPlaces.clear();
+    for (size_t i = 0; i < freeCount; ++i)
+        m_PassOldPlaces.push_back(m_OldPlaces[i].allocation);
+    m_Context->FreeOldPlaces(m_PassOldPlaces.size(), m_PassOldPlaces.data());
+    m_PassOldPlaces.clear();
+
+    for (size_t i = freeCount; i < m_OldPlaces.size(); ++i)
+        m_OldPlaces[i - freeCount] = m_OldPlaces[i];
+    m_OldPlaces.resize(m_OldPlaces.size() - freeCount);
+}
+
+VkBuffer VmaDefragmentationExecutor_T::GetBlockBuffer(VmaDeviceMemoryBlock* block)
+{
+    const VkDeviceMemory memory = block->GetDeviceMemory();
+    for (size_t i = 0; i < m_BlockBuffers.size(); ++i)
+    {
+        if (m_BlockBuffers[i].memory == memory)
+            return m_BlockBuffers[i].buffer;
+    }
+
+    const VmaVulkanFunctions& funcs = m_hAllocator->GetVulkanFunctions();
+    BlockBuffer blockBuffer = { memory, VK_NULL_HANDLE };
+    VkBufferCreateInfo bufferCreateInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    bufferCreateInfo.size = block->m_pMetadata->GetSize();
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VkBuffer buffer = VK_NULL_HANDLE;
+    if (funcs.vkCreateBuffer(m_hAllocator->m_hDevice, &bufferCreateInfo, m_hAllocator->GetAllocationCallbacks(), &buffer) == VK_SUCCESS)
+    {
+        VkMemoryRequirements memReq = {};
+        funcs.vkGetBufferMemoryRequirements(m_hAllocator->m_hDevice, buffer, &memReq);
+        VkResult res = VK_ERROR_FEATURE_NOT_PRESENT;
+        if ((memReq.memoryTypeBits & (1u << block->GetMemoryTypeIndex())) != 0 && memReq.size <= bufferCreateInfo.size)
         {
-            MoveAllocationData moveData = GetMoveData(handle, freeMetadata);
-            switch (CheckCounters(moveData.move.srcAllocation->GetSize()))
-            {
-            case CounterStatus::Ignore:
-                continue;
-            case CounterStatus::End:
-                return true;
-            default:
-                VMA_ASSERT(0);
-            case CounterStatus::Pass:
-                break;
-            }
+            VmaMutexLock lock(block->m_MapAndBindMutex, m_hAllocator->m_UseMutex);
+            res = m_hAllocator->BindVulkanBuffer(memory, 0, buffer, VMA_NULL);
+        }
+        if (res == VK_SUCCESS)
+            blockBuffer.buffer = buffer;
+        else
+            funcs.vkDestroyBuffer(m_hAllocator->m_hDevice, buffer, m_hAllocator->GetAllocationCallbacks());
+    }
+    m_BlockBuffers.push_back(blockBuffer);
+    return blockBuffer.buffer;
+}
 
-            // Check all previous blocks for free space
-            if (AllocInOtherBlock(0, last, moveData, vector))
-            {
-                // Full clear performed already
-                if (prevMoveCount != m_Moves.size() && freeMetadata->GetNextAllocation(handle) == VK_NULL_HANDLE)
-                    reinterpret_cast<size_t*>(m_AlgorithmState)[index] = last;
-                return true;
-            }
+void VmaDefragmentationExecutor_T::DestroyBlockBuffers()
+{
+    for (size_t i = 0; i < m_BlockBuffers.size(); ++i)
+    {
+        if (m_BlockBuffers[i].buffer != VK_NULL_HANDLE)
+        {
+            m_hAllocator->GetVulkanFunctions().vkDestroyBuffer(m_hAllocator->m_hDevice,
+                m_BlockBuffers[i].buffer, m_hAllocator->GetAllocationCallbacks());
         }
+    }
+    m_BlockBuffers.clear();
+}
+#endif // _VMA_DEFRAGMENTATION_EXECUTOR_FUNCTIONS
+#endif // #if VMA_TIMELINE_SEMAPHORE
 
-        if (prevMoveCount == m_Moves.size())
+#ifndef _VMA_RESIDENCY_MANAGER_FUNCTIONS
+VmaResidencyManager_T::VmaResidencyManager_T(
+    VmaAllocator hAllocator,
+    const VmaResidencyManagerCreateInfo& createInfo)
+    : m_hAllocator(hAllocator),
+    m_DemoteThreshold(createInfo.demoteThreshold),
+    m_PromoteThreshold(createInfo.promoteThreshold),
+    m_MinIdleFrameCount(createInfo.minIdleFrameCount),
+    m_MaxPassBytes(createInfo.maxBytesPerPass != 0 ? createInfo.maxBytesPerPass : VK_WHOLE_SIZE),
+    m_MaxPassAllocations(createInfo.maxAllocationsPerPass != 0 ? createInfo.maxAllocationsPerPass : UINT32_MAX),
+    m_Moves(VmaStlAllocator<VmaDefragmentationMove>(hAllocator->GetAllocationCallbacks())),
+    m_Candidates(VmaStlAllocator<Candidate>(hAllocator->GetAllocationCallbacks())),
+    m_StatsFrameIndex(hAllocator->GetCurrentFrameIndex()) {}
+
+VmaResidencyManager_T::~VmaResidencyManager_T()
+{
+    VMA_ASSERT(m_Moves.empty() && "Residency pass must be ended before destroying the manager.");
+}
+
+VkResult VmaResidencyManager_T::PassBegin(VmaDefragmentationPassMoveInfo& moveInfo)
+{
+    VMA_ASSERT(m_Moves.empty());
+    m_PassBytes = 0;
+
+    const uint32_t frameIndex = m_hAllocator->GetCurrentFrameIndex();
+    for (uint32_t heapIndex = 0; heapIndex < m_hAllocator->GetMemoryHeapCount(); ++heapIndex)
+    {
+        if (!IsHeapDeviceLocal(heapIndex))
+            continue;
+
+        VmaBudget budget = {};
+        m_hAllocator->GetHeapBudgets(&budget, heapIndex, 1);
+        const VkDeviceSize highUsage = static_cast<VkDeviceSize>(budget.budget * m_DemoteThreshold);
+        const VkDeviceSize lowUsage = static_cast<VkDeviceSize>(budget.budget * m_PromoteThreshold);
+        // Moves change allocation bytes right away, while usage drops only when whole blocks become free.
+        // Measuring progress in usage would demote more allocations every pass until that happens.
+        const VkDeviceSize allocationBytes = budget.statistics.allocationBytes;
+        if (budget.usage > highUsage)
         {
-            // Cannot perform full clear, have to move data in other blocks around
-            if (last != 0)
+            if (allocationBytes > lowUsage)
+                Demote(heapIndex, allocationBytes - lowUsage, frameIndex);
+        }
+        else if (allocationBytes < lowUsage)
+            Promote(heapIndex, lowUsage - allocationBytes, frameIndex);
+    }
+
+    moveInfo.moveCount = static_cast<uint32_t>(m_Moves.size());
+    if (moveInfo.moveCount > 0)
+    {
+        moveInfo.pMoves = m_Moves.data();
+        return VK_INCOMPLETE;
+    }
+    moveInfo.pMoves = VMA_NULL;
+    return VK_SUCCESS;
+}
+
+void VmaResidencyManager_T::PassEnd(VmaDefragmentationPassMoveInfo& moveInfo)
+{
+    VMA_ASSERT(moveInfo.moveCount > 0 ? moveInfo.pMoves != VMA_NULL : true);
+    UpdateFrameStats();
+
+    for (uint32_t i = 0; i < moveInfo.moveCount; ++i)
+    {
+        VmaDefragmentationMove& move = moveInfo.pMoves[i];
+        const uint32_t dstMemTypeIndex = move.dstTmpAllocation->GetMemoryTypeIndex();
+        switch (move.operation)
+        {
+        case VMA_DEFRAGMENTATION_MOVE_OPERATION_COPY:
+        {
+            const uint8_t mapCount = move.srcAllocation->SwapBlockAllocation(m_hAllocator, move.dstTmpAllocation);
+            if (mapCount > 0)
             {
-                for (size_t i = last - 1; i; --i)
-                {
-                    if (ReallocWithinBlock(vector, vector.GetBlock(i)))
-                        return true;
-                }
+                VkResult res = move.srcAllocation->GetBlock()->Map(m_hAllocator, mapCount, VMA_NULL);
+                VMA_ASSERT(res == VK_SUCCESS);
+                (void)res;
             }
+            // After the swap, temporary allocation holds the old place of the source.
+            m_hAllocator->m_pBlockVectors[move.dstTmpAllocation->GetMemoryTypeIndex()]->Free(move.dstTmpAllocation);
 
-            if (prevMoveCount == m_Moves.size())
+            const VkDeviceSize size = move.srcAllocation->GetSize();
+            if (IsHeapDeviceLocal(m_hAllocator->MemoryTypeIndexToHeapIndex(dstMemTypeIndex)))
             {
-                // No possible reallocs within blocks, try to move them around fast
-                return ComputeDefragmentation_Fast(vector);
+                ++m_FrameStats.allocationsPromoted;
+                m_FrameStats.bytesPromoted += size;
+                ++m_TotalStats.allocationsPromoted;
+                m_TotalStats.bytesPromoted += size;
             }
-        }
-        else
-        {
-            switch (vectorState.operation)
+            else
             {
-            case StateExtensive::Operation::FindFreeBlockBuffer:
-                vectorState.operation = StateExtensive::Operation::MoveBuffers;
-                break;
-            default:
-                VMA_ASSERT(0);
-            case StateExtensive::Operation::FindFreeBlockTexture:
-                vectorState.operation = StateExtensive::Operation::MoveTextures;
-                break;
-            case StateExtensive::Operation::FindFreeBlockAll:
-                vectorState.operation = StateExtensive::Operation::MoveAll;
-                break;
+                ++m_FrameStats.allocationsDemoted;
+                m_FrameStats.bytesDemoted += size;
+                ++m_TotalStats.allocationsDemoted;
+                m_TotalStats.bytesDemoted += size;
             }
-            vectorState.firstFreeBlock = last;
-            // Nothing done, block found without reallocations, can perform another reallocs in same pass
-            return ComputeDefragmentation_Extensive(vector, index);
+            break;
+        }
+        case VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE:
+            m_hAllocator->m_pBlockVectors[dstMemTypeIndex]->Free(move.dstTmpAllocation);
+            break;
+        case VMA_DEFRAGMENTATION_MOVE_OPERATION_DESTROY:
+            m_hAllocator->m_pBlockVectors[dstMemTypeIndex]->Free(move.dstTmpAllocation);
+            m_hAllocator->FreeMemory(1, &move.srcAllocation);
+            break;
+        default:
+            VMA_ASSERT(0);
         }
-        break;
     }
-    case StateExtensive::Operation::MoveTextures:
+
+    moveInfo.moveCount = 0;
+    moveInfo.pMoves = VMA_NULL;
+    m_Moves.clear();
+}
+
+void VmaResidencyManager_T::GetStats(VmaResidencyStats* pFrameStats, VmaResidencyStats* pTotalStats)
+{
+    UpdateFrameStats();
+    if (pFrameStats != VMA_NULL)
+        *pFrameStats = m_FrameStats;
+    if (pTotalStats != VMA_NULL)
+        *pTotalStats = m_TotalStats;
+}
+
+bool VmaResidencyManager_T::IsHeapDeviceLocal(uint32_t heapIndex) const
+{
+    return (m_hAllocator->m_MemProps.memoryHeaps[heapIndex].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+}
+
+bool VmaResidencyManager_T::IsPassFull(VkDeviceSize size) const
+{
+    return m_Moves.size() >= m_MaxPassAllocations ||
+        (!m_Moves.empty() && m_PassBytes + size > m_MaxPassBytes);
+}
+
+void VmaResidencyManager_T::CollectCandidates(uint32_t memTypeBits, uint32_t frameIndex, bool idle)
+{
+    m_Candidates.clear();
+    for (uint32_t memTypeIndex = 0; memTypeIndex < m_hAllocator->GetMemoryTypeCount(); ++memTypeIndex)
     {
-        if (MoveDataToFreeBlocks(VMA_SUBALLOCATION_TYPE_IMAGE_OPTIMAL, vector,
-            vectorState.firstFreeBlock, texturePresent, bufferPresent, otherPresent))
+        VmaBlockVector* const vector = m_hAllocator->m_pBlockVectors[memTypeIndex];
+        if ((memTypeBits & (1u << memTypeIndex)) == 0 || vector == VMA_NULL)
+            continue;
+
+        VmaMutexLockRead lock(vector->GetMutex(), m_hAllocator->m_UseMutex);
+        for (size_t blockIndex = 0; blockIndex < vector->GetBlockCount(); ++blockIndex)
         {
-            if (texturePresent)
+            VmaDeviceMemoryBlock* const block = vector->GetBlock(blockIndex);
+            VmaMutexLock blockLock(block->GetMetadataMutex(), m_hAllocator->m_UseMutex);
+            VmaBlockMetadata* const metadata = block->m_pMetadata;
+            for (VmaAllocHandle handle = metadata->GetAllocationListBegin();
+                handle != VK_NULL_HANDLE;
+                handle = metadata->GetNextAllocation(handle))
             {
-                vectorState.operation = StateExtensive::Operation::FindFreeBlockTexture;
-                return ComputeDefragmentation_Extensive(vector, index);
+                VmaAllocation allocation = reinterpret_cast<VmaAllocation>(metadata->GetAllocationUserData(handle));
+                if (!allocation->CanBeDemoted() || allocation->IsPersistentMap())
+                    continue;
+
+                // Unsigned difference stays correct when the frame index wraps around.
+                const uint32_t lastUseFrameIndex = allocation->GetLastUseFrameIndex();
+                if ((frameIndex - lastUseFrameIndex >= m_MinIdleFrameCount) == idle)
+                    m_Candidates.push_back({ allocation, lastUseFrameIndex });
             }
+        }
+    }
+}
 
-            if (!bufferPresent && !otherPresent)
-            {
-                vectorState.operation = StateExtensive::Operation::Cleanup;
-                break;
-            }
+void VmaResidencyManager_T::GetMemoryTypeBits(uint32_t heapIndex, uint32_t& outHeapMemTypeBits, uint32_t& outOtherMemTypeBits) const
+{
+    outHeapMemTypeBits = 0;
+    outOtherMemTypeBits = 0;
+    for (uint32_t memTypeIndex = 0; memTypeIndex < m_hAllocator->GetMemoryTypeCount(); ++memTypeIndex)
+    {
+        const uint32_t memTypeHeapIndex = m_hAllocator->MemoryTypeIndexToHeapIndex(memTypeIndex);
+        if (memTypeHeapIndex == heapIndex)
+            outHeapMemTypeBits |= 1u << memTypeIndex;
+        else if (!IsHeapDeviceLocal(memTypeHeapIndex))
+            outOtherMemTypeBits |= 1u << memTypeIndex;
+    }
+}
 
-            // No more textures to move, check buffers
-            vectorState.operation = StateExtensive::Operation::MoveBuffers;
-            bufferPresent = false;
-            otherPresent = false;
-        }
-        else
+void VmaResidencyManager_T::Demote(uint32_t heapIndex, VkDeviceSize bytesToFree, uint32_t frameIndex)
+{
+    uint32_t heapMemTypeBits, otherMemTypeBits;
+    GetMemoryTypeBits(heapIndex, heapMemTypeBits, otherMemTypeBits);
+
+    CollectCandidates(heapMemTypeBits, frameIndex, true);
+    // Least recently used first.
+    VMA_SORT(m_Candidates.begin(), m_Candidates.end(), [frameIndex](const Candidate& lhs, const Candidate& rhs)
+        {
+            return frameIndex - lhs.lastUseFrameIndex > frameIndex - rhs.lastUseFrameIndex;
+        });
+
+    VkDeviceSize bytesFreed = 0;
+    for (size_t i = 0; i < m_Candidates.size() && bytesFreed < bytesToFree; ++i)
+    {
+        VmaAllocation allocation = m_Candidates[i].allocation;
+        if (IsPassFull(allocation->GetSize()))
             break;
+
+        const uint32_t dstMemTypeBits = allocation->GetResidencyMemoryTypeBits() & otherMemTypeBits;
+        if (dstMemTypeBits != 0 && AddMove(allocation, VMA_BITSCAN_LSB(dstMemTypeBits)))
+            bytesFreed += allocation->GetSize();
     }
-    case StateExtensive::Operation::MoveBuffers:
-    {
-        if (MoveDataToFreeBlocks(VMA_SUBALLOCATION_TYPE_BUFFER, vector,
-            vectorState.firstFreeBlock, texturePresent, bufferPresent, otherPresent))
+}
+
+void VmaResidencyManager_T::Promote(uint32_t heapIndex, VkDeviceSize bytesToAdd, uint32_t frameIndex)
+{
+    uint32_t heapMemTypeBits, otherMemTypeBits;
+    GetMemoryTypeBits(heapIndex, heapMemTypeBits, otherMemTypeBits);
+
+    CollectCandidates(otherMemTypeBits, frameIndex, false);
+    // Most recently used first.
+    VMA_SORT(m_Candidates.begin(), m_Candidates.end(), [frameIndex](const Candidate& lhs, const Candidate& rhs)
         {
-            if (bufferPresent)
-            {
-                vectorState.operation = StateExtensive::Operation::FindFreeBlockBuffer;
-                return ComputeDefragmentation_Extensive(vector, index);
-            }
+            return frameIndex - lhs.lastUseFrameIndex < frameIndex - rhs.lastUseFrameIndex;
+        });
 
-            if (!otherPresent)
-            {
-                vectorState.operation = StateExtensive::Operation::Cleanup;
-                break;
-            }
+    VkDeviceSize bytesAdded = 0;
+    for (size_t i = 0; i < m_Candidates.size(); ++i)
+    {
+        VmaAllocation allocation = m_Candidates[i].allocation;
+        const VkDeviceSize size = allocation->GetSize();
+        if (bytesAdded + size > bytesToAdd || IsPassFull(size))
+            break;
 
-            // No more buffers to move, check all others
-            vectorState.operation = StateExtensive::Operation::MoveAll;
-            otherPresent = false;
+        const uint32_t dstMemTypeBits = allocation->GetResidencyMemoryTypeBits() & heapMemTypeBits;
+        if (dstMemTypeBits == 0 || !AddMove(allocation, VMA_BITSCAN_LSB(dstMemTypeBits)))
+            continue;
+        bytesAdded += size;
+
+        // New block might have been created for the destination, so stop before crossing the demote threshold.
+        VmaBudget budget = {};
+        m_hAllocator->GetHeapBudgets(&budget, heapIndex, 1);
+        if (budget.usage > static_cast<VkDeviceSize>(budget.budget * m_DemoteThreshold))
+        {
+            m_hAllocator->m_pBlockVectors[m_Moves.back().dstTmpAllocation->GetMemoryTypeIndex()]->Free(m_Moves.back().dstTmpAllocation);
+            m_PassBytes -= size;
+            m_Moves.pop_back();
+            break;
         }
+    }
+}
+
+bool VmaResidencyManager_T::AddMove(VmaAllocation allocation, uint32_t dstMemTypeIndex)
+{
+    VmaBlockVector* const dstVector = m_hAllocator->m_pBlockVectors[dstMemTypeIndex];
+    VMA_ASSERT(dstVector != VMA_NULL);
+
+    VmaAllocationCreateInfo createInfo = {};
+    createInfo.flags = VMA_ALLOCATION_CREATE_WITHIN_BUDGET_BIT;
+    VmaDefragmentationMove move = {};
+    move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_COPY;
+    move.srcAllocation = allocation;
+    if (dstVector->Allocate(allocation->GetSize(), allocation->GetAlignment(), createInfo,
+        allocation->GetSuballocationType(), 1, &move.dstTmpAllocation) != VK_SUCCESS)
+    {
+        return false;
+    }
+    m_Moves.push_back(move);
+    m_PassBytes += allocation->GetSize();
+    return true;
+}
+
+void VmaResidencyManager_T::UpdateFrameStats()
+{
+    const uint32_t frameIndex = m_hAllocator->GetCurrentFrameIndex();
+    if (frameIndex != m_StatsFrameIndex)
+    {
+        m_StatsFrameIndex = frameIndex;
+        m_FrameStats = {};
+    }
+}
+#endif // _VMA_RESIDENCY_MANAGER_FUNCTIONS
+
+#ifndef _VMA_SPARSE_RESOURCE_FUNCTIONS
+VmaSparseResource_T::VmaSparseResource_T(
+    VmaAllocator hAllocator,
+    VkBuffer buffer,
+    VkImage image,
+    const VkMemoryRequirements& memReq,
+    VkFlags bufferImageUsage,
+    const VmaAllocationCreateInfo& createInfo,
+    VmaSuballocationType suballocType)
+    : m_hAllocator(hAllocator),
+    m_Buffer(buffer),
+    m_Image(image),
+    m_Size(memReq.size),
+    m_PageSize(memReq.alignment),
+    m_MemoryTypeBits(memReq.memoryTypeBits),
+    m_BufferImageUsage(bufferImageUsage),
+    m_CreateInfo(createInfo),
+    m_SuballocType(suballocType),
+    m_ImageExtent(),
+    m_ImageArrayLayers(0),
+    m_Pages(VmaStlAllocator<Page>(hAllocator->GetAllocationCallbacks())),
+    m_DirtyPages(VmaStlAllocator<VkDeviceSize>(hAllocator->GetAllocationCallbacks())),
+    m_ImageRequirements(VmaStlAllocator<VkSparseImageMemoryRequirements>(hAllocator->GetAllocationCallbacks())),
+    m_Tiles(VmaStlAllocator<Tile>(hAllocator->GetAllocationCallbacks())),
+    m_DirtyTiles(VmaStlAllocator<Tile>(hAllocator->GetAllocationCallbacks())),
+    m_PendingFree(VmaStlAllocator<VmaAllocation>(hAllocator->GetAllocationCallbacks())),
+    m_Unbound(VmaStlAllocator<VmaAllocation>(hAllocator->GetAllocationCallbacks())) {}
+
+VmaSparseResource_T::~VmaSparseResource_T()
+{
+    // The buffer or image is already destroyed, so no binding refers to the pages anymore.
+    for (size_t i = 0; i < m_Pages.size(); ++i)
+        m_hAllocator->FreeMemory(1, &m_Pages[i].allocation);
+    for (size_t i = 0; i < m_Tiles.size(); ++i)
+        m_hAllocator->FreeMemory(1, &m_Tiles[i].allocation);
+    if (!m_PendingFree.empty())
+        m_hAllocator->FreeMemory(m_PendingFree.size(), m_PendingFree.data());
+    FreeUnboundPages();
+}
+
+void VmaSparseResource_T::GetInfo(VmaSparseResourceInfo& outInfo) const
+{
+    outInfo.pageSize = m_PageSize;
+    outInfo.pageCount = GetPageCount();
+    outInfo.committedPageCount = m_Pages.size();
+    outInfo.committedTileCount = m_Tiles.size();
+    outInfo.pendingPageCount = m_DirtyPages.size() + m_DirtyTiles.size();
+    outInfo.unboundPageCount = m_Unbound.size();
+}
+
+void VmaSparseResource_T::InitImageTiles(
+    const VkImageCreateInfo& createInfo,
+    uint32_t requirementCount,
+    const VkSparseImageMemoryRequirements* pRequirements)
+{
+    m_ImageExtent = createInfo.extent;
+    m_ImageArrayLayers = createInfo.arrayLayers;
+    for (uint32_t i = 0; i < requirementCount; ++i)
+    {
+        // Metadata has no tiles, it is bound as opaque pages.
+        if ((pRequirements[i].formatProperties.aspectMask & VK_IMAGE_ASPECT_METADATA_BIT) == 0)
+            m_ImageRequirements.push_back(pRequirements[i]);
+    }
+}
+
+VkResult VmaSparseResource_T::Commit(VkDeviceSize firstPage, VkDeviceSize pageCount)
+{
+    VMA_ASSERT(firstPage + pageCount <= GetPageCount());
+
+    const size_t oldPageCount = m_Pages.size();
+    VmaVector<VkDeviceSize, VmaStlAllocator<VkDeviceSize>> newIndices(
+        VmaStlAllocator<VkDeviceSize>(m_hAllocator->GetAllocationCallbacks()));
+    size_t pageIndex = VmaBinaryFindFirstNotLess(m_Pages.begin(), m_Pages.end(), firstPage, PageLess()) - m_Pages.begin();
+    for (VkDeviceSize index = firstPage; index < firstPage + pageCount; ++index)
+    {
+        if (pageIndex < oldPageCount && m_Pages[pageIndex].index == index)
+            ++pageIndex;
         else
-            break;
+            newIndices.push_back(index);
     }
-    case StateExtensive::Operation::MoveAll:
+    const size_t newPageCount = newIndices.size();
+    if (newPageCount == 0)
+        return VK_SUCCESS;
+
+    VmaVector<VmaAllocation, VmaStlAllocator<VmaAllocation>> allocations(
+        newPageCount, VmaStlAllocator<VmaAllocation>(m_hAllocator->GetAllocationCallbacks()));
+    const VkResult res = AllocatePages(newPageCount, allocations.data());
+    if (res != VK_SUCCESS)
+        return res;
+
+    // Both runs are sorted, so merge new pages in from the back.
+    m_Pages.resize(oldPageCount + newPageCount);
+    size_t dstIndex = m_Pages.size();
+    size_t oldIndex = oldPageCount;
+    for (size_t i = newPageCount; i--; )
     {
-        if (MoveDataToFreeBlocks(VMA_SUBALLOCATION_TYPE_FREE, vector,
-            vectorState.firstFreeBlock, texturePresent, bufferPresent, otherPresent))
+        while (oldIndex > 0 && m_Pages[oldIndex - 1].index > newIndices[i])
+            m_Pages[--dstIndex] = m_Pages[--oldIndex];
+        m_Pages[--dstIndex] = { newIndices[i], allocations[i] };
+        m_DirtyPages.push_back(newIndices[i]);
+    }
+    return VK_SUCCESS;
+}
+
+void VmaSparseResource_T::Decommit(VkDeviceSize firstPage, VkDeviceSize pageCount)
+{
+    VMA_ASSERT(firstPage + pageCount <= GetPageCount());
+
+    const size_t beginIndex = VmaBinaryFindFirstNotLess(m_Pages.begin(), m_Pages.end(), firstPage, PageLess()) - m_Pages.begin();
+    size_t endIndex = beginIndex;
+    for (; endIndex < m_Pages.size() && m_Pages[endIndex].index < firstPage + pageCount; ++endIndex)
+    {
+        m_PendingFree.push_back(m_Pages[endIndex].allocation);
+        m_DirtyPages.push_back(m_Pages[endIndex].index);
+    }
+
+    const size_t removedCount = endIndex - beginIndex;
+    if (removedCount > 0)
+    {
+        for (size_t i = endIndex; i < m_Pages.size(); ++i)
+            m_Pages[i - removedCount] = m_Pages[i];
+        m_Pages.resize(m_Pages.size() - removedCount);
+    }
+}
+
+VkResult VmaSparseResource_T::CommitRegion(const VmaSparseImageRegion& region)
+{
+    Tile begin, end;
+    GetRegionTiles(region, begin, end);
+
+    VmaVector<Tile, VmaStlAllocator<Tile>> newTiles(VmaStlAllocator<Tile>(m_hAllocator->GetAllocationCallbacks()));
+    Tile tile = begin;
+    for (tile.z = begin.z; tile.z < end.z; ++tile.z)
+    {
+        for (tile.y = begin.y; tile.y < end.y; ++tile.y)
         {
-            if (otherPresent)
+            for (tile.x = begin.x; tile.x < end.x; ++tile.x)
             {
-                vectorState.operation = StateExtensive::Operation::FindFreeBlockBuffer;
-                return ComputeDefragmentation_Extensive(vector, index);
+                if (VmaBinaryFindSorted(m_Tiles.begin(), m_Tiles.end(), tile, TileLess()) == m_Tiles.end())
+                    newTiles.push_back(tile);
             }
-            // Everything moved
-            vectorState.operation = StateExtensive::Operation::Cleanup;
         }
-        break;
     }
-    case StateExtensive::Operation::Cleanup:
-        // Cleanup is handled below so that other operations may reuse the cleanup code. This case is here to prevent the unhandled enum value warning (C4062).
-        break;
+    const size_t newTileCount = newTiles.size();
+    if (newTileCount == 0)
+        return VK_SUCCESS;
+
+    VmaVector<VmaAllocation, VmaStlAllocator<VmaAllocation>> allocations(
+        newTileCount, VmaStlAllocator<VmaAllocation>(m_hAllocator->GetAllocationCallbacks()));
+    const VkResult res = AllocatePages(newTileCount, allocations.data());
+    if (res != VK_SUCCESS)
+        return res;
+
+    for (size_t i = 0; i < newTileCount; ++i)
+    {
+        newTiles[i].allocation = allocations[i];
+        m_Tiles.push_back(newTiles[i]);
+        m_DirtyTiles.push_back(newTiles[i]);
     }
+    VMA_SORT(m_Tiles.begin(), m_Tiles.end(), TileLess());
+    return VK_SUCCESS;
+}
 
-    if (vectorState.operation == StateExtensive::Operation::Cleanup)
+void VmaSparseResource_T::DecommitRegion(const VmaSparseImageRegion& region)
+{
+    Tile begin, end;
+    GetRegionTiles(region, begin, end);
+
+    size_t keptCount = 0;
+    for (size_t i = 0; i < m_Tiles.size(); ++i)
     {
-        // All other work done, pack data in blocks even tighter if possible
-        const size_t prevMoveCount = m_Moves.size();
-        for (size_t i = 0; i < vector.GetBlockCount(); ++i)
+        const Tile& tile = m_Tiles[i];
+        if (tile.aspectMask == begin.aspectMask && tile.mipLevel == begin.mipLevel && tile.arrayLayer == begin.arrayLayer &&
+            tile.x >= begin.x && tile.x < end.x && tile.y >= begin.y && tile.y < end.y && tile.z >= begin.z && tile.z < end.z)
         {
-            if (ReallocWithinBlock(vector, vector.GetBlock(i)))
-                return true;
+            m_PendingFree.push_back(tile.allocation);
+            m_DirtyTiles.push_back(tile);
         }
-
-        if (prevMoveCount == m_Moves.size())
-            vectorState.operation = StateExtensive::Operation::Done;
+        else
+            m_Tiles[keptCount++] = tile;
     }
-    return false;
+    m_Tiles.resize(keptCount);
 }
 
-void VmaDefragmentationContext_T::UpdateVectorStatistics(VmaBlockVector& vector, StateBalanced& state)
+void VmaSparseResource_T::FreeUnboundPages()
 {
-    size_t allocCount = 0;
-    size_t freeCount = 0;
-    state.avgFreeSize = 0;
-    state.avgAllocSize = 0;
+    if (!m_Unbound.empty())
+    {
+        m_hAllocator->FreeMemory(m_Unbound.size(), m_Unbound.data());
+        m_Unbound.clear();
+    }
+}
 
-    for (size_t i = 0; i < vector.GetBlockCount(); ++i)
+VkResult VmaSparseResource_T::Bind(
+    VmaAllocator hAllocator,
+    VkQueue queue,
+    uint32_t resourceCount,
+    const VmaSparseResource* pResources,
+    const VmaSparseBindSubmitInfo* pSubmitInfo)
+{
+    const VkAllocationCallbacks* const allocs = hAllocator->GetAllocationCallbacks();
+    VmaVector<VkSparseMemoryBind, VmaStlAllocator<VkSparseMemoryBind>> binds(VmaStlAllocator<VkSparseMemoryBind>{ allocs });
+    VmaVector<VkSparseImageMemoryBind, VmaStlAllocator<VkSparseImageMemoryBind>> tileBinds(
+        VmaStlAllocator<VkSparseImageMemoryBind>{ allocs });
+    // Offset of the first bind of every resource in `binds` and `tileBinds`, and the end at the last position.
+    VmaVector<size_t, VmaStlAllocator<size_t>> bindOffsets(VmaStlAllocator<size_t>{ allocs });
+    VmaVector<size_t, VmaStlAllocator<size_t>> tileBindOffsets(VmaStlAllocator<size_t>{ allocs });
+    for (uint32_t i = 0; i < resourceCount; ++i)
+    {
+        bindOffsets.push_back(binds.size());
+        tileBindOffsets.push_back(tileBinds.size());
+        pResources[i]->AppendBinds(binds);
+        pResources[i]->AppendImageBinds(tileBinds);
+    }
+    bindOffsets.push_back(binds.size());
+    tileBindOffsets.push_back(tileBinds.size());
+
+    const bool hasSync = pSubmitInfo != VMA_NULL &&
+        (pSubmitInfo->waitSemaphoreCount > 0 || pSubmitInfo->signalSemaphoreCount > 0 || pSubmitInfo->fence != VK_NULL_HANDLE);
+    // Decommitted pages and tiles are always dirty, so there is nothing to retire either.
+    if (binds.empty() && tileBinds.empty() && !hasSync)
+        return VK_SUCCESS;
+
+    // Pointers into `binds` are taken only now, when it doesn't grow anymore.
+    VmaVector<VkSparseBufferMemoryBindInfo, VmaStlAllocator<VkSparseBufferMemoryBindInfo>> bufferBinds(
+        VmaStlAllocator<VkSparseBufferMemoryBindInfo>{ allocs });
+    VmaVector<VkSparseImageOpaqueMemoryBindInfo, VmaStlAllocator<VkSparseImageOpaqueMemoryBindInfo>> imageBinds(
+        VmaStlAllocator<VkSparseImageOpaqueMemoryBindInfo>{ allocs });
+    VmaVector<VkSparseImageMemoryBindInfo, VmaStlAllocator<VkSparseImageMemoryBindInfo>> imageTileBinds(
+        VmaStlAllocator<VkSparseImageMemoryBindInfo>{ allocs });
+    for (uint32_t i = 0; i < resourceCount; ++i)
     {
-        VmaBlockMetadata* metadata = vector.GetBlock(i)->m_pMetadata;
+        const uint32_t bindCount = static_cast<uint32_t>(bindOffsets[i + 1] - bindOffsets[i]);
+        if (bindCount > 0)
+        {
+            if (pResources[i]->m_Buffer != VK_NULL_HANDLE)
+                bufferBinds.push_back({ pResources[i]->m_Buffer, bindCount, binds.data() + bindOffsets[i] });
+            else
+                imageBinds.push_back({ pResources[i]->m_Image, bindCount, binds.data() + bindOffsets[i] });
+        }
+        const uint32_t tileBindCount = static_cast<uint32_t>(tileBindOffsets[i + 1] - tileBindOffsets[i]);
+        if (tileBindCount > 0)
+            imageTileBinds.push_back({ pResources[i]->m_Image, tileBindCount, tileBinds.data() + tileBindOffsets[i] });
+    }
+
+    VkBindSparseInfo bindInfo = { VK_STRUCTURE_TYPE_BIND_SPARSE_INFO };
+    bindInfo.bufferBindCount = static_cast<uint32_t>(bufferBinds.size());
+    bindInfo.pBufferBinds = bufferBinds.data();
+    bindInfo.imageOpaqueBindCount = static_cast<uint32_t>(imageBinds.size());
+    bindInfo.pImageOpaqueBinds = imageBinds.data();
+    bindInfo.imageBindCount = static_cast<uint32_t>(imageTileBinds.size());
+    bindInfo.pImageBinds = imageTileBinds.data();
+    VkFence fence = VK_NULL_HANDLE;
+    if (pSubmitInfo != VMA_NULL)
+    {
+        bindInfo.waitSemaphoreCount = pSubmitInfo->waitSemaphoreCount;
+        bindInfo.pWaitSemaphores = pSubmitInfo->pWaitSemaphores;
+        bindInfo.signalSemaphoreCount = pSubmitInfo->signalSemaphoreCount;
+        bindInfo.pSignalSemaphores = pSubmitInfo->pSignalSemaphores;
+        fence = pSubmitInfo->fence;
+    }
+    const VkResult res = hAllocator->GetVulkanFunctions().vkQueueBindSparse(queue, 1, &bindInfo, fence);
+    if (res != VK_SUCCESS)
+        return res;
 
-        allocCount += metadata->GetAllocationCount();
-        freeCount += metadata->GetFreeRegionsCount();
-        state.avgFreeSize += metadata->GetSumFreeSize();
-        state.avgAllocSize += metadata->GetSize();
+    for (uint32_t i = 0; i < resourceCount; ++i)
+    {
+        pResources[i]->m_DirtyPages.clear();
+        pResources[i]->m_DirtyTiles.clear();
+        pResources[i]->RetirePendingPages();
     }
+    return VK_SUCCESS;
+}
 
-    state.avgAllocSize = (state.avgAllocSize - state.avgFreeSize) / allocCount;
-    state.avgFreeSize /= freeCount;
+bool VmaSparseResource_T::TileLess::operator()(const Tile& lhs, const Tile& rhs) const
+{
+    if (lhs.aspectMask != rhs.aspectMask)
+        return lhs.aspectMask < rhs.aspectMask;
+    if (lhs.mipLevel != rhs.mipLevel)
+        return lhs.mipLevel < rhs.mipLevel;
+    if (lhs.arrayLayer != rhs.arrayLayer)
+        return lhs.arrayLayer < rhs.arrayLayer;
+    if (lhs.z != rhs.z)
+        return lhs.z < rhs.z;
+    if (lhs.y != rhs.y)
+        return lhs.y < rhs.y;
+    return lhs.x < rhs.x;
 }
 
-bool VmaDefragmentationContext_T::MoveDataToFreeBlocks(VmaSuballocationType currentType,
-    VmaBlockVector& vector, size_t firstFreeBlock,
-    bool& texturePresent, bool& bufferPresent, bool& otherPresent)
+VkResult VmaSparseResource_T::AllocatePages(size_t allocationCount, VmaAllocation* pAllocations)
 {
-    const size_t prevMoveCount = m_Moves.size();
-    for (size_t i = firstFreeBlock ; i;)
+    VkMemoryRequirements pageMemReq = {};
+    pageMemReq.size = m_PageSize;
+    pageMemReq.alignment = m_PageSize;
+    pageMemReq.memoryTypeBits = m_MemoryTypeBits;
+    const VkResult res = m_hAllocator->AllocateMemory(
+        pageMemReq,
+        false, // requiresDedicatedAllocation
+        false, // prefersDedicatedAllocation
+        VK_NULL_HANDLE, // dedicatedBuffer
+        VK_NULL_HANDLE, // dedicatedImage
+        m_BufferImageUsage,
+        m_CreateInfo,
+        m_SuballocType,
+        allocationCount,
+        pAllocations);
+    if (res != VK_SUCCESS)
+        return res;
+
+    // Binding refers to the memory of the page, so it must not be moved by defragmentation.
+    for (size_t i = 0; i < allocationCount; ++i)
+        pAllocations[i]->SetNotMovable();
+    return VK_SUCCESS;
+}
+
+const VkSparseImageMemoryRequirements* VmaSparseResource_T::FindImageRequirements(VkImageAspectFlags aspectMask) const
+{
+    for (size_t i = 0; i < m_ImageRequirements.size(); ++i)
     {
-        VmaDeviceMemoryBlock* block = vector.GetBlock(--i);
-        VmaBlockMetadata* metadata = block->m_pMetadata;
+        if ((m_ImageRequirements[i].formatProperties.aspectMask & aspectMask) == aspectMask)
+            return &m_ImageRequirements[i];
+    }
+    return VMA_NULL;
+}
 
-        for (VmaAllocHandle handle = metadata->GetAllocationListBegin();
-            handle != VK_NULL_HANDLE;
-            handle = metadata->GetNextAllocation(handle))
+void VmaSparseResource_T::GetRegionTiles(const VmaSparseImageRegion& region, Tile& outBegin, Tile& outEnd) const
+{
+    const VkSparseImageMemoryRequirements* const requirements = FindImageRequirements(region.subresource.aspectMask);
+    VMA_ASSERT(requirements != VMA_NULL && "Image not created with VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT or invalid aspect.");
+    VMA_ASSERT(region.subresource.mipLevel < requirements->imageMipTailFirstLod && region.subresource.arrayLayer < m_ImageArrayLayers);
+
+    const VkExtent3D& granularity = requirements->formatProperties.imageGranularity;
+    const uint32_t mipWidth = VMA_MAX(m_ImageExtent.width >> region.subresource.mipLevel, 1u);
+    const uint32_t mipHeight = VMA_MAX(m_ImageExtent.height >> region.subresource.mipLevel, 1u);
+    const uint32_t mipDepth = VMA_MAX(m_ImageExtent.depth >> region.subresource.mipLevel, 1u);
+    VMA_ASSERT(region.offset.x >= 0 && region.offset.y >= 0 && region.offset.z >= 0);
+    VMA_ASSERT(region.offset.x % granularity.width == 0 && region.offset.y % granularity.height == 0 &&
+        region.offset.z % granularity.depth == 0);
+    VMA_ASSERT(region.offset.x + region.extent.width <= mipWidth && region.offset.y + region.extent.height <= mipHeight &&
+        region.offset.z + region.extent.depth <= mipDepth);
+
+    outBegin.aspectMask = region.subresource.aspectMask;
+    outBegin.mipLevel = region.subresource.mipLevel;
+    outBegin.arrayLayer = region.subresource.arrayLayer;
+    outBegin.x = region.offset.x / granularity.width;
+    outBegin.y = region.offset.y / granularity.height;
+    outBegin.z = region.offset.z / granularity.depth;
+    outBegin.allocation = VK_NULL_HANDLE;
+    outEnd = outBegin;
+    // An extent that is not a multiple of granularity rounds up to the tile at the edge of the mip level.
+    outEnd.x = VmaDivideRoundingUp(region.offset.x + region.extent.width, granularity.width);
+    outEnd.y = VmaDivideRoundingUp(region.offset.y + region.extent.height, granularity.height);
+    outEnd.z = VmaDivideRoundingUp(region.offset.z + region.extent.depth, granularity.depth);
+}
+
+void VmaSparseResource_T::AppendBinds(VmaVector<VkSparseMemoryBind, VmaStlAllocator<VkSparseMemoryBind>>& outBinds)
+{
+    if (m_DirtyPages.empty())
+        return;
+
+    VMA_SORT(m_DirtyPages.begin(), m_DirtyPages.end(), std::less<VkDeviceSize>());
+    const size_t firstBind = outBinds.size();
+    VkDeviceSize prevIndex = VK_WHOLE_SIZE;
+    for (size_t i = 0; i < m_DirtyPages.size(); ++i)
+    {
+        const VkDeviceSize index = m_DirtyPages[i];
+        if (index == prevIndex)
+            continue;
+        prevIndex = index;
+
+        VkSparseMemoryBind bind = {};
+        bind.resourceOffset = index * m_PageSize;
+        // Last page may be cut at the end of the resource.
+        bind.size = VMA_MIN(m_PageSize, m_Size - bind.resourceOffset);
+        const Page* page = VmaBinaryFindSorted(m_Pages.begin(), m_Pages.end(), Page{ index, VK_NULL_HANDLE }, PageLess());
+        if (page != m_Pages.end())
+        {
+            bind.memory = page->allocation->GetMemory();
+            bind.memoryOffset = page->allocation->GetOffset();
+        }
+
+        if (outBinds.size() > firstBind)
         {
-            MoveAllocationData moveData = GetMoveData(handle, metadata);
-            // Ignore newly created allocations by defragmentation algorithm
-            if (moveData.move.srcAllocation->GetUserData() == this)
-                continue;
-            switch (CheckCounters(moveData.move.srcAllocation->GetSize()))
+            VkSparseMemoryBind& last = outBinds.back();
+            if (last.resourceOffset + last.size == bind.resourceOffset && last.memory == bind.memory &&
+                (bind.memory == VK_NULL_HANDLE || last.memoryOffset + last.size == bind.memoryOffset))
             {
-            case CounterStatus::Ignore:
+                last.size += bind.size;
                 continue;
-            case CounterStatus::End:
-                return true;
-            default:
-                VMA_ASSERT(0);
-            case CounterStatus::Pass:
-                break;
             }
+        }
+        outBinds.push_back(bind);
+    }
+}
 
-            // Move only single type of resources at once
-            if (!VmaIsBufferImageGranularityConflict(moveData.type, currentType))
-            {
-                // Try to fit allocation into free blocks
-                if (AllocInOtherBlock(firstFreeBlock, vector.GetBlockCount(), moveData, vector))
-                    return false;
-            }
+void VmaSparseResource_T::AppendImageBinds(VmaVector<VkSparseImageMemoryBind, VmaStlAllocator<VkSparseImageMemoryBind>>& outBinds)
+{
+    if (m_DirtyTiles.empty())
+        return;
 
-            if (!VmaIsBufferImageGranularityConflict(moveData.type, VMA_SUBALLOCATION_TYPE_IMAGE_OPTIMAL))
-                texturePresent = true;
-            else if (!VmaIsBufferImageGranularityConflict(moveData.type, VMA_SUBALLOCATION_TYPE_BUFFER))
-                bufferPresent = true;
-            else
-                otherPresent = true;
+    VMA_SORT(m_DirtyTiles.begin(), m_DirtyTiles.end(), TileLess());
+    for (size_t i = 0; i < m_DirtyTiles.size(); ++i)
+    {
+        const Tile& tile = m_DirtyTiles[i];
+        if (i > 0 && !TileLess()(m_DirtyTiles[i - 1], tile))
+            continue;
+
+        const VkExtent3D& granularity = FindImageRequirements(tile.aspectMask)->formatProperties.imageGranularity;
+
+        VkSparseImageMemoryBind bind = {};
+        bind.subresource.aspectMask = tile.aspectMask;
+        bind.subresource.mipLevel = tile.mipLevel;
+        bind.subresource.arrayLayer = tile.arrayLayer;
+        bind.offset.x = static_cast<int32_t>(tile.x * granularity.width);
+        bind.offset.y = static_cast<int32_t>(tile.y * granularity.height);
+        bind.offset.z = static_cast<int32_t>(tile.z * granularity.depth);
+        // Tiles at the edge of the mip level are cut to its size.
+        bind.extent.width = VMA_MIN(granularity.width, VMA_MAX(m_ImageExtent.width >> tile.mipLevel, 1u) - bind.offset.x);
+        bind.extent.height = VMA_MIN(granularity.height, VMA_MAX(m_ImageExtent.height >> tile.mipLevel, 1u) - bind.offset.y);
+        bind.extent.depth = VMA_MIN(granularity.depth, VMA_MAX(m_ImageExtent.depth >> tile.mipLevel, 1u) - bind.offset.z);
+        const Tile* committed = VmaBinaryFindSorted(m_Tiles.begin(), m_Tiles.end(), tile, TileLess());
+        if (committed != m_Tiles.end())
+        {
+            bind.memory = committed->allocation->GetMemory();
+            bind.memoryOffset = committed->allocation->GetOffset();
         }
+        outBinds.push_back(bind);
     }
-    return prevMoveCount == m_Moves.size();
 }
-#endif // _VMA_DEFRAGMENTATION_CONTEXT_FUNCTIONS
+
+void VmaSparseResource_T::RetirePendingPages()
+{
+    if (m_PendingFree.empty())
+        return;
+    // The GPU may still use the pages until it executes the unbinding, which is only submitted.
+    if (m_hAllocator->IsDeferredFreeEnabled())
+        m_hAllocator->DeferFree(m_PendingFree.size(), m_PendingFree.data(), VMA_NULL, VMA_NULL);
+    else
+    {
+        for (size_t i = 0; i < m_PendingFree.size(); ++i)
+            m_Unbound.push_back(m_PendingFree[i]);
+    }
+    m_PendingFree.clear();
+}
+#endif // _VMA_SPARSE_RESOURCE_FUNCTIONS
+
+#ifndef _VMA_CACHE_RANGE_BATCH_FUNCTIONS
+VmaCacheRangeBatch_T::VmaCacheRangeBatch_T(VmaAllocator hAllocator)
+    : m_hAllocator(hAllocator),
+    m_Ranges(VmaStlAllocator<VkMappedMemoryRange>(hAllocator->GetAllocationCallbacks())),
+    m_Stats() {}
+
+void VmaCacheRangeBatch_T::Add(VmaAllocation allocation, VkDeviceSize offset, VkDeviceSize size)
+{
+    VkMappedMemoryRange range;
+    if (m_hAllocator->GetFlushOrInvalidateRange(allocation, offset, size, range))
+    {
+        m_Ranges.push_back(range);
+        ++m_Stats.rangesCollected;
+    }
+}
+
+VkResult VmaCacheRangeBatch_T::Submit(VMA_CACHE_OPERATION op)
+{
+    if (m_Ranges.empty())
+        return VK_SUCCESS;
+
+    uint32_t rangeCount = static_cast<uint32_t>(m_Ranges.size());
+    const VkResult res = m_hAllocator->FlushOrInvalidateRanges(rangeCount, m_Ranges.data(), op);
+    for (uint32_t i = 0; i < rangeCount; ++i)
+        m_Stats.bytesIssued += m_Ranges[i].size;
+    m_Stats.rangesIssued += rangeCount;
+    ++m_Stats.callsIssued;
+    m_Ranges.clear();
+    return res;
+}
+#endif // _VMA_CACHE_RANGE_BATCH_FUNCTIONS
 
 #ifndef _VMA_POOL_T_FUNCTIONS
 VmaPool_T::VmaPool_T(
@@ -13995,6 +19284,7 @@ VmaPool_T::VmaPool_T(
 VmaPool_T::~VmaPool_T()
 {
     VMA_ASSERT(m_PrevPool == VMA_NULL && m_NextPool == VMA_NULL);
+    SetName(VMA_NULL);
 }
 
 void VmaPool_T::SetName(const char* pName)
@@ -14013,9 +19303,204 @@ void VmaPool_T::SetName(const char* pName)
 }
 #endif // _VMA_POOL_T_FUNCTIONS
 
+#if VMA_RECORDING_ENABLED
+#ifndef _VMA_RECORDER_FUNCTIONS
+VmaRecorder::VmaRecorder(const VkAllocationCallbacks* pAllocationCallbacks)
+    : m_Flags(0),
+    m_File(VMA_NULL),
+    m_UseMutex(true),
+    m_StartTime(0),
+    m_Data(VmaStlAllocator<char>(pAllocationCallbacks)) {}
+
+VmaRecorder::~VmaRecorder()
+{
+    if (m_File != VMA_NULL)
+    {
+        Flush();
+        fclose(m_File);
+    }
+}
+
+VkResult VmaRecorder::Init(const VmaRecordSettings& settings, bool useMutex)
+{
+    m_Flags = settings.flags;
+    m_UseMutex = useMutex;
+    m_StartTime = VMA_TIME_NANOSECONDS();
+
+    m_File = fopen(settings.pFilePath, "wb");
+    if (m_File == VMA_NULL)
+        return VK_ERROR_INITIALIZATION_FAILED;
+
+    m_Data.reserve(CHUNK_SIZE * 2);
+    return VK_SUCCESS;
+}
+
+void VmaRecorder::WriteConfiguration(
+    uint32_t vulkanApiVersion,
+    VmaAllocatorCreateFlags allocatorFlags,
+    VkDeviceSize preferredLargeHeapBlockSize,
+    const VkPhysicalDeviceProperties& devProps,
+    const VkPhysicalDeviceMemoryProperties& memProps)
+{
+    VmaMutexLock lock(m_Mutex, m_UseMutex);
+
+    Write<char>('V'); Write<char>('M'); Write<char>('A'); Write<char>('R');
+    Write<uint32_t>(FORMAT_VERSION);
+    Write<uint32_t>(vulkanApiVersion);
+    Write<uint32_t>(allocatorFlags);
+    Write<uint64_t>(preferredLargeHeapBlockSize);
+    Write<uint64_t>(devProps.limits.bufferImageGranularity);
+    Write<uint64_t>(devProps.limits.nonCoherentAtomSize);
+    Write<uint32_t>(devProps.limits.maxMemoryAllocationCount);
+
+    Write<uint32_t>(memProps.memoryHeapCount);
+    for (uint32_t i = 0; i < memProps.memoryHeapCount; ++i)
+    {
+        Write<uint64_t>(memProps.memoryHeaps[i].size);
+        Write<uint32_t>(memProps.memoryHeaps[i].flags);
+    }
+    Write<uint32_t>(memProps.memoryTypeCount);
+    for (uint32_t i = 0; i < memProps.memoryTypeCount; ++i)
+    {
+        Write<uint32_t>(memProps.memoryTypes[i].propertyFlags);
+        Write<uint32_t>(memProps.memoryTypes[i].heapIndex);
+    }
+    Flush();
+}
+
+void VmaRecorder::RecordCreatePool(uint32_t frameIndex, const VmaPoolCreateInfo& createInfo, VmaPool pool)
+{
+    const uint64_t time = GetTime();
+    VmaMutexLock lock(m_Mutex, m_UseMutex);
+
+    BeginRecord(CALL_CREATE_POOL, time, frameIndex);
+    WriteHandle(pool);
+    Write<uint32_t>(createInfo.memoryTypeIndex);
+    Write<uint32_t>(createInfo.flags);
+    Write<uint64_t>(createInfo.blockSize);
+    Write<uint64_t>(createInfo.minBlockCount);
+    Write<uint64_t>(createInfo.maxBlockCount);
+    Write<float>(createInfo.priority);
+    Write<uint64_t>(createInfo.minAllocationAlignment);
+    EndRecord();
+}
+
+void VmaRecorder::RecordDestroyPool(uint32_t frameIndex, VmaPool pool)
+{
+    const uint64_t time = GetTime();
+    VmaMutexLock lock(m_Mutex, m_UseMutex);
+
+    BeginRecord(CALL_DESTROY_POOL, time, frameIndex);
+    WriteHandle(pool);
+    EndRecord();
+}
+
+void VmaRecorder::RecordAllocateMemory(
+    uint32_t frameIndex,
+    uint64_t startTime,
+    const VkMemoryRequirements& vkMemReq,
+    bool requiresDedicatedAllocation,
+    bool prefersDedicatedAllocation,
+    VkBuffer dedicatedBuffer,
+    VkImage dedicatedImage,
+    VkFlags dedicatedBufferImageUsage,
+    const VmaAllocationCreateInfo& createInfo,
+    VmaSuballocationType suballocType,
+    size_t allocationCount,
+    const VmaAllocation* pAllocations,
+    VkResult result)
+{
+    const uint64_t duration = GetTime() - startTime;
+    VmaMutexLock lock(m_Mutex, m_UseMutex);
+
+    BeginRecord(CALL_ALLOCATE_MEMORY, startTime, frameIndex);
+    Write<uint64_t>(duration);
+    Write<int32_t>(result);
+    Write<uint64_t>(vkMemReq.size);
+    Write<uint64_t>(vkMemReq.alignment);
+    Write<uint32_t>(vkMemReq.memoryTypeBits);
+    Write<uint8_t>(requiresDedicatedAllocation ? 1 : 0);
+    Write<uint8_t>(prefersDedicatedAllocation ? 1 : 0);
+    Write<uint8_t>(dedicatedBuffer != VK_NULL_HANDLE ? 1 : (dedicatedImage != VK_NULL_HANDLE ? 2 : 0));
+    Write<uint32_t>(dedicatedBufferImageUsage);
+    Write<uint32_t>(createInfo.flags);
+    Write<uint32_t>(createInfo.usage);
+    Write<uint32_t>(createInfo.requiredFlags);
+    Write<uint32_t>(createInfo.preferredFlags);
+    Write<uint32_t>(createInfo.memoryTypeBits);
+    WriteHandle(createInfo.pool);
+    Write<float>(createInfo.priority);
+    Write<uint32_t>(suballocType);
+    Write<uint32_t>(static_cast<uint32_t>(allocationCount));
+    // Failed allocation leaves all the handles null.
+    for (size_t i = 0; i < allocationCount; ++i)
+        WriteHandle(pAllocations[i]);
+    EndRecord();
+}
+
+void VmaRecorder::RecordFreeMemory(uint32_t frameIndex, size_t allocationCount, const VmaAllocation* pAllocations)
+{
+    const uint64_t time = GetTime();
+    VmaMutexLock lock(m_Mutex, m_UseMutex);
+
+    BeginRecord(CALL_FREE_MEMORY, time, frameIndex);
+    Write<uint32_t>(static_cast<uint32_t>(allocationCount));
+    for (size_t i = 0; i < allocationCount; ++i)
+        WriteHandle(pAllocations[i]);
+    EndRecord();
+}
+
+void VmaRecorder::RecordSetCurrentFrameIndex(uint32_t frameIndex)
+{
+    const uint64_t time = GetTime();
+    VmaMutexLock lock(m_Mutex, m_UseMutex);
+
+    BeginRecord(CALL_SET_CURRENT_FRAME_INDEX, time, frameIndex);
+    EndRecord();
+}
+
+template<typename T>
+void VmaRecorder::Write(T value)
+{
+    const size_t offset = m_Data.size();
+    m_Data.resize(offset + sizeof(T));
+    memcpy(m_Data.data() + offset, &value, sizeof(T));
+}
+
+void VmaRecorder::BeginRecord(CALL call, uint64_t time, uint32_t frameIndex)
+{
+    Write<uint32_t>(call);
+    Write<uint32_t>(static_cast<uint32_t>(std::hash<std::thread::id>()(std::this_thread::get_id())));
+    Write<uint64_t>(time);
+    Write<uint32_t>(frameIndex);
+}
+
+void VmaRecorder::EndRecord()
+{
+    if ((m_Flags & VMA_RECORD_FLUSH_AFTER_CALL_BIT) != 0 || m_Data.size() >= CHUNK_SIZE)
+        Flush();
+}
+
+void VmaRecorder::Flush()
+{
+    if (!m_Data.empty())
+    {
+        fwrite(m_Data.data(), 1, m_Data.size(), m_File);
+        m_Data.clear();
+    }
+    if ((m_Flags & VMA_RECORD_FLUSH_AFTER_CALL_BIT) != 0)
+        fflush(m_File);
+}
+#endif // _VMA_RECORDER_FUNCTIONS
+#endif // #if VMA_RECORDING_ENABLED
+
 #ifndef _VMA_ALLOCATOR_T_FUNCTIONS
 VmaAllocator_T::VmaAllocator_T(const VmaAllocatorCreateInfo* pCreateInfo) :
     m_UseMutex((pCreateInfo->flags & VMA_ALLOCATOR_CREATE_EXTERNALLY_SYNCHRONIZED_BIT) == 0),
+    m_UseThreadCache((pCreateInfo->flags & VMA_ALLOCATOR_CREATE_THREAD_CACHE_BIT) != 0 &&
+        (pCreateInfo->flags & VMA_ALLOCATOR_CREATE_EXTERNALLY_SYNCHRONIZED_BIT) == 0),
+    m_UseIncrementalStatistics((pCreateInfo->flags & VMA_ALLOCATOR_CREATE_INCREMENTAL_STATISTICS_BIT) != 0),
+    m_DefragmentationContextCount(0),
     m_VulkanApiVersion(pCreateInfo->vulkanApiVersion != 0 ? pCreateInfo->vulkanApiVersion : VK_API_VERSION_1_0),
     m_UseKhrDedicatedAllocation((pCreateInfo->flags & VMA_ALLOCATOR_CREATE_KHR_DEDICATED_ALLOCATION_BIT) != 0),
     m_UseKhrBindMemory2((pCreateInfo->flags & VMA_ALLOCATOR_CREATE_KHR_BIND_MEMORY2_BIT) != 0),
@@ -14035,8 +19520,19 @@ VmaAllocator_T::VmaAllocator_T(const VmaAllocatorCreateInfo* pCreateInfo) :
     m_PhysicalDevice(pCreateInfo->physicalDevice),
     m_GpuDefragmentationMemoryTypeBits(UINT32_MAX),
     m_NextPoolId(0),
-    m_GlobalMemoryTypeBits(UINT32_MAX)
+    m_GlobalMemoryTypeBits(UINT32_MAX),
+    m_ThreadLocalOwnerId(VmaNextThreadLocalOwnerId++),
+    m_ThreadCacheClassCount(0),
+    m_ThreadCaches(VmaStlAllocator<VmaThreadCache*>(GetAllocationCallbacks())),
+    m_DeferredFreeFrameCount(pCreateInfo->deferredFreeFrameCount),
+    m_DeferredFreeLists(VmaStlAllocator<VmaDeferredFreeList*>(GetAllocationCallbacks()))
 {
+    while (m_ThreadCacheClassCount < VMA_THREAD_CACHE_MAX_CLASS_COUNT &&
+        VmaThreadCacheClassSize(m_ThreadCacheClassCount) <= VMA_THREAD_CACHE_MAX_ALLOCATION_SIZE)
+    {
+        ++m_ThreadCacheClassCount;
+    }
+
     if(m_VulkanApiVersion >= VK_MAKE_VERSION(1, 1, 0))
     {
         m_UseKhrDedicatedAllocation = false;
@@ -14189,6 +19685,28 @@ VkResult VmaAllocator_T::Init(const VmaAllocatorCreateInfo* pCreateInfo)
 {
     VkResult res = VK_SUCCESS;
 
+    if(pCreateInfo->pRecordSettings != VMA_NULL &&
+        !VmaStrIsEmpty(pCreateInfo->pRecordSettings->pFilePath))
+    {
+#if VMA_RECORDING_ENABLED
+        m_pRecorder = vma_new(this, VmaRecorder)(GetAllocationCallbacks());
+        res = m_pRecorder->Init(*pCreateInfo->pRecordSettings, m_UseMutex);
+        if(res != VK_SUCCESS)
+        {
+            return res;
+        }
+        m_pRecorder->WriteConfiguration(
+            m_VulkanApiVersion,
+            pCreateInfo->flags,
+            m_PreferredLargeHeapBlockSize,
+            m_PhysicalDeviceProperties,
+            m_MemProps);
+#else
+        VMA_ASSERT(0 && "VmaAllocatorCreateInfo::pRecordSettings used, but not supported due to VMA_RECORDING_ENABLED not defined to 1.");
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+#endif
+    }
+
 #if VMA_MEMORY_BUDGET
     if(m_UseExtMemoryBudget)
     {
@@ -14203,10 +19721,26 @@ VmaAllocator_T::~VmaAllocator_T()
 {
     VMA_ASSERT(m_Pools.IsEmpty());
 
+    ReleaseDeferredFrees(true, VK_NULL_HANDLE);
+    for (size_t i = m_DeferredFreeLists.size(); i--; )
+    {
+        vma_delete(this, m_DeferredFreeLists[i]);
+    }
+
+    FlushThreadCaches();
+    for (size_t i = m_ThreadCaches.size(); i--; )
+    {
+        vma_delete(this, m_ThreadCaches[i]);
+    }
+
     for(size_t memTypeIndex = GetMemoryTypeCount(); memTypeIndex--; )
     {
         vma_delete(this, m_pBlockVectors[memTypeIndex]);
     }
+
+#if VMA_RECORDING_ENABLED
+    vma_delete(this, m_pRecorder);
+#endif
 }
 
 void VmaAllocator_T::ImportVulkanFunctions(const VmaVulkanFunctions* pVulkanFunctions)
@@ -14251,6 +19785,8 @@ void VmaAllocator_T::ImportVulkanFunctions_Static()
     m_VulkanFunctions.vkCreateImage = (PFN_vkCreateImage)vkCreateImage;
     m_VulkanFunctions.vkDestroyImage = (PFN_vkDestroyImage)vkDestroyImage;
     m_VulkanFunctions.vkCmdCopyBuffer = (PFN_vkCmdCopyBuffer)vkCmdCopyBuffer;
+    m_VulkanFunctions.vkQueueBindSparse = (PFN_vkQueueBindSparse)vkQueueBindSparse;
+    m_VulkanFunctions.vkGetImageSparseMemoryRequirements = (PFN_vkGetImageSparseMemoryRequirements)vkGetImageSparseMemoryRequirements;
 
     // Vulkan 1.1
 #if VMA_VULKAN_VERSION >= 1001000
@@ -14264,6 +19800,27 @@ void VmaAllocator_T::ImportVulkanFunctions_Static()
     }
 #endif
 
+#if VMA_TIMELINE_SEMAPHORE
+    m_VulkanFunctions.vkCreateCommandPool = (PFN_vkCreateCommandPool)vkCreateCommandPool;
+    m_VulkanFunctions.vkDestroyCommandPool = (PFN_vkDestroyCommandPool)vkDestroyCommandPool;
+    m_VulkanFunctions.vkAllocateCommandBuffers = (PFN_vkAllocateCommandBuffers)vkAllocateCommandBuffers;
+    m_VulkanFunctions.vkResetCommandPool = (PFN_vkResetCommandPool)vkResetCommandPool;
+    m_VulkanFunctions.vkBeginCommandBuffer = (PFN_vkBeginCommandBuffer)vkBeginCommandBuffer;
+    m_VulkanFunctions.vkEndCommandBuffer = (PFN_vkEndCommandBuffer)vkEndCommandBuffer;
+    m_VulkanFunctions.vkQueueSubmit = (PFN_vkQueueSubmit)vkQueueSubmit;
+    m_VulkanFunctions.vkCreateSemaphore = (PFN_vkCreateSemaphore)vkCreateSemaphore;
+    m_VulkanFunctions.vkDestroySemaphore = (PFN_vkDestroySemaphore)vkDestroySemaphore;
+#endif
+
+#if VMA_VULKAN_VERSION >= 1002000
+    // On Vulkan 1.1, pass vkGetSemaphoreCounterValueKHR and vkWaitSemaphoresKHR in VmaAllocatorCreateInfo::pVulkanFunctions.
+    if(m_VulkanApiVersion >= VK_MAKE_VERSION(1, 2, 0))
+    {
+        m_VulkanFunctions.vkGetSemaphoreCounterValue = (PFN_vkGetSemaphoreCounterValueKHR)vkGetSemaphoreCounterValue;
+        m_VulkanFunctions.vkWaitSemaphores = (PFN_vkWaitSemaphoresKHR)vkWaitSemaphores;
+    }
+#endif
+
 #if VMA_VULKAN_VERSION >= 1003000
     if(m_VulkanApiVersion >= VK_MAKE_VERSION(1, 3, 0))
     {
@@ -14301,6 +19858,8 @@ void VmaAllocator_T::ImportVulkanFunctions_Custom(const VmaVulkanFunctions* pVul
     VMA_COPY_IF_NOT_NULL(vkCreateImage);
     VMA_COPY_IF_NOT_NULL(vkDestroyImage);
     VMA_COPY_IF_NOT_NULL(vkCmdCopyBuffer);
+    VMA_COPY_IF_NOT_NULL(vkQueueBindSparse);
+    VMA_COPY_IF_NOT_NULL(vkGetImageSparseMemoryRequirements);
 
 #if VMA_DEDICATED_ALLOCATION || VMA_VULKAN_VERSION >= 1001000
     VMA_COPY_IF_NOT_NULL(vkGetBufferMemoryRequirements2KHR);
@@ -14321,6 +19880,20 @@ void VmaAllocator_T::ImportVulkanFunctions_Custom(const VmaVulkanFunctions* pVul
     VMA_COPY_IF_NOT_NULL(vkGetDeviceImageMemoryRequirements);
 #endif
 
+#if VMA_TIMELINE_SEMAPHORE
+    VMA_COPY_IF_NOT_NULL(vkCreateCommandPool);
+    VMA_COPY_IF_NOT_NULL(vkDestroyCommandPool);
+    VMA_COPY_IF_NOT_NULL(vkAllocateCommandBuffers);
+    VMA_COPY_IF_NOT_NULL(vkResetCommandPool);
+    VMA_COPY_IF_NOT_NULL(vkBeginCommandBuffer);
+    VMA_COPY_IF_NOT_NULL(vkEndCommandBuffer);
+    VMA_COPY_IF_NOT_NULL(vkQueueSubmit);
+    VMA_COPY_IF_NOT_NULL(vkCreateSemaphore);
+    VMA_COPY_IF_NOT_NULL(vkDestroySemaphore);
+    VMA_COPY_IF_NOT_NULL(vkGetSemaphoreCounterValue);
+    VMA_COPY_IF_NOT_NULL(vkWaitSemaphores);
+#endif
+
 #undef VMA_COPY_IF_NOT_NULL
 }
 
@@ -14359,6 +19932,8 @@ void VmaAllocator_T::ImportVulkanFunctions_Dynamic()
     VMA_FETCH_DEVICE_FUNC(vkCreateImage, PFN_vkCreateImage, "vkCreateImage");
     VMA_FETCH_DEVICE_FUNC(vkDestroyImage, PFN_vkDestroyImage, "vkDestroyImage");
     VMA_FETCH_DEVICE_FUNC(vkCmdCopyBuffer, PFN_vkCmdCopyBuffer, "vkCmdCopyBuffer");
+    VMA_FETCH_DEVICE_FUNC(vkQueueBindSparse, PFN_vkQueueBindSparse, "vkQueueBindSparse");
+    VMA_FETCH_DEVICE_FUNC(vkGetImageSparseMemoryRequirements, PFN_vkGetImageSparseMemoryRequirements, "vkGetImageSparseMemoryRequirements");
 
 #if VMA_VULKAN_VERSION >= 1001000
     if(m_VulkanApiVersion >= VK_MAKE_VERSION(1, 1, 0))
@@ -14402,6 +19977,29 @@ void VmaAllocator_T::ImportVulkanFunctions_Dynamic()
     }
 #endif
 
+#if VMA_TIMELINE_SEMAPHORE
+    // Needed only by defragmentation executor, so missing ones are not an error here.
+    VMA_FETCH_DEVICE_FUNC(vkCreateCommandPool, PFN_vkCreateCommandPool, "vkCreateCommandPool");
+    VMA_FETCH_DEVICE_FUNC(vkDestroyCommandPool, PFN_vkDestroyCommandPool, "vkDestroyCommandPool");
+    VMA_FETCH_DEVICE_FUNC(vkAllocateCommandBuffers, PFN_vkAllocateCommandBuffers, "vkAllocateCommandBuffers");
+    VMA_FETCH_DEVICE_FUNC(vkResetCommandPool, PFN_vkResetCommandPool, "vkResetCommandPool");
+    VMA_FETCH_DEVICE_FUNC(vkBeginCommandBuffer, PFN_vkBeginCommandBuffer, "vkBeginCommandBuffer");
+    VMA_FETCH_DEVICE_FUNC(vkEndCommandBuffer, PFN_vkEndCommandBuffer, "vkEndCommandBuffer");
+    VMA_FETCH_DEVICE_FUNC(vkQueueSubmit, PFN_vkQueueSubmit, "vkQueueSubmit");
+    VMA_FETCH_DEVICE_FUNC(vkCreateSemaphore, PFN_vkCreateSemaphore, "vkCreateSemaphore");
+    VMA_FETCH_DEVICE_FUNC(vkDestroySemaphore, PFN_vkDestroySemaphore, "vkDestroySemaphore");
+#if VMA_VULKAN_VERSION >= 1002000
+    if(m_VulkanApiVersion >= VK_MAKE_VERSION(1, 2, 0))
+    {
+        VMA_FETCH_DEVICE_FUNC(vkGetSemaphoreCounterValue, PFN_vkGetSemaphoreCounterValueKHR, "vkGetSemaphoreCounterValue");
+        VMA_FETCH_DEVICE_FUNC(vkWaitSemaphores, PFN_vkWaitSemaphoresKHR, "vkWaitSemaphores");
+    }
+#endif
+    // Fallback to VK_KHR_timeline_semaphore on Vulkan 1.1. Null if the extension is not enabled.
+    VMA_FETCH_DEVICE_FUNC(vkGetSemaphoreCounterValue, PFN_vkGetSemaphoreCounterValueKHR, "vkGetSemaphoreCounterValueKHR");
+    VMA_FETCH_DEVICE_FUNC(vkWaitSemaphores, PFN_vkWaitSemaphoresKHR, "vkWaitSemaphoresKHR");
+#endif
+
 #undef VMA_FETCH_DEVICE_FUNC
 #undef VMA_FETCH_INSTANCE_FUNC
 }
@@ -14569,6 +20167,13 @@ VkResult VmaAllocator_T::AllocateMemoryOfType(
             }
         }
 
+        if(m_UseThreadCache && pool == VK_NULL_HANDLE && allocationCount == 1 &&
+            AllocateFromThreadCache(size, alignment, finalCreateInfo, suballocType, blockVector, pAllocations))
+        {
+            VMA_DEBUG_LOG("    Allocated from thread cache");
+            return VK_SUCCESS;
+        }
+
         res = blockVector.Allocate(
             size,
             alignment,
@@ -14614,6 +20219,110 @@ VkResult VmaAllocator_T::AllocateMemoryOfType(
     }
 }
 
+VmaThreadCache* VmaAllocator_T::GetThreadCache()
+{
+    // Address of thread-local data identifies the calling thread among all live threads.
+    const void* const pThread = VmaThreadCacheSlots;
+    VmaThreadCacheSlot& slot = VmaThreadCacheSlots[m_ThreadLocalOwnerId % VMA_THREAD_LOCAL_SLOT_COUNT];
+    if(slot.allocatorId != m_ThreadLocalOwnerId)
+    {
+        // First use by this thread or the slot was taken by another allocator.
+        // A cache left by an exited thread with the same address of thread-local data is adopted.
+        VmaThreadCache* pCache = VMA_NULL;
+        {
+            VmaMutexLock lock(m_ThreadCachesMutex);
+            for(size_t i = 0; i < m_ThreadCaches.size(); ++i)
+            {
+                if(m_ThreadCaches[i]->GetOwnerThread() == pThread)
+                {
+                    pCache = m_ThreadCaches[i];
+                    break;
+                }
+            }
+            if(pCache == VMA_NULL)
+            {
+                pCache = vma_new(this, VmaThreadCache)(this, pThread);
+                m_ThreadCaches.push_back(pCache);
+            }
+        }
+        slot.allocatorId = m_ThreadLocalOwnerId;
+        slot.pCache = pCache;
+    }
+    return slot.pCache;
+}
+
+bool VmaAllocator_T::AllocateFromThreadCache(
+    VkDeviceSize size,
+    VkDeviceSize alignment,
+    const VmaAllocationCreateInfo& createInfo,
+    VmaSuballocationType suballocType,
+    VmaBlockVector& blockVector,
+    VmaAllocation* pAllocation)
+{
+    const VmaAllocationCreateFlags unsupportedFlags =
+        VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT |
+        VMA_ALLOCATION_CREATE_NEVER_ALLOCATE_BIT |
+        VMA_ALLOCATION_CREATE_MAPPED_BIT |
+        VMA_ALLOCATION_CREATE_UPPER_ADDRESS_BIT |
+        VMA_ALLOCATION_CREATE_CAN_ALIAS_BIT |
+        VMA_ALLOCATION_CREATE_WITHIN_BUDGET_BIT;
+    if(suballocType != VMA_SUBALLOCATION_TYPE_BUFFER ||
+        (createInfo.flags & unsupportedFlags) != 0 ||
+        size > VMA_THREAD_CACHE_MAX_ALLOCATION_SIZE ||
+        blockVector.IsCorruptionDetectionEnabled())
+    {
+        return false;
+    }
+
+    // Classes of 1.5x size guarantee only half of their base alignment, so larger alignment may need a bigger class.
+    uint32_t sizeClass = VmaThreadCacheSizeToClass(size);
+    while(sizeClass < m_ThreadCacheClassCount && VmaThreadCacheClassAlignment(sizeClass) < alignment)
+        ++sizeClass;
+    if(sizeClass >= m_ThreadCacheClassCount)
+        return false;
+
+    VmaAllocation hAllocation = GetThreadCache()->Allocate(blockVector, sizeClass);
+    if(hAllocation == VK_NULL_HANDLE)
+        return false;
+
+    hAllocation->ResetCachedBlockAllocation((createInfo.flags &
+        (VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT)) != 0);
+    if((createInfo.flags & VMA_ALLOCATION_CREATE_USER_DATA_COPY_STRING_BIT) != 0)
+        hAllocation->SetName(this, (const char*)createInfo.pUserData);
+    else
+        hAllocation->SetUserData(this, createInfo.pUserData);
+    if(VMA_DEBUG_INITIALIZE_ALLOCATIONS)
+    {
+        FillAllocation(hAllocation, VMA_ALLOCATION_FILL_PATTERN_CREATED);
+    }
+    *pAllocation = hAllocation;
+    return true;
+}
+
+bool VmaAllocator_T::FreeToThreadCache(VmaAllocation allocation, VmaBlockVector& blockVector)
+{
+    const VkDeviceSize size = allocation->GetSize();
+    if(allocation->GetSuballocationType() != VMA_SUBALLOCATION_TYPE_BUFFER ||
+        allocation->IsPersistentMap() ||
+        size > VMA_THREAD_CACHE_MAX_ALLOCATION_SIZE ||
+        blockVector.IsCorruptionDetectionEnabled())
+    {
+        return false;
+    }
+
+    // Any allocation exactly matching a size class and its alignment can be handed out again,
+    // not only the ones that came from a cache.
+    const uint32_t sizeClass = VmaThreadCacheSizeToClass(size);
+    if(sizeClass >= m_ThreadCacheClassCount ||
+        VmaThreadCacheClassSize(sizeClass) != size ||
+        allocation->GetAlignment() < VmaThreadCacheClassAlignment(sizeClass))
+    {
+        return false;
+    }
+
+    return GetThreadCache()->Free(blockVector, sizeClass, allocation);
+}
+
 VkResult VmaAllocator_T::AllocateDedicatedMemory(
     VmaPool pool,
     VkDeviceSize size,
@@ -15007,6 +20716,13 @@ VkResult VmaAllocator_T::CalcAllocationParams(
         return VK_ERROR_FEATURE_NOT_PRESENT;
     }
 
+    if((inoutCreateInfo.flags & VMA_ALLOCATION_CREATE_CAN_BE_DEMOTED_BIT) != 0 &&
+        (inoutCreateInfo.flags & VMA_ALLOCATION_CREATE_MAPPED_BIT) != 0)
+    {
+        VMA_ASSERT(0 && "Specifying VMA_ALLOCATION_CREATE_CAN_BE_DEMOTED_BIT together with VMA_ALLOCATION_CREATE_MAPPED_BIT is not supported, as mapped allocations cannot be moved.");
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+    }
+
     if(VMA_DEBUG_ALWAYS_DEDICATED_MEMORY &&
         (inoutCreateInfo.flags & VMA_ALLOCATION_CREATE_NEVER_ALLOCATE_BIT) != 0)
     {
@@ -15041,6 +20757,34 @@ VkResult VmaAllocator_T::AllocateMemory(
     VmaSuballocationType suballocType,
     size_t allocationCount,
     VmaAllocation* pAllocations)
+{
+#if VMA_RECORDING_ENABLED
+    if(m_pRecorder != VMA_NULL)
+    {
+        const uint64_t startTime = m_pRecorder->GetTime();
+        const VkResult res = AllocateMemoryImpl(vkMemReq, requiresDedicatedAllocation, prefersDedicatedAllocation,
+            dedicatedBuffer, dedicatedImage, dedicatedBufferImageUsage, createInfo, suballocType, allocationCount, pAllocations);
+        m_pRecorder->RecordAllocateMemory(GetCurrentFrameIndex(), startTime, vkMemReq,
+            requiresDedicatedAllocation, prefersDedicatedAllocation, dedicatedBuffer, dedicatedImage, dedicatedBufferImageUsage,
+            createInfo, suballocType, allocationCount, pAllocations, res);
+        return res;
+    }
+#endif
+    return AllocateMemoryImpl(vkMemReq, requiresDedicatedAllocation, prefersDedicatedAllocation,
+        dedicatedBuffer, dedicatedImage, dedicatedBufferImageUsage, createInfo, suballocType, allocationCount, pAllocations);
+}
+
+VkResult VmaAllocator_T::AllocateMemoryImpl(
+    const VkMemoryRequirements& vkMemReq,
+    bool requiresDedicatedAllocation,
+    bool prefersDedicatedAllocation,
+    VkBuffer dedicatedBuffer,
+    VkImage dedicatedImage,
+    VkFlags dedicatedBufferImageUsage,
+    const VmaAllocationCreateInfo& createInfo,
+    VmaSuballocationType suballocType,
+    size_t allocationCount,
+    VmaAllocation* pAllocations)
 {
     memset(pAllocations, 0, sizeof(VmaAllocation) * allocationCount);
 
@@ -15105,7 +20849,13 @@ VkResult VmaAllocator_T::AllocateMemory(
                 pAllocations);
             // Allocation succeeded
             if(res == VK_SUCCESS)
+            {
+                if((createInfoFinal.flags & VMA_ALLOCATION_CREATE_CAN_BE_DEMOTED_BIT) != 0)
+                {
+                    InitResidency(vkMemReq.memoryTypeBits, createInfoFinal, allocationCount, pAllocations);
+                }
                 return VK_SUCCESS;
+            }
 
             // Remove old memTypeIndex from list of possibilities.
             memoryTypeBits &= ~(1u << memTypeIndex);
@@ -15119,12 +20869,65 @@ VkResult VmaAllocator_T::AllocateMemory(
     }
 }
 
+void VmaAllocator_T::InitResidency(
+    uint32_t memoryTypeBits,
+    const VmaAllocationCreateInfo& createInfo,
+    size_t allocationCount,
+    const VmaAllocation* pAllocations)
+{
+    memoryTypeBits &= GetGlobalMemoryTypeBits();
+    if(createInfo.memoryTypeBits != 0)
+    {
+        memoryTypeBits &= createInfo.memoryTypeBits;
+    }
+    uint32_t hostVisibleMemoryTypeBits = 0;
+    for(uint32_t memTypeIndex = 0; memTypeIndex < GetMemoryTypeCount(); ++memTypeIndex)
+    {
+        const VkMemoryPropertyFlags flags = m_MemProps.memoryTypes[memTypeIndex].propertyFlags;
+        if(m_pBlockVectors[memTypeIndex] == VMA_NULL ||
+            (flags & createInfo.requiredFlags) != createInfo.requiredFlags)
+        {
+            memoryTypeBits &= ~(1u << memTypeIndex);
+        }
+        else if((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0)
+        {
+            hostVisibleMemoryTypeBits |= 1u << memTypeIndex;
+        }
+    }
+
+    const uint32_t frameIndex = GetCurrentFrameIndex();
+    for(size_t allocIndex = 0; allocIndex < allocationCount; ++allocIndex)
+    {
+        VmaAllocation allocation = pAllocations[allocIndex];
+        // Dedicated allocations are never moved.
+        if(allocation->GetType() == VmaAllocation_T::ALLOCATION_TYPE_BLOCK)
+        {
+            // Allocation that can be mapped must stay in HOST_VISIBLE memory.
+            allocation->InitResidency(
+                allocation->IsMappingAllowed() ? (memoryTypeBits & hostVisibleMemoryTypeBits) : memoryTypeBits,
+                frameIndex);
+        }
+    }
+}
+
 void VmaAllocator_T::FreeMemory(
     size_t allocationCount,
     const VmaAllocation* pAllocations)
 {
     VMA_ASSERT(pAllocations);
 
+#if VMA_RECORDING_ENABLED
+    if(m_pRecorder != VMA_NULL)
+    {
+        m_pRecorder->RecordFreeMemory(GetCurrentFrameIndex(), allocationCount, pAllocations);
+    }
+#endif
+
+    // Consecutive allocations from the same block vector are returned to it together, locking it once.
+    typedef VmaSmallVector<VmaAllocation, VmaStlAllocator<VmaAllocation>, 16> AllocationBatch;
+    AllocationBatch blockVectorBatch = AllocationBatch(VmaStlAllocator<VmaAllocation>(GetAllocationCallbacks()));
+    VmaBlockVector* pBatchBlockVector = VMA_NULL;
+
     for(size_t allocIndex = allocationCount; allocIndex--; )
     {
         VmaAllocation allocation = pAllocations[allocIndex];
@@ -15137,6 +20940,7 @@ void VmaAllocator_T::FreeMemory(
             }
 
             allocation->FreeName(this);
+            allocation->ClearCanBeDemoted();
 
             switch(allocation->GetType())
             {
@@ -15153,8 +20957,19 @@ void VmaAllocator_T::FreeMemory(
                         const uint32_t memTypeIndex = allocation->GetMemoryTypeIndex();
                         pBlockVector = m_pBlockVectors[memTypeIndex];
                         VMA_ASSERT(pBlockVector && "Trying to free memory of unsupported type!");
+                        if(m_UseThreadCache && FreeToThreadCache(allocation, *pBlockVector))
+                            break;
+                    }
+                    if(pBlockVector != pBatchBlockVector)
+                    {
+                        if(!blockVectorBatch.empty())
+                        {
+                            pBatchBlockVector->Free(blockVectorBatch.size(), blockVectorBatch.data());
+                            blockVectorBatch.clear();
+                        }
+                        pBatchBlockVector = pBlockVector;
                     }
-                    pBlockVector->Free(allocation);
+                    blockVectorBatch.push_back(allocation);
                 }
                 break;
             case VmaAllocation_T::ALLOCATION_TYPE_DEDICATED:
@@ -15165,6 +20980,11 @@ void VmaAllocator_T::FreeMemory(
             }
         }
     }
+
+    if(!blockVectorBatch.empty())
+    {
+        pBatchBlockVector->Free(blockVectorBatch.size(), blockVectorBatch.data());
+    }
 }
 
 void VmaAllocator_T::CalculateStatistics(VmaTotalStatistics* pStats)
@@ -15213,9 +21033,10 @@ void VmaAllocator_T::CalculateStatistics(VmaTotalStatistics* pStats)
     for(uint32_t memHeapIndex = 0; memHeapIndex < GetMemoryHeapCount(); ++memHeapIndex)
         VmaAddDetailedStatistics(pStats->total, pStats->memoryHeap[memHeapIndex]);
 
-    VMA_ASSERT(pStats->total.statistics.allocationCount == 0 ||
+    // Incremental statistics are read without locks, so concurrent changes can tear them.
+    VMA_ASSERT(m_UseIncrementalStatistics || pStats->total.statistics.allocationCount == 0 ||
         pStats->total.allocationSizeMax >= pStats->total.allocationSizeMin);
-    VMA_ASSERT(pStats->total.unusedRangeCount == 0 ||
+    VMA_ASSERT(m_UseIncrementalStatistics || pStats->total.unusedRangeCount == 0 ||
         pStats->total.unusedRangeSizeMax >= pStats->total.unusedRangeSizeMin);
 }
 
@@ -15224,7 +21045,7 @@ void VmaAllocator_T::GetHeapBudgets(VmaBudget* outBudgets, uint32_t firstHeap, u
 #if VMA_MEMORY_BUDGET
     if(m_UseExtMemoryBudget)
     {
-        if(m_Budget.m_OperationsSinceBudgetFetch < 30)
+        if(m_Budget.GetOperationsSinceBudgetFetch() < 30)
         {
             VmaMutexLockRead lockRead(m_Budget.m_BudgetMutex, m_UseMutex);
             for(uint32_t i = 0; i < heapCount; ++i, ++outBudgets)
@@ -15232,9 +21053,9 @@ void VmaAllocator_T::GetHeapBudgets(VmaBudget* outBudgets, uint32_t firstHeap, u
                 const uint32_t heapIndex = firstHeap + i;
 
                 outBudgets->statistics.blockCount = m_Budget.m_BlockCount[heapIndex];
-                outBudgets->statistics.allocationCount = m_Budget.m_AllocationCount[heapIndex];
+                outBudgets->statistics.allocationCount = m_Budget.GetAllocationCount(heapIndex);
                 outBudgets->statistics.blockBytes = m_Budget.m_BlockBytes[heapIndex];
-                outBudgets->statistics.allocationBytes = m_Budget.m_AllocationBytes[heapIndex];
+                outBudgets->statistics.allocationBytes = m_Budget.GetAllocationBytes(heapIndex);
 
                 if(m_Budget.m_VulkanUsage[heapIndex] + outBudgets->statistics.blockBytes > m_Budget.m_BlockBytesAtBudgetFetch[heapIndex])
                 {
@@ -15265,9 +21086,9 @@ void VmaAllocator_T::GetHeapBudgets(VmaBudget* outBudgets, uint32_t firstHeap, u
             const uint32_t heapIndex = firstHeap + i;
 
             outBudgets->statistics.blockCount = m_Budget.m_BlockCount[heapIndex];
-            outBudgets->statistics.allocationCount = m_Budget.m_AllocationCount[heapIndex];
+            outBudgets->statistics.allocationCount = m_Budget.GetAllocationCount(heapIndex);
             outBudgets->statistics.blockBytes = m_Budget.m_BlockBytes[heapIndex];
-            outBudgets->statistics.allocationBytes = m_Budget.m_AllocationBytes[heapIndex];
+            outBudgets->statistics.allocationBytes = m_Budget.GetAllocationBytes(heapIndex);
 
             outBudgets->usage = outBudgets->statistics.blockBytes;
             outBudgets->budget = m_MemProps.memoryHeaps[heapIndex].size * 8 / 10; // 80% heuristics.
@@ -15336,11 +21157,28 @@ VkResult VmaAllocator_T::CreatePool(const VmaPoolCreateInfo* pCreateInfo, VmaPoo
         m_Pools.PushBack(*pPool);
     }
 
+#if VMA_RECORDING_ENABLED
+    if(m_pRecorder != VMA_NULL)
+    {
+        m_pRecorder->RecordCreatePool(GetCurrentFrameIndex(), *pCreateInfo, *pPool);
+    }
+#endif
+
     return VK_SUCCESS;
 }
 
 void VmaAllocator_T::DestroyPool(VmaPool pool)
 {
+    // Memory of the pool can't wait any longer.
+    ReleaseDeferredFrees(false, pool);
+
+#if VMA_RECORDING_ENABLED
+    if(m_pRecorder != VMA_NULL)
+    {
+        m_pRecorder->RecordDestroyPool(GetCurrentFrameIndex(), pool);
+    }
+#endif
+
     // Remove from m_Pools.
     {
         VmaMutexLockWrite lock(m_PoolsMutex, m_UseMutex);
@@ -15368,6 +21206,15 @@ void VmaAllocator_T::SetCurrentFrameIndex(uint32_t frameIndex)
 {
     m_CurrentFrameIndex.store(frameIndex);
 
+#if VMA_RECORDING_ENABLED
+    if(m_pRecorder != VMA_NULL)
+    {
+        m_pRecorder->RecordSetCurrentFrameIndex(frameIndex);
+    }
+#endif
+
+    ReleaseDeferredFrees(false, VK_NULL_HANDLE);
+
 #if VMA_MEMORY_BUDGET
     if(m_UseExtMemoryBudget)
     {
@@ -15376,6 +21223,129 @@ void VmaAllocator_T::SetCurrentFrameIndex(uint32_t frameIndex)
 #endif // #if VMA_MEMORY_BUDGET
 }
 
+void VmaAllocator_T::FlushThreadCaches()
+{
+    if(!m_UseThreadCache)
+        return;
+
+    VmaMutexLock lock(m_ThreadCachesMutex);
+    for(size_t i = 0; i < m_ThreadCaches.size(); ++i)
+    {
+        m_ThreadCaches[i]->Flush();
+    }
+}
+
+VmaDeferredFreeList* VmaAllocator_T::GetDeferredFreeList()
+{
+    // Same scheme as GetThreadCache().
+    const void* const pThread = VmaDeferredFreeSlots;
+    VmaDeferredFreeSlot& slot = VmaDeferredFreeSlots[m_ThreadLocalOwnerId % VMA_THREAD_LOCAL_SLOT_COUNT];
+    if(slot.allocatorId != m_ThreadLocalOwnerId)
+    {
+        VmaDeferredFreeList* pList = VMA_NULL;
+        {
+            VmaMutexLock lock(m_DeferredFreeListsMutex, m_UseMutex);
+            for(size_t i = 0; i < m_DeferredFreeLists.size(); ++i)
+            {
+                if(m_DeferredFreeLists[i]->m_pOwnerThread == pThread)
+                {
+                    pList = m_DeferredFreeLists[i];
+                    break;
+                }
+            }
+            if(pList == VMA_NULL)
+            {
+                pList = vma_new(this, VmaDeferredFreeList)(GetAllocationCallbacks(), pThread);
+                m_DeferredFreeLists.push_back(pList);
+            }
+        }
+        slot.allocatorId = m_ThreadLocalOwnerId;
+        slot.pList = pList;
+    }
+    return slot.pList;
+}
+
+void VmaAllocator_T::DeferFree(size_t count, const VmaAllocation* pAllocations, const VkBuffer* pBuffers, const VkImage* pImages)
+{
+    VMA_ASSERT(IsDeferredFreeEnabled());
+    const uint32_t frameIndex = GetCurrentFrameIndex();
+    VmaDeferredFreeList* const pList = GetDeferredFreeList();
+
+    VmaMutexLock lock(pList->m_Mutex, m_UseMutex);
+    for(size_t i = 0; i < count; ++i)
+    {
+        VmaDeferredFree item = {};
+        item.allocation = pAllocations != VMA_NULL ? pAllocations[i] : VK_NULL_HANDLE;
+        item.buffer = pBuffers != VMA_NULL ? pBuffers[i] : VK_NULL_HANDLE;
+        item.image = pImages != VMA_NULL ? pImages[i] : VK_NULL_HANDLE;
+        item.frameIndex = frameIndex;
+        if(item.allocation != VK_NULL_HANDLE)
+        {
+            // Resource is being released, so the allocation must not be moved anymore,
+            // neither by demotion nor by defragmentation while it waits in the list.
+            item.allocation->ClearCanBeDemoted();
+            item.allocation->SetNotMovable();
+        }
+        if(item.allocation != VK_NULL_HANDLE || item.buffer != VK_NULL_HANDLE || item.image != VK_NULL_HANDLE)
+        {
+            pList->m_Items.push_back(item);
+        }
+    }
+}
+
+void VmaAllocator_T::ReleaseDeferredFrees(bool releaseAll, VmaPool hPool)
+{
+    if(!IsDeferredFreeEnabled())
+        return;
+
+    const uint32_t frameIndex = GetCurrentFrameIndex();
+    typedef VmaVector<VmaDeferredFree, VmaStlAllocator<VmaDeferredFree>> DeferredFreeVector;
+    DeferredFreeVector released = DeferredFreeVector(VmaStlAllocator<VmaDeferredFree>(GetAllocationCallbacks()));
+    {
+        VmaMutexLock lock(m_DeferredFreeListsMutex, m_UseMutex);
+        for(size_t listIndex = 0; listIndex < m_DeferredFreeLists.size(); ++listIndex)
+        {
+            VmaDeferredFreeList* const pList = m_DeferredFreeLists[listIndex];
+            VmaMutexLock listLock(pList->m_Mutex, m_UseMutex);
+            size_t keptCount = 0;
+            for(size_t i = 0; i < pList->m_Items.size(); ++i)
+            {
+                const VmaDeferredFree& item = pList->m_Items[i];
+                // Unsigned subtraction handles wraparound of the frame index.
+                if(releaseAll || frameIndex - item.frameIndex >= m_DeferredFreeFrameCount ||
+                    (hPool != VK_NULL_HANDLE && item.allocation != VK_NULL_HANDLE && item.allocation->GetParentPool() == hPool))
+                {
+                    released.push_back(item);
+                }
+                else
+                {
+                    pList->m_Items[keptCount++] = item;
+                }
+            }
+            pList->m_Items.resize(keptCount);
+        }
+    }
+    if(released.empty())
+        return;
+
+    typedef VmaVector<VmaAllocation, VmaStlAllocator<VmaAllocation>> AllocationVector;
+    AllocationVector allocations = AllocationVector(VmaStlAllocator<VmaAllocation>(GetAllocationCallbacks()));
+    for(size_t i = 0; i < released.size(); ++i)
+    {
+        const VmaDeferredFree& item = released[i];
+        if(item.buffer != VK_NULL_HANDLE)
+            (*m_VulkanFunctions.vkDestroyBuffer)(m_hDevice, item.buffer, GetAllocationCallbacks());
+        if(item.image != VK_NULL_HANDLE)
+            (*m_VulkanFunctions.vkDestroyImage)(m_hDevice, item.image, GetAllocationCallbacks());
+        if(item.allocation != VK_NULL_HANDLE)
+            allocations.push_back(item.allocation);
+    }
+    // Grouped by block vector, so FreeMemory() locks each one only once.
+    VMA_SORT(allocations.begin(), allocations.end(), VmaAllocationBlockVectorLess());
+    if(!allocations.empty())
+        FreeMemory(allocations.size(), allocations.data());
+}
+
 VkResult VmaAllocator_T::CheckPoolCorruption(VmaPool hPool)
 {
     return hPool->m_BlockVector.CheckCorruption();
@@ -15430,6 +21400,258 @@ VkResult VmaAllocator_T::CheckCorruption(uint32_t memoryTypeBits)
     return finalRes;
 }
 
+// Allocation profile is a sequence of native-endian values, to be imported on the same machine.
+static const uint32_t VMA_ALLOCATION_PROFILE_VERSION = 1;
+
+template<typename T>
+static void VmaAppendProfileValue(VmaVector<char, VmaStlAllocator<char>>& data, const T& value)
+{
+    const size_t offset = data.size();
+    data.resize(offset + sizeof(T));
+    memcpy(data.data() + offset, &value, sizeof(T));
+}
+
+template<typename T>
+static bool VmaReadProfileValue(const char*& pCurr, const char* pEnd, T& outValue)
+{
+    if(static_cast<size_t>(pEnd - pCurr) < sizeof(T))
+    {
+        return false;
+    }
+    memcpy(&outValue, pCurr, sizeof(T));
+    pCurr += sizeof(T);
+    return true;
+}
+
+VkResult VmaAllocator_T::ExportProfile(size_t* pDataSize, void* pData)
+{
+    typedef VmaVector<char, VmaStlAllocator<char>> ProfileData;
+    ProfileData data = ProfileData(VmaStlAllocator<char>(GetAllocationCallbacks()));
+    const char magic[4] = { 'V', 'M', 'A', 'P' };
+    VmaAppendProfileValue(data, magic);
+    VmaAppendProfileValue(data, VMA_ALLOCATION_PROFILE_VERSION);
+    VmaAppendProfileValue(data, m_PhysicalDeviceProperties.vendorID);
+    VmaAppendProfileValue(data, m_PhysicalDeviceProperties.deviceID);
+    VmaAppendProfileValue(data, m_MemProps.memoryTypeCount);
+    for(uint32_t memTypeIndex = 0; memTypeIndex < m_MemProps.memoryTypeCount; ++memTypeIndex)
+    {
+        VmaAppendProfileValue(data, m_MemProps.memoryTypes[memTypeIndex].propertyFlags);
+        VmaAppendProfileValue(data, m_MemProps.memoryTypes[memTypeIndex].heapIndex);
+    }
+
+    uint32_t entryCount = 0;
+    const size_t entryCountOffset = data.size();
+    VmaAppendProfileValue(data, entryCount);
+    auto appendEntry = [&](VmaBlockVector& blockVector, const char* pName)
+    {
+        size_t peakBlockCount = 0;
+        VkDeviceSize peakBlockBytes = 0, maxBlockSize = 0;
+        blockVector.GetBlockProfile(peakBlockCount, peakBlockBytes, maxBlockSize);
+        if(peakBlockCount == 0)
+        {
+            return;
+        }
+        const uint32_t nameLength = pName != VMA_NULL ? static_cast<uint32_t>(strlen(pName)) : 0;
+        VmaAppendProfileValue(data, blockVector.GetMemoryTypeIndex());
+        VmaAppendProfileValue(data, static_cast<uint32_t>(peakBlockCount));
+        VmaAppendProfileValue(data, static_cast<uint64_t>(maxBlockSize));
+        VmaAppendProfileValue(data, static_cast<uint64_t>(peakBlockBytes));
+        VmaAppendProfileValue(data, nameLength);
+        for(uint32_t i = 0; i < nameLength; ++i)
+        {
+            data.push_back(pName[i]);
+        }
+        ++entryCount;
+    };
+
+    for(uint32_t memTypeIndex = 0; memTypeIndex < GetMemoryTypeCount(); ++memTypeIndex)
+    {
+        if(m_pBlockVectors[memTypeIndex] != VMA_NULL)
+        {
+            appendEntry(*m_pBlockVectors[memTypeIndex], VMA_NULL);
+        }
+    }
+    {
+        VmaMutexLockRead lock(m_PoolsMutex, m_UseMutex);
+        for(VmaPool pool = m_Pools.Front(); pool != VMA_NULL; pool = m_Pools.GetNext(pool))
+        {
+            // Pools are matched by name on import, so unnamed ones are left out.
+            if(pool->GetName() != VMA_NULL && pool->GetName()[0] != '\0')
+            {
+                appendEntry(pool->m_BlockVector, pool->GetName());
+            }
+        }
+    }
+    memcpy(data.data() + entryCountOffset, &entryCount, sizeof(entryCount));
+
+    if(pData == VMA_NULL)
+    {
+        *pDataSize = data.size();
+        return VK_SUCCESS;
+    }
+    if(*pDataSize < data.size())
+    {
+        *pDataSize = 0;
+        return VK_INCOMPLETE;
+    }
+    memcpy(pData, data.data(), data.size());
+    *pDataSize = data.size();
+    return VK_SUCCESS;
+}
+
+VkResult VmaAllocator_T::ImportProfile(size_t dataSize, const void* pData)
+{
+    const char* pCurr = static_cast<const char*>(pData);
+    const char* const pEnd = pCurr + dataSize;
+
+    char magic[4] = {};
+    uint32_t version = 0, vendorID = 0, deviceID = 0, memoryTypeCount = 0;
+    if(!VmaReadProfileValue(pCurr, pEnd, magic) ||
+        !VmaReadProfileValue(pCurr, pEnd, version) ||
+        memcmp(magic, "VMAP", 4) != 0)
+    {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+    if(version != VMA_ALLOCATION_PROFILE_VERSION)
+    {
+        return VK_ERROR_INCOMPATIBLE_DRIVER;
+    }
+    if(!VmaReadProfileValue(pCurr, pEnd, vendorID) ||
+        !VmaReadProfileValue(pCurr, pEnd, deviceID) ||
+        !VmaReadProfileValue(pCurr, pEnd, memoryTypeCount))
+    {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+    if(vendorID != m_PhysicalDeviceProperties.vendorID ||
+        deviceID != m_PhysicalDeviceProperties.deviceID ||
+        memoryTypeCount != m_MemProps.memoryTypeCount)
+    {
+        return VK_ERROR_INCOMPATIBLE_DRIVER;
+    }
+    for(uint32_t memTypeIndex = 0; memTypeIndex < memoryTypeCount; ++memTypeIndex)
+    {
+        VkMemoryPropertyFlags propertyFlags = 0;
+        uint32_t heapIndex = 0;
+        if(!VmaReadProfileValue(pCurr, pEnd, propertyFlags) ||
+            !VmaReadProfileValue(pCurr, pEnd, heapIndex))
+        {
+            return VK_ERROR_INITIALIZATION_FAILED;
+        }
+        if(propertyFlags != m_MemProps.memoryTypes[memTypeIndex].propertyFlags ||
+            heapIndex != m_MemProps.memoryTypes[memTypeIndex].heapIndex)
+        {
+            return VK_ERROR_INCOMPATIBLE_DRIVER;
+        }
+    }
+
+    struct Entry
+    {
+        uint32_t memoryTypeIndex;
+        uint32_t blockCount;
+        uint64_t blockSize;
+        uint64_t totalBytes;
+        uint32_t nameLength;
+        const char* pName;
+    };
+    uint32_t entryCount = 0;
+    if(!VmaReadProfileValue(pCurr, pEnd, entryCount))
+    {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+    // Whole profile is validated before any block gets created.
+    typedef VmaVector<Entry, VmaStlAllocator<Entry>> EntryVector;
+    EntryVector entries = EntryVector(VmaStlAllocator<Entry>(GetAllocationCallbacks()));
+    for(uint32_t entryIndex = 0; entryIndex < entryCount; ++entryIndex)
+    {
+        Entry entry = {};
+        if(!VmaReadProfileValue(pCurr, pEnd, entry.memoryTypeIndex) ||
+            !VmaReadProfileValue(pCurr, pEnd, entry.blockCount) ||
+            !VmaReadProfileValue(pCurr, pEnd, entry.blockSize) ||
+            !VmaReadProfileValue(pCurr, pEnd, entry.totalBytes) ||
+            !VmaReadProfileValue(pCurr, pEnd, entry.nameLength) ||
+            static_cast<size_t>(pEnd - pCurr) < entry.nameLength ||
+            entry.memoryTypeIndex >= memoryTypeCount)
+        {
+            return VK_ERROR_INITIALIZATION_FAILED;
+        }
+        entry.pName = pCurr;
+        pCurr += entry.nameLength;
+        entries.push_back(entry);
+    }
+
+    VkResult finalRes = VK_SUCCESS;
+    for(size_t entryIndex = 0; entryIndex < entries.size(); ++entryIndex)
+    {
+        const Entry& entry = entries[entryIndex];
+        VkResult res = VK_SUCCESS;
+        if(entry.nameLength == 0)
+        {
+            if(m_pBlockVectors[entry.memoryTypeIndex] != VMA_NULL)
+            {
+                res = m_pBlockVectors[entry.memoryTypeIndex]->CreateProfileBlocks(
+                    entry.blockCount, entry.blockSize, entry.totalBytes);
+            }
+        }
+        else
+        {
+            // Pool is only looked up under the lock, so creating and destroying other pools is not blocked by allocations.
+            VmaPool matchingPool = VMA_NULL;
+            {
+                VmaMutexLockRead lock(m_PoolsMutex, m_UseMutex);
+                for(VmaPool pool = m_Pools.Front(); pool != VMA_NULL; pool = m_Pools.GetNext(pool))
+                {
+                    const char* const pPoolName = pool->GetName();
+                    if(pool->m_BlockVector.GetMemoryTypeIndex() == entry.memoryTypeIndex &&
+                        pPoolName != VMA_NULL &&
+                        strlen(pPoolName) == entry.nameLength &&
+                        memcmp(pPoolName, entry.pName, entry.nameLength) == 0)
+                    {
+                        matchingPool = pool;
+                        break;
+                    }
+                }
+            }
+            if(matchingPool != VMA_NULL)
+            {
+                res = matchingPool->m_BlockVector.CreateProfileBlocks(entry.blockCount, entry.blockSize, entry.totalBytes);
+            }
+        }
+        if(finalRes == VK_SUCCESS)
+        {
+            finalRes = res;
+        }
+    }
+    return finalRes;
+}
+
+VkResult VmaAllocator_T::PreallocateBlocks(uint32_t memoryTypeBits, VkDeviceSize minFreeSize, uint32_t* pAllocatedBlockCount)
+{
+    uint32_t allocatedBlockCount = 0;
+    VkResult finalRes = VK_SUCCESS;
+    for(uint32_t memTypeIndex = 0; memTypeIndex < GetMemoryTypeCount(); ++memTypeIndex)
+    {
+        VmaBlockVector* const pBlockVector = m_pBlockVectors[memTypeIndex];
+        if(pBlockVector != VMA_NULL && ((1u << memTypeIndex) & memoryTypeBits) != 0)
+        {
+            bool allocated = false;
+            VkResult res = pBlockVector->PreallocateBlock(minFreeSize, allocated);
+            if(allocated)
+            {
+                ++allocatedBlockCount;
+            }
+            if(finalRes == VK_SUCCESS)
+            {
+                finalRes = res;
+            }
+        }
+    }
+    if(pAllocatedBlockCount != VMA_NULL)
+    {
+        *pAllocatedBlockCount = allocatedBlockCount;
+    }
+    return finalRes;
+}
+
 VkResult VmaAllocator_T::AllocateVulkanMemory(const VkMemoryAllocateInfo* pAllocateInfo, VkDeviceMemory* pMemory)
 {
     AtomicTransactionalIncrement<uint32_t> deviceMemoryCountIncrement;
@@ -15473,7 +21695,7 @@ VkResult VmaAllocator_T::AllocateVulkanMemory(const VkMemoryAllocateInfo* pAlloc
     if(res == VK_SUCCESS)
     {
 #if VMA_MEMORY_BUDGET
-        ++m_Budget.m_OperationsSinceBudgetFetch;
+        m_Budget.AddOperation();
 #endif
 
         // Informative callback.
@@ -15641,6 +21863,60 @@ VkResult VmaAllocator_T::BindBufferMemory(
     return res;
 }
 
+VkResult VmaAllocator_T::BindBufferMemories(
+    size_t count,
+    const VmaAllocation* pAllocations,
+    const VkBuffer* pBuffers)
+{
+#if VMA_VULKAN_VERSION >= 1001000 || VMA_BIND_MEMORY2
+    if((m_UseKhrBindMemory2 || m_VulkanApiVersion >= VK_MAKE_VERSION(1, 1, 0)) &&
+        m_VulkanFunctions.vkBindBufferMemory2KHR != VMA_NULL)
+    {
+        VmaVector<VkBindBufferMemoryInfoKHR, VmaStlAllocator<VkBindBufferMemoryInfoKHR>> bindInfos(
+            count, VmaStlAllocator<VkBindBufferMemoryInfoKHR>(GetAllocationCallbacks()));
+        for(size_t i = 0; i < count; ++i)
+        {
+            VkBindBufferMemoryInfoKHR& bindInfo = bindInfos[i];
+            bindInfo = { VK_STRUCTURE_TYPE_BIND_BUFFER_MEMORY_INFO_KHR };
+            bindInfo.buffer = pBuffers[i];
+            bindInfo.memory = pAllocations[i]->GetMemory();
+            bindInfo.memoryOffset = pAllocations[i]->GetOffset();
+        }
+
+        // Consecutive allocations from the same block are bound with a single call under the lock of that block.
+        // Consecutive dedicated allocations don't need any lock and are also bound together.
+        for(size_t runBegin = 0; runBegin < count; )
+        {
+            VmaDeviceMemoryBlock* const pBlock = pAllocations[runBegin]->GetType() == VmaAllocation_T::ALLOCATION_TYPE_BLOCK ?
+                pAllocations[runBegin]->GetBlock() : VMA_NULL;
+            size_t runEnd = runBegin + 1;
+            while(runEnd < count &&
+                (pAllocations[runEnd]->GetType() == VmaAllocation_T::ALLOCATION_TYPE_BLOCK ? pAllocations[runEnd]->GetBlock() : VMA_NULL) == pBlock)
+            {
+                ++runEnd;
+            }
+
+            const uint32_t runCount = static_cast<uint32_t>(runEnd - runBegin);
+            const VkResult res = pBlock != VMA_NULL ?
+                pBlock->BindBufferMemories(this, runCount, bindInfos.data() + runBegin) :
+                (*m_VulkanFunctions.vkBindBufferMemory2KHR)(m_hDevice, runCount, bindInfos.data() + runBegin);
+            if(res < 0)
+                return res;
+            runBegin = runEnd;
+        }
+        return VK_SUCCESS;
+    }
+#endif // #if VMA_VULKAN_VERSION >= 1001000 || VMA_BIND_MEMORY2
+
+    for(size_t i = 0; i < count; ++i)
+    {
+        const VkResult res = BindBufferMemory(pAllocations[i], 0, pBuffers[i], VMA_NULL);
+        if(res < 0)
+            return res;
+    }
+    return VK_SUCCESS;
+}
+
 VkResult VmaAllocator_T::BindImageMemory(
     VmaAllocation hAllocation,
     VkDeviceSize allocationLocalOffset,
@@ -15717,19 +21993,54 @@ VkResult VmaAllocator_T::FlushOrInvalidateAllocations(
     VkResult res = VK_SUCCESS;
     if(!ranges.empty())
     {
-        switch(op)
+        uint32_t rangeCount = (uint32_t)ranges.size();
+        res = FlushOrInvalidateRanges(rangeCount, ranges.data(), op);
+    }
+    // else: Just ignore this call.
+    return res;
+}
+
+VkResult VmaAllocator_T::FlushOrInvalidateRanges(uint32_t& inoutRangeCount, VkMappedMemoryRange* pRanges, VMA_CACHE_OPERATION op)
+{
+    VMA_ASSERT(inoutRangeCount > 0 && pRanges);
+
+    VMA_SORT(pRanges, pRanges + inoutRangeCount, [](const VkMappedMemoryRange& lhs, const VkMappedMemoryRange& rhs)
+    {
+        if(lhs.memory != rhs.memory)
         {
-        case VMA_CACHE_FLUSH:
-            res = (*GetVulkanFunctions().vkFlushMappedMemoryRanges)(m_hDevice, (uint32_t)ranges.size(), ranges.data());
-            break;
-        case VMA_CACHE_INVALIDATE:
-            res = (*GetVulkanFunctions().vkInvalidateMappedMemoryRanges)(m_hDevice, (uint32_t)ranges.size(), ranges.data());
-            break;
-        default:
-            VMA_ASSERT(0);
+            return lhs.memory < rhs.memory;
+        }
+        return lhs.offset < rhs.offset;
+    });
+    // Ranges are already aligned to nonCoherentAtomSize, so merged ones stay aligned.
+    uint32_t mergedCount = 1;
+    for(uint32_t i = 1; i < inoutRangeCount; ++i)
+    {
+        VkMappedMemoryRange& last = pRanges[mergedCount - 1];
+        const VkMappedMemoryRange& curr = pRanges[i];
+        if(curr.memory == last.memory && curr.offset <= last.offset + last.size)
+        {
+            last.size = VMA_MAX(last.size, curr.offset + curr.size - last.offset);
+        }
+        else
+        {
+            pRanges[mergedCount++] = curr;
         }
     }
-    // else: Just ignore this call.
+    inoutRangeCount = mergedCount;
+
+    VkResult res = VK_SUCCESS;
+    switch(op)
+    {
+    case VMA_CACHE_FLUSH:
+        res = (*GetVulkanFunctions().vkFlushMappedMemoryRanges)(m_hDevice, inoutRangeCount, pRanges);
+        break;
+    case VMA_CACHE_INVALIDATE:
+        res = (*GetVulkanFunctions().vkInvalidateMappedMemoryRanges)(m_hDevice, inoutRangeCount, pRanges);
+        break;
+    default:
+        VMA_ASSERT(0);
+    }
     return res;
 }
 
@@ -15915,7 +22226,7 @@ void VmaAllocator_T::UpdateVulkanBudget()
                 m_Budget.m_VulkanUsage[heapIndex] = m_Budget.m_BlockBytesAtBudgetFetch[heapIndex];
             }
         }
-        m_Budget.m_OperationsSinceBudgetFetch = 0;
+        m_Budget.ResetOperationsSinceBudgetFetch();
     }
 }
 #endif // VMA_MEMORY_BUDGET
@@ -15979,6 +22290,7 @@ void VmaAllocator_T::PrintDetailedMap(VmaJsonWriter& json)
                     dedicatedAllocList.BuildStatsString(json);
                 }
                 json.EndObject();
+                json.FlushIfNeeded();
             }
         }
     }
@@ -16030,6 +22342,8 @@ void VmaAllocator_T::PrintDetailedMap(VmaJsonWriter& json)
                             pool->m_DedicatedAllocations.BuildStatsString(json);
                         }
                         json.EndObject();
+                        // Only m_PoolsMutex is held here, which doesn't block allocations.
+                        json.FlushIfNeeded();
                     }
                 }
 
@@ -16119,6 +22433,26 @@ VMA_CALL_PRE void VMA_CALL_POST vmaSetCurrentFrameIndex(
     allocator->SetCurrentFrameIndex(frameIndex);
 }
 
+VMA_CALL_PRE void VMA_CALL_POST vmaFlushThreadCaches(
+    VmaAllocator allocator)
+{
+    VMA_ASSERT(allocator);
+
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+
+    allocator->FlushThreadCaches();
+}
+
+VMA_CALL_PRE void VMA_CALL_POST vmaFlushDeferredFrees(
+    VmaAllocator allocator)
+{
+    VMA_ASSERT(allocator);
+
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+
+    allocator->ReleaseDeferredFrees(true, VK_NULL_HANDLE);
+}
+
 VMA_CALL_PRE void VMA_CALL_POST vmaCalculateStatistics(
     VmaAllocator allocator,
     VmaTotalStatistics* pStats)
@@ -16139,190 +22473,194 @@ VMA_CALL_PRE void VMA_CALL_POST vmaGetHeapBudgets(
 
 #if VMA_STATS_STRING_ENABLED
 
-VMA_CALL_PRE void VMA_CALL_POST vmaBuildStatsString(
-    VmaAllocator allocator,
-    char** ppStatsString,
-    VkBool32 detailedMap)
+// Writes the document of vmaBuildStatsString() to sb, which may be streaming.
+static void VmaBuildStatsString(VmaAllocator allocator, VmaStringBuilder& sb, bool detailedMap)
 {
-    VMA_ASSERT(allocator && ppStatsString);
-    VMA_DEBUG_GLOBAL_MUTEX_LOCK
-
-    VmaStringBuilder sb(allocator->GetAllocationCallbacks());
-    {
-        VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
-        allocator->GetHeapBudgets(budgets, 0, allocator->GetMemoryHeapCount());
+    VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+    allocator->GetHeapBudgets(budgets, 0, allocator->GetMemoryHeapCount());
 
-        VmaTotalStatistics stats;
-        allocator->CalculateStatistics(&stats);
+    VmaTotalStatistics stats;
+    allocator->CalculateStatistics(&stats);
 
-        VmaJsonWriter json(allocator->GetAllocationCallbacks(), sb);
+    VmaJsonWriter json(allocator->GetAllocationCallbacks(), sb);
+    json.BeginObject();
+    {
+        json.WriteString("General");
         json.BeginObject();
         {
-            json.WriteString("General");
-            json.BeginObject();
-            {
-                const VkPhysicalDeviceProperties& deviceProperties = allocator->m_PhysicalDeviceProperties;
-                const VkPhysicalDeviceMemoryProperties& memoryProperties = allocator->m_MemProps;
-
-                json.WriteString("API");
-                json.WriteString("Vulkan");
-
-                json.WriteString("apiVersion");
-                json.BeginString();
-                json.ContinueString(VK_VERSION_MAJOR(deviceProperties.apiVersion));
-                json.ContinueString(".");
-                json.ContinueString(VK_VERSION_MINOR(deviceProperties.apiVersion));
-                json.ContinueString(".");
-                json.ContinueString(VK_VERSION_PATCH(deviceProperties.apiVersion));
-                json.EndString();
+            const VkPhysicalDeviceProperties& deviceProperties = allocator->m_PhysicalDeviceProperties;
+            const VkPhysicalDeviceMemoryProperties& memoryProperties = allocator->m_MemProps;
 
-                json.WriteString("GPU");
-                json.WriteString(deviceProperties.deviceName);
-                json.WriteString("deviceType");
-                json.WriteNumber(static_cast<uint32_t>(deviceProperties.deviceType));
-
-                json.WriteString("maxMemoryAllocationCount");
-                json.WriteNumber(deviceProperties.limits.maxMemoryAllocationCount);
-                json.WriteString("bufferImageGranularity");
-                json.WriteNumber(deviceProperties.limits.bufferImageGranularity);
-                json.WriteString("nonCoherentAtomSize");
-                json.WriteNumber(deviceProperties.limits.nonCoherentAtomSize);
-
-                json.WriteString("memoryHeapCount");
-                json.WriteNumber(memoryProperties.memoryHeapCount);
-                json.WriteString("memoryTypeCount");
-                json.WriteNumber(memoryProperties.memoryTypeCount);
-            }
-            json.EndObject();
-        }
-        {
-            json.WriteString("Total");
-            VmaPrintDetailedStatistics(json, stats.total);
+            json.WriteString("API");
+            json.WriteString("Vulkan");
+
+            json.WriteString("apiVersion");
+            json.BeginString();
+            json.ContinueString(VK_VERSION_MAJOR(deviceProperties.apiVersion));
+            json.ContinueString(".");
+            json.ContinueString(VK_VERSION_MINOR(deviceProperties.apiVersion));
+            json.ContinueString(".");
+            json.ContinueString(VK_VERSION_PATCH(deviceProperties.apiVersion));
+            json.EndString();
+
+            json.WriteString("GPU");
+            json.WriteString(deviceProperties.deviceName);
+            json.WriteString("deviceType");
+            json.WriteNumber(static_cast<uint32_t>(deviceProperties.deviceType));
+
+            json.WriteString("maxMemoryAllocationCount");
+            json.WriteNumber(deviceProperties.limits.maxMemoryAllocationCount);
+            json.WriteString("bufferImageGranularity");
+            json.WriteNumber(deviceProperties.limits.bufferImageGranularity);
+            json.WriteString("nonCoherentAtomSize");
+            json.WriteNumber(deviceProperties.limits.nonCoherentAtomSize);
+
+            json.WriteString("memoryHeapCount");
+            json.WriteNumber(memoryProperties.memoryHeapCount);
+            json.WriteString("memoryTypeCount");
+            json.WriteNumber(memoryProperties.memoryTypeCount);
         }
+        json.EndObject();
+    }
+    {
+        json.WriteString("Total");
+        VmaPrintDetailedStatistics(json, stats.total);
+    }
+    {
+        json.WriteString("MemoryInfo");
+        json.BeginObject();
         {
-            json.WriteString("MemoryInfo");
-            json.BeginObject();
+            for (uint32_t heapIndex = 0; heapIndex < allocator->GetMemoryHeapCount(); ++heapIndex)
             {
-                for (uint32_t heapIndex = 0; heapIndex < allocator->GetMemoryHeapCount(); ++heapIndex)
+                json.BeginString("Heap ");
+                json.ContinueString(heapIndex);
+                json.EndString();
+                json.BeginObject();
                 {
-                    json.BeginString("Heap ");
-                    json.ContinueString(heapIndex);
-                    json.EndString();
-                    json.BeginObject();
+                    const VkMemoryHeap& heapInfo = allocator->m_MemProps.memoryHeaps[heapIndex];
+                    json.WriteString("Flags");
+                    json.BeginArray(true);
                     {
-                        const VkMemoryHeap& heapInfo = allocator->m_MemProps.memoryHeaps[heapIndex];
-                        json.WriteString("Flags");
-                        json.BeginArray(true);
-                        {
-                            if (heapInfo.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
-                                json.WriteString("DEVICE_LOCAL");
-                        #if VMA_VULKAN_VERSION >= 1001000
-                            if (heapInfo.flags & VK_MEMORY_HEAP_MULTI_INSTANCE_BIT)
-                                json.WriteString("MULTI_INSTANCE");
-                        #endif
-
-                            VkMemoryHeapFlags flags = heapInfo.flags &
-                                ~(VK_MEMORY_HEAP_DEVICE_LOCAL_BIT
-                        #if VMA_VULKAN_VERSION >= 1001000
-                                    | VK_MEMORY_HEAP_MULTI_INSTANCE_BIT
-                        #endif
-                                    );
-                            if (flags != 0)
-                                json.WriteNumber(flags);
-                        }
-                        json.EndArray();
+                        if (heapInfo.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+                            json.WriteString("DEVICE_LOCAL");
+                    #if VMA_VULKAN_VERSION >= 1001000
+                        if (heapInfo.flags & VK_MEMORY_HEAP_MULTI_INSTANCE_BIT)
+                            json.WriteString("MULTI_INSTANCE");
+                    #endif
+
+                        VkMemoryHeapFlags flags = heapInfo.flags &
+                            ~(VK_MEMORY_HEAP_DEVICE_LOCAL_BIT
+                    #if VMA_VULKAN_VERSION >= 1001000
+                                | VK_MEMORY_HEAP_MULTI_INSTANCE_BIT
+                    #endif
+                                );
+                        if (flags != 0)
+                            json.WriteNumber(flags);
+                    }
+                    json.EndArray();
 
-                        json.WriteString("Size");
-                        json.WriteNumber(heapInfo.size);
+                    json.WriteString("Size");
+                    json.WriteNumber(heapInfo.size);
 
-                        json.WriteString("Budget");
-                        json.BeginObject();
-                        {
-                            json.WriteString("BudgetBytes");
-                            json.WriteNumber(budgets[heapIndex].budget);
-                            json.WriteString("UsageBytes");
-                            json.WriteNumber(budgets[heapIndex].usage);
-                        }
-                        json.EndObject();
+                    json.WriteString("Budget");
+                    json.BeginObject();
+                    {
+                        json.WriteString("BudgetBytes");
+                        json.WriteNumber(budgets[heapIndex].budget);
+                        json.WriteString("UsageBytes");
+                        json.WriteNumber(budgets[heapIndex].usage);
+                    }
+                    json.EndObject();
 
-                        json.WriteString("Stats");
-                        VmaPrintDetailedStatistics(json, stats.memoryHeap[heapIndex]);
+                    json.WriteString("Stats");
+                    VmaPrintDetailedStatistics(json, stats.memoryHeap[heapIndex]);
 
-                        json.WriteString("MemoryPools");
-                        json.BeginObject();
+                    json.WriteString("MemoryPools");
+                    json.BeginObject();
+                    {
+                        for (uint32_t typeIndex = 0; typeIndex < allocator->GetMemoryTypeCount(); ++typeIndex)
                         {
-                            for (uint32_t typeIndex = 0; typeIndex < allocator->GetMemoryTypeCount(); ++typeIndex)
+                            if (allocator->MemoryTypeIndexToHeapIndex(typeIndex) == heapIndex)
                             {
-                                if (allocator->MemoryTypeIndexToHeapIndex(typeIndex) == heapIndex)
+                                json.BeginString("Type ");
+                                json.ContinueString(typeIndex);
+                                json.EndString();
+                                json.BeginObject();
                                 {
-                                    json.BeginString("Type ");
-                                    json.ContinueString(typeIndex);
-                                    json.EndString();
-                                    json.BeginObject();
+                                    json.WriteString("Flags");
+                                    json.BeginArray(true);
                                     {
-                                        json.WriteString("Flags");
-                                        json.BeginArray(true);
-                                        {
-                                            VkMemoryPropertyFlags flags = allocator->m_MemProps.memoryTypes[typeIndex].propertyFlags;
-                                            if (flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
-                                                json.WriteString("DEVICE_LOCAL");
-                                            if (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
-                                                json.WriteString("HOST_VISIBLE");
-                                            if (flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
-                                                json.WriteString("HOST_COHERENT");
-                                            if (flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT)
-                                                json.WriteString("HOST_CACHED");
-                                            if (flags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)
-                                                json.WriteString("LAZILY_ALLOCATED");
-                                        #if VMA_VULKAN_VERSION >= 1001000
-                                            if (flags & VK_MEMORY_PROPERTY_PROTECTED_BIT)
-                                                json.WriteString("PROTECTED");
-                                        #endif
-                                        #if VK_AMD_device_coherent_memory
-                                            if (flags & VK_MEMORY_PROPERTY_DEVICE_COHERENT_BIT_AMD_COPY)
-                                                json.WriteString("DEVICE_COHERENT_AMD");
-                                            if (flags & VK_MEMORY_PROPERTY_DEVICE_UNCACHED_BIT_AMD_COPY)
-                                                json.WriteString("DEVICE_UNCACHED_AMD");
-                                        #endif
-
-                                            flags &= ~(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-                                        #if VMA_VULKAN_VERSION >= 1001000
-                                                | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT
-                                        #endif
-                                        #if VK_AMD_device_coherent_memory
-                                                | VK_MEMORY_PROPERTY_DEVICE_COHERENT_BIT_AMD_COPY
-                                                | VK_MEMORY_PROPERTY_DEVICE_UNCACHED_BIT_AMD_COPY
-                                        #endif
-                                                | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
-                                                | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-                                                | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
-                                            if (flags != 0)
-                                                json.WriteNumber(flags);
-                                        }
-                                        json.EndArray();
-
-                                        json.WriteString("Stats");
-                                        VmaPrintDetailedStatistics(json, stats.memoryType[typeIndex]);
+                                        VkMemoryPropertyFlags flags = allocator->m_MemProps.memoryTypes[typeIndex].propertyFlags;
+                                        if (flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+                                            json.WriteString("DEVICE_LOCAL");
+                                        if (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+                                            json.WriteString("HOST_VISIBLE");
+                                        if (flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+                                            json.WriteString("HOST_COHERENT");
+                                        if (flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT)
+                                            json.WriteString("HOST_CACHED");
+                                        if (flags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)
+                                            json.WriteString("LAZILY_ALLOCATED");
+                                    #if VMA_VULKAN_VERSION >= 1001000
+                                        if (flags & VK_MEMORY_PROPERTY_PROTECTED_BIT)
+                                            json.WriteString("PROTECTED");
+                                    #endif
+                                    #if VK_AMD_device_coherent_memory
+                                        if (flags & VK_MEMORY_PROPERTY_DEVICE_COHERENT_BIT_AMD_COPY)
+                                            json.WriteString("DEVICE_COHERENT_AMD");
+                                        if (flags & VK_MEMORY_PROPERTY_DEVICE_UNCACHED_BIT_AMD_COPY)
+                                            json.WriteString("DEVICE_UNCACHED_AMD");
+                                    #endif
+
+                                        flags &= ~(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+                                    #if VMA_VULKAN_VERSION >= 1001000
+                                            | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT
+                                    #endif
+                                    #if VK_AMD_device_coherent_memory
+                                            | VK_MEMORY_PROPERTY_DEVICE_COHERENT_BIT_AMD_COPY
+                                            | VK_MEMORY_PROPERTY_DEVICE_UNCACHED_BIT_AMD_COPY
+                                    #endif
+                                            | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+                                            | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+                                            | VK_MEMORY_PROPERTY_HOST_CACHED_BIT);
+                                        if (flags != 0)
+                                            json.WriteNumber(flags);
                                     }
-                                    json.EndObject();
+                                    json.EndArray();
+
+                                    json.WriteString("Stats");
+                                    VmaPrintDetailedStatistics(json, stats.memoryType[typeIndex]);
                                 }
+                                json.EndObject();
                             }
-
                         }
-                        json.EndObject();
+
                     }
                     json.EndObject();
                 }
+                json.EndObject();
+                json.FlushIfNeeded();
             }
-            json.EndObject();
         }
-
-        if (detailedMap == VK_TRUE)
-            allocator->PrintDetailedMap(json);
-
         json.EndObject();
     }
 
+    if (detailedMap)
+        allocator->PrintDetailedMap(json);
+
+    json.EndObject();
+}
+
+VMA_CALL_PRE void VMA_CALL_POST vmaBuildStatsString(
+    VmaAllocator allocator,
+    char** ppStatsString,
+    VkBool32 detailedMap)
+{
+    VMA_ASSERT(allocator && ppStatsString);
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+
+    VmaStringBuilder sb(allocator->GetAllocationCallbacks());
+    VmaBuildStatsString(allocator, sb, detailedMap != VK_FALSE);
     *ppStatsString = VmaCreateStringCopy(allocator->GetAllocationCallbacks(), sb.GetData(), sb.GetLength());
 }
 
@@ -16337,6 +22675,20 @@ VMA_CALL_PRE void VMA_CALL_POST vmaFreeStatsString(
     }
 }
 
+VMA_CALL_PRE void VMA_CALL_POST vmaWriteStatsString(
+    VmaAllocator allocator,
+    PFN_vmaWriteStatsStringFunction pfnWrite,
+    void* pUserData,
+    VkBool32 detailedMap)
+{
+    VMA_ASSERT(allocator && pfnWrite);
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+
+    VmaStringBuilder sb(allocator->GetAllocationCallbacks(), pfnWrite, pUserData);
+    VmaBuildStatsString(allocator, sb, detailedMap != VK_FALSE);
+    sb.Flush();
+}
+
 #endif // VMA_STATS_STRING_ENABLED
 
 /*
@@ -16721,6 +23073,12 @@ VMA_CALL_PRE void VMA_CALL_POST vmaFreeMemory(
 
     VMA_DEBUG_GLOBAL_MUTEX_LOCK
 
+    if(allocator->IsDeferredFreeEnabled())
+    {
+        allocator->DeferFree(1, &allocation, VMA_NULL, VMA_NULL);
+        return;
+    }
+
     allocator->FreeMemory(
         1, // allocationCount
         &allocation);
@@ -16742,6 +23100,12 @@ VMA_CALL_PRE void VMA_CALL_POST vmaFreeMemoryPages(
 
     VMA_DEBUG_GLOBAL_MUTEX_LOCK
 
+    if(allocator->IsDeferredFreeEnabled())
+    {
+        allocator->DeferFree(allocationCount, pAllocations, VMA_NULL, VMA_NULL);
+        return;
+    }
+
     allocator->FreeMemory(allocationCount, pAllocations);
 }
 
@@ -16787,6 +23151,14 @@ VMA_CALL_PRE void VMA_CALL_POST vmaGetAllocationMemoryProperties(
     *pFlags = allocator->m_MemProps.memoryTypes[memTypeIndex].propertyFlags;
 }
 
+VMA_CALL_PRE void VMA_CALL_POST vmaTouchAllocation(
+    VmaAllocator VMA_NOT_NULL allocator,
+    VmaAllocation VMA_NOT_NULL allocation)
+{
+    VMA_ASSERT(allocator && allocation);
+    allocation->Touch(allocator->GetCurrentFrameIndex());
+}
+
 VMA_CALL_PRE VkResult VMA_CALL_POST vmaMapMemory(
     VmaAllocator allocator,
     VmaAllocation allocation,
@@ -16894,83 +23266,345 @@ VMA_CALL_PRE VkResult VMA_CALL_POST vmaInvalidateAllocations(
     return res;
 }
 
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaCreateCacheRangeBatch(
+    VmaAllocator allocator,
+    VmaCacheRangeBatch* pBatch)
+{
+    VMA_ASSERT(allocator && pBatch);
+
+    VMA_DEBUG_LOG("vmaCreateCacheRangeBatch");
+
+    *pBatch = vma_new(allocator, VmaCacheRangeBatch_T)(allocator);
+    return VK_SUCCESS;
+}
+
+VMA_CALL_PRE void VMA_CALL_POST vmaDestroyCacheRangeBatch(
+    VmaAllocator allocator,
+    VmaCacheRangeBatch batch)
+{
+    VMA_ASSERT(allocator);
+
+    if(batch != VK_NULL_HANDLE)
+    {
+        VMA_DEBUG_LOG("vmaDestroyCacheRangeBatch");
+        vma_delete(allocator, batch);
+    }
+}
+
+VMA_CALL_PRE void VMA_CALL_POST vmaAddCacheRange(
+    VmaAllocator allocator,
+    VmaCacheRangeBatch batch,
+    VmaAllocation allocation,
+    VkDeviceSize offset,
+    VkDeviceSize size)
+{
+    VMA_ASSERT(allocator && batch && allocation);
+    batch->Add(allocation, offset, size);
+}
+
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaFlushCacheRangeBatch(
+    VmaAllocator allocator,
+    VmaCacheRangeBatch batch)
+{
+    VMA_ASSERT(allocator && batch);
+
+    VMA_DEBUG_LOG("vmaFlushCacheRangeBatch");
+
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+
+    return batch->Submit(VMA_CACHE_FLUSH);
+}
+
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaInvalidateCacheRangeBatch(
+    VmaAllocator allocator,
+    VmaCacheRangeBatch batch)
+{
+    VMA_ASSERT(allocator && batch);
+
+    VMA_DEBUG_LOG("vmaInvalidateCacheRangeBatch");
+
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+
+    return batch->Submit(VMA_CACHE_INVALIDATE);
+}
+
+VMA_CALL_PRE void VMA_CALL_POST vmaGetCacheRangeBatchStats(
+    VmaAllocator allocator,
+    VmaCacheRangeBatch batch,
+    VmaCacheRangeBatchStats* pStats)
+{
+    VMA_ASSERT(allocator && batch && pStats);
+    batch->GetStats(*pStats);
+}
+
 VMA_CALL_PRE VkResult VMA_CALL_POST vmaCheckCorruption(
     VmaAllocator allocator,
     uint32_t memoryTypeBits)
 {
     VMA_ASSERT(allocator);
 
-    VMA_DEBUG_LOG("vmaCheckCorruption");
+    VMA_DEBUG_LOG("vmaCheckCorruption");
+
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+
+    return allocator->CheckCorruption(memoryTypeBits);
+}
+
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaExportAllocationProfile(
+    VmaAllocator allocator,
+    size_t* pDataSize,
+    void* pData)
+{
+    VMA_ASSERT(allocator && pDataSize);
+
+    VMA_DEBUG_LOG("vmaExportAllocationProfile");
+
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+
+    return allocator->ExportProfile(pDataSize, pData);
+}
+
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaImportAllocationProfile(
+    VmaAllocator allocator,
+    size_t dataSize,
+    const void* pData)
+{
+    VMA_ASSERT(allocator && pData);
+
+    VMA_DEBUG_LOG("vmaImportAllocationProfile");
+
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+
+    return allocator->ImportProfile(dataSize, pData);
+}
+
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaPreallocateBlocks(
+    VmaAllocator allocator,
+    uint32_t memoryTypeBits,
+    VkDeviceSize minFreeSize,
+    uint32_t* pAllocatedBlockCount)
+{
+    VMA_ASSERT(allocator);
+
+    VMA_DEBUG_LOG("vmaPreallocateBlocks");
+
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+
+    return allocator->PreallocateBlocks(memoryTypeBits, minFreeSize, pAllocatedBlockCount);
+}
+
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaBeginDefragmentation(
+    VmaAllocator allocator,
+    const VmaDefragmentationInfo* pInfo,
+    VmaDefragmentationContext* pContext)
+{
+    VMA_ASSERT(allocator && pInfo && pContext);
+
+    VMA_DEBUG_LOG("vmaBeginDefragmentation");
+
+    if (pInfo->pool != VMA_NULL)
+    {
+        // Check if run on supported algorithms
+        if (pInfo->pool->m_BlockVector.GetAlgorithm() &
+            (VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT | VMA_POOL_CREATE_SLAB_ALGORITHM_BIT | VMA_POOL_CREATE_BUDDY_ALGORITHM_BIT))
+            return VK_ERROR_FEATURE_NOT_PRESENT;
+    }
+
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+
+    // Suballocations parked in thread caches are not owned by the user, so they must not be moved.
+    // Caches are bypassed until the context is destroyed, so they don't get refilled in the meantime.
+    if (pInfo->pool == VMA_NULL)
+    {
+        ++allocator->m_DefragmentationContextCount;
+        allocator->FlushThreadCaches();
+    }
+
+    *pContext = vma_new(allocator, VmaDefragmentationContext_T)(allocator, *pInfo);
+    return VK_SUCCESS;
+}
+
+VMA_CALL_PRE void VMA_CALL_POST vmaEndDefragmentation(
+    VmaAllocator allocator,
+    VmaDefragmentationContext context,
+    VmaDefragmentationStats* pStats)
+{
+    VMA_ASSERT(allocator && context);
+
+    VMA_DEBUG_LOG("vmaEndDefragmentation");
+
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+
+    if (pStats)
+        context->GetStats(*pStats);
+    if (context->IsForDefaultPools())
+        --allocator->m_DefragmentationContextCount;
+    vma_delete(allocator, context);
+}
+
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaBeginDefragmentationPass(
+    VmaAllocator VMA_NOT_NULL allocator,
+    VmaDefragmentationContext VMA_NOT_NULL context,
+    VmaDefragmentationPassMoveInfo* VMA_NOT_NULL pPassInfo)
+{
+    VMA_ASSERT(context && pPassInfo);
+
+    VMA_DEBUG_LOG("vmaBeginDefragmentationPass");
+
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+
+    return context->DefragmentPassBegin(*pPassInfo);
+}
+
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaEndDefragmentationPass(
+    VmaAllocator VMA_NOT_NULL allocator,
+    VmaDefragmentationContext VMA_NOT_NULL context,
+    VmaDefragmentationPassMoveInfo* VMA_NOT_NULL pPassInfo)
+{
+    VMA_ASSERT(context && pPassInfo);
+
+    VMA_DEBUG_LOG("vmaEndDefragmentationPass");
+
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+
+    return context->DefragmentPassEnd(*pPassInfo);
+}
+
+#if VMA_TIMELINE_SEMAPHORE
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaCreateDefragmentationExecutor(
+    VmaAllocator allocator,
+    const VmaDefragmentationExecutorCreateInfo* pCreateInfo,
+    VmaDefragmentationExecutor* pExecutor)
+{
+    VMA_ASSERT(allocator && pCreateInfo && pCreateInfo->transferQueue && pExecutor);
+
+    VMA_DEBUG_LOG("vmaCreateDefragmentationExecutor");
+
+    *pExecutor = vma_new(allocator, VmaDefragmentationExecutor_T)(allocator, *pCreateInfo);
+    // Begins defragmentation through the public function, so global mutex is not locked here.
+    VkResult res = (*pExecutor)->Init();
+    if (res != VK_SUCCESS)
+    {
+        vma_delete(allocator, *pExecutor);
+        *pExecutor = VK_NULL_HANDLE;
+    }
+    return res;
+}
+
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaStepDefragmentationExecutor(
+    VmaAllocator allocator,
+    VmaDefragmentationExecutor executor)
+{
+    VMA_ASSERT(allocator && executor);
+
+    VMA_DEBUG_LOG("vmaStepDefragmentationExecutor");
+
+    // Global mutex is not locked, as pfnAllocationMoved may call back into the library.
+    return executor->Step();
+}
+
+VMA_CALL_PRE void VMA_CALL_POST vmaGetDefragmentationExecutorSemaphore(
+    VmaAllocator allocator,
+    VmaDefragmentationExecutor executor,
+    VkSemaphore* pSemaphore,
+    uint64_t* pValue)
+{
+    VMA_ASSERT(allocator && executor && pSemaphore && pValue);
+    executor->GetSemaphore(*pSemaphore, *pValue);
+}
+
+VMA_CALL_PRE void VMA_CALL_POST vmaDestroyDefragmentationExecutor(
+    VmaAllocator allocator,
+    VmaDefragmentationExecutor executor,
+    VmaDefragmentationStats* pStats)
+{
+    VMA_ASSERT(allocator);
+
+    if (executor == VK_NULL_HANDLE)
+    {
+        if (pStats != VMA_NULL)
+            *pStats = {};
+        return;
+    }
 
-    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+    VMA_DEBUG_LOG("vmaDestroyDefragmentationExecutor");
 
-    return allocator->CheckCorruption(memoryTypeBits);
+    executor->Finish(pStats);
+    vma_delete(allocator, executor);
 }
+#endif // #if VMA_TIMELINE_SEMAPHORE
 
-VMA_CALL_PRE VkResult VMA_CALL_POST vmaBeginDefragmentation(
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaCreateResidencyManager(
     VmaAllocator allocator,
-    const VmaDefragmentationInfo* pInfo,
-    VmaDefragmentationContext* pContext)
+    const VmaResidencyManagerCreateInfo* pCreateInfo,
+    VmaResidencyManager* pManager)
 {
-    VMA_ASSERT(allocator && pInfo && pContext);
+    VMA_ASSERT(allocator && pCreateInfo && pManager);
+    VMA_ASSERT(pCreateInfo->demoteThreshold > 0.f && pCreateInfo->demoteThreshold <= 1.f);
+    VMA_ASSERT(pCreateInfo->promoteThreshold > 0.f && pCreateInfo->promoteThreshold <= pCreateInfo->demoteThreshold);
 
-    VMA_DEBUG_LOG("vmaBeginDefragmentation");
+    VMA_DEBUG_LOG("vmaCreateResidencyManager");
 
-    if (pInfo->pool != VMA_NULL)
+    if (!(pCreateInfo->demoteThreshold > 0.f && pCreateInfo->demoteThreshold <= 1.f) ||
+        !(pCreateInfo->promoteThreshold > 0.f && pCreateInfo->promoteThreshold <= pCreateInfo->demoteThreshold))
     {
-        // Check if run on supported algorithms
-        if (pInfo->pool->m_BlockVector.GetAlgorithm() & VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT)
-            return VK_ERROR_FEATURE_NOT_PRESENT;
+        return VK_ERROR_INITIALIZATION_FAILED;
     }
 
-    VMA_DEBUG_GLOBAL_MUTEX_LOCK
-
-    *pContext = vma_new(allocator, VmaDefragmentationContext_T)(allocator, *pInfo);
+    *pManager = vma_new(allocator, VmaResidencyManager_T)(allocator, *pCreateInfo);
     return VK_SUCCESS;
 }
 
-VMA_CALL_PRE void VMA_CALL_POST vmaEndDefragmentation(
+VMA_CALL_PRE void VMA_CALL_POST vmaDestroyResidencyManager(
     VmaAllocator allocator,
-    VmaDefragmentationContext context,
-    VmaDefragmentationStats* pStats)
+    VmaResidencyManager manager)
 {
-    VMA_ASSERT(allocator && context);
+    VMA_ASSERT(allocator);
 
-    VMA_DEBUG_LOG("vmaEndDefragmentation");
+    if (manager == VK_NULL_HANDLE)
+        return;
 
-    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+    VMA_DEBUG_LOG("vmaDestroyResidencyManager");
 
-    if (pStats)
-        context->GetStats(*pStats);
-    vma_delete(allocator, context);
+    vma_delete(allocator, manager);
 }
 
-VMA_CALL_PRE VkResult VMA_CALL_POST vmaBeginDefragmentationPass(
-    VmaAllocator VMA_NOT_NULL allocator,
-    VmaDefragmentationContext VMA_NOT_NULL context,
-    VmaDefragmentationPassMoveInfo* VMA_NOT_NULL pPassInfo)
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaBeginResidencyPass(
+    VmaAllocator allocator,
+    VmaResidencyManager manager,
+    VmaDefragmentationPassMoveInfo* pPassInfo)
 {
-    VMA_ASSERT(context && pPassInfo);
+    VMA_ASSERT(allocator && manager && pPassInfo);
 
-    VMA_DEBUG_LOG("vmaBeginDefragmentationPass");
+    VMA_DEBUG_LOG("vmaBeginResidencyPass");
 
     VMA_DEBUG_GLOBAL_MUTEX_LOCK
 
-    return context->DefragmentPassBegin(*pPassInfo);
+    return manager->PassBegin(*pPassInfo);
 }
 
-VMA_CALL_PRE VkResult VMA_CALL_POST vmaEndDefragmentationPass(
-    VmaAllocator VMA_NOT_NULL allocator,
-    VmaDefragmentationContext VMA_NOT_NULL context,
-    VmaDefragmentationPassMoveInfo* VMA_NOT_NULL pPassInfo)
+VMA_CALL_PRE void VMA_CALL_POST vmaEndResidencyPass(
+    VmaAllocator allocator,
+    VmaResidencyManager manager,
+    VmaDefragmentationPassMoveInfo* pPassInfo)
 {
-    VMA_ASSERT(context && pPassInfo);
+    VMA_ASSERT(allocator && manager && pPassInfo);
 
-    VMA_DEBUG_LOG("vmaEndDefragmentationPass");
+    VMA_DEBUG_LOG("vmaEndResidencyPass");
 
     VMA_DEBUG_GLOBAL_MUTEX_LOCK
 
-    return context->DefragmentPassEnd(*pPassInfo);
+    manager->PassEnd(*pPassInfo);
+}
+
+VMA_CALL_PRE void VMA_CALL_POST vmaGetResidencyStats(
+    VmaAllocator allocator,
+    VmaResidencyManager manager,
+    VmaResidencyStats* pFrameStats,
+    VmaResidencyStats* pTotalStats)
+{
+    VMA_ASSERT(allocator && manager);
+    manager->GetStats(pFrameStats, pTotalStats);
 }
 
 VMA_CALL_PRE VkResult VMA_CALL_POST vmaBindBufferMemory(
@@ -17290,6 +23924,12 @@ VMA_CALL_PRE void VMA_CALL_POST vmaDestroyBuffer(
 
     VMA_DEBUG_GLOBAL_MUTEX_LOCK
 
+    if(allocator->IsDeferredFreeEnabled())
+    {
+        allocator->DeferFree(1, &allocation, &buffer, VMA_NULL);
+        return;
+    }
+
     if(buffer != VK_NULL_HANDLE)
     {
         (*allocator->GetVulkanFunctions().vkDestroyBuffer)(allocator->m_hDevice, buffer, allocator->GetAllocationCallbacks());
@@ -17303,6 +23943,165 @@ VMA_CALL_PRE void VMA_CALL_POST vmaDestroyBuffer(
     }
 }
 
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaCreateBuffers(
+    VmaAllocator allocator,
+    const VkBufferCreateInfo* pBufferCreateInfo,
+    const VmaAllocationCreateInfo* pAllocationCreateInfo,
+    size_t bufferCount,
+    VkBuffer* pBuffers,
+    VmaAllocation* pAllocations,
+    VmaAllocationInfo* pAllocationInfos)
+{
+    if(bufferCount == 0)
+    {
+        return VK_SUCCESS;
+    }
+
+    VMA_ASSERT(allocator && pBufferCreateInfo && pAllocationCreateInfo && pBuffers && pAllocations);
+
+    if(pBufferCreateInfo->size == 0)
+    {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+    if((pBufferCreateInfo->usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT_COPY) != 0 &&
+        !allocator->m_UseKhrBufferDeviceAddress)
+    {
+        VMA_ASSERT(0 && "Creating a buffer with VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT is not valid if VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT was not used.");
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    VMA_DEBUG_LOG("vmaCreateBuffers");
+
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+
+    memset(pBuffers, 0, sizeof(VkBuffer) * bufferCount);
+    memset(pAllocations, 0, sizeof(VmaAllocation) * bufferCount);
+
+    // 1. Create VkBuffers.
+    VkResult res = VK_SUCCESS;
+    for(size_t bufferIndex = 0; bufferIndex < bufferCount && res >= 0; ++bufferIndex)
+    {
+        res = (*allocator->GetVulkanFunctions().vkCreateBuffer)(
+            allocator->m_hDevice,
+            pBufferCreateInfo,
+            allocator->GetAllocationCallbacks(),
+            pBuffers + bufferIndex);
+    }
+    if(res >= 0)
+    {
+        // 2. vkGetBufferMemoryRequirements. Identical for all buffers created with the same parameters.
+        VkMemoryRequirements vkMemReq = {};
+        bool requiresDedicatedAllocation = false;
+        bool prefersDedicatedAllocation  = false;
+        allocator->GetBufferMemoryRequirements(pBuffers[0], vkMemReq,
+            requiresDedicatedAllocation, prefersDedicatedAllocation);
+
+        // 3. Allocate memory using allocator.
+        if(requiresDedicatedAllocation || prefersDedicatedAllocation)
+        {
+            // Dedicated allocation is made for a specific buffer.
+            for(size_t bufferIndex = 0; bufferIndex < bufferCount && res >= 0; ++bufferIndex)
+            {
+                res = allocator->AllocateMemory(
+                    vkMemReq,
+                    requiresDedicatedAllocation,
+                    prefersDedicatedAllocation,
+                    pBuffers[bufferIndex], // dedicatedBuffer
+                    VK_NULL_HANDLE, // dedicatedImage
+                    pBufferCreateInfo->usage, // dedicatedBufferImageUsage
+                    *pAllocationCreateInfo,
+                    VMA_SUBALLOCATION_TYPE_BUFFER,
+                    1, // allocationCount
+                    pAllocations + bufferIndex);
+            }
+        }
+        else
+        {
+            res = allocator->AllocateMemory(
+                vkMemReq,
+                false, // requiresDedicatedAllocation
+                false, // prefersDedicatedAllocation
+                VK_NULL_HANDLE, // dedicatedBuffer
+                VK_NULL_HANDLE, // dedicatedImage
+                pBufferCreateInfo->usage, // dedicatedBufferImageUsage
+                *pAllocationCreateInfo,
+                VMA_SUBALLOCATION_TYPE_BUFFER,
+                bufferCount,
+                pAllocations);
+        }
+
+        if(res >= 0)
+        {
+            // 4. Bind buffers with memory.
+            if((pAllocationCreateInfo->flags & VMA_ALLOCATION_CREATE_DONT_BIND_BIT) == 0)
+            {
+                res = allocator->BindBufferMemories(bufferCount, pAllocations, pBuffers);
+            }
+            if(res >= 0)
+            {
+                // All steps succeeded.
+                for(size_t bufferIndex = 0; bufferIndex < bufferCount; ++bufferIndex)
+                {
+                    #if VMA_STATS_STRING_ENABLED
+                        pAllocations[bufferIndex]->InitBufferImageUsage(pBufferCreateInfo->usage);
+                    #endif
+                    if(pAllocationInfos != VMA_NULL)
+                    {
+                        allocator->GetAllocationInfo(pAllocations[bufferIndex], pAllocationInfos + bufferIndex);
+                    }
+                }
+                return VK_SUCCESS;
+            }
+        }
+        allocator->FreeMemory(bufferCount, pAllocations);
+        memset(pAllocations, 0, sizeof(VmaAllocation) * bufferCount);
+    }
+
+    for(size_t bufferIndex = 0; bufferIndex < bufferCount; ++bufferIndex)
+    {
+        if(pBuffers[bufferIndex] != VK_NULL_HANDLE)
+        {
+            (*allocator->GetVulkanFunctions().vkDestroyBuffer)(allocator->m_hDevice, pBuffers[bufferIndex], allocator->GetAllocationCallbacks());
+            pBuffers[bufferIndex] = VK_NULL_HANDLE;
+        }
+    }
+    return res;
+}
+
+VMA_CALL_PRE void VMA_CALL_POST vmaDestroyBuffers(
+    VmaAllocator allocator,
+    size_t bufferCount,
+    const VkBuffer* pBuffers,
+    const VmaAllocation* pAllocations)
+{
+    if(bufferCount == 0)
+    {
+        return;
+    }
+
+    VMA_ASSERT(allocator && pBuffers && pAllocations);
+
+    VMA_DEBUG_LOG("vmaDestroyBuffers");
+
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+
+    if(allocator->IsDeferredFreeEnabled())
+    {
+        allocator->DeferFree(bufferCount, pAllocations, pBuffers, VMA_NULL);
+        return;
+    }
+
+    for(size_t bufferIndex = 0; bufferIndex < bufferCount; ++bufferIndex)
+    {
+        if(pBuffers[bufferIndex] != VK_NULL_HANDLE)
+        {
+            (*allocator->GetVulkanFunctions().vkDestroyBuffer)(allocator->m_hDevice, pBuffers[bufferIndex], allocator->GetAllocationCallbacks());
+        }
+    }
+
+    allocator->FreeMemory(bufferCount, pAllocations);
+}
+
 VMA_CALL_PRE VkResult VMA_CALL_POST vmaCreateImage(
     VmaAllocator allocator,
     const VkImageCreateInfo* pImageCreateInfo,
@@ -17395,83 +24194,336 @@ VMA_CALL_PRE VkResult VMA_CALL_POST vmaCreateImage(
     return res;
 }
 
-VMA_CALL_PRE VkResult VMA_CALL_POST vmaCreateAliasingImage(
-    VmaAllocator VMA_NOT_NULL allocator,
-    VmaAllocation VMA_NOT_NULL allocation,
-    const VkImageCreateInfo* VMA_NOT_NULL pImageCreateInfo,
-    VkImage VMA_NULLABLE_NON_DISPATCHABLE* VMA_NOT_NULL pImage)
-{
-    return vmaCreateAliasingImage2(allocator, allocation, 0, pImageCreateInfo, pImage);
-}
-
-VMA_CALL_PRE VkResult VMA_CALL_POST vmaCreateAliasingImage2(
-    VmaAllocator VMA_NOT_NULL allocator,
-    VmaAllocation VMA_NOT_NULL allocation,
-    VkDeviceSize allocationLocalOffset,
-    const VkImageCreateInfo* VMA_NOT_NULL pImageCreateInfo,
-    VkImage VMA_NULLABLE_NON_DISPATCHABLE* VMA_NOT_NULL pImage)
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaCreateAliasingImage(
+    VmaAllocator VMA_NOT_NULL allocator,
+    VmaAllocation VMA_NOT_NULL allocation,
+    const VkImageCreateInfo* VMA_NOT_NULL pImageCreateInfo,
+    VkImage VMA_NULLABLE_NON_DISPATCHABLE* VMA_NOT_NULL pImage)
+{
+    return vmaCreateAliasingImage2(allocator, allocation, 0, pImageCreateInfo, pImage);
+}
+
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaCreateAliasingImage2(
+    VmaAllocator VMA_NOT_NULL allocator,
+    VmaAllocation VMA_NOT_NULL allocation,
+    VkDeviceSize allocationLocalOffset,
+    const VkImageCreateInfo* VMA_NOT_NULL pImageCreateInfo,
+    VkImage VMA_NULLABLE_NON_DISPATCHABLE* VMA_NOT_NULL pImage)
+{
+    VMA_ASSERT(allocator && pImageCreateInfo && pImage && allocation);
+
+    *pImage = VK_NULL_HANDLE;
+
+    VMA_DEBUG_LOG("vmaCreateImage2");
+
+    if (pImageCreateInfo->extent.width == 0 ||
+        pImageCreateInfo->extent.height == 0 ||
+        pImageCreateInfo->extent.depth == 0 ||
+        pImageCreateInfo->mipLevels == 0 ||
+        pImageCreateInfo->arrayLayers == 0)
+    {
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+
+    // 1. Create VkImage.
+    VkResult res = (*allocator->GetVulkanFunctions().vkCreateImage)(
+        allocator->m_hDevice,
+        pImageCreateInfo,
+        allocator->GetAllocationCallbacks(),
+        pImage);
+    if (res >= 0)
+    {
+        // 2. Bind image with memory.
+        res = allocator->BindImageMemory(allocation, allocationLocalOffset, *pImage, VMA_NULL);
+        if (res >= 0)
+        {
+            return VK_SUCCESS;
+        }
+        (*allocator->GetVulkanFunctions().vkDestroyImage)(allocator->m_hDevice, *pImage, allocator->GetAllocationCallbacks());
+    }
+    return res;
+}
+
+VMA_CALL_PRE void VMA_CALL_POST vmaDestroyImage(
+    VmaAllocator VMA_NOT_NULL allocator,
+    VkImage VMA_NULLABLE_NON_DISPATCHABLE image,
+    VmaAllocation VMA_NULLABLE allocation)
+{
+    VMA_ASSERT(allocator);
+
+    if(image == VK_NULL_HANDLE && allocation == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    VMA_DEBUG_LOG("vmaDestroyImage");
+
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+
+    if(allocator->IsDeferredFreeEnabled())
+    {
+        allocator->DeferFree(1, &allocation, VMA_NULL, &image);
+        return;
+    }
+
+    if(image != VK_NULL_HANDLE)
+    {
+        (*allocator->GetVulkanFunctions().vkDestroyImage)(allocator->m_hDevice, image, allocator->GetAllocationCallbacks());
+    }
+    if(allocation != VK_NULL_HANDLE)
+    {
+        allocator->FreeMemory(
+            1, // allocationCount
+            &allocation);
+    }
+}
+
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaCreateSparseBuffer(
+    VmaAllocator allocator,
+    const VkBufferCreateInfo* pBufferCreateInfo,
+    const VmaAllocationCreateInfo* pAllocationCreateInfo,
+    VkBuffer* pBuffer,
+    VmaSparseResource* pResource)
+{
+    VMA_ASSERT(allocator && pBufferCreateInfo && pAllocationCreateInfo && pBuffer && pResource);
+
+    if(pBufferCreateInfo->size == 0 ||
+        (pBufferCreateInfo->flags & VK_BUFFER_CREATE_SPARSE_BINDING_BIT) == 0 ||
+        (pAllocationCreateInfo->flags & (VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT |
+            VMA_ALLOCATION_CREATE_CAN_BE_DEMOTED_BIT)) != 0)
+    {
+        VMA_ASSERT(0 && "Invalid parameters of a sparse buffer.");
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    VMA_DEBUG_LOG("vmaCreateSparseBuffer");
+
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+
+    *pBuffer = VK_NULL_HANDLE;
+    *pResource = VK_NULL_HANDLE;
+
+    VkResult res = (*allocator->GetVulkanFunctions().vkCreateBuffer)(
+        allocator->m_hDevice,
+        pBufferCreateInfo,
+        allocator->GetAllocationCallbacks(),
+        pBuffer);
+    if(res >= 0)
+    {
+        VkMemoryRequirements vkMemReq = {};
+        bool requiresDedicatedAllocation = false;
+        bool prefersDedicatedAllocation  = false;
+        allocator->GetBufferMemoryRequirements(*pBuffer, vkMemReq,
+            requiresDedicatedAllocation, prefersDedicatedAllocation);
+
+        *pResource = vma_new(allocator, VmaSparseResource_T)(allocator, *pBuffer, VK_NULL_HANDLE,
+            vkMemReq, pBufferCreateInfo->usage, *pAllocationCreateInfo, VMA_SUBALLOCATION_TYPE_BUFFER);
+    }
+    return res;
+}
+
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaCreateSparseImage(
+    VmaAllocator allocator,
+    const VkImageCreateInfo* pImageCreateInfo,
+    const VmaAllocationCreateInfo* pAllocationCreateInfo,
+    VkImage* pImage,
+    VmaSparseResource* pResource)
 {
-    VMA_ASSERT(allocator && pImageCreateInfo && pImage && allocation);
+    VMA_ASSERT(allocator && pImageCreateInfo && pAllocationCreateInfo && pImage && pResource);
 
-    *pImage = VK_NULL_HANDLE;
-
-    VMA_DEBUG_LOG("vmaCreateImage2");
-
-    if (pImageCreateInfo->extent.width == 0 ||
+    if(pImageCreateInfo->extent.width == 0 ||
         pImageCreateInfo->extent.height == 0 ||
         pImageCreateInfo->extent.depth == 0 ||
         pImageCreateInfo->mipLevels == 0 ||
-        pImageCreateInfo->arrayLayers == 0)
+        pImageCreateInfo->arrayLayers == 0 ||
+        (pImageCreateInfo->flags & VK_IMAGE_CREATE_SPARSE_BINDING_BIT) == 0 ||
+        (pAllocationCreateInfo->flags & (VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT |
+            VMA_ALLOCATION_CREATE_CAN_BE_DEMOTED_BIT)) != 0)
     {
+        VMA_ASSERT(0 && "Invalid parameters of a sparse image.");
         return VK_ERROR_INITIALIZATION_FAILED;
     }
+    const bool sparseResidency = (pImageCreateInfo->flags & VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT) != 0;
+    if(sparseResidency && allocator->GetVulkanFunctions().vkGetImageSparseMemoryRequirements == VMA_NULL)
+    {
+        VMA_ASSERT(0 && "vkGetImageSparseMemoryRequirements is required for images with VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT.");
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+    }
+
+    VMA_DEBUG_LOG("vmaCreateSparseImage");
 
     VMA_DEBUG_GLOBAL_MUTEX_LOCK
 
-    // 1. Create VkImage.
+    *pImage = VK_NULL_HANDLE;
+    *pResource = VK_NULL_HANDLE;
+
     VkResult res = (*allocator->GetVulkanFunctions().vkCreateImage)(
         allocator->m_hDevice,
         pImageCreateInfo,
         allocator->GetAllocationCallbacks(),
         pImage);
-    if (res >= 0)
+    if(res >= 0)
     {
-        // 2. Bind image with memory.
-        res = allocator->BindImageMemory(allocation, allocationLocalOffset, *pImage, VMA_NULL);
-        if (res >= 0)
+        VkMemoryRequirements vkMemReq = {};
+        bool requiresDedicatedAllocation = false;
+        bool prefersDedicatedAllocation  = false;
+        allocator->GetImageMemoryRequirements(*pImage, vkMemReq,
+            requiresDedicatedAllocation, prefersDedicatedAllocation);
+
+        const VmaSuballocationType suballocType = pImageCreateInfo->tiling == VK_IMAGE_TILING_OPTIMAL ?
+            VMA_SUBALLOCATION_TYPE_IMAGE_OPTIMAL :
+            VMA_SUBALLOCATION_TYPE_IMAGE_LINEAR;
+        *pResource = vma_new(allocator, VmaSparseResource_T)(allocator, VK_NULL_HANDLE, *pImage,
+            vkMemReq, pImageCreateInfo->usage, *pAllocationCreateInfo, suballocType);
+
+        if(sparseResidency)
         {
-            return VK_SUCCESS;
+            uint32_t requirementCount = 0;
+            (*allocator->GetVulkanFunctions().vkGetImageSparseMemoryRequirements)(
+                allocator->m_hDevice, *pImage, &requirementCount, VMA_NULL);
+            VmaVector<VkSparseImageMemoryRequirements, VmaStlAllocator<VkSparseImageMemoryRequirements>> requirements(
+                requirementCount, VmaStlAllocator<VkSparseImageMemoryRequirements>(allocator->GetAllocationCallbacks()));
+            (*allocator->GetVulkanFunctions().vkGetImageSparseMemoryRequirements)(
+                allocator->m_hDevice, *pImage, &requirementCount, requirements.data());
+            (*pResource)->InitImageTiles(*pImageCreateInfo, requirementCount, requirements.data());
         }
-        (*allocator->GetVulkanFunctions().vkDestroyImage)(allocator->m_hDevice, *pImage, allocator->GetAllocationCallbacks());
     }
     return res;
 }
 
-VMA_CALL_PRE void VMA_CALL_POST vmaDestroyImage(
-    VmaAllocator VMA_NOT_NULL allocator,
-    VkImage VMA_NULLABLE_NON_DISPATCHABLE image,
-    VmaAllocation VMA_NULLABLE allocation)
+VMA_CALL_PRE void VMA_CALL_POST vmaDestroySparseResource(
+    VmaAllocator allocator,
+    VmaSparseResource resource)
 {
     VMA_ASSERT(allocator);
 
-    if(image == VK_NULL_HANDLE && allocation == VK_NULL_HANDLE)
+    if(resource == VK_NULL_HANDLE)
     {
         return;
     }
 
-    VMA_DEBUG_LOG("vmaDestroyImage");
+    VMA_DEBUG_LOG("vmaDestroySparseResource");
 
     VMA_DEBUG_GLOBAL_MUTEX_LOCK
 
-    if(image != VK_NULL_HANDLE)
+    if(resource->GetBuffer() != VK_NULL_HANDLE)
     {
-        (*allocator->GetVulkanFunctions().vkDestroyImage)(allocator->m_hDevice, image, allocator->GetAllocationCallbacks());
+        (*allocator->GetVulkanFunctions().vkDestroyBuffer)(allocator->m_hDevice, resource->GetBuffer(), allocator->GetAllocationCallbacks());
     }
-    if(allocation != VK_NULL_HANDLE)
+    else
     {
-        allocator->FreeMemory(
-            1, // allocationCount
-            &allocation);
+        (*allocator->GetVulkanFunctions().vkDestroyImage)(allocator->m_hDevice, resource->GetImage(), allocator->GetAllocationCallbacks());
+    }
+    vma_delete(allocator, resource);
+}
+
+VMA_CALL_PRE void VMA_CALL_POST vmaGetSparseResourceInfo(
+    VmaAllocator allocator,
+    VmaSparseResource resource,
+    VmaSparseResourceInfo* pInfo)
+{
+    VMA_ASSERT(allocator && resource && pInfo);
+    resource->GetInfo(*pInfo);
+}
+
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaCommitSparsePages(
+    VmaAllocator allocator,
+    VmaSparseResource resource,
+    VkDeviceSize firstPage,
+    VkDeviceSize pageCount)
+{
+    VMA_ASSERT(allocator && resource);
+
+    VMA_DEBUG_LOG("vmaCommitSparsePages");
+
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+
+    return resource->Commit(firstPage, pageCount);
+}
+
+VMA_CALL_PRE void VMA_CALL_POST vmaDecommitSparsePages(
+    VmaAllocator allocator,
+    VmaSparseResource resource,
+    VkDeviceSize firstPage,
+    VkDeviceSize pageCount)
+{
+    VMA_ASSERT(allocator && resource);
+
+    VMA_DEBUG_LOG("vmaDecommitSparsePages");
+
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+
+    resource->Decommit(firstPage, pageCount);
+}
+
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaCommitSparseImageRegion(
+    VmaAllocator allocator,
+    VmaSparseResource resource,
+    const VmaSparseImageRegion* pRegion)
+{
+    VMA_ASSERT(allocator && resource && pRegion);
+    VMA_ASSERT(resource->GetImage() != VK_NULL_HANDLE);
+
+    VMA_DEBUG_LOG("vmaCommitSparseImageRegion");
+
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+
+    return resource->CommitRegion(*pRegion);
+}
+
+VMA_CALL_PRE void VMA_CALL_POST vmaDecommitSparseImageRegion(
+    VmaAllocator allocator,
+    VmaSparseResource resource,
+    const VmaSparseImageRegion* pRegion)
+{
+    VMA_ASSERT(allocator && resource && pRegion);
+    VMA_ASSERT(resource->GetImage() != VK_NULL_HANDLE);
+
+    VMA_DEBUG_LOG("vmaDecommitSparseImageRegion");
+
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+
+    resource->DecommitRegion(*pRegion);
+}
+
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaBindSparsePages(
+    VmaAllocator allocator,
+    VkQueue queue,
+    uint32_t resourceCount,
+    const VmaSparseResource* pResources,
+    const VmaSparseBindSubmitInfo* pSubmitInfo)
+{
+    VMA_ASSERT(allocator && queue && (resourceCount == 0 || pResources));
+
+    if(allocator->GetVulkanFunctions().vkQueueBindSparse == VMA_NULL)
+    {
+        VMA_ASSERT(0 && "vkQueueBindSparse is required to bind sparse resources.");
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+    }
+
+    VMA_DEBUG_LOG("vmaBindSparsePages");
+
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+
+    return VmaSparseResource_T::Bind(allocator, queue, resourceCount, pResources, pSubmitInfo);
+}
+
+VMA_CALL_PRE void VMA_CALL_POST vmaFreeUnboundSparsePages(
+    VmaAllocator allocator,
+    uint32_t resourceCount,
+    const VmaSparseResource* pResources)
+{
+    VMA_ASSERT(allocator && (resourceCount == 0 || pResources));
+
+    VMA_DEBUG_LOG("vmaFreeUnboundSparsePages");
+
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK
+
+    for(uint32_t i = 0; i < resourceCount; ++i)
+    {
+        pResources[i]->FreeUnboundPages();
     }
 }
 
@@ -17577,6 +24629,24 @@ VMA_CALL_PRE void VMA_CALL_POST vmaCalculateVirtualBlockStatistics(VmaVirtualBlo
     virtualBlock->CalculateDetailedStatistics(*pStats);
 }
 
+VMA_CALL_PRE VkResult VMA_CALL_POST vmaBeginVirtualBlockDefragmentationPass(VmaVirtualBlock VMA_NOT_NULL virtualBlock,
+    const VmaVirtualDefragmentationInfo* VMA_NOT_NULL pInfo, VmaVirtualDefragmentationPassMoveInfo* VMA_NOT_NULL pPassInfo)
+{
+    VMA_ASSERT(virtualBlock != VK_NULL_HANDLE && pInfo != VMA_NULL && pPassInfo != VMA_NULL);
+    VMA_DEBUG_LOG("vmaBeginVirtualBlockDefragmentationPass");
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK;
+    return virtualBlock->BeginDefragmentationPass(*pInfo, *pPassInfo);
+}
+
+VMA_CALL_PRE void VMA_CALL_POST vmaEndVirtualBlockDefragmentationPass(VmaVirtualBlock VMA_NOT_NULL virtualBlock,
+    VmaVirtualDefragmentationPassMoveInfo* VMA_NOT_NULL pPassInfo)
+{
+    VMA_ASSERT(virtualBlock != VK_NULL_HANDLE && pPassInfo != VMA_NULL);
+    VMA_DEBUG_LOG("vmaEndVirtualBlockDefragmentationPass");
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK;
+    virtualBlock->EndDefragmentationPass(*pPassInfo);
+}
+
 #if VMA_STATS_STRING_ENABLED
 
 VMA_CALL_PRE void VMA_CALL_POST vmaBuildVirtualBlockStatsString(VmaVirtualBlock VMA_NOT_NULL virtualBlock,
@@ -17600,6 +24670,16 @@ VMA_CALL_PRE void VMA_CALL_POST vmaFreeVirtualBlockStatsString(VmaVirtualBlock V
         VmaFreeString(virtualBlock->GetAllocationCallbacks(), pStatsString);
     }
 }
+
+VMA_CALL_PRE void VMA_CALL_POST vmaWriteVirtualBlockStatsString(VmaVirtualBlock VMA_NOT_NULL virtualBlock,
+    PFN_vmaWriteStatsStringFunction VMA_NOT_NULL pfnWrite, void* VMA_NULLABLE pUserData, VkBool32 detailedMap)
+{
+    VMA_ASSERT(virtualBlock != VK_NULL_HANDLE && pfnWrite != VMA_NULL);
+    VMA_DEBUG_GLOBAL_MUTEX_LOCK;
+    VmaStringBuilder sb(virtualBlock->GetAllocationCallbacks(), pfnWrite, pUserData);
+    virtualBlock->BuildStatsString(detailedMap != VK_FALSE, sb);
+    sb.Flush();
+}
 #endif // VMA_STATS_STRING_ENABLED
 #endif // _VMA_PUBLIC_INTERFACE
 #endif // VMA_IMPLEMENTATION
@@ -18060,6 +25140,27 @@ Also, Windows drivers from all 3 PC GPU vendors (AMD, Intel, NVIDIA)
 currently provide `HOST_COHERENT` flag on all memory types that are
 `HOST_VISIBLE`, so on PC you may not need to bother.
 
+\section memory_mapping_batching_flushes Batching flushes
+
+When many small parts of mapped memory are written during a frame, collect them in a #VmaCacheRangeBatch
+instead of flushing each one separately. Ranges falling into the same `VkDeviceMemory` block are sorted and merged
+when adjacent or overlapping, so the driver gets the minimal set of ranges in a single call:
+
+\code
+VmaCacheRangeBatch batch;
+vmaCreateCacheRangeBatch(allocator, &batch);
+
+// During the frame:
+vmaAddCacheRange(allocator, batch, alloc1, dirtyOffset1, dirtySize1);
+vmaAddCacheRange(allocator, batch, alloc2, dirtyOffset2, dirtySize2);
+
+// Before submitting GPU work:
+vmaFlushCacheRangeBatch(allocator, batch);
+\endcode
+
+vmaFlushAllocations() and vmaInvalidateAllocations() merge ranges in the same way.
+vmaGetCacheRangeBatchStats() returns the number of ranges collected versus the number actually passed to Vulkan.
+
 
 \page staying_within_budget Staying within budget
 
@@ -18246,6 +25347,120 @@ images with `COLOR_ATTACHMENT` usage, so the sets of memory types supported by y
 resources may be disjoint. Aliasing them is not possible in that case.
 
 
+\page warm_start Warm start
+
+Memory blocks of default pools start small - 1/8, 1/4, 1/2 of the preferred block size - and new blocks
+are allocated as the usage grows, so the first minutes of an application may be full of `vkAllocateMemory` calls.
+To avoid it, you can save peak block counts and sizes of each memory type and each named custom pool
+at the end of a run, and create the blocks up front on the next start:
+
+\code
+// At exit:
+size_t profileSize = 0;
+vmaExportAllocationProfile(allocator, &profileSize, nullptr);
+std::vector<char> profile(profileSize);
+vmaExportAllocationProfile(allocator, &profileSize, profile.data());
+SaveToFile(profile);
+
+// At start, after custom pools are created and named with vmaSetPoolName():
+std::vector<char> profile = LoadFromFile();
+VkResult res = vmaImportAllocationProfile(allocator, profile.size(), profile.data());
+\endcode
+
+Blocks are pre-created with the full block size, until their total size reaches the peak from the profile,
+as long as they fit in the heap budget. They are kept even when empty.
+Import can be performed on a background thread, while the main thread already creates resources.
+The profile is bound to the physical device it was exported on - vmaImportAllocationProfile() returns
+`VK_ERROR_INCOMPATIBLE_DRIVER` for a profile of another device.
+
+\section warm_start_block_preallocation Block preallocation
+
+Later on, when an allocation doesn't fit in existing blocks, the thread that requested it waits for `vkAllocateMemory`
+of a new block, which may take milliseconds. To move this cost off the critical path, a background thread
+of the application can call vmaPreallocateBlocks() periodically, e.g. once per frame:
+
+\code
+uint32_t allocatedBlockCount = 0;
+vmaPreallocateBlocks(allocator, UINT32_MAX, 32ull * 1024 * 1024, &allocatedBlockCount);
+\endcode
+
+For each memory type whose blocks have less than the given amount of free space left, it allocates the next block
+ahead of demand, within the heap budget. Allocations of that memory type are not blocked during this `vkAllocateMemory` -
+the new block is only published when it is ready. This applies only to vmaPreallocateBlocks():
+when an allocation runs out of space before the next call, it still creates the block itself,
+holding the lock of the memory type during `vkAllocateMemory`.
+
+The preallocated block is kept while it is the only empty block. If a free empties another block first,
+the preallocated one is released and the newly emptied block stays as the spare instead,
+so the next call may allocate a block again.
+
+
+\page sparse_resources Sparse resources
+
+Buffers and images created with `VK_BUFFER_CREATE_SPARSE_BINDING_BIT` or `VK_IMAGE_CREATE_SPARSE_BINDING_BIT`
+don't need to be backed by memory as a whole. The library can manage memory of their pages for you,
+so a buffer can reserve a huge range of addresses while only the pages in use consume memory.
+The device must support `sparseBinding` feature and a queue with `VK_QUEUE_SPARSE_BINDING_BIT`.
+
+\code
+VkBufferCreateInfo bufCreateInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+bufCreateInfo.flags = VK_BUFFER_CREATE_SPARSE_BINDING_BIT;
+bufCreateInfo.size = 1ull << 40; // 1 TiB of address space.
+bufCreateInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+
+VmaAllocationCreateInfo allocCreateInfo = {};
+allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+
+VkBuffer buf;
+VmaSparseResource sparse;
+vmaCreateSparseBuffer(allocator, &bufCreateInfo, &allocCreateInfo, &buf, &sparse);
+
+VmaSparseResourceInfo sparseInfo;
+vmaGetSparseResourceInfo(allocator, sparse, &sparseInfo);
+
+// Back first 16 pages with memory, release some other.
+vmaCommitSparsePages(allocator, sparse, 0, 16);
+vmaDecommitSparsePages(allocator, sparse, 1024, 64);
+
+// Once per frame, for all sparse resources together:
+VmaSparseBindSubmitInfo submitInfo = {};
+submitInfo.signalSemaphoreCount = 1;
+submitInfo.pSignalSemaphores = &bindFinishedSemaphore;
+submitInfo.fence = bindFinishedFence;
+vmaBindSparsePages(allocator, sparseQueue, 1, &sparse, &submitInfo);
+
+// Later, once bindFinishedFence has signaled:
+vmaFreeUnboundSparsePages(allocator, 1, &sparse);
+\endcode
+
+Every page is a separate allocation made with VmaAllocationCreateInfo passed at creation,
+of size and alignment equal to VmaSparseResourceInfo::pageSize, so it is placed in regular memory blocks
+of default pools or of the custom pool specified in VmaAllocationCreateInfo::pool.
+vmaCommitSparsePages() and vmaDecommitSparsePages() only update this bookkeeping.
+vmaBindSparsePages() issues a single `vkQueueBindSparse` for all the changes of all given resources,
+merging neighboring pages that also lie next to each other in memory into one `VkSparseMemoryBind`.
+
+The GPU may access decommitted pages until it executes the `vkQueueBindSparse` that unbinds them,
+so their memory is not freed by vmaBindSparsePages(). With VmaAllocatorCreateInfo::deferredFreeFrameCount
+they are queued for deferred freeing like vmaFreeMemory(), otherwise they wait for vmaFreeUnboundSparsePages().
+
+Pages of images are bound as opaque ranges of image memory. Images created with
+`VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT` can also be backed tile by tile in mip levels above the mip tail,
+using vmaCommitSparseImageRegion() and vmaDecommitSparseImageRegion(). Each tile is a page-sized allocation
+bound with its own `VkSparseImageMemoryBind`:
+
+\code
+VmaSparseImageRegion region = {};
+region.subresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+region.subresource.mipLevel = 0;
+region.offset = { 256, 512, 0 }; // Multiple of VkSparseImageFormatProperties::imageGranularity.
+region.extent = { 256, 256, 1 };
+vmaCommitSparseImageRegion(allocator, sparseImage, &region);
+\endcode
+
+\note Sparse resources are not recorded by [call recording](@ref record_and_replay).
+
+
 \page custom_memory_pools Custom memory pools
 
 A memory pool contains a number of `VkDeviceMemory` blocks.
@@ -18448,6 +25663,55 @@ VmaPoolCreateInfo::maxBlockCount must be 1. Otherwise behavior is undefined.
 
 \note \ref defragmentation is not supported in custom pools created with #VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT.
 
+\section slab_algorithm Slab allocation algorithm
+
+When a custom pool holds many tiny allocations, e.g. small uniform buffers or
+per-object constants, the general purpose metadata spends more time and memory on
+each of them than they are worth. You can create such pool with flag
+#VMA_POOL_CREATE_SLAB_ALGORITHM_BIT added to VmaPoolCreateInfo::flags. Memory
+blocks of this pool are divided into slabs of 64 KiB. Every slab that is in use
+serves one size class: 64, 96, 128, 192, 256, ... 3072, 4096 bytes, and keeps
+track of its free slots in a bitmap. Allocation and free take constant time and
+the only metadata stored for an allocation is one bit and its user data pointer.
+When all allocations are freed from a slab, it can be reused for any size class.
+
+Allocation size is rounded up to its size class. Slots of a size class are aligned
+to the lowest power of 2 that divides the class size, so e.g. allocation of 65 bytes
+with alignment of 256 bytes takes a 256-byte slot. Allocations that don't fit into
+the biggest size class fail with `VK_ERROR_OUT_OF_DEVICE_MEMORY`.
+
+Same algorithm can be used in virtual blocks with flag #VMA_VIRTUAL_BLOCK_CREATE_SLAB_ALGORITHM_BIT.
+
+\note \ref defragmentation is not supported in custom pools created with #VMA_POOL_CREATE_SLAB_ALGORITHM_BIT.
+
+\section buddy_algorithm Buddy allocation algorithm
+
+There is another allocation algorithm that can be used with custom pools, called
+"buddy". Its internal data structure is based on a binary tree of blocks, each
+having size that is a power of two and a half of its parent's size. When you want
+to allocate memory of certain size, a free node in the tree is located. If it is
+too large, it is recursively split into two halves (called "buddies"). However, if
+requested allocation size is not a power of two, the size of the allocation is
+aligned up to the nearest power of two and the remaining space is wasted. When two
+buddy nodes become free, they are merged back into one larger node.
+
+To use buddy algorithm, add flag #VMA_POOL_CREATE_BUDDY_ALGORITHM_BIT to
+VmaPoolCreateInfo::flags while creating #VmaPool object, or flag
+#VMA_VIRTUAL_BLOCK_CREATE_BUDDY_ALGORITHM_BIT to VmaVirtualBlockCreateInfo::flags.
+
+The advantage of buddy allocation algorithm over default algorithm is that merging
+of freed space is predictable and bounded by the depth of the tree, which suits
+workloads with power-of-two sized resources like texture atlases or octree pages.
+The disadvantage is more wasted space (internal fragmentation) for sizes that are
+not a power of two.
+
+Several limitations apply to pools that use buddy algorithm:
+
+- It is recommended to use VmaPoolCreateInfo::blockSize that is a power of two.
+  Otherwise, only largest power of two smaller than the size is used for
+  allocations. The remaining space always stays unused.
+- \ref defragmentation doesn't work with allocations made from such pool.
+
 
 \page defragmentation Defragmentation
 
@@ -18593,7 +25857,105 @@ Whether through #VMA_ALLOCATION_CREATE_MAPPED_BIT or vmaMapMemory(), the allocat
 are mapped at their new place. Of course, pointer to the mapped data changes, so it needs to be queried
 using VmaAllocationInfo::pMappedData.
 
-\note Defragmentation is not supported in custom pools created with #VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT.
+\note Defragmentation is not supported in custom pools created with #VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT,
+#VMA_POOL_CREATE_SLAB_ALGORITHM_BIT or #VMA_POOL_CREATE_BUDDY_ALGORITHM_BIT.
+
+\section defragmentation_executor Defragmentation executor
+
+If your allocations are buffers, you can let the library perform the copies for you.
+#VmaDefragmentationExecutor runs the passes described above on a queue you give it,
+preferably one of a dedicated transfer family, a little bit every frame:
+
+\code
+VmaDefragmentationExecutorCreateInfo executorInfo = {};
+executorInfo.defragmentationInfo.pool = myPool;
+executorInfo.defragmentationInfo.maxBytesPerPass = 16ull * 1024 * 1024;
+executorInfo.transferQueue = transferQueue;
+executorInfo.transferQueueFamilyIndex = transferQueueFamilyIndex;
+executorInfo.maxStepDuration = 500000; // 0.5 ms
+executorInfo.frameInUseCount = 2;
+executorInfo.pfnAllocationMoved = MyRecreateBufferCallback;
+
+VmaDefragmentationExecutor executor;
+VkResult res = vmaCreateDefragmentationExecutor(allocator, &executorInfo, &executor);
+// Check res...
+
+// Once per frame:
+res = vmaStepDefragmentationExecutor(allocator, executor);
+if(res == VK_SUCCESS)
+{
+    vmaDestroyDefragmentationExecutor(allocator, executor, nullptr);
+    executor = VK_NULL_HANDLE;
+}
+\endcode
+
+Each step commits the pass whose copies finished on the GPU, calling VmaDefragmentationExecutorCreateInfo::pfnAllocationMoved
+for every allocation that got moved, so you can recreate the buffer bound to it.
+Then it starts a new pass, records `vkCmdCopyBuffer()` for its moves and submits them,
+signaling a timeline semaphore available through vmaGetDefragmentationExecutorSemaphore().
+If the copies are still executing, the step returns `VK_NOT_READY` right away.
+VmaDefragmentationExecutorCreateInfo::maxStepDuration limits the CPU time spent in a step.
+Moves that don't fit in it are copied by following steps before the pass is committed.
+VmaDefragmentationInfo::maxBytesPerPass limits amount of data copied by the GPU per step.
+
+Frames already submitted may still read data of the moved allocations at their old places,
+so they are freed only VmaDefragmentationExecutorCreateInfo::frameInUseCount frames later,
+as counted by vmaSetCurrentFrameIndex(). Keep stepping until the executor returns `VK_SUCCESS`.
+
+Data is copied between temporary buffers bound to whole `VkDeviceMemory` blocks, so moves of allocations
+created for images with optimal tiling are left out, as well as moves in memory types that don't support such buffers.
+The executor requires the `timelineSemaphore` feature of Vulkan 1.2 or `VK_KHR_timeline_semaphore`.
+On Vulkan 1.1, `vkGetSemaphoreCounterValueKHR` and `vkWaitSemaphoresKHR` are fetched by #VMA_DYNAMIC_VULKAN_FUNCTIONS,
+or you can pass them in VmaVulkanFunctions::vkGetSemaphoreCounterValue and VmaVulkanFunctions::vkWaitSemaphores.
+
+
+\page residency_management Residency management
+
+When `DEVICE_LOCAL` memory gets oversubscribed, some resources need to live in slower memory.
+Instead of failing new allocations, the library can move resources that are not used at the moment
+to other memory types and bring them back when they become used again.
+
+Create allocations that may be moved with #VMA_ALLOCATION_CREATE_CAN_BE_DEMOTED_BIT.
+They can be placed only in memory types allowed by the resource and by VmaAllocationCreateInfo::requiredFlags,
+so make sure these flags don't require `DEVICE_LOCAL`.
+Call vmaTouchAllocation() every frame the resource is used. Then, once per frame, run a residency pass:
+
+\code
+VmaResidencyManagerCreateInfo managerInfo = {};
+managerInfo.demoteThreshold = 0.95f;
+managerInfo.promoteThreshold = 0.8f;
+managerInfo.minIdleFrameCount = 3;
+managerInfo.maxBytesPerPass = 64ull * 1024 * 1024;
+
+VmaResidencyManager manager;
+VkResult res = vmaCreateResidencyManager(allocator, &managerInfo, &manager);
+// Check res...
+
+// Once per frame, after vmaSetCurrentFrameIndex():
+VmaDefragmentationPassMoveInfo pass;
+res = vmaBeginResidencyPass(allocator, manager, &pass);
+if(res == VK_INCOMPLETE)
+{
+    // Copy data and recreate resources the same way as in a defragmentation pass.
+    // ...
+    vmaEndResidencyPass(allocator, manager, &pass);
+}
+\endcode
+
+If usage of a `DEVICE_LOCAL` heap exceeds VmaResidencyManagerCreateInfo::demoteThreshold of its budget,
+allocations not touched for at least VmaResidencyManagerCreateInfo::minIdleFrameCount frames are moved
+out of it, least recently used first, until the bytes of allocations left in the heap drop to
+VmaResidencyManagerCreateInfo::promoteThreshold. The usage itself goes down only when memory blocks become empty and get freed.
+When the bytes of allocations are below VmaResidencyManagerCreateInfo::promoteThreshold and the usage is not above
+VmaResidencyManagerCreateInfo::demoteThreshold, demoted allocations touched recently are moved back, most recently used first. The gap between the two thresholds prevents allocations from bouncing
+between heaps every frame. Moves returned in VmaDefragmentationPassMoveInfo::pMoves are handled
+exactly like in [Defragmentation](@ref defragmentation), including VmaDefragmentationMove::operation.
+vmaGetResidencyStats() returns the number of allocations and bytes moved in each direction.
+
+\note Only allocations made in default pools are managed. Dedicated allocations,
+allocations from custom pools and allocations created with #VMA_ALLOCATION_CREATE_MAPPED_BIT are never moved.
+Allocations created with #VMA_ALLOCATION_CREATE_CAN_BE_DEMOTED_BIT must not be freed
+between vmaBeginResidencyPass() and vmaEndResidencyPass().
 
 
 \page statistics Statistics
@@ -18629,8 +25991,10 @@ printf("Vulkan reports total usage %llu B with budget %llu B.\n",
 You can query for more detailed statistics per memory heap, type, and totals,
 including minimum and maximum allocation size and unused range size,
 by calling function vmaCalculateStatistics() and inspecting structure #VmaTotalStatistics.
-This function is slower though, as it has to traverse all the internal data structures,
-so it should be used only for debugging purposes.
+This function is slower though, as it may have to traverse internal data structures.
+With #VMA_ALLOCATOR_CREATE_INCREMENTAL_STATISTICS_BIT, default pools and custom pools using
+the default or buddy algorithm maintain their statistics incrementally, which makes it cheap for them,
+at the cost of minimum and maximum sizes being approximate and the result not being an atomic snapshot.
 
 You can query for statistics of a custom pool using function vmaGetPoolStatistics()
 or vmaCalculatePoolStatistics().
@@ -18657,6 +26021,25 @@ It can also contain detailed map of allocated memory blocks and their regions -
 free and occupied by allocations.
 This allows e.g. to visualize the memory or assess fragmentation.
 
+With many allocations, the detailed map can take many megabytes.
+Function vmaWriteStatsString() produces the same JSON without building it as one string -
+it passes it in parts to your callback, e.g. to write it to a file:
+
+\code
+static void VKAPI_PTR WriteStatsToFile(void* pUserData, const char* pData, size_t size)
+{
+    fwrite(pData, 1, size, (FILE*)pUserData);
+}
+
+FILE* file = fopen("vma_stats.json", "wb");
+vmaWriteStatsString(allocator, WriteStatsToFile, file, VK_TRUE);
+fclose(file);
+\endcode
+
+The callback is never called while the library holds a lock of a memory block,
+so it doesn't stall other threads allocating memory.
+vmaWriteVirtualBlockStatsString() does the same for a virtual block.
+
 
 \page allocation_annotation Allocation names and user data
 
@@ -18865,6 +26248,42 @@ vmaBuildVirtualBlockStatsString().
 Returned string must be later freed using vmaFreeVirtualBlockStatsString().
 The format of this string differs from the one returned by the main Vulkan allocator, but it is similar.
 
+\section virtual_allocator_defragmentation Defragmentation
+
+After many allocations and deallocations, free space in a virtual block may become scattered across many small regions.
+You can compact the block incrementally, moving allocations towards its beginning.
+The library only computes new places - copying the data, e.g. with `vkCmdCopyBuffer()` within your buffer,
+is up to you:
+
+\code
+VmaVirtualDefragmentationInfo defragInfo = {};
+defragInfo.maxBytesPerPass = 16ull * 1024 * 1024;
+defragInfo.maxAlignment = 256; // Greatest alignment I ever used for allocations in this block.
+
+VmaVirtualDefragmentationPassMoveInfo pass;
+while(vmaBeginVirtualBlockDefragmentationPass(block, &defragInfo, &pass) == VK_INCOMPLETE)
+{
+    for(uint32_t i = 0; i < pass.moveCount; ++i)
+    {
+        const VmaVirtualDefragmentationMove& move = pass.pMoves[i];
+        RecordCopy(move.srcOffset, move.dstOffset, move.size);
+        // pUserData of the allocation is preserved, so it can point to your object.
+        VmaVirtualAllocationInfo allocInfo;
+        vmaGetVirtualAllocationInfo(block, move.dstAllocation, &allocInfo);
+        ((MyObject*)allocInfo.pUserData)->alloc = move.dstAllocation;
+    }
+    SubmitCopiesAndWait();
+    vmaEndVirtualBlockDefragmentationPass(block, &pass);
+}
+\endcode
+
+VmaVirtualDefragmentationInfo::maxBytesPerPass and VmaVirtualDefragmentationInfo::maxAllocationsPerPass
+limit the amount of work in a single pass.
+Destination places are reserved when the pass begins and sources are released only when it ends,
+so source and destination ranges never overlap and the copies can execute in any order.
+You can cancel a move by setting VmaVirtualDefragmentationMove::operation to #VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE.
+Defragmentation is not supported in blocks created with #VMA_VIRTUAL_BLOCK_CREATE_LINEAR_ALGORITHM_BIT.
+
 \section virtual_allocator_additional_considerations Additional considerations
 
 The "virtual allocator" functionality is implemented on a level of individual memory blocks.
@@ -18974,6 +26393,95 @@ Margin validation (corruption detection) works only for memory types that are
 `HOST_VISIBLE` and `HOST_COHERENT`.
 
 
+\page record_and_replay Record and replay
+
+\section record_and_replay_introduction Introduction
+
+While using the library, sequence of calls to its functions together with their
+parameters can be recorded to a file and later replayed using standalone
+application `vma_replay`. It can be useful to:
+
+- Test correctness - check if same sequence of calls will not cause crash or
+  failures on a different machine or with a different heap configuration.
+- Gather statistics - see how many allocations and memory blocks are made, how
+  fragmented the memory becomes over time, and how long the calls take.
+- Benchmark - compare latency and peak memory usage of different versions of the library,
+  allocation algorithms, or block sizes, on a real workload of an application.
+
+\section record_and_replay_usage Usage
+
+Recording functionality is disabled by default.
+To enable it, define following macro before every include of this library:
+
+\code
+#define VMA_RECORDING_ENABLED 1
+\endcode
+
+<b>To record sequence of calls to a file:</b> Fill in
+VmaAllocatorCreateInfo::pRecordSettings member while creating #VmaAllocator
+object. File is opened and written during whole lifetime of the allocator.
+Set #VMA_RECORD_FLUSH_AFTER_CALL_BIT to write every call to the file immediately,
+so the recording is complete even if the application crashes,
+at the cost of performance.
+
+<b>To replay file:</b> Build `vma_replay` from `src/vma_replay.cpp`. Run it
+with the path to the file as the first parameter:
+
+\code
+vma_replay recording.vmar --heap 0=2048 --block-size 64 --interval 10000
+\endcode
+
+The file is replayed against a stub device, not the GPU, so no Vulkan driver is needed.
+The stub device reports memory heaps and types saved in the recording.
+Their sizes can be changed with `--heap <index>=<MiB>`, and
+VmaAllocatorCreateInfo::preferredLargeHeapBlockSize with `--block-size <MiB>`,
+to check how the application would behave on a device with less memory.
+Every `--interval` records, the tool prints number and size of memory blocks,
+bytes allocated, and fragmentation of free space. At the end, it prints
+latency percentiles of allocations as recorded and as replayed, latency of frees,
+numbers of failed allocations, and peak device memory usage.
+
+\section record_and_replay_format File format
+
+The file is binary, in native byte order of the machine that recorded it.
+It starts with a header:
+
+- `char[4]` "VMAR", `uint32_t` format version, currently 1.
+- `uint32_t` VmaAllocatorCreateInfo::vulkanApiVersion, `uint32_t` VmaAllocatorCreateInfo::flags,
+  `uint64_t` preferred large heap block size.
+- `uint64_t` `bufferImageGranularity`, `uint64_t` `nonCoherentAtomSize`, `uint32_t` `maxMemoryAllocationCount`.
+- `uint32_t` heap count, then for every heap: `uint64_t` size, `uint32_t` flags.
+- `uint32_t` memory type count, then for every type: `uint32_t` property flags, `uint32_t` heap index.
+
+Then records follow until the end of the file. Each starts with: `uint32_t` call,
+`uint32_t` hash of thread id, `uint64_t` nanoseconds since creation of the allocator,
+`uint32_t` current frame index. Objects are identified by their `uint64_t` handle values,
+which may be reused after an object is destroyed. Calls are:
+
+- 1 - pool created: pool, `uint32_t` memory type index, `uint32_t` flags, `uint64_t` block size,
+  `uint64_t` min block count, `uint64_t` max block count, `float` priority, `uint64_t` min allocation alignment.
+- 2 - pool destroyed: pool.
+- 3 - memory allocated: `uint64_t` duration in nanoseconds, `int32_t` result,
+  `uint64_t` size, `uint64_t` alignment, `uint32_t` memory type bits of `VkMemoryRequirements`,
+  `uint8_t` requires dedicated, `uint8_t` prefers dedicated, `uint8_t` dedicated resource - 0 none, 1 buffer, 2 image,
+  `uint32_t` buffer or image usage, then #VmaAllocationCreateInfo: `uint32_t` flags, `uint32_t` usage,
+  `uint32_t` required flags, `uint32_t` preferred flags, `uint32_t` memory type bits, pool, `float` priority,
+  followed by `uint32_t` suballocation type, `uint32_t` allocation count, and that many allocations - null if failed.
+- 4 - memory freed: `uint32_t` allocation count and that many allocations.
+- 5 - current frame index set: no more data.
+
+All functions that allocate or free memory, like vmaCreateBuffer(), vmaAllocateMemoryPages(),
+or vmaDestroyImage(), are recorded as calls 3 and 4.
+
+\section record_and_replay_limitations Limitations
+
+- Defragmentation, virtual blocks, and functions that don't allocate or free memory,
+  like vmaMapMemory(), are not recorded.
+- Allocations are replayed without buffers or images, and Vulkan extensions
+  like `VK_KHR_dedicated_allocation` or `VK_EXT_memory_budget` are not emulated by the stub device.
+- Calls from multiple threads are replayed in the order they were recorded, on a single thread.
+
+
 \page opengl_interop OpenGL Interop
 
 VMA provides some features that help with interoperability with OpenGL.
@@ -31,6 +31,7 @@
 #endif
 
 #include <mutex>
+#include <thread>
 #include <algorithm>
 
 namespace vkb {
@@ -147,6 +148,7 @@ class VulkanFunctions {
 	PFN_vkGetPhysicalDeviceQueueFamilyProperties2 fp_vkGetPhysicalDeviceQueueFamilyProperties2 = nullptr;
 	PFN_vkGetPhysicalDeviceMemoryProperties fp_vkGetPhysicalDeviceMemoryProperties = nullptr;
 	PFN_vkGetPhysicalDeviceFormatProperties2 fp_vkGetPhysicalDeviceFormatProperties2 = nullptr;
+	PFN_vkGetPhysicalDeviceFormatProperties2KHR fp_vkGetPhysicalDeviceFormatProperties2KHR = nullptr;
 	PFN_vkGetPhysicalDeviceMemoryProperties2 fp_vkGetPhysicalDeviceMemoryProperties2 = nullptr;
 
 	PFN_vkGetDeviceProcAddr fp_vkGetDeviceProcAddr = nullptr;
@@ -181,6 +183,7 @@ class VulkanFunctions {
 		get_inst_proc_addr(fp_vkGetPhysicalDeviceQueueFamilyProperties2, "vkGetPhysicalDeviceQueueFamilyProperties2");
 		get_inst_proc_addr(fp_vkGetPhysicalDeviceMemoryProperties, "vkGetPhysicalDeviceMemoryProperties");
 		get_inst_proc_addr(fp_vkGetPhysicalDeviceFormatProperties2, "vkGetPhysicalDeviceFormatProperties2");
+		get_inst_proc_addr(fp_vkGetPhysicalDeviceFormatProperties2KHR, "vkGetPhysicalDeviceFormatProperties2KHR");
 		get_inst_proc_addr(fp_vkGetPhysicalDeviceMemoryProperties2, "vkGetPhysicalDeviceMemoryProperties2");
 
 		get_inst_proc_addr(fp_vkGetDeviceProcAddr, "vkGetDeviceProcAddr");
@@ -422,6 +425,8 @@ const char* to_string(PhysicalDeviceError err) {
 			return "no_physical_devices_found";
 		case PhysicalDeviceError::no_suitable_device:
 			return "no_suitable_device";
+		case PhysicalDeviceError::failed_get_image_format_properties:
+			return "failed_get_image_format_properties";
 		default:
 			return "";
 	}
@@ -448,6 +453,8 @@ const char* to_string(DeviceError err) {
 	switch (err) {
 		case DeviceError::failed_create_device:
 			return "failed_create_device";
+		case DeviceError::global_priority_not_permitted:
+			return "global_priority_not_permitted";
 		default:
 			return "";
 	}
@@ -464,6 +471,12 @@ const char* to_string(SwapchainError err) {
 			return "failed_get_swapchain_images";
 		case SwapchainError::failed_create_swapchain_image_views:
 			return "failed_create_swapchain_image_views";
+		case SwapchainError::present_timing_not_enabled:
+			return "present_timing_not_enabled";
+		case SwapchainError::failed_wait_for_present:
+			return "failed_wait_for_present";
+		case SwapchainError::failed_get_presentation_timing:
+			return "failed_get_presentation_timing";
 		default:
 			return "";
 	}
@@ -1031,6 +1044,93 @@ PhysicalDevice PhysicalDeviceSelector::populate_device_details(VkPhysicalDevice
 		physical_device.extensions.push_back(&ext.extensionName[0]);
 	}
 
+	// The extension list is trimmed down to the enabled extensions later on, so record what the format table needs now
+	auto& format_cache = *physical_device.format_capability_cache;
+	format_cache.physical_device = vk_phys_device;
+	format_cache.api_version = std::min(instance_info.version, physical_device.properties.apiVersion);
+	format_cache.supports_properties2 = format_cache.api_version >= VKB_VK_API_VERSION_1_1;
+	format_cache.supports_properties2_ext = instance_info.supports_properties2_ext;
+	for (const auto& ext : physical_device.extensions) {
+		if (ext == "VK_KHR_format_feature_flags2") format_cache.supports_format_feature_flags2 = true;
+		if (ext == "VK_EXT_image_drm_format_modifier" && criteria.gather_drm_format_modifiers)
+			format_cache.query_drm_format_modifiers = true;
+	}
+#if defined(VKB_VK_API_VERSION_1_3)
+	if (format_cache.api_version >= VKB_VK_API_VERSION_1_3) format_cache.supports_format_feature_flags2 = true;
+#endif
+
+#if defined(VK_EXT_global_priority)
+	bool has_global_priority_query = false;
+	for (const auto& ext : physical_device.extensions) {
+		if (ext == "VK_KHR_global_priority") {
+			physical_device.global_priority_extension = "VK_KHR_global_priority";
+			has_global_priority_query = true;
+		} else if (ext == "VK_EXT_global_priority" && physical_device.global_priority_extension == nullptr) {
+			physical_device.global_priority_extension = "VK_EXT_global_priority";
+		} else if (ext == "VK_EXT_global_priority_query") {
+			has_global_priority_query = true;
+		}
+	}
+#if defined(VKB_VK_API_VERSION_1_1) && defined(VK_KHR_global_priority)
+	if (physical_device.global_priority_extension != nullptr && has_global_priority_query &&
+	    instance_info.version >= VKB_VK_API_VERSION_1_1 && physical_device.properties.apiVersion >= VKB_VK_API_VERSION_1_1) {
+		uint32_t family_count = static_cast<uint32_t>(queue_families.size());
+		std::vector<VkQueueFamilyGlobalPriorityPropertiesKHR> priority_properties(family_count);
+		std::vector<VkQueueFamilyProperties2> family_properties(family_count);
+		for (uint32_t i = 0; i < family_count; i++) {
+			priority_properties[i].sType = VK_STRUCTURE_TYPE_QUEUE_FAMILY_GLOBAL_PRIORITY_PROPERTIES_KHR;
+			family_properties[i].sType = VK_STRUCTURE_TYPE_QUEUE_FAMILY_PROPERTIES_2;
+			family_properties[i].pNext = &priority_properties[i];
+		}
+		detail::vulkan_functions().fp_vkGetPhysicalDeviceQueueFamilyProperties2(
+		    vk_phys_device, &family_count, family_properties.data());
+		physical_device.queue_family_global_priorities.resize(family_count);
+		for (uint32_t i = 0; i < family_count; i++) {
+			for (uint32_t p = 0; p < priority_properties[i].priorityCount; p++) {
+				physical_device.queue_family_global_priorities[i].push_back(
+				    static_cast<QueueGlobalPriority>(priority_properties[i].priorities[p]));
+			}
+		}
+	}
+#else
+	(void)has_global_priority_query;
+#endif
+#endif
+
+	if (criteria.enable_present_timing) {
+		bool has_present_id = false;
+		bool has_present_wait = false;
+		for (const auto& ext : physical_device.extensions) {
+			if (ext == "VK_KHR_present_id") has_present_id = true;
+			if (ext == "VK_KHR_present_wait") has_present_wait = true;
+#if defined(VK_GOOGLE_display_timing)
+			if (ext == "VK_GOOGLE_display_timing") physical_device.present_timing.display_timing = true;
+#endif
+		}
+#if defined(VKB_VK_API_VERSION_1_1) && defined(VK_KHR_present_id) && defined(VK_KHR_present_wait)
+		// Present id and present wait are features as well as extensions, which can only be enabled through the features chain
+		if (has_present_id && instance_info.version >= VKB_VK_API_VERSION_1_1 &&
+		    physical_device.properties.apiVersion >= VKB_VK_API_VERSION_1_1) {
+			VkPhysicalDevicePresentWaitFeaturesKHR present_wait_features{};
+			present_wait_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+			VkPhysicalDevicePresentIdFeaturesKHR present_id_features{};
+			present_id_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+			if (has_present_wait) present_id_features.pNext = &present_wait_features;
+			VkPhysicalDeviceFeatures2 local_features{};
+			local_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+			local_features.pNext = &present_id_features;
+			detail::vulkan_functions().fp_vkGetPhysicalDeviceFeatures2(vk_phys_device, &local_features);
+			physical_device.present_timing.present_id = present_id_features.presentId == VK_TRUE;
+			// Waiting on a present requires the present to carry an id
+			physical_device.present_timing.present_wait =
+			    physical_device.present_timing.present_id && present_wait_features.presentWait == VK_TRUE;
+		}
+#else
+		(void)has_present_id;
+		(void)has_present_wait;
+#endif
+	}
+
 #if defined(VKB_VK_API_VERSION_1_1)
 	physical_device.features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
 #else
@@ -1211,6 +1311,36 @@ detail::Result<std::vector<PhysicalDevice>> PhysicalDeviceSelector::select_impl(
 		if (portability_ext_available) {
 			phys_dev.extensions.push_back("VK_KHR_portability_subset");
 		}
+		if (criteria.enable_present_timing) {
+			auto add_extension = [&](const char* extension) {
+				if (std::find(phys_dev.extensions.begin(), phys_dev.extensions.end(), extension) == phys_dev.extensions.end())
+					phys_dev.extensions.push_back(extension);
+			};
+#if defined(VKB_VK_API_VERSION_1_1) && defined(VK_KHR_present_id) && defined(VK_KHR_present_wait)
+			auto add_features = [&](detail::GenericFeaturesPNextNode const& node) {
+				for (const auto& existing : phys_dev.extended_features_chain)
+					if (existing.sType == node.sType) return;
+				phys_dev.extended_features_chain.push_back(node);
+			};
+			if (phys_dev.present_timing.present_id) {
+				add_extension("VK_KHR_present_id");
+				VkPhysicalDevicePresentIdFeaturesKHR present_id_features{};
+				present_id_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+				present_id_features.presentId = VK_TRUE;
+				add_features(present_id_features);
+			}
+			if (phys_dev.present_timing.present_wait) {
+				add_extension("VK_KHR_present_wait");
+				VkPhysicalDevicePresentWaitFeaturesKHR present_wait_features{};
+				present_wait_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+				present_wait_features.presentWait = VK_TRUE;
+				add_features(present_wait_features);
+			}
+#endif
+			if (phys_dev.present_timing.display_timing) {
+				add_extension("VK_GOOGLE_display_timing");
+			}
+		}
 	};
 
 	// if this option is set, always return only the first physical device found
@@ -1390,6 +1520,14 @@ PhysicalDeviceSelector& PhysicalDeviceSelector::select_first_device_unconditiona
 	criteria.use_first_gpu_unconditionally = unconditionally;
 	return *this;
 }
+PhysicalDeviceSelector& PhysicalDeviceSelector::gather_drm_format_modifiers(bool gather) {
+	criteria.gather_drm_format_modifiers = gather;
+	return *this;
+}
+PhysicalDeviceSelector& PhysicalDeviceSelector::enable_present_timing(bool enable) {
+	criteria.enable_present_timing = enable;
+	return *this;
+}
 
 // PhysicalDevice
 bool PhysicalDevice::has_dedicated_compute_queue() const {
@@ -1406,8 +1544,235 @@ bool PhysicalDevice::has_separate_transfer_queue() const {
 }
 std::vector<VkQueueFamilyProperties> PhysicalDevice::get_queue_families() const { return queue_families; }
 std::vector<std::string> PhysicalDevice::get_extensions() const { return extensions; }
+bool PhysicalDevice::supports_global_priority() const { return global_priority_extension != nullptr; }
+std::vector<QueueGlobalPriority> PhysicalDevice::get_queue_family_global_priorities(uint32_t family_index) const {
+	if (family_index >= queue_family_global_priorities.size()) return {};
+	return queue_family_global_priorities[family_index];
+}
+FormatCapabilityTable const& PhysicalDevice::get_format_capabilities() const {
+	return detail::get_format_capabilities(*format_capability_cache);
+}
 PhysicalDevice::operator VkPhysicalDevice() const { return this->physical_device; }
 
+// ---- Format Capabilities ---- //
+
+namespace detail {
+struct FormatRange {
+	uint32_t first;
+	uint32_t count;
+	uint32_t api_version; // The formats of the range are only queried on devices supporting this version
+};
+
+// Core formats are contiguous, formats promoted from extensions sit in a few small ranges. Table entries are laid out
+// range after range, so mapping a format to its entry takes a handful of comparisons.
+const FormatRange format_ranges[] = {
+	{ 0, 185, VKB_MAKE_VK_VERSION(0, 1, 0, 0) },          // VK_FORMAT_UNDEFINED to VK_FORMAT_ASTC_12x12_SRGB_BLOCK
+	{ 1000156000, 34, VKB_MAKE_VK_VERSION(0, 1, 1, 0) }, // VK_FORMAT_G8B8G8R8_422_UNORM to VK_FORMAT_G16_B16_R16_3PLANE_444_UNORM
+	{ 1000066000, 14, VKB_MAKE_VK_VERSION(0, 1, 3, 0) }, // VK_FORMAT_ASTC_4x4_SFLOAT_BLOCK to VK_FORMAT_ASTC_12x12_SFLOAT_BLOCK
+	{ 1000330000, 4, VKB_MAKE_VK_VERSION(0, 1, 3, 0) },  // VK_FORMAT_G8_B8R8_2PLANE_444_UNORM to VK_FORMAT_G16_B16R16_2PLANE_444_UNORM
+	{ 1000340000, 2, VKB_MAKE_VK_VERSION(0, 1, 3, 0) },  // VK_FORMAT_A4R4G4B4_UNORM_PACK16 to VK_FORMAT_A4B4G4R4_UNORM_PACK16
+};
+
+uint32_t format_table_index(VkFormat format) {
+	const uint32_t value = static_cast<uint32_t>(format);
+	uint32_t offset = 0;
+	for (auto const& range : format_ranges) {
+		if (value >= range.first && value - range.first < range.count) return offset + (value - range.first);
+		offset += range.count;
+	}
+	return UINT32_MAX;
+}
+
+uint32_t format_table_size() {
+	uint32_t size = 0;
+	for (auto const& range : format_ranges)
+		size += range.count;
+	return size;
+}
+
+FormatCapabilityTable const& get_format_capabilities(FormatCapabilityCache& cache) {
+	std::call_once(cache.built, &FormatCapabilityTable::populate, &cache.table, std::cref(cache));
+	return cache.table;
+}
+} // namespace detail
+
+void FormatCapabilityTable::populate(detail::FormatCapabilityCache const& cache) {
+	physical_device = cache.physical_device;
+	use_properties2 = cache.supports_properties2;
+	use_khr_properties2 = !cache.supports_properties2 && cache.supports_properties2_ext;
+	format_feature_flags2 = cache.supports_format_feature_flags2 && (use_properties2 || use_khr_properties2);
+	drm_format_modifiers = cache.query_drm_format_modifiers && (use_properties2 || use_khr_properties2);
+	entries.resize(detail::format_table_size());
+	if (physical_device == VK_NULL_HANDLE) return;
+
+	std::vector<VkFormat> formats;
+	for (auto const& range : detail::format_ranges) {
+		if (range.api_version > cache.api_version) continue;
+		for (uint32_t i = 0; i < range.count; i++) {
+			if (range.first + i == static_cast<uint32_t>(VK_FORMAT_UNDEFINED)) continue;
+			formats.push_back(static_cast<VkFormat>(range.first + i));
+		}
+	}
+
+	auto query_formats = [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			query_entry(formats[i], entries[detail::format_table_index(formats[i])]);
+		}
+	};
+
+	// The format queries don't require external synchronization, so split them across a few threads.
+	// Each thread writes to its own set of entries.
+	const size_t worker_count = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), 4);
+	const size_t chunk_size = (formats.size() + worker_count - 1) / worker_count;
+	std::vector<std::thread> workers;
+	for (size_t begin = chunk_size; begin < formats.size(); begin += chunk_size) {
+		workers.emplace_back(query_formats, begin, std::min(begin + chunk_size, formats.size()));
+	}
+	query_formats(0, std::min(chunk_size, formats.size()));
+	for (auto& worker : workers) {
+		worker.join();
+	}
+}
+
+void FormatCapabilityTable::query_entry(VkFormat format, Entry& entry) const {
+	if (use_properties2 || use_khr_properties2) {
+		std::vector<VkBaseOutStructure*> pNext_chain;
+#if defined(VKB_VK_API_VERSION_1_3)
+		VkFormatProperties3 properties3{};
+		properties3.sType = VK_STRUCTURE_TYPE_FORMAT_PROPERTIES_3;
+		if (format_feature_flags2) pNext_chain.push_back(reinterpret_cast<VkBaseOutStructure*>(&properties3));
+#endif
+#if defined(VK_EXT_image_drm_format_modifier)
+		VkDrmFormatModifierPropertiesListEXT modifier_list{};
+		modifier_list.sType = VK_STRUCTURE_TYPE_DRM_FORMAT_MODIFIER_PROPERTIES_LIST_EXT;
+		if (drm_format_modifiers) pNext_chain.push_back(reinterpret_cast<VkBaseOutStructure*>(&modifier_list));
+#endif
+		VkFormatProperties2 properties2{};
+		properties2.sType = VK_STRUCTURE_TYPE_FORMAT_PROPERTIES_2;
+		detail::setup_pNext_chain(properties2, pNext_chain);
+
+		PFN_vkGetPhysicalDeviceFormatProperties2 get_format_properties2 = use_properties2
+		                                                                      ? detail::vulkan_functions().fp_vkGetPhysicalDeviceFormatProperties2
+		                                                                      : detail::vulkan_functions().fp_vkGetPhysicalDeviceFormatProperties2KHR;
+		get_format_properties2(physical_device, format, &properties2);
+		entry.properties = properties2.formatProperties;
+
+#if defined(VK_EXT_image_drm_format_modifier)
+		// Second call of the two-call pattern, now that the number of modifiers is known
+		if (drm_format_modifiers && modifier_list.drmFormatModifierCount > 0) {
+			entry.drm_format_modifiers.resize(modifier_list.drmFormatModifierCount);
+			modifier_list.pDrmFormatModifierProperties = entry.drm_format_modifiers.data();
+			get_format_properties2(physical_device, format, &properties2);
+			entry.drm_format_modifiers.resize(modifier_list.drmFormatModifierCount);
+		}
+#endif
+#if defined(VKB_VK_API_VERSION_1_3)
+		if (format_feature_flags2) entry.properties3 = properties3;
+#endif
+	} else {
+		detail::vulkan_functions().fp_vkGetPhysicalDeviceFormatProperties(physical_device, format, &entry.properties);
+	}
+
+#if defined(VKB_VK_API_VERSION_1_3)
+	if (!format_feature_flags2) {
+		entry.properties3.linearTilingFeatures = entry.properties.linearTilingFeatures;
+		entry.properties3.optimalTilingFeatures = entry.properties.optimalTilingFeatures;
+		entry.properties3.bufferFeatures = entry.properties.bufferFeatures;
+	}
+	entry.properties3.sType = VK_STRUCTURE_TYPE_FORMAT_PROPERTIES_3;
+	entry.properties3.pNext = nullptr;
+#endif
+}
+
+FormatCapabilityTable::Entry const* FormatCapabilityTable::find_entry(VkFormat format) const {
+	const uint32_t index = detail::format_table_index(format);
+	if (index >= entries.size()) return nullptr;
+	return &entries[index];
+}
+
+VkFormatProperties FormatCapabilityTable::get_format_properties(VkFormat format) const {
+	auto entry = find_entry(format);
+	if (entry == nullptr) return VkFormatProperties{};
+	return entry->properties;
+}
+#if defined(VKB_VK_API_VERSION_1_3)
+VkFormatProperties3 FormatCapabilityTable::get_format_properties3(VkFormat format) const {
+	auto entry = find_entry(format);
+	if (entry == nullptr) {
+		VkFormatProperties3 properties3{};
+		properties3.sType = VK_STRUCTURE_TYPE_FORMAT_PROPERTIES_3;
+		return properties3;
+	}
+	return entry->properties3;
+}
+#endif
+#if defined(VK_EXT_image_drm_format_modifier)
+std::vector<VkDrmFormatModifierPropertiesEXT> const& FormatCapabilityTable::get_drm_format_modifiers(VkFormat format) const {
+	static const std::vector<VkDrmFormatModifierPropertiesEXT> no_modifiers;
+	auto entry = find_entry(format);
+	if (entry == nullptr) return no_modifiers;
+	return entry->drm_format_modifiers;
+}
+#endif
+
+bool FormatCapabilityTable::supports_image_features(VkFormat format, VkImageTiling tiling, VkFormatFeatureFlags features) const {
+	const VkFormatProperties properties = get_format_properties(format);
+	switch (tiling) {
+		case VK_IMAGE_TILING_OPTIMAL:
+			return (properties.optimalTilingFeatures & features) == features;
+		case VK_IMAGE_TILING_LINEAR:
+			return (properties.linearTilingFeatures & features) == features;
+		default:
+			return false;
+	}
+}
+bool FormatCapabilityTable::supports_buffer_features(VkFormat format, VkFormatFeatureFlags features) const {
+	return (get_format_properties(format).bufferFeatures & features) == features;
+}
+VkFormat FormatCapabilityTable::find_supported_format(
+    std::vector<VkFormat> const& candidates, VkImageTiling tiling, VkFormatFeatureFlags features) const {
+	for (auto const& candidate : candidates) {
+		if (supports_image_features(candidate, tiling, features)) return candidate;
+	}
+	return VK_FORMAT_UNDEFINED;
+}
+
+detail::Result<VkImageFormatProperties> FormatCapabilityTable::get_image_format_properties(
+    VkFormat format, VkImageType type, VkImageTiling tiling, VkImageUsageFlags usage, VkImageCreateFlags flags) const {
+	if (physical_device == VK_NULL_HANDLE) return { PhysicalDeviceError::failed_get_image_format_properties };
+
+	const ImageFormatKey key{ format, type, tiling, usage, flags };
+	std::lock_guard<std::mutex> lg(image_format_mutex);
+	auto it = image_format_properties.find(key);
+	if (it == image_format_properties.end()) {
+		ImageFormatResult image_format{};
+		image_format.result = detail::vulkan_functions().fp_vkGetPhysicalDeviceImageFormatProperties(
+		    physical_device, format, type, tiling, usage, flags, &image_format.properties);
+		it = image_format_properties.emplace(key, image_format).first;
+	}
+	if (it->second.result != VK_SUCCESS) {
+		return { PhysicalDeviceError::failed_get_image_format_properties, it->second.result };
+	}
+	return it->second.properties;
+}
+
+bool FormatCapabilityTable::has_format_feature_flags2() const { return format_feature_flags2; }
+bool FormatCapabilityTable::has_drm_format_modifiers() const { return drm_format_modifiers; }
+
+bool FormatCapabilityTable::ImageFormatKey::operator==(ImageFormatKey const& other) const {
+	return format == other.format && type == other.type && tiling == other.tiling && usage == other.usage && flags == other.flags;
+}
+size_t FormatCapabilityTable::ImageFormatKeyHash::operator()(ImageFormatKey const& key) const {
+	size_t hash = 0;
+	auto combine = [&hash](uint32_t value) { hash ^= std::hash<uint32_t>{}(value) + 0x9e3779b9 + (hash << 6) + (hash >> 2); };
+	combine(static_cast<uint32_t>(key.format));
+	combine(static_cast<uint32_t>(key.type));
+	combine(static_cast<uint32_t>(key.tiling));
+	combine(key.usage);
+	combine(key.flags);
+	return hash;
+}
+
 // ---- Queues ---- //
 
 detail::Result<uint32_t> Device::get_queue_index(QueueType type) const {
@@ -1472,10 +1837,113 @@ detail::Result<VkQueue> Device::get_dedicated_queue(QueueType type) const {
 	return out_queue;
 }
 
+namespace detail {
+struct QueueRegistry {
+	std::mutex mutex;
+	std::vector<std::shared_ptr<QueueSyncState>> queues;
+};
+
+std::unique_lock<std::mutex> QueueSyncState::lock() {
+	lock_count.fetch_add(1, std::memory_order_relaxed);
+	std::unique_lock<std::mutex> queue_lock(mutex, std::try_to_lock);
+	if (queue_lock.owns_lock()) return queue_lock;
+
+	// Only time the wait when there is one, so uncontended submits stay cheap
+	auto start = std::chrono::steady_clock::now();
+	queue_lock.lock();
+	uint64_t wait_ns = static_cast<uint64_t>(
+	    std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+	contended_count.fetch_add(1, std::memory_order_relaxed);
+	total_wait_ns.fetch_add(wait_ns, std::memory_order_relaxed);
+	uint64_t prev_max = max_wait_ns.load(std::memory_order_relaxed);
+	while (prev_max < wait_ns && !max_wait_ns.compare_exchange_weak(prev_max, wait_ns, std::memory_order_relaxed)) {
+	}
+	return queue_lock;
+}
+} // namespace detail
+
+detail::Result<QueueHandle> Device::get_queue_handle(QueueType type) const {
+	auto index = get_queue_index(type);
+	if (!index.has_value()) return { index.error() };
+	return get_queue_handle(index.value(), 0);
+}
+detail::Result<QueueHandle> Device::get_dedicated_queue_handle(QueueType type) const {
+	auto index = get_dedicated_queue_index(type);
+	if (!index.has_value()) return { index.error() };
+	return get_queue_handle(index.value(), 0);
+}
+detail::Result<QueueHandle> Device::get_queue_handle(uint32_t family_index, uint32_t queue_index) const {
+	assert(queue_registry != nullptr && "Device must be created with DeviceBuilder");
+	if (family_index >= queue_families.size()) return detail::Result<QueueHandle>{ QueueError::invalid_queue_family_index };
+	if (family_index >= created_queue_counts.size() || queue_index >= created_queue_counts[family_index])
+		return detail::Result<QueueHandle>{ QueueError::queue_index_out_of_range };
+
+	VkQueue queue = VK_NULL_HANDLE;
+	internal_table.fp_vkGetDeviceQueue(device, family_index, queue_index, &queue);
+
+	// Hand out the same state for the same VkQueue, so that every handle to it shares one lock
+	std::lock_guard<std::mutex> lock(queue_registry->mutex);
+	for (auto& state : queue_registry->queues) {
+		if (state->queue == queue) return QueueHandle{ state };
+	}
+	auto state = std::make_shared<detail::QueueSyncState>();
+	state->queue = queue;
+	state->family_index = family_index;
+	state->queue_index = queue_index;
+	state->fp_vkQueueSubmit = internal_table.fp_vkQueueSubmit;
+	state->fp_vkQueuePresentKHR = internal_table.fp_vkQueuePresentKHR;
+	state->fp_vkQueueWaitIdle = internal_table.fp_vkQueueWaitIdle;
+	queue_registry->queues.push_back(state);
+	return QueueHandle{ state };
+}
+
+QueueHandle::QueueHandle(std::shared_ptr<detail::QueueSyncState> state) : state(std::move(state)) {}
+
+VkQueue QueueHandle::get_queue() const { return state ? state->queue : VK_NULL_HANDLE; }
+uint32_t QueueHandle::get_family_index() const { return state ? state->family_index : detail::QUEUE_INDEX_MAX_VALUE; }
+uint32_t QueueHandle::get_queue_index() const { return state ? state->queue_index : 0; }
+
+VkResult QueueHandle::submit(uint32_t submit_count, const VkSubmitInfo* submits, VkFence fence) const {
+	assert(state != nullptr && "QueueHandle must be obtained from a Device");
+	if (!state) return VK_ERROR_INITIALIZATION_FAILED;
+	auto lock = state->lock();
+	return state->fp_vkQueueSubmit(state->queue, submit_count, submits, fence);
+}
+VkResult QueueHandle::present(VkPresentInfoKHR const& present_info) const {
+	assert(state != nullptr && "QueueHandle must be obtained from a Device");
+	if (!state) return VK_ERROR_INITIALIZATION_FAILED;
+	assert(state->fp_vkQueuePresentKHR != nullptr && "VK_KHR_swapchain must be enabled to present");
+	auto lock = state->lock();
+	return state->fp_vkQueuePresentKHR(state->queue, &present_info);
+}
+VkResult QueueHandle::wait_idle() const {
+	assert(state != nullptr && "QueueHandle must be obtained from a Device");
+	if (!state) return VK_ERROR_INITIALIZATION_FAILED;
+	auto lock = state->lock();
+	return state->fp_vkQueueWaitIdle(state->queue);
+}
+
+QueueContentionStats QueueHandle::get_contention_stats() const {
+	QueueContentionStats stats;
+	if (!state) return stats;
+	stats.lock_count = state->lock_count.load(std::memory_order_relaxed);
+	stats.contended_count = state->contended_count.load(std::memory_order_relaxed);
+	stats.total_wait_ns = state->total_wait_ns.load(std::memory_order_relaxed);
+	stats.max_wait_ns = state->max_wait_ns.load(std::memory_order_relaxed);
+	return stats;
+}
+
+QueueHandle::operator VkQueue() const { return get_queue(); }
+
 // ---- Dispatch ---- //
 
 DispatchTable Device::make_table() const { return { device, fp_vkGetDeviceProcAddr }; }
 
+QueueGlobalPriority Device::get_queue_global_priority(uint32_t family_index) const {
+	if (family_index >= queue_global_priorities.size()) return QueueGlobalPriority::unspecified;
+	return queue_global_priorities[family_index];
+}
+
 // ---- Device ---- //
 
 Device::operator VkDevice() const { return this->device; }
@@ -1484,6 +1952,27 @@ CustomQueueDescription::CustomQueueDescription(uint32_t index, uint32_t count, s
 : index(index), count(count), priorities(priorities) {
 	assert(count == priorities.size());
 }
+CustomQueueDescription::CustomQueueDescription(
+    uint32_t index, uint32_t count, std::vector<float> priorities, QueueGlobalPriority global_priority)
+: index(index), count(count), priorities(priorities), global_priority(global_priority) {
+	assert(count == priorities.size());
+}
+
+namespace detail {
+// The highest priority at or below `priority` that the family supports. Families which can't report their
+// priorities are assumed to support everything.
+QueueGlobalPriority clamp_global_priority(
+    std::vector<std::vector<QueueGlobalPriority>> const& family_priorities, uint32_t family_index, QueueGlobalPriority priority) {
+	if (priority == QueueGlobalPriority::unspecified || family_index >= family_priorities.size() ||
+	    family_priorities[family_index].empty())
+		return priority;
+	QueueGlobalPriority best = QueueGlobalPriority::unspecified;
+	for (auto supported : family_priorities[family_index]) {
+		if (supported <= priority && supported > best) best = supported;
+	}
+	return best;
+}
+} // namespace detail
 
 void destroy_device(Device device) {
 	device.internal_table.fp_vkDestroyDevice(device.device, device.allocation_callbacks);
@@ -1512,10 +2001,32 @@ detail::Result<Device> DeviceBuilder::build() const {
 		queueCreateInfos.push_back(queue_create_info);
 	}
 
+	// Global priorities are only requested when the device has the extension, and lowered up front to what each family supports
+	std::vector<QueueGlobalPriority> global_priorities;
+	bool uses_global_priority = false;
+	for (auto& desc : queue_descriptions) {
+		QueueGlobalPriority priority = QueueGlobalPriority::unspecified;
+		if (physical_device.global_priority_extension != nullptr) {
+			priority = detail::clamp_global_priority(physical_device.queue_family_global_priorities, desc.index, desc.global_priority);
+		}
+		if (priority != QueueGlobalPriority::unspecified) uses_global_priority = true;
+		global_priorities.push_back(priority);
+	}
+#if defined(VK_EXT_global_priority)
+	std::vector<VkDeviceQueueGlobalPriorityCreateInfoEXT> global_priority_infos(queue_descriptions.size());
+	for (auto& global_priority_info : global_priority_infos) {
+		global_priority_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_GLOBAL_PRIORITY_CREATE_INFO_EXT;
+	}
+#endif
+
 	std::vector<const char*> extensions;
 	for (const auto& ext : physical_device.extensions) {
 		extensions.push_back(ext.c_str());
 	}
+	if (uses_global_priority && std::find(physical_device.extensions.begin(),
+	                                physical_device.extensions.end(),
+	                                physical_device.global_priority_extension) == physical_device.extensions.end())
+		extensions.push_back(physical_device.global_priority_extension);
 	if (physical_device.surface != VK_NULL_HANDLE || physical_device.defer_surface_initialization)
 		extensions.push_back({ VK_KHR_SWAPCHAIN_EXTENSION_NAME });
 
@@ -1574,8 +2085,40 @@ detail::Result<Device> DeviceBuilder::build() const {
 
 	Device device;
 
-	VkResult res = detail::vulkan_functions().fp_vkCreateDevice(
-	    physical_device.physical_device, &device_create_info, info.allocation_callbacks, &device.device);
+	VkResult res = VK_SUCCESS;
+	while (true) {
+#if defined(VK_EXT_global_priority)
+		for (size_t i = 0; i < queueCreateInfos.size(); i++) {
+			global_priority_infos[i].globalPriority = static_cast<VkQueueGlobalPriorityEXT>(global_priorities[i]);
+			queueCreateInfos[i].pNext =
+			    global_priorities[i] != QueueGlobalPriority::unspecified ? &global_priority_infos[i] : nullptr;
+		}
+#endif
+		res = detail::vulkan_functions().fp_vkCreateDevice(
+		    physical_device.physical_device, &device_create_info, info.allocation_callbacks, &device.device);
+#if defined(VK_EXT_global_priority)
+		if (res != VK_ERROR_NOT_PERMITTED_EXT || !uses_global_priority) break;
+
+		// The driver refused a priority, which only happens above medium. Step the highest requested priority down and retry.
+		QueueGlobalPriority highest = QueueGlobalPriority::unspecified;
+		for (auto priority : global_priorities)
+			if (priority > highest) highest = priority;
+		if (highest <= QueueGlobalPriority::medium) break;
+		QueueGlobalPriority lower = highest == QueueGlobalPriority::realtime ? QueueGlobalPriority::high : QueueGlobalPriority::medium;
+		for (size_t i = 0; i < global_priorities.size(); i++) {
+			if (global_priorities[i] == highest)
+				global_priorities[i] = detail::clamp_global_priority(
+				    physical_device.queue_family_global_priorities, queue_descriptions[i].index, lower);
+		}
+#else
+		break;
+#endif
+	}
+#if defined(VK_EXT_global_priority)
+	if (res == VK_ERROR_NOT_PERMITTED_EXT) {
+		return { DeviceError::global_priority_not_permitted, res };
+	}
+#endif
 	if (res != VK_SUCCESS) {
 		return { DeviceError::failed_create_device, res };
 	}
@@ -1587,6 +2130,20 @@ detail::Result<Device> DeviceBuilder::build() const {
 	device.fp_vkGetDeviceProcAddr = detail::vulkan_functions().fp_vkGetDeviceProcAddr;
 	detail::vulkan_functions().get_device_proc_addr(device.device, device.internal_table.fp_vkGetDeviceQueue, "vkGetDeviceQueue");
 	detail::vulkan_functions().get_device_proc_addr(device.device, device.internal_table.fp_vkDestroyDevice, "vkDestroyDevice");
+	detail::vulkan_functions().get_device_proc_addr(device.device, device.internal_table.fp_vkQueueSubmit, "vkQueueSubmit");
+	detail::vulkan_functions().get_device_proc_addr(device.device, device.internal_table.fp_vkQueueWaitIdle, "vkQueueWaitIdle");
+	if (physical_device.surface != VK_NULL_HANDLE || physical_device.defer_surface_initialization)
+		detail::vulkan_functions().get_device_proc_addr(
+		    device.device, device.internal_table.fp_vkQueuePresentKHR, "vkQueuePresentKHR");
+	device.queue_registry = std::make_shared<detail::QueueRegistry>();
+	device.queue_global_priorities.resize(physical_device.queue_families.size(), QueueGlobalPriority::unspecified);
+	device.created_queue_counts.resize(physical_device.queue_families.size(), 0);
+	for (size_t i = 0; i < queue_descriptions.size(); i++) {
+		if (queue_descriptions[i].index < device.queue_global_priorities.size()) {
+			device.queue_global_priorities[queue_descriptions[i].index] = global_priorities[i];
+			device.created_queue_counts[queue_descriptions[i].index] = queue_descriptions[i].count;
+		}
+	}
 	return device;
 }
 DeviceBuilder& DeviceBuilder::custom_queue_setup(std::vector<CustomQueueDescription> queue_descriptions) {
@@ -1662,6 +2219,7 @@ Result<SurfaceSupportDetails> query_surface_support_details(VkPhysicalDevice phy
 }
 
 VkSurfaceFormatKHR find_surface_format(VkPhysicalDevice phys_device,
+    FormatCapabilityTable const* format_capabilities,
     std::vector<VkSurfaceFormatKHR> const& available_formats,
     std::vector<VkSurfaceFormatKHR> const& desired_formats,
     VkFormatFeatureFlags feature_flags) {
@@ -1670,7 +2228,11 @@ VkSurfaceFormatKHR find_surface_format(VkPhysicalDevice phys_device,
 			// finds the first format that is desired and available
 			if (desired_format.format == available_format.format && desired_format.colorSpace == available_format.colorSpace) {
 				VkFormatProperties properties;
-				detail::vulkan_functions().fp_vkGetPhysicalDeviceFormatProperties(phys_device, desired_format.format, &properties);
+				if (format_capabilities != nullptr) {
+					properties = format_capabilities->get_format_properties(desired_format.format);
+				} else {
+					detail::vulkan_functions().fp_vkGetPhysicalDeviceFormatProperties(phys_device, desired_format.format, &properties);
+				}
 				if ((properties.optimalTilingFeatures & feature_flags) == feature_flags) return desired_format;
 			}
 		}
@@ -1727,6 +2289,10 @@ SwapchainBuilder::SwapchainBuilder(Device const& device) {
 	info.graphics_queue_index = present.value();
 	info.present_queue_index = graphics.value();
 	info.allocation_callbacks = device.allocation_callbacks;
+	info.format_capability_cache = device.physical_device.format_capability_cache;
+	info.present_id_available = device.physical_device.present_timing.present_id;
+	info.present_wait_available = device.physical_device.present_timing.present_wait;
+	info.display_timing_available = device.physical_device.present_timing.display_timing;
 }
 SwapchainBuilder::SwapchainBuilder(Device const& device, VkSurfaceKHR const surface) {
 	info.device = device.device;
@@ -1740,6 +2306,10 @@ SwapchainBuilder::SwapchainBuilder(Device const& device, VkSurfaceKHR const surf
 	info.graphics_queue_index = present.value();
 	info.present_queue_index = graphics.value();
 	info.allocation_callbacks = device.allocation_callbacks;
+	info.format_capability_cache = device.physical_device.format_capability_cache;
+	info.present_id_available = device.physical_device.present_timing.present_id;
+	info.present_wait_available = device.physical_device.present_timing.present_wait;
+	info.display_timing_available = device.physical_device.present_timing.display_timing;
 }
 SwapchainBuilder::SwapchainBuilder(VkPhysicalDevice const physical_device,
     VkDevice const device,
@@ -1789,12 +2359,24 @@ detail::Result<Swapchain> SwapchainBuilder::build() const {
 		if (image_count < surface_support.capabilities.minImageCount)
 			image_count = surface_support.capabilities.minImageCount;
 	}
+	if (info.tuner != nullptr && info.tuner->built) {
+		image_count = detail::maximum(info.tuner->image_count, info.required_min_image_count);
+		if (image_count < surface_support.capabilities.minImageCount)
+			image_count = surface_support.capabilities.minImageCount;
+		desired_present_modes.insert(desired_present_modes.begin(), info.tuner->present_mode);
+	}
 	if (surface_support.capabilities.maxImageCount > 0 && image_count > surface_support.capabilities.maxImageCount) {
 		image_count = surface_support.capabilities.maxImageCount;
 	}
 
-	VkSurfaceFormatKHR surface_format =
-	    detail::find_surface_format(info.physical_device, surface_support.formats, desired_formats, info.format_feature_flags);
+	// Only use the format table when it describes the physical device the swapchain is built for
+	FormatCapabilityTable const* format_capabilities = nullptr;
+	if (info.format_capability_cache && info.format_capability_cache->physical_device == info.physical_device) {
+		format_capabilities = &detail::get_format_capabilities(*info.format_capability_cache);
+	}
+
+	VkSurfaceFormatKHR surface_format = detail::find_surface_format(
+	    info.physical_device, format_capabilities, surface_support.formats, desired_formats, info.format_feature_flags);
 
 	VkExtent2D extent = detail::find_extent(surface_support.capabilities, info.desired_width, info.desired_height);
 
@@ -1868,6 +2450,32 @@ detail::Result<Swapchain> SwapchainBuilder::build() const {
 	swapchain.present_mode = present_mode;
 	swapchain.image_count = static_cast<uint32_t>(images.value().size());
 	swapchain.allocation_callbacks = info.allocation_callbacks;
+	if (info.tuner != nullptr) {
+		// The driver may create more images than requested, so the tuner continues from the actual count
+		info.tuner->on_swapchain_built(
+		    surface_support.capabilities, surface_support.present_modes, present_mode, swapchain.image_count);
+	}
+	if (info.enable_present_timing) {
+		swapchain.present_id_enabled = info.present_id_available;
+#if defined(VK_KHR_present_wait)
+		if (info.present_wait_available) {
+			detail::vulkan_functions().get_device_proc_addr(
+			    info.device, swapchain.internal_table.fp_vkWaitForPresentKHR, "vkWaitForPresentKHR");
+			swapchain.present_wait_enabled = swapchain.internal_table.fp_vkWaitForPresentKHR != nullptr;
+		}
+#endif
+#if defined(VK_GOOGLE_display_timing)
+		if (info.display_timing_available) {
+			detail::vulkan_functions().get_device_proc_addr(
+			    info.device, swapchain.internal_table.fp_vkGetRefreshCycleDurationGOOGLE, "vkGetRefreshCycleDurationGOOGLE");
+			detail::vulkan_functions().get_device_proc_addr(info.device,
+			    swapchain.internal_table.fp_vkGetPastPresentationTimingGOOGLE,
+			    "vkGetPastPresentationTimingGOOGLE");
+			swapchain.display_timing_enabled = swapchain.internal_table.fp_vkGetRefreshCycleDurationGOOGLE != nullptr &&
+			                                   swapchain.internal_table.fp_vkGetPastPresentationTimingGOOGLE != nullptr;
+		}
+#endif
+	}
 	return swapchain;
 }
 detail::Result<std::vector<VkImage>> Swapchain::get_images() {
@@ -1915,6 +2523,40 @@ void Swapchain::destroy_image_views(std::vector<VkImageView> const& image_views)
 		internal_table.fp_vkDestroyImageView(device, image_view, allocation_callbacks);
 	}
 }
+detail::Result<bool> Swapchain::wait_for_present(uint64_t present_id, uint64_t timeout) const {
+#if defined(VK_KHR_present_wait)
+	if (!present_wait_enabled) return detail::Error{ SwapchainError::present_timing_not_enabled };
+	VkResult res = internal_table.fp_vkWaitForPresentKHR(device, swapchain, present_id, timeout);
+	if (res == VK_TIMEOUT) return false;
+	if (res != VK_SUCCESS && res != VK_SUBOPTIMAL_KHR) return detail::Error{ SwapchainError::failed_wait_for_present, res };
+	return true;
+#else
+	(void)present_id;
+	(void)timeout;
+	return detail::Error{ SwapchainError::present_timing_not_enabled };
+#endif
+}
+detail::Result<uint64_t> Swapchain::get_refresh_cycle_duration() const {
+#if defined(VK_GOOGLE_display_timing)
+	if (!display_timing_enabled) return detail::Error{ SwapchainError::present_timing_not_enabled };
+	VkRefreshCycleDurationGOOGLE refresh_cycle{};
+	VkResult res = internal_table.fp_vkGetRefreshCycleDurationGOOGLE(device, swapchain, &refresh_cycle);
+	if (res != VK_SUCCESS) return detail::Error{ SwapchainError::failed_get_presentation_timing, res };
+	return refresh_cycle.refreshDuration;
+#else
+	return detail::Error{ SwapchainError::present_timing_not_enabled };
+#endif
+}
+#if defined(VK_GOOGLE_display_timing)
+detail::Result<std::vector<VkPastPresentationTimingGOOGLE>> Swapchain::get_past_presentation_timing() const {
+	if (!display_timing_enabled) return detail::Error{ SwapchainError::present_timing_not_enabled };
+	std::vector<VkPastPresentationTimingGOOGLE> timings;
+	auto timings_ret = detail::get_vector<VkPastPresentationTimingGOOGLE>(
+	    timings, internal_table.fp_vkGetPastPresentationTimingGOOGLE, device, swapchain);
+	if (timings_ret != VK_SUCCESS) return detail::Error{ SwapchainError::failed_get_presentation_timing, timings_ret };
+	return timings;
+}
+#endif
 Swapchain::operator VkSwapchainKHR() const { return this->swapchain; }
 SwapchainBuilder& SwapchainBuilder::set_old_swapchain(VkSwapchainKHR old_swapchain) {
 	info.old_swapchain = old_swapchain;
@@ -2013,6 +2655,15 @@ SwapchainBuilder& SwapchainBuilder::set_composite_alpha_flags(VkCompositeAlphaFl
 	return *this;
 }
 
+SwapchainBuilder& SwapchainBuilder::enable_present_timing(bool enable) {
+	info.enable_present_timing = enable;
+	return *this;
+}
+SwapchainBuilder& SwapchainBuilder::set_tuner(SwapchainTuner* tuner) {
+	info.tuner = tuner;
+	return *this;
+}
+
 void SwapchainBuilder::add_desired_formats(std::vector<VkSurfaceFormatKHR>& formats) const {
 	formats.push_back({ VK_FORMAT_B8G8R8A8_SRGB, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR });
 	formats.push_back({ VK_FORMAT_R8G8B8A8_SRGB, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR });
@@ -2021,4 +2672,240 @@ void SwapchainBuilder::add_desired_present_modes(std::vector<VkPresentModeKHR>&
 	modes.push_back(VK_PRESENT_MODE_MAILBOX_KHR);
 	modes.push_back(VK_PRESENT_MODE_FIFO_KHR);
 }
+
+SwapchainTuner::SwapchainTuner(SwapchainTuningPolicy policy) : policy(policy) {}
+
+SwapchainTuner& SwapchainTuner::set_policy(SwapchainTuningPolicy new_policy) {
+	policy = new_policy;
+	return *this;
+}
+SwapchainTuner& SwapchainTuner::set_refresh_cycle_duration(std::chrono::nanoseconds duration) {
+	refresh_cycle_duration = duration;
+	return *this;
+}
+SwapchainTuner& SwapchainTuner::set_hysteresis(uint32_t frame_count) {
+	hysteresis = detail::maximum(frame_count, 1u);
+	return *this;
+}
+SwapchainTuner& SwapchainTuner::set_cooldown(uint32_t frame_count) {
+	cooldown = frame_count;
+	return *this;
+}
+
+bool SwapchainTuner::record_frame(std::chrono::nanoseconds cpu_time, std::chrono::nanoseconds gpu_time) {
+	if (!built || refresh_cycle_duration.count() <= 0) return false;
+	if (rebuild_requested) return true;
+	if (cooldown_remaining > 0) {
+		cooldown_remaining--;
+		return false;
+	}
+
+	// The more a policy favors throughput, the more headroom a frame needs before images are taken away
+	double keep_up_ratio = 0.7;
+	if (policy == SwapchainTuningPolicy::latency) keep_up_ratio = 0.85;
+	if (policy == SwapchainTuningPolicy::throughput) keep_up_ratio = 0.5;
+
+	auto frame_time = detail::maximum(cpu_time, gpu_time);
+	auto keep_up_time = std::chrono::nanoseconds{ static_cast<int64_t>(refresh_cycle_duration.count() * keep_up_ratio) };
+	if (frame_time <= keep_up_time) {
+		frames_keeping_up++;
+		frames_falling_behind = 0;
+	} else if (frame_time > refresh_cycle_duration) {
+		frames_falling_behind++;
+		frames_keeping_up = 0;
+	} else {
+		frames_keeping_up = 0;
+		frames_falling_behind = 0;
+	}
+
+	uint32_t min_image_count = detail::maximum(surface_min_image_count, 2u);
+	if (policy == SwapchainTuningPolicy::throughput) min_image_count = detail::maximum(min_image_count, 3u);
+	min_image_count = detail::minimum(min_image_count, get_max_image_count());
+
+	bool can_relax = present_mode == VK_PRESENT_MODE_FIFO_KHR && policy != SwapchainTuningPolicy::throughput &&
+	                 is_present_mode_available(VK_PRESENT_MODE_FIFO_RELAXED_KHR);
+	bool can_unrelax = present_mode == VK_PRESENT_MODE_FIFO_RELAXED_KHR && policy != SwapchainTuningPolicy::latency &&
+	                   is_present_mode_available(VK_PRESENT_MODE_FIFO_KHR);
+
+	if (frames_keeping_up >= hysteresis) {
+		frames_keeping_up = 0;
+		if (can_unrelax) {
+			present_mode = VK_PRESENT_MODE_FIFO_KHR;
+			rebuild_requested = true;
+		} else if (image_count > min_image_count) {
+			image_count--;
+			rebuild_requested = true;
+		}
+	} else if (frames_falling_behind >= hysteresis) {
+		frames_falling_behind = 0;
+		// Tearing on a late frame costs less latency than queueing another image
+		if (can_relax && policy == SwapchainTuningPolicy::latency) {
+			present_mode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+			rebuild_requested = true;
+		} else if (image_count < get_max_image_count()) {
+			image_count++;
+			rebuild_requested = true;
+		} else if (can_relax) {
+			present_mode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+			rebuild_requested = true;
+		}
+	}
+	return rebuild_requested;
+}
+
+bool SwapchainTuner::needs_rebuild() const { return rebuild_requested; }
+uint32_t SwapchainTuner::get_image_count() const { return image_count; }
+VkPresentModeKHR SwapchainTuner::get_present_mode() const { return present_mode; }
+
+void SwapchainTuner::on_swapchain_built(VkSurfaceCapabilitiesKHR const& capabilities,
+    std::vector<VkPresentModeKHR> const& present_modes,
+    VkPresentModeKHR built_present_mode,
+    uint32_t built_image_count) {
+	built = true;
+	rebuild_requested = false;
+	available_present_modes = present_modes;
+	surface_min_image_count = capabilities.minImageCount;
+	surface_max_image_count = capabilities.maxImageCount;
+	present_mode = built_present_mode;
+	image_count = built_image_count;
+	cooldown_remaining = cooldown;
+	frames_keeping_up = 0;
+	frames_falling_behind = 0;
+}
+
+bool SwapchainTuner::is_present_mode_available(VkPresentModeKHR mode) const {
+	return std::find(available_present_modes.begin(), available_present_modes.end(), mode) != available_present_modes.end();
+}
+
+uint32_t SwapchainTuner::get_max_image_count() const {
+	uint32_t max_image_count = policy == SwapchainTuningPolicy::throughput ? 4 : 3;
+	max_image_count = detail::maximum(max_image_count, surface_min_image_count);
+	if (surface_max_image_count > 0) max_image_count = detail::minimum(max_image_count, surface_max_image_count);
+	return max_image_count;
+}
+
+// ---- Frame Latency ---- //
+
+FrameLatencyTracker::FrameLatencyTracker(uint32_t frame_capacity) : frames(frame_capacity > 0 ? frame_capacity : 1) {}
+
+uint64_t FrameLatencyTracker::begin_frame() {
+	auto now = clock::now();
+	std::lock_guard<std::mutex> lock(mutex);
+	if (low_latency_mode) update_pacing_delay();
+	uint64_t frame_id = next_frame_id++;
+	FrameRecord& record = frames[frame_id % frames.size()];
+	record = FrameRecord{};
+	record.frame_id = frame_id;
+	record.times[static_cast<uint32_t>(FrameStage::frame_start)] = now;
+	record.recorded[static_cast<uint32_t>(FrameStage::frame_start)] = true;
+	return frame_id;
+}
+
+uint64_t FrameLatencyTracker::wait_and_begin_frame() {
+	auto delay = get_pacing_delay();
+	if (delay.count() > 0) std::this_thread::sleep_for(delay);
+	return begin_frame();
+}
+
+void FrameLatencyTracker::record(uint64_t frame_id, FrameStage stage) { record(frame_id, stage, clock::now()); }
+
+void FrameLatencyTracker::record(uint64_t frame_id, FrameStage stage, clock::time_point time) {
+	std::lock_guard<std::mutex> lock(mutex);
+	FrameRecord* record = find_record(frame_id);
+	if (record == nullptr) return;
+	record->times[static_cast<uint32_t>(stage)] = time;
+	record->recorded[static_cast<uint32_t>(stage)] = true;
+}
+
+std::chrono::nanoseconds FrameLatencyTracker::get_percentile(FrameStage from, FrameStage to, double percentile) const {
+	std::vector<std::chrono::nanoseconds> intervals;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		gather_intervals(from, to, intervals);
+	}
+	if (intervals.empty()) return std::chrono::nanoseconds{ 0 };
+	if (percentile < 0.0) percentile = 0.0;
+	if (percentile > 100.0) percentile = 100.0;
+	size_t index = static_cast<size_t>(percentile / 100.0 * static_cast<double>(intervals.size() - 1) + 0.5);
+	std::nth_element(intervals.begin(), intervals.begin() + index, intervals.end());
+	return intervals[index];
+}
+
+uint32_t FrameLatencyTracker::get_sample_count(FrameStage from, FrameStage to) const {
+	std::vector<std::chrono::nanoseconds> intervals;
+	std::lock_guard<std::mutex> lock(mutex);
+	gather_intervals(from, to, intervals);
+	return static_cast<uint32_t>(intervals.size());
+}
+
+void FrameLatencyTracker::set_low_latency_mode(bool enable) {
+	std::lock_guard<std::mutex> lock(mutex);
+	low_latency_mode = enable;
+	if (!enable) pacing_delay = std::chrono::nanoseconds{ 0 };
+}
+
+void FrameLatencyTracker::set_refresh_cycle_duration(std::chrono::nanoseconds duration) {
+	std::lock_guard<std::mutex> lock(mutex);
+	refresh_cycle_duration = duration;
+}
+
+std::chrono::nanoseconds FrameLatencyTracker::get_pacing_delay() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return pacing_delay;
+}
+
+void FrameLatencyTracker::reset() {
+	std::lock_guard<std::mutex> lock(mutex);
+	for (auto& record : frames)
+		record = FrameRecord{};
+	last_paced_frame_id = 0;
+	pacing_delay = std::chrono::nanoseconds{ 0 };
+}
+
+FrameLatencyTracker::FrameRecord* FrameLatencyTracker::find_record(uint64_t frame_id) {
+	FrameRecord& record = frames[frame_id % frames.size()];
+	return record.frame_id == frame_id && frame_id != 0 ? &record : nullptr;
+}
+
+void FrameLatencyTracker::gather_intervals(FrameStage from, FrameStage to, std::vector<std::chrono::nanoseconds>& out) const {
+	uint32_t from_index = static_cast<uint32_t>(from);
+	uint32_t to_index = static_cast<uint32_t>(to);
+	for (const auto& record : frames) {
+		if (record.frame_id == 0 || !record.recorded[from_index] || !record.recorded[to_index]) continue;
+		out.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(record.times[to_index] - record.times[from_index]));
+	}
+}
+
+// A frame whose present takes longer than a refresh cycle to reach the display was queued behind earlier frames.
+// Starting the next frame later by part of that excess drains the queue, while a small step down every frame
+// without queueing keeps the delay from sticking once the load drops.
+void FrameLatencyTracker::update_pacing_delay() {
+	uint32_t present_index = static_cast<uint32_t>(FrameStage::present);
+	uint32_t complete_index = static_cast<uint32_t>(FrameStage::present_complete);
+
+	FrameRecord const* latest = nullptr;
+	std::chrono::nanoseconds lowest_latency = std::chrono::nanoseconds::max();
+	for (const auto& record : frames) {
+		if (record.frame_id == 0 || !record.recorded[present_index] || !record.recorded[complete_index]) continue;
+		auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(record.times[complete_index] - record.times[present_index]);
+		if (latency < lowest_latency) lowest_latency = latency;
+		if (latest == nullptr || record.frame_id > latest->frame_id) latest = &record;
+	}
+	if (latest == nullptr || latest->frame_id <= last_paced_frame_id) return;
+	last_paced_frame_id = latest->frame_id;
+
+	auto expected = refresh_cycle_duration.count() > 0 ? refresh_cycle_duration : lowest_latency;
+	auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(latest->times[complete_index] - latest->times[present_index]);
+	auto excess = latency - expected;
+	if (excess.count() > 0) {
+		pacing_delay += excess / 2;
+	} else {
+		pacing_delay -= expected / 16;
+	}
+	// Never hold a frame back by more than a few refresh cycles
+	auto max_delay = expected * 4;
+	if (pacing_delay > max_delay) pacing_delay = max_delay;
+	if (pacing_delay.count() < 0) pacing_delay = std::chrono::nanoseconds{ 0 };
+}
+
 } // namespace vkb
@@ -0,0 +1,692 @@
+//
+// Replays a recording written by VMA with VmaAllocatorCreateInfo::pRecordSettings
+// against a stub Vulkan device and reports allocation latency, peak memory,
+// block counts and fragmentation over time.
+//
+// Usage: vma_replay <recording> [options]
+//   --heap <index>=<MiB>      Override size of a memory heap of the recorded device.
+//   --block-size <MiB>        Override VmaAllocatorCreateInfo::preferredLargeHeapBlockSize.
+//   --interval <records>      Print statistics every that many records. Default 10000.
+//   --algorithm <name>        Replay with given pool algorithm: tlsf, linear or buddy. Recorded custom pools
+//                             use it instead of their own, and allocations from default pools go to
+//                             a custom pool per memory type created with it, except dedicated ones.
+//
+// Format of the recording is described in vk_mem_alloc.h, chapter "Recording and replay".
+//
+
+#define VMA_IMPLEMENTATION
+#define VMA_STATIC_VULKAN_FUNCTIONS 0
+#define VMA_DYNAMIC_VULKAN_FUNCTIONS 0
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <vk_mem_alloc.h>
+
+namespace
+{
+
+// Must match VmaRecorder.
+enum CALL
+{
+    CALL_CREATE_POOL = 1,
+    CALL_DESTROY_POOL = 2,
+    CALL_ALLOCATE_MEMORY = 3,
+    CALL_FREE_MEMORY = 4,
+    CALL_SET_CURRENT_FRAME_INDEX = 5,
+};
+const uint32_t FORMAT_VERSION = 1;
+
+// Extension flags whose functions the stub device doesn't provide.
+const VmaAllocatorCreateFlags UNSUPPORTED_ALLOCATOR_FLAGS =
+    VMA_ALLOCATOR_CREATE_KHR_DEDICATED_ALLOCATION_BIT |
+    VMA_ALLOCATOR_CREATE_KHR_BIND_MEMORY2_BIT |
+    VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+
+class Reader
+{
+public:
+    Reader(const std::vector<char>& data) : m_Data(data) {}
+
+    bool IsEnd() const { return m_Offset >= m_Data.size(); }
+    bool IsValid() const { return m_Valid; }
+    size_t GetOffset() const { return m_Offset; }
+
+    template<typename T>
+    T Read()
+    {
+        T value = {};
+        if (m_Offset + sizeof(T) > m_Data.size())
+        {
+            m_Valid = false;
+            m_Offset = m_Data.size();
+            return value;
+        }
+        memcpy(&value, m_Data.data() + m_Offset, sizeof(T));
+        m_Offset += sizeof(T);
+        return value;
+    }
+
+private:
+    const std::vector<char>& m_Data;
+    size_t m_Offset = 0;
+    bool m_Valid = true;
+};
+
+struct Configuration
+{
+    uint32_t vulkanApiVersion = 0;
+    VmaAllocatorCreateFlags allocatorFlags = 0;
+    VkDeviceSize preferredLargeHeapBlockSize = 0;
+    VkPhysicalDeviceProperties deviceProperties = {};
+    VkPhysicalDeviceMemoryProperties memoryProperties = {};
+};
+
+// Stub device: VkDeviceMemory objects only account for heap usage.
+struct StubMemory
+{
+    VkDeviceSize size;
+    uint32_t heapIndex;
+    void* pMappedData;
+};
+
+struct StubDevice
+{
+    Configuration config;
+    VkDeviceSize heapUsage[VK_MAX_MEMORY_HEAPS] = {};
+    VkDeviceSize totalUsage = 0;
+    VkDeviceSize peakUsage = 0;
+    uint32_t memoryCount = 0;
+    uint32_t peakMemoryCount = 0;
+    uint64_t nextHandle = 1;
+};
+
+StubDevice g_Device;
+
+template<typename T>
+T NewStubHandle()
+{
+    return (T)(uintptr_t)(g_Device.nextHandle++ * 16);
+}
+
+VKAPI_ATTR void VKAPI_CALL StubGetPhysicalDeviceProperties(VkPhysicalDevice, VkPhysicalDeviceProperties* pProperties)
+{
+    *pProperties = g_Device.config.deviceProperties;
+}
+
+VKAPI_ATTR void VKAPI_CALL StubGetPhysicalDeviceMemoryProperties(VkPhysicalDevice, VkPhysicalDeviceMemoryProperties* pMemoryProperties)
+{
+    *pMemoryProperties = g_Device.config.memoryProperties;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL StubAllocateMemory(VkDevice, const VkMemoryAllocateInfo* pAllocateInfo,
+    const VkAllocationCallbacks*, VkDeviceMemory* pMemory)
+{
+    const VkPhysicalDeviceMemoryProperties& memProps = g_Device.config.memoryProperties;
+    const uint32_t heapIndex = memProps.memoryTypes[pAllocateInfo->memoryTypeIndex].heapIndex;
+    if (g_Device.heapUsage[heapIndex] + pAllocateInfo->allocationSize > memProps.memoryHeaps[heapIndex].size ||
+        g_Device.memoryCount >= g_Device.config.deviceProperties.limits.maxMemoryAllocationCount)
+    {
+        return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+    }
+
+    StubMemory* memory = new StubMemory{ pAllocateInfo->allocationSize, heapIndex, nullptr };
+    g_Device.heapUsage[heapIndex] += memory->size;
+    g_Device.totalUsage += memory->size;
+    g_Device.peakUsage = std::max(g_Device.peakUsage, g_Device.totalUsage);
+    g_Device.peakMemoryCount = std::max(g_Device.peakMemoryCount, ++g_Device.memoryCount);
+    *pMemory = (VkDeviceMemory)(uintptr_t)memory;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL StubFreeMemory(VkDevice, VkDeviceMemory memory, const VkAllocationCallbacks*)
+{
+    StubMemory* stubMemory = (StubMemory*)(uintptr_t)memory;
+    if (stubMemory == nullptr)
+        return;
+    g_Device.heapUsage[stubMemory->heapIndex] -= stubMemory->size;
+    g_Device.totalUsage -= stubMemory->size;
+    --g_Device.memoryCount;
+    free(stubMemory->pMappedData);
+    delete stubMemory;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL StubMapMemory(VkDevice, VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize,
+    VkMemoryMapFlags, void** ppData)
+{
+    // Pages are committed by the OS only when touched, and the replay never touches them.
+    StubMemory* stubMemory = (StubMemory*)(uintptr_t)memory;
+    if (stubMemory->pMappedData == nullptr)
+        stubMemory->pMappedData = calloc(1, (size_t)stubMemory->size);
+    if (stubMemory->pMappedData == nullptr)
+        return VK_ERROR_MEMORY_MAP_FAILED;
+    *ppData = (char*)stubMemory->pMappedData + offset;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL StubUnmapMemory(VkDevice, VkDeviceMemory) {}
+
+VKAPI_ATTR VkResult VKAPI_CALL StubFlushMappedMemoryRanges(VkDevice, uint32_t, const VkMappedMemoryRange*)
+{
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL StubBindBufferMemory(VkDevice, VkBuffer, VkDeviceMemory, VkDeviceSize)
+{
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL StubBindImageMemory(VkDevice, VkImage, VkDeviceMemory, VkDeviceSize)
+{
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL StubGetBufferMemoryRequirements(VkDevice, VkBuffer, VkMemoryRequirements* pMemoryRequirements)
+{
+    pMemoryRequirements->size = 0;
+    pMemoryRequirements->alignment = 1;
+    pMemoryRequirements->memoryTypeBits = UINT32_MAX;
+}
+
+VKAPI_ATTR void VKAPI_CALL StubGetImageMemoryRequirements(VkDevice, VkImage, VkMemoryRequirements* pMemoryRequirements)
+{
+    pMemoryRequirements->size = 0;
+    pMemoryRequirements->alignment = 1;
+    pMemoryRequirements->memoryTypeBits = UINT32_MAX;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL StubCreateBuffer(VkDevice, const VkBufferCreateInfo*, const VkAllocationCallbacks*, VkBuffer* pBuffer)
+{
+    *pBuffer = NewStubHandle<VkBuffer>();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL StubDestroyBuffer(VkDevice, VkBuffer, const VkAllocationCallbacks*) {}
+
+VKAPI_ATTR VkResult VKAPI_CALL StubCreateImage(VkDevice, const VkImageCreateInfo*, const VkAllocationCallbacks*, VkImage* pImage)
+{
+    *pImage = NewStubHandle<VkImage>();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL StubDestroyImage(VkDevice, VkImage, const VkAllocationCallbacks*) {}
+
+VKAPI_ATTR void VKAPI_CALL StubCmdCopyBuffer(VkCommandBuffer, VkBuffer, VkBuffer, uint32_t, const VkBufferCopy*) {}
+
+class LatencyStats
+{
+public:
+    void Add(uint64_t nanoseconds) { m_Samples.push_back(nanoseconds); }
+
+    void Print(const char* name)
+    {
+        if (m_Samples.empty())
+        {
+            printf("  %-20s no samples\n", name);
+            return;
+        }
+        std::sort(m_Samples.begin(), m_Samples.end());
+        printf("  %-20s count %-9zu p50 %8.2f  p90 %8.2f  p99 %8.2f  p99.9 %9.2f  max %10.2f us\n",
+            name, m_Samples.size(),
+            Percentile(0.5), Percentile(0.9), Percentile(0.99), Percentile(0.999),
+            m_Samples.back() / 1000.0);
+    }
+
+private:
+    std::vector<uint64_t> m_Samples;
+
+    double Percentile(double fraction) const
+    {
+        const size_t index = std::min(m_Samples.size() - 1, (size_t)(fraction * (double)m_Samples.size()));
+        return m_Samples[index] / 1000.0;
+    }
+};
+
+bool ReadConfiguration(Reader& reader, Configuration& outConfig)
+{
+    char magic[4];
+    for (char& c : magic)
+        c = reader.Read<char>();
+    if (memcmp(magic, "VMAR", 4) != 0)
+    {
+        fprintf(stderr, "Not a VMA recording.\n");
+        return false;
+    }
+    const uint32_t version = reader.Read<uint32_t>();
+    if (version != FORMAT_VERSION)
+    {
+        fprintf(stderr, "Unsupported recording version %u.\n", version);
+        return false;
+    }
+
+    outConfig.vulkanApiVersion = reader.Read<uint32_t>();
+    outConfig.allocatorFlags = reader.Read<uint32_t>();
+    outConfig.preferredLargeHeapBlockSize = reader.Read<uint64_t>();
+    VkPhysicalDeviceProperties& devProps = outConfig.deviceProperties;
+    devProps.apiVersion = VK_API_VERSION_1_0;
+    devProps.limits.bufferImageGranularity = reader.Read<uint64_t>();
+    devProps.limits.nonCoherentAtomSize = reader.Read<uint64_t>();
+    devProps.limits.maxMemoryAllocationCount = reader.Read<uint32_t>();
+
+    VkPhysicalDeviceMemoryProperties& memProps = outConfig.memoryProperties;
+    memProps.memoryHeapCount = reader.Read<uint32_t>();
+    if (memProps.memoryHeapCount > VK_MAX_MEMORY_HEAPS)
+        return false;
+    for (uint32_t i = 0; i < memProps.memoryHeapCount; ++i)
+    {
+        memProps.memoryHeaps[i].size = reader.Read<uint64_t>();
+        memProps.memoryHeaps[i].flags = reader.Read<uint32_t>();
+    }
+    memProps.memoryTypeCount = reader.Read<uint32_t>();
+    if (memProps.memoryTypeCount > VK_MAX_MEMORY_TYPES)
+        return false;
+    for (uint32_t i = 0; i < memProps.memoryTypeCount; ++i)
+    {
+        memProps.memoryTypes[i].propertyFlags = reader.Read<uint32_t>();
+        memProps.memoryTypes[i].heapIndex = reader.Read<uint32_t>();
+    }
+    return reader.IsValid();
+}
+
+uint64_t Now()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void PrintStatisticsHeader()
+{
+    printf("%10s %8s %10s %7s %12s %12s %9s %8s\n",
+        "record", "frame", "time ms", "blocks", "block MiB", "alloc MiB", "unused %", "frag %");
+}
+
+void PrintStatistics(VmaAllocator allocator, size_t recordIndex, uint32_t frameIndex, uint64_t time,
+    uint32_t& inoutPeakBlockCount)
+{
+    VmaTotalStatistics stats;
+    vmaCalculateStatistics(allocator, &stats);
+    const VmaDetailedStatistics& total = stats.total;
+    const VkDeviceSize unusedBytes = total.statistics.blockBytes - total.statistics.allocationBytes;
+    // 0% when all free space forms a single range, close to 100% when it is scattered into many small ones.
+    const double fragmentation = unusedBytes > 0 && total.unusedRangeCount > 0 ?
+        100.0 * (1.0 - (double)total.unusedRangeSizeMax / (double)unusedBytes) : 0.0;
+    inoutPeakBlockCount = std::max(inoutPeakBlockCount, total.statistics.blockCount);
+    printf("%10zu %8u %10.1f %7u %12.2f %12.2f %9.2f %8.2f\n",
+        recordIndex, frameIndex, time / 1e6, total.statistics.blockCount,
+        total.statistics.blockBytes / (1024.0 * 1024.0),
+        total.statistics.allocationBytes / (1024.0 * 1024.0),
+        total.statistics.blockBytes > 0 ? 100.0 * unusedBytes / total.statistics.blockBytes : 0.0,
+        fragmentation);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <recording> [--heap <index>=<MiB>]... [--block-size <MiB>] [--interval <records>]"
+            " [--algorithm tlsf|linear|buddy]\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<std::pair<uint32_t, VkDeviceSize>> heapOverrides;
+    VkDeviceSize blockSizeOverride = 0;
+    size_t interval = 10000;
+    const char* algorithmName = nullptr;
+    VmaPoolCreateFlags algorithm = 0;
+    for (int i = 2; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            fprintf(stderr, "Missing value of %s.\n", arg.c_str());
+            return 1;
+        }
+        const char* value = argv[++i];
+        if (arg == "--heap")
+        {
+            uint32_t heapIndex = 0;
+            unsigned long long sizeMiB = 0;
+            if (sscanf(value, "%u=%llu", &heapIndex, &sizeMiB) != 2 || heapIndex >= VK_MAX_MEMORY_HEAPS)
+            {
+                fprintf(stderr, "Invalid --heap value: %s\n", value);
+                return 1;
+            }
+            heapOverrides.push_back({ heapIndex, (VkDeviceSize)sizeMiB * 1024 * 1024 });
+        }
+        else if (arg == "--block-size")
+            blockSizeOverride = (VkDeviceSize)strtoull(value, nullptr, 10) * 1024 * 1024;
+        else if (arg == "--interval")
+            interval = std::max((size_t)1, (size_t)strtoull(value, nullptr, 10));
+        else if (arg == "--algorithm")
+        {
+            algorithmName = value;
+            if (strcmp(value, "tlsf") == 0)
+                algorithm = 0;
+            else if (strcmp(value, "linear") == 0)
+                algorithm = VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT;
+            else if (strcmp(value, "buddy") == 0)
+                algorithm = VMA_POOL_CREATE_BUDDY_ALGORITHM_BIT;
+            else
+            {
+                fprintf(stderr, "Invalid --algorithm value: %s\n", value);
+                return 1;
+            }
+        }
+        else
+        {
+            fprintf(stderr, "Unknown option: %s\n", arg.c_str());
+            return 1;
+        }
+    }
+
+    std::vector<char> data;
+    {
+        FILE* file = fopen(argv[1], "rb");
+        if (file == nullptr)
+        {
+            fprintf(stderr, "Cannot open %s.\n", argv[1]);
+            return 1;
+        }
+        char buffer[64 * 1024];
+        size_t readCount;
+        while ((readCount = fread(buffer, 1, sizeof(buffer), file)) > 0)
+            data.insert(data.end(), buffer, buffer + readCount);
+        fclose(file);
+    }
+
+    Reader reader(data);
+    Configuration& config = g_Device.config;
+    if (!ReadConfiguration(reader, config))
+    {
+        fprintf(stderr, "Invalid recording header.\n");
+        return 1;
+    }
+    for (const auto& heapOverride : heapOverrides)
+    {
+        if (heapOverride.first < config.memoryProperties.memoryHeapCount)
+            config.memoryProperties.memoryHeaps[heapOverride.first].size = heapOverride.second;
+    }
+
+    printf("Recording: %s, %zu bytes\n", argv[1], data.size());
+    for (uint32_t i = 0; i < config.memoryProperties.memoryHeapCount; ++i)
+    {
+        printf("  heap %u: %.2f MiB%s\n", i, config.memoryProperties.memoryHeaps[i].size / (1024.0 * 1024.0),
+            (config.memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0 ? ", device local" : "");
+    }
+    if ((config.allocatorFlags & UNSUPPORTED_ALLOCATOR_FLAGS) != 0)
+        printf("  Allocator flags 0x%X are ignored by the stub device.\n", config.allocatorFlags & UNSUPPORTED_ALLOCATOR_FLAGS);
+    if (algorithmName != nullptr)
+        printf("  Replayed with pool algorithm %s.\n", algorithmName);
+
+    VmaVulkanFunctions vulkanFunctions = {};
+    vulkanFunctions.vkGetPhysicalDeviceProperties = StubGetPhysicalDeviceProperties;
+    vulkanFunctions.vkGetPhysicalDeviceMemoryProperties = StubGetPhysicalDeviceMemoryProperties;
+    vulkanFunctions.vkAllocateMemory = StubAllocateMemory;
+    vulkanFunctions.vkFreeMemory = StubFreeMemory;
+    vulkanFunctions.vkMapMemory = StubMapMemory;
+    vulkanFunctions.vkUnmapMemory = StubUnmapMemory;
+    vulkanFunctions.vkFlushMappedMemoryRanges = StubFlushMappedMemoryRanges;
+    vulkanFunctions.vkInvalidateMappedMemoryRanges = StubFlushMappedMemoryRanges;
+    vulkanFunctions.vkBindBufferMemory = StubBindBufferMemory;
+    vulkanFunctions.vkBindImageMemory = StubBindImageMemory;
+    vulkanFunctions.vkGetBufferMemoryRequirements = StubGetBufferMemoryRequirements;
+    vulkanFunctions.vkGetImageMemoryRequirements = StubGetImageMemoryRequirements;
+    vulkanFunctions.vkCreateBuffer = StubCreateBuffer;
+    vulkanFunctions.vkDestroyBuffer = StubDestroyBuffer;
+    vulkanFunctions.vkCreateImage = StubCreateImage;
+    vulkanFunctions.vkDestroyImage = StubDestroyImage;
+    vulkanFunctions.vkCmdCopyBuffer = StubCmdCopyBuffer;
+
+    VmaAllocatorCreateInfo allocatorCreateInfo = {};
+    // Frees are recorded when memory is actually released, so deferred freeing is not enabled again.
+    allocatorCreateInfo.flags = config.allocatorFlags & ~UNSUPPORTED_ALLOCATOR_FLAGS;
+    allocatorCreateInfo.physicalDevice = NewStubHandle<VkPhysicalDevice>();
+    allocatorCreateInfo.device = NewStubHandle<VkDevice>();
+    allocatorCreateInfo.instance = NewStubHandle<VkInstance>();
+    allocatorCreateInfo.preferredLargeHeapBlockSize = blockSizeOverride != 0 ? blockSizeOverride : config.preferredLargeHeapBlockSize;
+    allocatorCreateInfo.pVulkanFunctions = &vulkanFunctions;
+    allocatorCreateInfo.vulkanApiVersion = VK_API_VERSION_1_0;
+
+    VmaAllocator allocator = VK_NULL_HANDLE;
+    if (vmaCreateAllocator(&allocatorCreateInfo, &allocator) != VK_SUCCESS)
+    {
+        fprintf(stderr, "Cannot create allocator.\n");
+        return 1;
+    }
+
+    struct Allocation
+    {
+        VmaAllocation allocation;
+        uint64_t poolId;
+    };
+    std::unordered_map<uint64_t, Allocation> allocations;
+    std::unordered_map<uint64_t, VmaPool> pools;
+    // Pools that take allocations of default pools with --algorithm, per memory type.
+    VmaPool algorithmPools[VK_MAX_MEMORY_TYPES] = {};
+    std::unordered_set<uint32_t> threads;
+    LatencyStats recordedAllocLatency, replayedAllocLatency, replayedFreeLatency;
+    std::vector<VmaAllocation> allocBuffer;
+    size_t recordIndex = 0;
+    size_t recordedFailures = 0, replayedFailures = 0, unknownHandles = 0, leakedAllocations = 0;
+    uint32_t frameIndex = 0;
+    uint64_t time = 0;
+    uint32_t peakBlockCount = 0;
+    bool unknownCall = false;
+
+    printf("\nTimeline:\n");
+    PrintStatisticsHeader();
+    while (!reader.IsEnd())
+    {
+        const uint32_t call = reader.Read<uint32_t>();
+        threads.insert(reader.Read<uint32_t>());
+        time = reader.Read<uint64_t>();
+        frameIndex = reader.Read<uint32_t>();
+
+        switch (call)
+        {
+        case CALL_CREATE_POOL:
+        {
+            const uint64_t poolId = reader.Read<uint64_t>();
+            VmaPoolCreateInfo poolCreateInfo = {};
+            poolCreateInfo.memoryTypeIndex = reader.Read<uint32_t>();
+            poolCreateInfo.flags = reader.Read<uint32_t>();
+            poolCreateInfo.blockSize = reader.Read<uint64_t>();
+            poolCreateInfo.minBlockCount = (size_t)reader.Read<uint64_t>();
+            poolCreateInfo.maxBlockCount = (size_t)reader.Read<uint64_t>();
+            poolCreateInfo.priority = reader.Read<float>();
+            poolCreateInfo.minAllocationAlignment = reader.Read<uint64_t>();
+            if (algorithmName != nullptr)
+                poolCreateInfo.flags = (poolCreateInfo.flags & ~VMA_POOL_CREATE_ALGORITHM_MASK) | algorithm;
+            VmaPool pool = VK_NULL_HANDLE;
+            if (vmaCreatePool(allocator, &poolCreateInfo, &pool) == VK_SUCCESS)
+                pools[poolId] = pool;
+            else
+                fprintf(stderr, "Record %zu: cannot create pool.\n", recordIndex);
+            break;
+        }
+        case CALL_DESTROY_POOL:
+        {
+            const auto it = pools.find(reader.Read<uint64_t>());
+            if (it != pools.end())
+            {
+                // Allocations the application didn't free, or that failed only in the recording.
+                for (auto allocIt = allocations.begin(); allocIt != allocations.end(); )
+                {
+                    if (allocIt->second.poolId == it->first)
+                    {
+                        vmaFreeMemory(allocator, allocIt->second.allocation);
+                        allocIt = allocations.erase(allocIt);
+                        ++leakedAllocations;
+                    }
+                    else
+                        ++allocIt;
+                }
+                vmaDestroyPool(allocator, it->second);
+                pools.erase(it);
+            }
+            break;
+        }
+        case CALL_ALLOCATE_MEMORY:
+        {
+            const uint64_t recordedDuration = reader.Read<uint64_t>();
+            const VkResult recordedResult = (VkResult)reader.Read<int32_t>();
+            VkMemoryRequirements memReq = {};
+            memReq.size = reader.Read<uint64_t>();
+            memReq.alignment = reader.Read<uint64_t>();
+            memReq.memoryTypeBits = reader.Read<uint32_t>();
+            const bool requiresDedicated = reader.Read<uint8_t>() != 0;
+            const bool prefersDedicated = reader.Read<uint8_t>() != 0;
+            reader.Read<uint8_t>(); // Dedicated resource kind - there are no resources to pass here.
+            const VkFlags dedicatedBufferImageUsage = reader.Read<uint32_t>();
+            VmaAllocationCreateInfo createInfo = {};
+            createInfo.flags = reader.Read<uint32_t>();
+            createInfo.usage = (VmaMemoryUsage)reader.Read<uint32_t>();
+            createInfo.requiredFlags = reader.Read<uint32_t>();
+            createInfo.preferredFlags = reader.Read<uint32_t>();
+            createInfo.memoryTypeBits = reader.Read<uint32_t>();
+            const uint64_t poolId = reader.Read<uint64_t>();
+            createInfo.priority = reader.Read<float>();
+            const VmaSuballocationType suballocType = (VmaSuballocationType)reader.Read<uint32_t>();
+            const uint32_t allocationCount = reader.Read<uint32_t>();
+            if (!reader.IsValid())
+                break;
+
+            if (poolId != 0)
+            {
+                const auto it = pools.find(poolId);
+                if (it == pools.end())
+                {
+                    ++unknownHandles;
+                    for (uint32_t i = 0; i < allocationCount; ++i)
+                        reader.Read<uint64_t>();
+                    break;
+                }
+                createInfo.pool = it->second;
+            }
+            else if (algorithmName != nullptr && !requiresDedicated &&
+                (createInfo.flags & VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT) == 0)
+            {
+                // Block size is left 0, so these pools pick block sizes and dedicated allocations like default pools.
+                uint32_t memTypeIndex = UINT32_MAX;
+                if (allocator->FindMemoryTypeIndex(memReq.memoryTypeBits, &createInfo, dedicatedBufferImageUsage, &memTypeIndex) == VK_SUCCESS)
+                {
+                    if (algorithmPools[memTypeIndex] == VK_NULL_HANDLE)
+                    {
+                        VmaPoolCreateInfo poolCreateInfo = {};
+                        poolCreateInfo.memoryTypeIndex = memTypeIndex;
+                        poolCreateInfo.flags = algorithm;
+                        if (vmaCreatePool(allocator, &poolCreateInfo, &algorithmPools[memTypeIndex]) != VK_SUCCESS)
+                            fprintf(stderr, "Record %zu: cannot create pool.\n", recordIndex);
+                    }
+                    createInfo.pool = algorithmPools[memTypeIndex];
+                }
+            }
+
+            recordedAllocLatency.Add(recordedDuration);
+            if (recordedResult != VK_SUCCESS)
+                ++recordedFailures;
+
+            allocBuffer.resize(allocationCount);
+            const uint64_t start = Now();
+            const VkResult res = allocator->AllocateMemory(memReq, requiresDedicated, prefersDedicated,
+                VK_NULL_HANDLE, VK_NULL_HANDLE, dedicatedBufferImageUsage, createInfo, suballocType,
+                allocationCount, allocBuffer.data());
+            replayedAllocLatency.Add(Now() - start);
+            if (res != VK_SUCCESS)
+                ++replayedFailures;
+
+            for (uint32_t i = 0; i < allocationCount; ++i)
+            {
+                const uint64_t allocationId = reader.Read<uint64_t>();
+                if (allocBuffer[i] == VK_NULL_HANDLE)
+                    continue;
+                // Failed in the recording, so it is never freed there - release it right away.
+                if (allocationId == 0)
+                    vmaFreeMemory(allocator, allocBuffer[i]);
+                else
+                    allocations[allocationId] = { allocBuffer[i], poolId };
+            }
+            break;
+        }
+        case CALL_FREE_MEMORY:
+        {
+            const uint32_t allocationCount = reader.Read<uint32_t>();
+            allocBuffer.clear();
+            for (uint32_t i = 0; i < allocationCount && reader.IsValid(); ++i)
+            {
+                const uint64_t allocationId = reader.Read<uint64_t>();
+                if (allocationId == 0)
+                    continue;
+                const auto it = allocations.find(allocationId);
+                if (it == allocations.end())
+                {
+                    // Allocation that failed during replay, or unknown.
+                    ++unknownHandles;
+                    continue;
+                }
+                allocBuffer.push_back(it->second.allocation);
+                allocations.erase(it);
+            }
+            if (!allocBuffer.empty())
+            {
+                const uint64_t start = Now();
+                allocator->FreeMemory(allocBuffer.size(), allocBuffer.data());
+                replayedFreeLatency.Add(Now() - start);
+            }
+            break;
+        }
+        case CALL_SET_CURRENT_FRAME_INDEX:
+            vmaSetCurrentFrameIndex(allocator, frameIndex);
+            break;
+        default:
+            // Payload size of an unknown call is unknown, so the rest of the recording cannot be parsed.
+            fprintf(stderr, "Record %zu: unknown call %u at offset %zu.\n", recordIndex, call, reader.GetOffset());
+            unknownCall = true;
+            break;
+        }
+
+        if (unknownCall)
+            break;
+        if (!reader.IsValid())
+        {
+            fprintf(stderr, "Recording is truncated at record %zu.\n", recordIndex);
+            break;
+        }
+        if (++recordIndex % interval == 0)
+            PrintStatistics(allocator, recordIndex, frameIndex, time, peakBlockCount);
+    }
+    PrintStatistics(allocator, recordIndex, frameIndex, time, peakBlockCount);
+
+    printf("\nSummary:\n");
+    printf("  records %zu, threads %zu, last frame %u, recorded time %.1f ms\n",
+        recordIndex, threads.size(), frameIndex, time / 1e6);
+    printf("  failed allocations: recorded %zu, replayed %zu; unmatched handles %zu, leaked allocations %zu\n",
+        recordedFailures, replayedFailures, unknownHandles, leakedAllocations + allocations.size());
+    printf("  peak device memory %.2f MiB in %u VkDeviceMemory objects, peak block count %u (sampled)\n",
+        g_Device.peakUsage / (1024.0 * 1024.0), g_Device.peakMemoryCount, peakBlockCount);
+    printf("\nLatency:\n");
+    recordedAllocLatency.Print("allocate (recorded)");
+    replayedAllocLatency.Print("allocate (replayed)");
+    replayedFreeLatency.Print("free (replayed)");
+
+    // Allocations leaked by the application are released, so the allocator can be destroyed.
+    for (const auto& allocation : allocations)
+        vmaFreeMemory(allocator, allocation.second.allocation);
+    for (const auto& pool : pools)
+        vmaDestroyPool(allocator, pool.second);
+    for (VmaPool pool : algorithmPools)
+    {
+        if (pool != VK_NULL_HANDLE)
+            vmaDestroyPool(allocator, pool);
+    }
+    vmaDestroyAllocator(allocator);
+    return 0;
+}
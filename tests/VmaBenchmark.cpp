@@ -0,0 +1,192 @@
+//
+// Microbenchmarks of vk_mem_alloc.h against the stub device, so they measure the allocator itself,
+// not the driver. Build in release. Numbers are only comparable between runs on the same machine.
+//
+// Modes:
+// - threads: buffers of small sizes created and destroyed by 1 to 64 threads in a default pool,
+//   without and with VMA_ALLOCATOR_CREATE_THREAD_CACHE_BIT. Prints operations per second.
+// - budget: the same from 1 thread with VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT, after warming up
+//   so all allocations fit into existing blocks. Prints operations per second and how many times
+//   the budget was fetched from the device.
+// - batch: groups of 1 to 256 buffers of 4 KiB created and destroyed from 1 thread, one by one with
+//   vmaCreateBuffer()/vmaDestroyBuffer() and together with vmaCreateBuffers()/vmaDestroyBuffers().
+//   Prints buffers created and destroyed per second.
+//
+// Usage: VmaBenchmark <mode> [operationCount]
+//
+
+#define VMA_IMPLEMENTATION
+#define VMA_STATIC_VULKAN_FUNCTIONS 0
+#define VMA_DYNAMIC_VULKAN_FUNCTIONS 0
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+#include <vk_mem_alloc.h>
+#include "VmaTestDevice.h"
+
+namespace
+{
+
+typedef std::chrono::steady_clock Clock;
+
+double GetSeconds(Clock::time_point begin)
+{
+    return std::chrono::duration<double>(Clock::now() - begin).count();
+}
+
+// Each thread keeps up to 64 buffers of 256 B to 16 KiB alive, creating and destroying them at random.
+void CreateDestroyBuffers(VmaAllocator allocator, uint32_t threadIndex, uint32_t operationCount)
+{
+    std::mt19937 random(threadIndex + 1);
+    std::vector<VkBuffer> buffers;
+    std::vector<VmaAllocation> allocations;
+    VkBufferCreateInfo bufCreateInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    bufCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    VmaAllocationCreateInfo allocCreateInfo = {};
+    allocCreateInfo.memoryTypeBits = 0x1;
+    for (uint32_t i = 0; i < operationCount; ++i)
+    {
+        if (buffers.empty() || (buffers.size() < 64 && random() % 2 == 0))
+        {
+            bufCreateInfo.size = 256 << (random() % 7);
+            VkBuffer buffer = VK_NULL_HANDLE;
+            VmaAllocation allocation = VK_NULL_HANDLE;
+            TEST(vmaCreateBuffer(allocator, &bufCreateInfo, &allocCreateInfo, &buffer, &allocation, nullptr) == VK_SUCCESS);
+            buffers.push_back(buffer);
+            allocations.push_back(allocation);
+        }
+        else
+        {
+            const size_t index = random() % buffers.size();
+            vmaDestroyBuffer(allocator, buffers[index], allocations[index]);
+            buffers[index] = buffers.back();
+            buffers.pop_back();
+            allocations[index] = allocations.back();
+            allocations.pop_back();
+        }
+    }
+    for (size_t i = 0; i < buffers.size(); ++i)
+        vmaDestroyBuffer(allocator, buffers[i], allocations[i]);
+}
+
+void BenchmarkThreads(uint32_t operationCount)
+{
+    printf("Threads; Thread cache; Operations/s\n");
+    for (uint32_t threadCount = 1; threadCount <= 64; threadCount *= 2)
+    {
+        for (uint32_t cache = 0; cache < 2; ++cache)
+        {
+            VmaAllocatorCreateInfo allocatorCreateInfo = {};
+            allocatorCreateInfo.flags = cache ? VMA_ALLOCATOR_CREATE_THREAD_CACHE_BIT : 0;
+            VmaAllocator allocator = VmaTest::CreateAllocator(allocatorCreateInfo);
+            const uint32_t operationsPerThread = operationCount / threadCount;
+
+            const Clock::time_point begin = Clock::now();
+            std::vector<std::thread> threads;
+            for (uint32_t i = 0; i < threadCount; ++i)
+                threads.emplace_back(CreateDestroyBuffers, allocator, i, operationsPerThread);
+            for (std::thread& thread : threads)
+                thread.join();
+            const double seconds = GetSeconds(begin);
+
+            vmaDestroyAllocator(allocator);
+            printf("%u; %s; %.0f\n", threadCount, cache ? "on" : "off", operationsPerThread * threadCount / seconds);
+        }
+    }
+}
+
+void BenchmarkBudget(uint32_t operationCount)
+{
+    VmaAllocatorCreateInfo allocatorCreateInfo = {};
+    allocatorCreateInfo.flags = VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+    VmaAllocator allocator = VmaTest::CreateAllocator(allocatorCreateInfo);
+    // Leaves an empty block behind. The buffer kept alive stops the measured run from emptying
+    // the block, so it never creates nor frees blocks.
+    CreateDestroyBuffers(allocator, 0, operationCount);
+    VkBufferCreateInfo bufCreateInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    bufCreateInfo.size = 256;
+    bufCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    VmaAllocationCreateInfo allocCreateInfo = {};
+    allocCreateInfo.memoryTypeBits = 0x1;
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VmaAllocation allocation = VK_NULL_HANDLE;
+    TEST(vmaCreateBuffer(allocator, &bufCreateInfo, &allocCreateInfo, &buffer, &allocation, nullptr) == VK_SUCCESS);
+
+    const uint64_t fetchCountBefore = VmaTest::GetDevice().getMemoryProperties2Count;
+    const Clock::time_point begin = Clock::now();
+    CreateDestroyBuffers(allocator, 0, operationCount);
+    const double seconds = GetSeconds(begin);
+    const uint64_t fetchCount = VmaTest::GetDevice().getMemoryProperties2Count - fetchCountBefore;
+
+    vmaDestroyBuffer(allocator, buffer, allocation);
+    vmaDestroyAllocator(allocator);
+    printf("Operations/s; Budget fetches\n%.0f; %llu\n", operationCount / seconds, (unsigned long long)fetchCount);
+}
+
+void BenchmarkBatch(uint32_t operationCount)
+{
+    VmaAllocatorCreateInfo allocatorCreateInfo = {};
+    VmaAllocator allocator = VmaTest::CreateAllocator(allocatorCreateInfo);
+    VkBufferCreateInfo bufCreateInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    bufCreateInfo.size = 4096;
+    bufCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    VmaAllocationCreateInfo allocCreateInfo = {};
+    allocCreateInfo.memoryTypeBits = 0x1;
+
+    printf("Batch size; Separate buffers/s; Batched buffers/s\n");
+    for (size_t batchSize = 1; batchSize <= 256; batchSize *= 4)
+    {
+        std::vector<VkBuffer> buffers(batchSize);
+        std::vector<VmaAllocation> allocations(batchSize);
+        const uint32_t batchCount = operationCount / (uint32_t)batchSize;
+        double buffersPerSecond[2];
+        for (uint32_t batched = 0; batched < 2; ++batched)
+        {
+            const Clock::time_point begin = Clock::now();
+            for (uint32_t i = 0; i < batchCount; ++i)
+            {
+                if (batched)
+                {
+                    TEST(vmaCreateBuffers(allocator, &bufCreateInfo, &allocCreateInfo, batchSize,
+                        buffers.data(), allocations.data(), nullptr) == VK_SUCCESS);
+                    vmaDestroyBuffers(allocator, batchSize, buffers.data(), allocations.data());
+                }
+                else
+                {
+                    for (size_t j = 0; j < batchSize; ++j)
+                        TEST(vmaCreateBuffer(allocator, &bufCreateInfo, &allocCreateInfo, &buffers[j], &allocations[j], nullptr) == VK_SUCCESS);
+                    for (size_t j = 0; j < batchSize; ++j)
+                        vmaDestroyBuffer(allocator, buffers[j], allocations[j]);
+                }
+            }
+            buffersPerSecond[batched] = batchCount * batchSize / GetSeconds(begin);
+        }
+        printf("%zu; %.0f; %.0f\n", batchSize, buffersPerSecond[0], buffersPerSecond[1]);
+    }
+    vmaDestroyAllocator(allocator);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const char* const mode = argc > 1 ? argv[1] : "";
+    const uint32_t operationCount = argc > 2 ? (uint32_t)strtoul(argv[2], nullptr, 10) : 1000000;
+    if (strcmp(mode, "threads") == 0)
+        BenchmarkThreads(operationCount);
+    else if (strcmp(mode, "budget") == 0)
+        BenchmarkBudget(operationCount);
+    else if (strcmp(mode, "batch") == 0)
+        BenchmarkBatch(operationCount);
+    else
+    {
+        fprintf(stderr, "Usage: VmaBenchmark threads|budget|batch [operationCount]\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,146 @@
+//
+// Stress test of per-block locking in VmaBlockVector, meant to be run also under ThreadSanitizer
+// (configure with -DVMA_TESTS_THREAD_SANITIZER=ON).
+//
+// Worker threads allocate and free memory of 4 KiB to 256 KiB in a custom pool of 1 MiB blocks,
+// so allocations run in parallel on different blocks, blocks fill up, new ones are created and
+// empty ones are released. Every allocation is filled with a tag of its owner through
+// vmaMapMemory() and checked before it is freed, so overlapping suballocations are detected.
+// Another thread keeps reading pool statistics and validating the pool meanwhile.
+// At the end the pool may hold no allocation and at most one empty block.
+//
+// Usage: VmaBlockLockStressTest [threadCount] [iterationCount]
+//
+
+#define VMA_IMPLEMENTATION
+#define VMA_STATIC_VULKAN_FUNCTIONS 0
+#define VMA_DYNAMIC_VULKAN_FUNCTIONS 0
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+#include <vk_mem_alloc.h>
+#include "VmaTestDevice.h"
+
+namespace
+{
+
+struct Allocation
+{
+    VmaAllocation allocation;
+    uint32_t tag;
+};
+
+void Fill(VmaAllocator allocator, const Allocation& allocation)
+{
+    uint32_t* pData = nullptr;
+    TEST(vmaMapMemory(allocator, allocation.allocation, (void**)&pData) == VK_SUCCESS);
+    VmaAllocationInfo info;
+    vmaGetAllocationInfo(allocator, allocation.allocation, &info);
+    for (size_t i = 0; i < info.size / sizeof(uint32_t); ++i)
+        pData[i] = allocation.tag;
+    vmaUnmapMemory(allocator, allocation.allocation);
+}
+
+void CheckAndFree(VmaAllocator allocator, const Allocation& allocation)
+{
+    uint32_t* pData = nullptr;
+    TEST(vmaMapMemory(allocator, allocation.allocation, (void**)&pData) == VK_SUCCESS);
+    VmaAllocationInfo info;
+    vmaGetAllocationInfo(allocator, allocation.allocation, &info);
+    for (size_t i = 0; i < info.size / sizeof(uint32_t); ++i)
+        TEST(pData[i] == allocation.tag);
+    vmaUnmapMemory(allocator, allocation.allocation);
+    vmaFreeMemory(allocator, allocation.allocation);
+}
+
+void Work(VmaAllocator allocator, VmaPool pool, uint32_t threadIndex, uint32_t iterationCount)
+{
+    std::mt19937 random(threadIndex + 1);
+    std::vector<Allocation> allocations;
+    for (uint32_t i = 0; i < iterationCount; ++i)
+    {
+        // Phases of growth and shrinking, so blocks get both created and released.
+        const size_t maxCount = (i / 512) % 2 == 0 ? 48 : 4;
+        if (allocations.size() < maxCount && random() % 3 != 0)
+        {
+            VkMemoryRequirements memReq = {};
+            memReq.size = (4 * 1024) << (random() % 7);
+            memReq.alignment = 256;
+            memReq.memoryTypeBits = 0x2;
+            VmaAllocationCreateInfo allocCreateInfo = {};
+            allocCreateInfo.pool = pool;
+            Allocation allocation = {};
+            allocation.tag = (threadIndex << 24) | i;
+            TEST(vmaAllocateMemory(allocator, &memReq, &allocCreateInfo, &allocation.allocation, nullptr) == VK_SUCCESS);
+            Fill(allocator, allocation);
+            allocations.push_back(allocation);
+        }
+        else if (!allocations.empty())
+        {
+            const size_t index = random() % allocations.size();
+            CheckAndFree(allocator, allocations[index]);
+            allocations[index] = allocations.back();
+            allocations.pop_back();
+        }
+    }
+    for (const Allocation& allocation : allocations)
+        CheckAndFree(allocator, allocation);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const uint32_t threadCount = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : 8;
+    const uint32_t iterationCount = argc > 2 ? (uint32_t)strtoul(argv[2], nullptr, 10) : 10000;
+
+    VmaAllocatorCreateInfo allocatorCreateInfo = {};
+    VmaAllocator allocator = VmaTest::CreateAllocator(allocatorCreateInfo);
+    VmaPoolCreateInfo poolCreateInfo = {};
+    poolCreateInfo.memoryTypeIndex = 1;
+    poolCreateInfo.blockSize = 1ull << 20;
+    VmaPool pool = VK_NULL_HANDLE;
+    TEST(vmaCreatePool(allocator, &poolCreateInfo, &pool) == VK_SUCCESS);
+
+    std::atomic<bool> done{ false };
+    std::thread monitor([&]()
+    {
+        while (!done)
+        {
+            VmaStatistics stats;
+            vmaGetPoolStatistics(allocator, pool, &stats);
+            TEST(stats.allocationBytes <= stats.blockBytes);
+            VmaDetailedStatistics detailedStats;
+            vmaCalculatePoolStatistics(allocator, pool, &detailedStats);
+            TEST(detailedStats.statistics.allocationBytes <= detailedStats.statistics.blockBytes);
+            const VkResult res = vmaCheckPoolCorruption(allocator, pool);
+            TEST(res == VK_SUCCESS || res == VK_ERROR_FEATURE_NOT_PRESENT);
+            std::this_thread::yield();
+        }
+    });
+
+    std::vector<std::thread> workers;
+    for (uint32_t i = 0; i < threadCount; ++i)
+        workers.emplace_back(Work, allocator, pool, i, iterationCount);
+    for (std::thread& worker : workers)
+        worker.join();
+    done = true;
+    monitor.join();
+
+    VmaDetailedStatistics stats;
+    vmaCalculatePoolStatistics(allocator, pool, &stats);
+    TEST(stats.statistics.allocationCount == 0);
+    TEST(stats.statistics.blockCount <= 1);
+    // Blocks were released while the workers were running, not only by vmaDestroyPool().
+    TEST(VmaTest::GetDevice().freeMemoryCount > 0);
+    vmaDestroyPool(allocator, pool);
+    vmaDestroyAllocator(allocator);
+    TEST(VmaTest::GetDevice().heapUsage[0] == 0 && VmaTest::GetDevice().heapUsage[1] == 0);
+
+    printf("Block lock stress test passed with %u threads, %u iterations.\n", threadCount, iterationCount);
+    return 0;
+}
@@ -0,0 +1,277 @@
+//
+// Tests of VmaDefragmentationExecutor against the stub device, whose queue performs
+// the recorded copies when the test calls ExecuteQueue(), once per frame.
+//
+// Checks that data of moved allocations survives, that a time budget only splits passes
+// across steps without changing what gets moved, that old places are freed no sooner than
+// frameInUseCount frames after the allocations were reported as moved, that destroying
+// the executor in the middle of a pass leaves no memory behind, and that missing Vulkan
+// functions are reported by vmaCreateDefragmentationExecutor().
+//
+
+#define VMA_IMPLEMENTATION
+#define VMA_STATIC_VULKAN_FUNCTIONS 0
+#define VMA_DYNAMIC_VULKAN_FUNCTIONS 0
+
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <vk_mem_alloc.h>
+#include "VmaTestDevice.h"
+
+namespace
+{
+
+const VkQueue g_Queue = (VkQueue)(uintptr_t)64;
+
+struct Context
+{
+    VmaAllocator allocator;
+    VmaPool pool;
+    std::vector<VmaAllocation> allocations;
+    // Moves reported by pfnAllocationMoved in the current step.
+    uint32_t movedInStep;
+};
+
+uint32_t GetPattern(size_t allocationIndex, size_t wordIndex)
+{
+    return (uint32_t)(allocationIndex * 2654435761u + wordIndex * 40503u);
+}
+
+void Fill(const Context& context)
+{
+    for (size_t i = 0; i < context.allocations.size(); ++i)
+    {
+        VmaAllocationInfo info;
+        vmaGetAllocationInfo(context.allocator, context.allocations[i], &info);
+        uint32_t* const pData = (uint32_t*)info.pMappedData;
+        for (size_t j = 0; j < info.size / sizeof(uint32_t); ++j)
+            pData[j] = GetPattern(i, j);
+    }
+}
+
+void Verify(const Context& context)
+{
+    for (size_t i = 0; i < context.allocations.size(); ++i)
+    {
+        VmaAllocationInfo info;
+        vmaGetAllocationInfo(context.allocator, context.allocations[i], &info);
+        const uint32_t* const pData = (const uint32_t*)info.pMappedData;
+        for (size_t j = 0; j < info.size / sizeof(uint32_t); ++j)
+            TEST(pData[j] == GetPattern(i, j));
+    }
+}
+
+uint32_t GetPoolAllocationCount(const Context& context)
+{
+    VmaDetailedStatistics stats;
+    vmaCalculatePoolStatistics(context.allocator, context.pool, &stats);
+    return stats.statistics.allocationCount;
+}
+
+// Fills blocks of 1 MiB with mapped allocations and frees every other one.
+void Init(Context& context, uint32_t seed, const VmaVulkanFunctions* pVulkanFunctions = nullptr)
+{
+    VmaAllocatorCreateInfo allocatorCreateInfo = {};
+    allocatorCreateInfo.pVulkanFunctions = pVulkanFunctions;
+    context.allocator = VmaTest::CreateAllocator(allocatorCreateInfo);
+    context.movedInStep = 0;
+
+    VmaPoolCreateInfo poolCreateInfo = {};
+    poolCreateInfo.memoryTypeIndex = 1;
+    poolCreateInfo.blockSize = 1ull << 20;
+    TEST(vmaCreatePool(context.allocator, &poolCreateInfo, &context.pool) == VK_SUCCESS);
+
+    std::mt19937 random(seed);
+    std::vector<VmaAllocation> allocations;
+    for (uint32_t i = 0; i < 200; ++i)
+    {
+        VkMemoryRequirements memReq = {};
+        memReq.size = (8 + random() % 56) * 1024;
+        memReq.alignment = 256;
+        memReq.memoryTypeBits = 0x2;
+        VmaAllocationCreateInfo allocCreateInfo = {};
+        allocCreateInfo.pool = context.pool;
+        allocCreateInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+        VmaAllocation allocation = VK_NULL_HANDLE;
+        TEST(vmaAllocateMemory(context.allocator, &memReq, &allocCreateInfo, &allocation, nullptr) == VK_SUCCESS);
+        allocations.push_back(allocation);
+    }
+    for (size_t i = 0; i < allocations.size(); ++i)
+    {
+        if (i % 2 == 0)
+            vmaFreeMemory(context.allocator, allocations[i]);
+        else
+            context.allocations.push_back(allocations[i]);
+    }
+    Fill(context);
+}
+
+void Destroy(Context& context)
+{
+    for (VmaAllocation allocation : context.allocations)
+        vmaFreeMemory(context.allocator, allocation);
+    vmaDestroyPool(context.allocator, context.pool);
+    vmaDestroyAllocator(context.allocator);
+}
+
+void VKAPI_PTR AllocationMoved(VmaAllocator, VmaAllocation, void* pUserData)
+{
+    ++((Context*)pUserData)->movedInStep;
+}
+
+VmaDefragmentationExecutor CreateExecutor(Context& context, uint64_t maxStepDuration, uint32_t frameInUseCount)
+{
+    VmaDefragmentationExecutorCreateInfo executorInfo = {};
+    executorInfo.defragmentationInfo.pool = context.pool;
+    executorInfo.defragmentationInfo.maxAllocationsPerPass = 16;
+    executorInfo.transferQueue = g_Queue;
+    executorInfo.maxStepDuration = maxStepDuration;
+    executorInfo.frameInUseCount = frameInUseCount;
+    executorInfo.pfnAllocationMoved = AllocationMoved;
+    executorInfo.pUserData = &context;
+    VmaDefragmentationExecutor executor = VK_NULL_HANDLE;
+    TEST(vmaCreateDefragmentationExecutor(context.allocator, &executorInfo, &executor) == VK_SUCCESS);
+    return executor;
+}
+
+// Steps once per frame until finished, the queue finishing the copies at the end of each frame.
+VmaDefragmentationStats Run(Context& context, uint64_t maxStepDuration, uint32_t& outStepCount)
+{
+    VmaDefragmentationExecutor executor = CreateExecutor(context, maxStepDuration, 0);
+    outStepCount = 0;
+    VkResult res;
+    do
+    {
+        vmaSetCurrentFrameIndex(context.allocator, outStepCount);
+        res = vmaStepDefragmentationExecutor(context.allocator, executor);
+        TEST(res == VK_SUCCESS || res == VK_INCOMPLETE);
+        VmaTest::ExecuteQueue();
+        TEST(++outStepCount < 100000);
+    } while (res != VK_SUCCESS);
+
+    VmaDefragmentationStats stats;
+    vmaDestroyDefragmentationExecutor(context.allocator, executor, &stats);
+    return stats;
+}
+
+void TestTimeBudget()
+{
+    // The budget of 1 ns lets every step submit a single copy. Moves left over must be copied
+    // by following steps, not abandoned, so the result must match the run without a budget.
+    Context unlimited, limited;
+    Init(unlimited, 1);
+    Init(limited, 1);
+    uint32_t unlimitedStepCount, limitedStepCount;
+    const VmaDefragmentationStats unlimitedStats = Run(unlimited, 0, unlimitedStepCount);
+    const VmaDefragmentationStats limitedStats = Run(limited, 1, limitedStepCount);
+
+    TEST(unlimitedStats.allocationsMoved > 16);
+    TEST(limitedStats.allocationsMoved == unlimitedStats.allocationsMoved);
+    TEST(limitedStats.bytesMoved == unlimitedStats.bytesMoved);
+    TEST(limitedStats.deviceMemoryBlocksFreed == unlimitedStats.deviceMemoryBlocksFreed);
+    TEST(limitedStats.deviceMemoryBlocksFreed > 0);
+    TEST(limitedStepCount > unlimitedStepCount);
+    Verify(unlimited);
+    Verify(limited);
+    TEST(GetPoolAllocationCount(limited) == limited.allocations.size());
+
+    Destroy(limited);
+    Destroy(unlimited);
+}
+
+void TestFrameInUseCount()
+{
+    const uint32_t frameInUseCount = 2;
+    Context context;
+    Init(context, 2);
+    const uint32_t liveCount = (uint32_t)context.allocations.size();
+    VmaDefragmentationExecutor executor = CreateExecutor(context, 0, frameInUseCount);
+
+    // Moves reported and pool allocation count after the step, per frame.
+    std::vector<uint32_t> movedCounts, allocationCounts;
+    VkResult res;
+    do
+    {
+        const uint32_t frameIndex = (uint32_t)movedCounts.size();
+        vmaSetCurrentFrameIndex(context.allocator, frameIndex);
+        context.movedInStep = 0;
+        res = vmaStepDefragmentationExecutor(context.allocator, executor);
+        TEST(res == VK_SUCCESS || res == VK_INCOMPLETE);
+        movedCounts.push_back(context.movedInStep);
+        allocationCounts.push_back(GetPoolAllocationCount(context));
+        VmaTest::ExecuteQueue();
+        TEST(frameIndex < 10000);
+    } while (res != VK_SUCCESS);
+    movedCounts.push_back(0);
+
+    // Pool holds live allocations, old places of moves reported in this and previous
+    // frameInUseCount - 1 frames, and places reserved for the pass reported in the next frame.
+    uint32_t totalMoved = 0;
+    for (size_t frame = 0; frame + 1 < movedCounts.size(); ++frame)
+    {
+        uint32_t oldPlaceCount = 0;
+        for (size_t i = 0; i < frameInUseCount && i <= frame; ++i)
+            oldPlaceCount += movedCounts[frame - i];
+        TEST(allocationCounts[frame] == liveCount + oldPlaceCount + movedCounts[frame + 1]);
+        totalMoved += movedCounts[frame];
+    }
+    TEST(totalMoved > 16);
+    TEST(allocationCounts.back() == liveCount);
+
+    VmaDefragmentationStats stats;
+    vmaDestroyDefragmentationExecutor(context.allocator, executor, &stats);
+    TEST(stats.allocationsMoved == totalMoved);
+    TEST(stats.deviceMemoryBlocksFreed > 0);
+    Verify(context);
+    Destroy(context);
+}
+
+void TestDestroyDuringPass()
+{
+    Context context;
+    Init(context, 3);
+    VmaDefragmentationExecutor executor = CreateExecutor(context, 1, 4);
+    // A pass of 16 moves submitted one copy per step has copies in flight and moves not copied yet.
+    for (uint32_t frameIndex = 0; frameIndex < 24; ++frameIndex)
+    {
+        vmaSetCurrentFrameIndex(context.allocator, frameIndex);
+        const VkResult res = vmaStepDefragmentationExecutor(context.allocator, executor);
+        TEST(res == VK_INCOMPLETE || res == VK_NOT_READY);
+        if (frameIndex % 3 != 2)
+            VmaTest::ExecuteQueue();
+    }
+    VmaDefragmentationStats stats;
+    vmaDestroyDefragmentationExecutor(context.allocator, executor, &stats);
+    TEST(stats.allocationsMoved > 0);
+    TEST(GetPoolAllocationCount(context) == context.allocations.size());
+    Verify(context);
+    Destroy(context);
+}
+
+void TestMissingFunctions()
+{
+    VmaVulkanFunctions functions = VmaTest::GetVulkanFunctions();
+    functions.vkWaitSemaphores = nullptr;
+    Context context;
+    Init(context, 4, &functions);
+    VmaDefragmentationExecutorCreateInfo executorInfo = {};
+    executorInfo.defragmentationInfo.pool = context.pool;
+    executorInfo.transferQueue = g_Queue;
+    VmaDefragmentationExecutor executor = VK_NULL_HANDLE;
+    TEST(vmaCreateDefragmentationExecutor(context.allocator, &executorInfo, &executor) == VK_ERROR_FEATURE_NOT_PRESENT);
+    TEST(executor == VK_NULL_HANDLE);
+    Destroy(context);
+}
+
+} // namespace
+
+int main()
+{
+    TestTimeBudget();
+    TestFrameInUseCount();
+    TestDestroyDuringPass();
+    TestMissingFunctions();
+    printf("Defragmentation executor tests passed.\n");
+    return 0;
+}
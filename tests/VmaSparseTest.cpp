@@ -0,0 +1,248 @@
+//
+// Tests of sparse resources against the stub device, which records the binds it receives.
+//
+// Checks that pages are bound with merged VkSparseMemoryBind, tiles of images with
+// VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT with VkSparseImageMemoryBind cut at the edges of mip levels,
+// and that memory of decommitted pages is freed only after their unbinding has been executed:
+// by vmaFreeUnboundSparsePages() or by deferred freeing.
+//
+
+#define VMA_IMPLEMENTATION
+#define VMA_STATIC_VULKAN_FUNCTIONS 0
+#define VMA_DYNAMIC_VULKAN_FUNCTIONS 0
+
+#include <cstdio>
+#include <vk_mem_alloc.h>
+#include "VmaTestDevice.h"
+
+namespace
+{
+
+const VkQueue g_Queue = (VkQueue)(uintptr_t)64;
+
+uint32_t GetAllocationCount(VmaAllocator allocator)
+{
+    VmaTotalStatistics stats;
+    vmaCalculateStatistics(allocator, &stats);
+    return stats.total.statistics.allocationCount;
+}
+
+VmaSparseResourceInfo GetInfo(VmaAllocator allocator, VmaSparseResource resource)
+{
+    VmaSparseResourceInfo info = {};
+    vmaGetSparseResourceInfo(allocator, resource, &info);
+    return info;
+}
+
+void ClearRecordedBinds()
+{
+    VmaTest::Device& device = VmaTest::GetDevice();
+    device.sparseMemoryBinds.clear();
+    device.sparseImageBinds.clear();
+}
+
+// Returns the number of bytes covered by recorded VkSparseMemoryBind, with or without memory.
+VkDeviceSize GetBoundBytes(bool withMemory)
+{
+    VkDeviceSize bytes = 0;
+    for (const VkSparseMemoryBind& bind : VmaTest::GetDevice().sparseMemoryBinds)
+    {
+        if ((bind.memory != VK_NULL_HANDLE) == withMemory)
+            bytes += bind.size;
+    }
+    return bytes;
+}
+
+VmaSparseResource CreateSparseBuffer(VmaAllocator allocator, VkDeviceSize pageCount, VkBuffer& outBuffer)
+{
+    VkBufferCreateInfo bufCreateInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    bufCreateInfo.flags = VK_BUFFER_CREATE_SPARSE_BINDING_BIT;
+    bufCreateInfo.size = pageCount * VmaTest::SPARSE_PAGE_SIZE;
+    VmaAllocationCreateInfo allocCreateInfo = {};
+    allocCreateInfo.memoryTypeBits = 0x1;
+    VmaSparseResource resource = VK_NULL_HANDLE;
+    TEST(vmaCreateSparseBuffer(allocator, &bufCreateInfo, &allocCreateInfo, &outBuffer, &resource) == VK_SUCCESS);
+    return resource;
+}
+
+void TestBufferPages()
+{
+    VmaAllocatorCreateInfo allocatorCreateInfo = {};
+    VmaAllocator allocator = VmaTest::CreateAllocator(allocatorCreateInfo);
+    VmaTest::Device& device = VmaTest::GetDevice();
+    const VkDeviceSize pageSize = VmaTest::SPARSE_PAGE_SIZE;
+
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VmaSparseResource resource = CreateSparseBuffer(allocator, 64, buffer);
+    TEST(GetInfo(allocator, resource).pageCount == 64);
+
+    TEST(vmaCommitSparsePages(allocator, resource, 0, 16) == VK_SUCCESS);
+    TEST(GetInfo(allocator, resource).committedPageCount == 16);
+    TEST(GetAllocationCount(allocator) == 16);
+
+    ClearRecordedBinds();
+    TEST(vmaBindSparsePages(allocator, g_Queue, 1, &resource, nullptr) == VK_SUCCESS);
+    TEST(GetBoundBytes(true) == 16 * pageSize && GetBoundBytes(false) == 0);
+    // Pages allocated together lie next to each other in one block.
+    TEST(device.sparseMemoryBinds.size() < 16);
+    TEST(GetInfo(allocator, resource).pendingPageCount == 0);
+
+    // Unbinding is submitted, but the pages stay allocated until the app says the GPU executed it.
+    vmaDecommitSparsePages(allocator, resource, 4, 8);
+    TEST(GetInfo(allocator, resource).committedPageCount == 8);
+    ClearRecordedBinds();
+    TEST(vmaBindSparsePages(allocator, g_Queue, 1, &resource, nullptr) == VK_SUCCESS);
+    TEST(GetBoundBytes(false) == 8 * pageSize && GetBoundBytes(true) == 0);
+    TEST(GetInfo(allocator, resource).unboundPageCount == 8);
+    TEST(GetAllocationCount(allocator) == 16);
+    vmaFreeUnboundSparsePages(allocator, 1, &resource);
+    TEST(GetInfo(allocator, resource).unboundPageCount == 0);
+    TEST(GetAllocationCount(allocator) == 8);
+
+    // Failed bind keeps the changes pending and the memory allocated.
+    vmaDecommitSparsePages(allocator, resource, 0, 4);
+    device.config.queueBindSparseResult = VK_ERROR_DEVICE_LOST;
+    TEST(vmaBindSparsePages(allocator, g_Queue, 1, &resource, nullptr) == VK_ERROR_DEVICE_LOST);
+    device.config.queueBindSparseResult = VK_SUCCESS;
+    TEST(GetInfo(allocator, resource).pendingPageCount == 4);
+    TEST(GetInfo(allocator, resource).unboundPageCount == 0);
+    TEST(GetAllocationCount(allocator) == 8);
+    TEST(vmaBindSparsePages(allocator, g_Queue, 1, &resource, nullptr) == VK_SUCCESS);
+    TEST(GetInfo(allocator, resource).unboundPageCount == 4);
+
+    // Destruction frees unbound pages too.
+    vmaDestroySparseResource(allocator, resource);
+    TEST(GetAllocationCount(allocator) == 0);
+    vmaDestroyAllocator(allocator);
+}
+
+void TestDeferredFree()
+{
+    VmaAllocatorCreateInfo allocatorCreateInfo = {};
+    allocatorCreateInfo.deferredFreeFrameCount = 2;
+    VmaAllocator allocator = VmaTest::CreateAllocator(allocatorCreateInfo);
+    vmaSetCurrentFrameIndex(allocator, 0);
+
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VmaSparseResource resource = CreateSparseBuffer(allocator, 16, buffer);
+    TEST(vmaCommitSparsePages(allocator, resource, 0, 8) == VK_SUCCESS);
+    TEST(vmaBindSparsePages(allocator, g_Queue, 1, &resource, nullptr) == VK_SUCCESS);
+    vmaDecommitSparsePages(allocator, resource, 0, 8);
+    TEST(vmaBindSparsePages(allocator, g_Queue, 1, &resource, nullptr) == VK_SUCCESS);
+
+    // Queued for deferred freeing instead of waiting for vmaFreeUnboundSparsePages().
+    TEST(GetInfo(allocator, resource).unboundPageCount == 0);
+    TEST(GetAllocationCount(allocator) == 8);
+    vmaSetCurrentFrameIndex(allocator, 1);
+    TEST(GetAllocationCount(allocator) == 8);
+    vmaSetCurrentFrameIndex(allocator, 2);
+    TEST(GetAllocationCount(allocator) == 0);
+
+    vmaDestroySparseResource(allocator, resource);
+    vmaDestroyAllocator(allocator);
+}
+
+const VkSparseImageMemoryBind* FindImageBind(uint32_t mipLevel, int32_t x, int32_t y)
+{
+    for (const VkSparseImageMemoryBind& bind : VmaTest::GetDevice().sparseImageBinds)
+    {
+        if (bind.subresource.mipLevel == mipLevel && bind.offset.x == x && bind.offset.y == y)
+            return &bind;
+    }
+    return nullptr;
+}
+
+void TestImageTiles()
+{
+    VmaAllocatorCreateInfo allocatorCreateInfo = {};
+    VmaAllocator allocator = VmaTest::CreateAllocator(allocatorCreateInfo);
+    VmaTest::Device& device = VmaTest::GetDevice();
+
+    // Mip levels 1000, 500, 250 have tiles of 128x128, the mip tail starts at level 3 of 125x125.
+    VkImageCreateInfo imageCreateInfo = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+    imageCreateInfo.flags = VK_IMAGE_CREATE_SPARSE_BINDING_BIT | VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT;
+    imageCreateInfo.extent = { 1000, 1000, 1 };
+    imageCreateInfo.mipLevels = 5;
+    imageCreateInfo.arrayLayers = 1;
+    imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    VmaAllocationCreateInfo allocCreateInfo = {};
+    VkImage image = VK_NULL_HANDLE;
+    VmaSparseResource resource = VK_NULL_HANDLE;
+    TEST(vmaCreateSparseImage(allocator, &imageCreateInfo, &allocCreateInfo, &image, &resource) == VK_SUCCESS);
+
+    VmaSparseImageRegion region = {};
+    region.subresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.offset = { 128, 256, 0 };
+    region.extent = { 256, 128, 1 };
+    TEST(vmaCommitSparseImageRegion(allocator, resource, &region) == VK_SUCCESS);
+    // Tile at the corner of mip level 0 is cut to 104x104.
+    region.offset = { 896, 896, 0 };
+    region.extent = { 104, 104, 1 };
+    TEST(vmaCommitSparseImageRegion(allocator, resource, &region) == VK_SUCCESS);
+    // Whole mip level 2 of 250x250 is 2x2 tiles.
+    region.subresource.mipLevel = 2;
+    region.offset = { 0, 0, 0 };
+    region.extent = { 250, 250, 1 };
+    TEST(vmaCommitSparseImageRegion(allocator, resource, &region) == VK_SUCCESS);
+    TEST(vmaCommitSparseImageRegion(allocator, resource, &region) == VK_SUCCESS);
+    TEST(GetInfo(allocator, resource).committedTileCount == 7);
+    TEST(GetInfo(allocator, resource).pendingPageCount == 7);
+    TEST(GetAllocationCount(allocator) == 7);
+
+    // Mip tail is backed by an opaque page, bound by the same vkQueueBindSparse.
+    VmaSparseResourceInfo info = GetInfo(allocator, resource);
+    const VkDeviceSize mipTailPage = (info.pageCount * info.pageSize - VmaTest::SPARSE_PAGE_SIZE) / info.pageSize;
+    TEST(vmaCommitSparsePages(allocator, resource, mipTailPage, 1) == VK_SUCCESS);
+
+    ClearRecordedBinds();
+    const uint32_t bindCallCount = device.queueBindSparseCount;
+    TEST(vmaBindSparsePages(allocator, g_Queue, 1, &resource, nullptr) == VK_SUCCESS);
+    TEST(device.queueBindSparseCount == bindCallCount + 1);
+    TEST(device.sparseMemoryBinds.size() == 1 && device.sparseMemoryBinds[0].memory != VK_NULL_HANDLE);
+    TEST(device.sparseImageBinds.size() == 7);
+    for (const VkSparseImageMemoryBind& bind : device.sparseImageBinds)
+    {
+        TEST(bind.memory != VK_NULL_HANDLE && bind.memoryOffset % VmaTest::SPARSE_PAGE_SIZE == 0);
+        TEST(bind.subresource.aspectMask == VK_IMAGE_ASPECT_COLOR_BIT && bind.subresource.arrayLayer == 0);
+        TEST(bind.extent.depth == 1);
+    }
+    const VkSparseImageMemoryBind* bind = FindImageBind(0, 128, 256);
+    TEST(bind != nullptr && bind->extent.width == 128 && bind->extent.height == 128);
+    TEST(FindImageBind(0, 256, 256) != nullptr);
+    bind = FindImageBind(0, 896, 896);
+    TEST(bind != nullptr && bind->extent.width == 104 && bind->extent.height == 104);
+    bind = FindImageBind(2, 128, 0);
+    TEST(bind != nullptr && bind->extent.width == 122 && bind->extent.height == 128);
+    bind = FindImageBind(2, 128, 128);
+    TEST(bind != nullptr && bind->extent.width == 122 && bind->extent.height == 122);
+
+    // Decommitting whole mip level 0 unbinds its 3 tiles.
+    region.subresource.mipLevel = 0;
+    region.extent = { 1000, 1000, 1 };
+    vmaDecommitSparseImageRegion(allocator, resource, &region);
+    TEST(GetInfo(allocator, resource).committedTileCount == 4);
+    ClearRecordedBinds();
+    TEST(vmaBindSparsePages(allocator, g_Queue, 1, &resource, nullptr) == VK_SUCCESS);
+    TEST(device.sparseMemoryBinds.empty() && device.sparseImageBinds.size() == 3);
+    for (const VkSparseImageMemoryBind& unbind : device.sparseImageBinds)
+        TEST(unbind.memory == VK_NULL_HANDLE && unbind.subresource.mipLevel == 0);
+    TEST(GetInfo(allocator, resource).unboundPageCount == 3);
+    TEST(GetAllocationCount(allocator) == 8);
+    vmaFreeUnboundSparsePages(allocator, 1, &resource);
+    TEST(GetAllocationCount(allocator) == 5);
+
+    vmaDestroySparseResource(allocator, resource);
+    TEST(GetAllocationCount(allocator) == 0);
+    vmaDestroyAllocator(allocator);
+}
+
+} // namespace
+
+int main()
+{
+    TestBufferPages();
+    TestDeferredFree();
+    TestImageTiles();
+    printf("Sparse resource tests passed.\n");
+    return 0;
+}
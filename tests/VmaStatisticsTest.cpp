@@ -0,0 +1,189 @@
+//
+// Compares statistics of VMA_ALLOCATOR_CREATE_INCREMENTAL_STATISTICS_BIT with the exact walk of all blocks.
+//
+// Two allocators replay the same random sequence of allocations and frees, in default pools,
+// a custom TLSF pool and a custom buddy pool. Placement is deterministic, so both contain
+// the same suballocations. Counts and bytes must match exactly. In custom pools, minimum
+// and maximum sizes must match after rounding the exact ones down to 4 significant bits.
+// Memory types and heaps also contain dedicated allocations, which are counted exactly,
+// so there they must lie between the rounded and the exact value.
+//
+// Usage: VmaStatisticsTest [seed]
+//
+
+#define VMA_IMPLEMENTATION
+#define VMA_STATIC_VULKAN_FUNCTIONS 0
+#define VMA_DYNAMIC_VULKAN_FUNCTIONS 0
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include <vk_mem_alloc.h>
+#include "VmaTestDevice.h"
+
+namespace
+{
+
+// Lower bound of the size class of VmaStatisticsCounters that given size falls into.
+VkDeviceSize RoundToClass(VkDeviceSize size)
+{
+    if (size < 16)
+        return size;
+    uint32_t msb = 63;
+    while ((size >> msb) == 0)
+        --msb;
+    const uint32_t shift = msb - 3;
+    return (size >> shift) << shift;
+}
+
+bool IsRounded(VkDeviceSize incremental, VkDeviceSize exact, bool onlyRounded)
+{
+    if (onlyRounded)
+        return incremental == RoundToClass(exact);
+    return incremental >= RoundToClass(exact) && incremental <= exact;
+}
+
+void CompareDetailed(const VmaDetailedStatistics& exact, const VmaDetailedStatistics& incremental, bool onlyRounded)
+{
+    TEST(incremental.statistics.blockCount == exact.statistics.blockCount);
+    TEST(incremental.statistics.allocationCount == exact.statistics.allocationCount);
+    TEST(incremental.statistics.blockBytes == exact.statistics.blockBytes);
+    TEST(incremental.statistics.allocationBytes == exact.statistics.allocationBytes);
+    TEST(incremental.unusedRangeCount == exact.unusedRangeCount);
+    if (exact.statistics.allocationCount > 0)
+    {
+        TEST(IsRounded(incremental.allocationSizeMin, exact.allocationSizeMin, onlyRounded));
+        TEST(IsRounded(incremental.allocationSizeMax, exact.allocationSizeMax, onlyRounded));
+    }
+    if (exact.unusedRangeCount > 0)
+    {
+        TEST(IsRounded(incremental.unusedRangeSizeMin, exact.unusedRangeSizeMin, onlyRounded));
+        TEST(IsRounded(incremental.unusedRangeSizeMax, exact.unusedRangeSizeMax, onlyRounded));
+    }
+}
+
+struct Context
+{
+    VmaAllocator allocator;
+    VmaPool pools[2];
+    std::vector<VmaAllocation> allocations;
+};
+
+void Compare(const Context& exactContext, const Context& incrementalContext)
+{
+    VmaTotalStatistics exact, incremental;
+    vmaCalculateStatistics(exactContext.allocator, &exact);
+    vmaCalculateStatistics(incrementalContext.allocator, &incremental);
+    for (uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; ++i)
+        CompareDetailed(exact.memoryType[i], incremental.memoryType[i], false);
+    for (uint32_t i = 0; i < VK_MAX_MEMORY_HEAPS; ++i)
+        CompareDetailed(exact.memoryHeap[i], incremental.memoryHeap[i], false);
+    CompareDetailed(exact.total, incremental.total, false);
+
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        VmaDetailedStatistics exactPool, incrementalPool;
+        vmaCalculatePoolStatistics(exactContext.allocator, exactContext.pools[i], &exactPool);
+        vmaCalculatePoolStatistics(incrementalContext.allocator, incrementalContext.pools[i], &incrementalPool);
+        CompareDetailed(exactPool, incrementalPool, true);
+    }
+}
+
+void Init(Context& context, VmaAllocatorCreateFlags flags)
+{
+    VmaAllocatorCreateInfo allocatorCreateInfo = {};
+    allocatorCreateInfo.flags = flags;
+    allocatorCreateInfo.preferredLargeHeapBlockSize = 16ull << 20;
+    context.allocator = VmaTest::CreateAllocator(allocatorCreateInfo);
+
+    VmaPoolCreateInfo poolCreateInfo = {};
+    poolCreateInfo.memoryTypeIndex = 1;
+    poolCreateInfo.blockSize = 4ull << 20;
+    TEST(vmaCreatePool(context.allocator, &poolCreateInfo, &context.pools[0]) == VK_SUCCESS);
+    poolCreateInfo.flags = VMA_POOL_CREATE_BUDDY_ALGORITHM_BIT;
+    TEST(vmaCreatePool(context.allocator, &poolCreateInfo, &context.pools[1]) == VK_SUCCESS);
+}
+
+void Destroy(Context& context)
+{
+    for (VmaAllocation allocation : context.allocations)
+        vmaFreeMemory(context.allocator, allocation);
+    vmaDestroyPool(context.allocator, context.pools[0]);
+    vmaDestroyPool(context.allocator, context.pools[1]);
+    vmaDestroyAllocator(context.allocator);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const uint32_t seed = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : 12345;
+    std::mt19937 random(seed);
+
+    Context contexts[2];
+    Init(contexts[0], 0);
+    Init(contexts[1], VMA_ALLOCATOR_CREATE_INCREMENTAL_STATISTICS_BIT);
+
+    const uint32_t stepCount = 20000;
+    const uint32_t checkInterval = 250;
+    for (uint32_t step = 0; step < stepCount; ++step)
+    {
+        const bool allocate = contexts[0].allocations.size() < 64 ||
+            (contexts[0].allocations.size() < 2000 && random() % 100 < 55);
+        if (allocate)
+        {
+            VkMemoryRequirements memReq = {};
+            // Mostly small sizes with a long tail, some large enough for dedicated memory.
+            const uint32_t sizeKind = random() % 100;
+            if (sizeKind < 70)
+                memReq.size = 16 + random() % (64 * 1024);
+            else if (sizeKind < 98)
+                memReq.size = 64 * 1024 + random() % (2 * 1024 * 1024);
+            else
+                memReq.size = 8 * 1024 * 1024 + random() % (16 * 1024 * 1024);
+            memReq.alignment = (VkDeviceSize)1 << (random() % 10);
+            memReq.memoryTypeBits = 0x7;
+
+            // Targets 0 and 1 are default pools of those memory types, 2 and 3 the custom pools.
+            VmaAllocationCreateInfo allocCreateInfo = {};
+            const uint32_t target = random() % 4;
+            if (target < 2)
+                allocCreateInfo.memoryTypeBits = 1u << target;
+
+            VmaAllocation allocations[2] = {};
+            VkResult results[2];
+            for (uint32_t i = 0; i < 2; ++i)
+            {
+                if (target >= 2)
+                    allocCreateInfo.pool = contexts[i].pools[target - 2];
+                results[i] = vmaAllocateMemory(contexts[i].allocator, &memReq, &allocCreateInfo, &allocations[i], nullptr);
+            }
+            TEST(results[0] == results[1]);
+            if (results[0] == VK_SUCCESS)
+            {
+                for (uint32_t i = 0; i < 2; ++i)
+                    contexts[i].allocations.push_back(allocations[i]);
+            }
+        }
+        else
+        {
+            const size_t index = random() % contexts[0].allocations.size();
+            for (uint32_t i = 0; i < 2; ++i)
+            {
+                vmaFreeMemory(contexts[i].allocator, contexts[i].allocations[index]);
+                contexts[i].allocations[index] = contexts[i].allocations.back();
+                contexts[i].allocations.pop_back();
+            }
+        }
+
+        if (step % checkInterval == 0)
+            Compare(contexts[0], contexts[1]);
+    }
+    Compare(contexts[0], contexts[1]);
+
+    Destroy(contexts[1]);
+    Destroy(contexts[0]);
+    printf("Incremental statistics match the exact walk after %u steps, seed %u.\n", stepCount, seed);
+    return 0;
+}
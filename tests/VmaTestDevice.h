@@ -0,0 +1,545 @@
+//
+// Stub Vulkan device for tests and benchmarks of vk_mem_alloc.h.
+//
+// VkDeviceMemory objects only account for heap usage and get host memory when mapped.
+// Buffers and images remember the size from their create info, which their memory
+// requirements report back. Sparse resources have pages of 64 KiB and vkQueueBindSparse
+// records the binds it receives. vkQueueSubmit only queues copies and semaphore signals,
+// which ExecuteQueue() performs later, like the GPU would. All functions are thread-safe.
+//
+// Include once per executable, after vk_mem_alloc.h with VMA_IMPLEMENTATION,
+// VMA_STATIC_VULKAN_FUNCTIONS 0 and VMA_DYNAMIC_VULKAN_FUNCTIONS 0.
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+namespace VmaTest
+{
+
+// Heap 0 is device-local, heap 1 is host memory.
+// Memory type 0 is DEVICE_LOCAL, 1 is HOST_VISIBLE | HOST_COHERENT, 2 is HOST_VISIBLE | HOST_CACHED.
+struct DeviceConfig
+{
+    VkDeviceSize heapSizes[2] = { 8ull << 30, 4ull << 30 };
+    VkDeviceSize bufferImageGranularity = 1024;
+    VkDeviceSize nonCoherentAtomSize = 64;
+    uint32_t maxMemoryAllocationCount = 4096;
+    // Tile size of images with VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT, 64 KiB of 4-byte texels.
+    VkExtent3D sparseImageGranularity = { 128, 128, 1 };
+    VkResult queueBindSparseResult = VK_SUCCESS;
+};
+
+const VkDeviceSize SPARSE_PAGE_SIZE = 65536;
+
+struct StubMemory
+{
+    VkDeviceSize size;
+    uint32_t heapIndex;
+    void* pMappedData;
+};
+
+struct StubResource
+{
+    VkDeviceSize size;
+    uint32_t memoryTypeBits;
+    bool sparse;
+    // Only for images.
+    VkExtent3D extent;
+    uint32_t mipLevels;
+    // Only for buffers, set by vkBindBufferMemory.
+    StubMemory* memory;
+    VkDeviceSize memoryOffset;
+};
+
+struct StubCopy
+{
+    StubResource* srcBuffer;
+    StubResource* dstBuffer;
+    VkBufferCopy region;
+};
+
+struct StubCommandBuffer
+{
+    std::vector<StubCopy> copies;
+};
+
+struct StubCommandPool
+{
+    std::vector<StubCommandBuffer*> commandBuffers;
+};
+
+// Binary semaphores are treated as timeline semaphores that are never waited on.
+struct StubSemaphore
+{
+    uint64_t value;
+};
+
+struct StubSignal
+{
+    StubSemaphore* semaphore;
+    uint64_t value;
+};
+
+struct Device
+{
+    DeviceConfig config;
+    std::mutex mutex;
+    VkDeviceSize heapUsage[2] = {};
+    uint32_t memoryCount = 0;
+    std::atomic<uint64_t> allocateMemoryCount{ 0 };
+    std::atomic<uint64_t> freeMemoryCount{ 0 };
+    // Calls of vkGetPhysicalDeviceMemoryProperties2, which is how the allocator fetches memory budget.
+    std::atomic<uint64_t> getMemoryProperties2Count{ 0 };
+    // Contents of all successful vkQueueBindSparse calls, protected by mutex.
+    uint32_t queueBindSparseCount = 0;
+    std::vector<VkSparseMemoryBind> sparseMemoryBinds;
+    std::vector<VkSparseImageMemoryBind> sparseImageBinds;
+    // Work of vkQueueSubmit waiting for ExecuteQueue(), protected by mutex.
+    uint32_t queueSubmitCount = 0;
+    std::vector<StubCopy> queuedCopies;
+    std::vector<StubSignal> queuedSignals;
+};
+
+inline Device& GetDevice()
+{
+    static Device device;
+    return device;
+}
+
+inline VKAPI_ATTR void VKAPI_CALL StubGetPhysicalDeviceProperties(VkPhysicalDevice, VkPhysicalDeviceProperties* pProperties)
+{
+    const DeviceConfig& config = GetDevice().config;
+    memset(pProperties, 0, sizeof(*pProperties));
+    pProperties->apiVersion = VK_API_VERSION_1_0;
+    pProperties->limits.bufferImageGranularity = config.bufferImageGranularity;
+    pProperties->limits.nonCoherentAtomSize = config.nonCoherentAtomSize;
+    pProperties->limits.maxMemoryAllocationCount = config.maxMemoryAllocationCount;
+    strcpy(pProperties->deviceName, "VMA test stub");
+}
+
+inline VKAPI_ATTR void VKAPI_CALL StubGetPhysicalDeviceMemoryProperties(VkPhysicalDevice, VkPhysicalDeviceMemoryProperties* pMemoryProperties)
+{
+    const DeviceConfig& config = GetDevice().config;
+    memset(pMemoryProperties, 0, sizeof(*pMemoryProperties));
+    pMemoryProperties->memoryHeapCount = 2;
+    pMemoryProperties->memoryHeaps[0].size = config.heapSizes[0];
+    pMemoryProperties->memoryHeaps[0].flags = VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+    pMemoryProperties->memoryHeaps[1].size = config.heapSizes[1];
+    pMemoryProperties->memoryTypeCount = 3;
+    pMemoryProperties->memoryTypes[0].propertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    pMemoryProperties->memoryTypes[0].heapIndex = 0;
+    pMemoryProperties->memoryTypes[1].propertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    pMemoryProperties->memoryTypes[1].heapIndex = 1;
+    pMemoryProperties->memoryTypes[2].propertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+    pMemoryProperties->memoryTypes[2].heapIndex = 1;
+}
+
+#if VMA_MEMORY_BUDGET || VMA_VULKAN_VERSION >= 1001000
+// Reports heap sizes as budgets when VkPhysicalDeviceMemoryBudgetPropertiesEXT is chained.
+inline VKAPI_ATTR void VKAPI_CALL StubGetPhysicalDeviceMemoryProperties2(VkPhysicalDevice physicalDevice,
+    VkPhysicalDeviceMemoryProperties2* pMemoryProperties)
+{
+    Device& device = GetDevice();
+    ++device.getMemoryProperties2Count;
+    StubGetPhysicalDeviceMemoryProperties(physicalDevice, &pMemoryProperties->memoryProperties);
+    for (VkBaseOutStructure* pNext = (VkBaseOutStructure*)pMemoryProperties->pNext; pNext != nullptr; pNext = pNext->pNext)
+    {
+        if (pNext->sType != VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT)
+            continue;
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT* const pBudget = (VkPhysicalDeviceMemoryBudgetPropertiesEXT*)pNext;
+        std::lock_guard<std::mutex> lock(device.mutex);
+        for (uint32_t i = 0; i < 2; ++i)
+        {
+            pBudget->heapBudget[i] = device.config.heapSizes[i];
+            pBudget->heapUsage[i] = device.heapUsage[i];
+        }
+    }
+}
+#endif
+
+inline VKAPI_ATTR VkResult VKAPI_CALL StubAllocateMemory(VkDevice, const VkMemoryAllocateInfo* pAllocateInfo,
+    const VkAllocationCallbacks*, VkDeviceMemory* pMemory)
+{
+    Device& device = GetDevice();
+    const uint32_t heapIndex = pAllocateInfo->memoryTypeIndex == 0 ? 0 : 1;
+    {
+        std::lock_guard<std::mutex> lock(device.mutex);
+        if (device.heapUsage[heapIndex] + pAllocateInfo->allocationSize > device.config.heapSizes[heapIndex] ||
+            device.memoryCount >= device.config.maxMemoryAllocationCount)
+        {
+            return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+        }
+        device.heapUsage[heapIndex] += pAllocateInfo->allocationSize;
+        ++device.memoryCount;
+    }
+    ++device.allocateMemoryCount;
+    *pMemory = (VkDeviceMemory)(uintptr_t)new StubMemory{ pAllocateInfo->allocationSize, heapIndex, nullptr };
+    return VK_SUCCESS;
+}
+
+inline VKAPI_ATTR void VKAPI_CALL StubFreeMemory(VkDevice, VkDeviceMemory memory, const VkAllocationCallbacks*)
+{
+    StubMemory* stubMemory = (StubMemory*)(uintptr_t)memory;
+    if (stubMemory == nullptr)
+        return;
+    Device& device = GetDevice();
+    {
+        std::lock_guard<std::mutex> lock(device.mutex);
+        device.heapUsage[stubMemory->heapIndex] -= stubMemory->size;
+        --device.memoryCount;
+    }
+    ++device.freeMemoryCount;
+    free(stubMemory->pMappedData);
+    delete stubMemory;
+}
+
+// Host memory backing the whole VkDeviceMemory, allocated on first use.
+inline char* GetMemoryData(StubMemory* stubMemory)
+{
+    if (stubMemory->pMappedData == nullptr)
+        stubMemory->pMappedData = calloc(1, (size_t)stubMemory->size);
+    return (char*)stubMemory->pMappedData;
+}
+
+inline VKAPI_ATTR VkResult VKAPI_CALL StubMapMemory(VkDevice, VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize,
+    VkMemoryMapFlags, void** ppData)
+{
+    // VMA maps a block at most once at a time, under the lock of the block.
+    char* const pData = GetMemoryData((StubMemory*)(uintptr_t)memory);
+    if (pData == nullptr)
+        return VK_ERROR_MEMORY_MAP_FAILED;
+    *ppData = pData + offset;
+    return VK_SUCCESS;
+}
+
+inline VKAPI_ATTR void VKAPI_CALL StubUnmapMemory(VkDevice, VkDeviceMemory) {}
+
+inline VKAPI_ATTR VkResult VKAPI_CALL StubFlushMappedMemoryRanges(VkDevice, uint32_t, const VkMappedMemoryRange*)
+{
+    return VK_SUCCESS;
+}
+
+inline VKAPI_ATTR VkResult VKAPI_CALL StubBindBufferMemory(VkDevice, VkBuffer buffer, VkDeviceMemory memory, VkDeviceSize memoryOffset)
+{
+    StubResource* resource = (StubResource*)(uintptr_t)buffer;
+    resource->memory = (StubMemory*)(uintptr_t)memory;
+    resource->memoryOffset = memoryOffset;
+    return VK_SUCCESS;
+}
+
+inline VKAPI_ATTR VkResult VKAPI_CALL StubBindImageMemory(VkDevice, VkImage, VkDeviceMemory, VkDeviceSize)
+{
+    return VK_SUCCESS;
+}
+
+inline VKAPI_ATTR void VKAPI_CALL StubGetBufferMemoryRequirements(VkDevice, VkBuffer buffer, VkMemoryRequirements* pMemoryRequirements)
+{
+    const StubResource* resource = (const StubResource*)(uintptr_t)buffer;
+    pMemoryRequirements->size = resource->size;
+    pMemoryRequirements->alignment = resource->sparse ? SPARSE_PAGE_SIZE : 256;
+    pMemoryRequirements->memoryTypeBits = resource->memoryTypeBits;
+}
+
+inline VKAPI_ATTR void VKAPI_CALL StubGetImageMemoryRequirements(VkDevice, VkImage image, VkMemoryRequirements* pMemoryRequirements)
+{
+    const StubResource* resource = (const StubResource*)(uintptr_t)image;
+    pMemoryRequirements->size = resource->size;
+    pMemoryRequirements->alignment = resource->sparse ? SPARSE_PAGE_SIZE : 4096;
+    pMemoryRequirements->memoryTypeBits = resource->memoryTypeBits;
+}
+
+inline VKAPI_ATTR VkResult VKAPI_CALL StubCreateBuffer(VkDevice, const VkBufferCreateInfo* pCreateInfo,
+    const VkAllocationCallbacks*, VkBuffer* pBuffer)
+{
+    const bool sparse = (pCreateInfo->flags & VK_BUFFER_CREATE_SPARSE_BINDING_BIT) != 0;
+    const VkDeviceSize alignment = sparse ? SPARSE_PAGE_SIZE : 256;
+    *pBuffer = (VkBuffer)(uintptr_t)new StubResource{ (pCreateInfo->size + alignment - 1) & ~(alignment - 1), 0x7, sparse };
+    return VK_SUCCESS;
+}
+
+inline VKAPI_ATTR void VKAPI_CALL StubDestroyBuffer(VkDevice, VkBuffer buffer, const VkAllocationCallbacks*)
+{
+    delete (StubResource*)(uintptr_t)buffer;
+}
+
+inline VKAPI_ATTR VkResult VKAPI_CALL StubCreateImage(VkDevice, const VkImageCreateInfo* pCreateInfo,
+    const VkAllocationCallbacks*, VkImage* pImage)
+{
+    const bool sparse = (pCreateInfo->flags & VK_IMAGE_CREATE_SPARSE_BINDING_BIT) != 0;
+    const VkDeviceSize alignment = sparse ? SPARSE_PAGE_SIZE : 4096;
+    VkDeviceSize size = (VkDeviceSize)pCreateInfo->extent.width * pCreateInfo->extent.height *
+        pCreateInfo->extent.depth * pCreateInfo->arrayLayers * 4;
+    // Room for the mip chain and the mip tail.
+    if (pCreateInfo->mipLevels > 1)
+        size *= 2;
+    if (sparse)
+        size += SPARSE_PAGE_SIZE;
+    *pImage = (VkImage)(uintptr_t)new StubResource{ (size + alignment - 1) & ~(alignment - 1), 0x1, sparse,
+        pCreateInfo->extent, pCreateInfo->mipLevels };
+    return VK_SUCCESS;
+}
+
+inline VKAPI_ATTR void VKAPI_CALL StubDestroyImage(VkDevice, VkImage image, const VkAllocationCallbacks*)
+{
+    delete (StubResource*)(uintptr_t)image;
+}
+
+inline VKAPI_ATTR VkResult VKAPI_CALL StubCreateCommandPool(VkDevice, const VkCommandPoolCreateInfo*,
+    const VkAllocationCallbacks*, VkCommandPool* pCommandPool)
+{
+    *pCommandPool = (VkCommandPool)(uintptr_t)new StubCommandPool();
+    return VK_SUCCESS;
+}
+
+inline VKAPI_ATTR void VKAPI_CALL StubDestroyCommandPool(VkDevice, VkCommandPool commandPool, const VkAllocationCallbacks*)
+{
+    StubCommandPool* pool = (StubCommandPool*)(uintptr_t)commandPool;
+    if (pool == nullptr)
+        return;
+    for (StubCommandBuffer* commandBuffer : pool->commandBuffers)
+        delete commandBuffer;
+    delete pool;
+}
+
+inline VKAPI_ATTR VkResult VKAPI_CALL StubAllocateCommandBuffers(VkDevice, const VkCommandBufferAllocateInfo* pAllocateInfo,
+    VkCommandBuffer* pCommandBuffers)
+{
+    StubCommandPool* pool = (StubCommandPool*)(uintptr_t)pAllocateInfo->commandPool;
+    for (uint32_t i = 0; i < pAllocateInfo->commandBufferCount; ++i)
+    {
+        pool->commandBuffers.push_back(new StubCommandBuffer());
+        pCommandBuffers[i] = (VkCommandBuffer)pool->commandBuffers.back();
+    }
+    return VK_SUCCESS;
+}
+
+inline VKAPI_ATTR VkResult VKAPI_CALL StubResetCommandPool(VkDevice, VkCommandPool commandPool, VkCommandPoolResetFlags)
+{
+    for (StubCommandBuffer* commandBuffer : ((StubCommandPool*)(uintptr_t)commandPool)->commandBuffers)
+        commandBuffer->copies.clear();
+    return VK_SUCCESS;
+}
+
+inline VKAPI_ATTR VkResult VKAPI_CALL StubBeginCommandBuffer(VkCommandBuffer commandBuffer, const VkCommandBufferBeginInfo*)
+{
+    ((StubCommandBuffer*)commandBuffer)->copies.clear();
+    return VK_SUCCESS;
+}
+
+inline VKAPI_ATTR VkResult VKAPI_CALL StubEndCommandBuffer(VkCommandBuffer)
+{
+    return VK_SUCCESS;
+}
+
+inline VKAPI_ATTR void VKAPI_CALL StubCmdCopyBuffer(VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkBuffer dstBuffer,
+    uint32_t regionCount, const VkBufferCopy* pRegions)
+{
+    for (uint32_t i = 0; i < regionCount; ++i)
+    {
+        ((StubCommandBuffer*)commandBuffer)->copies.push_back(
+            { (StubResource*)(uintptr_t)srcBuffer, (StubResource*)(uintptr_t)dstBuffer, pRegions[i] });
+    }
+}
+
+inline VKAPI_ATTR VkResult VKAPI_CALL StubQueueSubmit(VkQueue, uint32_t submitCount, const VkSubmitInfo* pSubmits, VkFence)
+{
+    Device& device = GetDevice();
+    std::lock_guard<std::mutex> lock(device.mutex);
+    ++device.queueSubmitCount;
+    for (uint32_t i = 0; i < submitCount; ++i)
+    {
+        const VkSubmitInfo& submit = pSubmits[i];
+        for (uint32_t j = 0; j < submit.commandBufferCount; ++j)
+        {
+            const StubCommandBuffer* commandBuffer = (const StubCommandBuffer*)submit.pCommandBuffers[j];
+            device.queuedCopies.insert(device.queuedCopies.end(), commandBuffer->copies.begin(), commandBuffer->copies.end());
+        }
+        const VkTimelineSemaphoreSubmitInfo* timelineInfo = (const VkTimelineSemaphoreSubmitInfo*)submit.pNext;
+        for (uint32_t j = 0; j < submit.signalSemaphoreCount; ++j)
+        {
+            const uint64_t value = timelineInfo != nullptr && j < timelineInfo->signalSemaphoreValueCount ?
+                timelineInfo->pSignalSemaphoreValues[j] : 1;
+            device.queuedSignals.push_back({ (StubSemaphore*)(uintptr_t)submit.pSignalSemaphores[j], value });
+        }
+    }
+    return VK_SUCCESS;
+}
+
+// Performs all work submitted so far: copies the data and signals the semaphores.
+inline void ExecuteQueue()
+{
+    Device& device = GetDevice();
+    std::lock_guard<std::mutex> lock(device.mutex);
+    for (const StubCopy& copy : device.queuedCopies)
+    {
+        char* const pSrc = GetMemoryData(copy.srcBuffer->memory) + copy.srcBuffer->memoryOffset + copy.region.srcOffset;
+        char* const pDst = GetMemoryData(copy.dstBuffer->memory) + copy.dstBuffer->memoryOffset + copy.region.dstOffset;
+        memmove(pDst, pSrc, (size_t)copy.region.size);
+    }
+    for (const StubSignal& signal : device.queuedSignals)
+        signal.semaphore->value = signal.value;
+    device.queuedCopies.clear();
+    device.queuedSignals.clear();
+}
+
+inline VKAPI_ATTR VkResult VKAPI_CALL StubCreateSemaphore(VkDevice, const VkSemaphoreCreateInfo* pCreateInfo,
+    const VkAllocationCallbacks*, VkSemaphore* pSemaphore)
+{
+    const VkSemaphoreTypeCreateInfo* typeInfo = (const VkSemaphoreTypeCreateInfo*)pCreateInfo->pNext;
+    *pSemaphore = (VkSemaphore)(uintptr_t)new StubSemaphore{ typeInfo != nullptr ? typeInfo->initialValue : 0 };
+    return VK_SUCCESS;
+}
+
+inline VKAPI_ATTR void VKAPI_CALL StubDestroySemaphore(VkDevice, VkSemaphore semaphore, const VkAllocationCallbacks*)
+{
+    delete (StubSemaphore*)(uintptr_t)semaphore;
+}
+
+inline VKAPI_ATTR VkResult VKAPI_CALL StubGetSemaphoreCounterValue(VkDevice, VkSemaphore semaphore, uint64_t* pValue)
+{
+    std::lock_guard<std::mutex> lock(GetDevice().mutex);
+    *pValue = ((const StubSemaphore*)(uintptr_t)semaphore)->value;
+    return VK_SUCCESS;
+}
+
+// The queue finishes all its work while the host waits.
+inline VKAPI_ATTR VkResult VKAPI_CALL StubWaitSemaphores(VkDevice, const VkSemaphoreWaitInfo*, uint64_t)
+{
+    ExecuteQueue();
+    return VK_SUCCESS;
+}
+
+inline VKAPI_ATTR VkResult VKAPI_CALL StubQueueBindSparse(VkQueue, uint32_t bindInfoCount, const VkBindSparseInfo* pBindInfo, VkFence)
+{
+    Device& device = GetDevice();
+    std::lock_guard<std::mutex> lock(device.mutex);
+    if (device.config.queueBindSparseResult != VK_SUCCESS)
+        return device.config.queueBindSparseResult;
+    ++device.queueBindSparseCount;
+    for (uint32_t i = 0; i < bindInfoCount; ++i)
+    {
+        for (uint32_t j = 0; j < pBindInfo[i].bufferBindCount; ++j)
+        {
+            const VkSparseBufferMemoryBindInfo& info = pBindInfo[i].pBufferBinds[j];
+            device.sparseMemoryBinds.insert(device.sparseMemoryBinds.end(), info.pBinds, info.pBinds + info.bindCount);
+        }
+        for (uint32_t j = 0; j < pBindInfo[i].imageOpaqueBindCount; ++j)
+        {
+            const VkSparseImageOpaqueMemoryBindInfo& info = pBindInfo[i].pImageOpaqueBinds[j];
+            device.sparseMemoryBinds.insert(device.sparseMemoryBinds.end(), info.pBinds, info.pBinds + info.bindCount);
+        }
+        for (uint32_t j = 0; j < pBindInfo[i].imageBindCount; ++j)
+        {
+            const VkSparseImageMemoryBindInfo& info = pBindInfo[i].pImageBinds[j];
+            device.sparseImageBinds.insert(device.sparseImageBinds.end(), info.pBinds, info.pBinds + info.bindCount);
+        }
+    }
+    return VK_SUCCESS;
+}
+
+// Color aspect only, with a single mip tail of one page at the end of the image.
+inline VKAPI_ATTR void VKAPI_CALL StubGetImageSparseMemoryRequirements(VkDevice, VkImage image,
+    uint32_t* pSparseMemoryRequirementCount, VkSparseImageMemoryRequirements* pSparseMemoryRequirements)
+{
+    if (pSparseMemoryRequirements == nullptr)
+    {
+        *pSparseMemoryRequirementCount = 1;
+        return;
+    }
+    const StubResource* resource = (const StubResource*)(uintptr_t)image;
+    const VkExtent3D granularity = GetDevice().config.sparseImageGranularity;
+    uint32_t mipTailFirstLod = 0;
+    while (mipTailFirstLod < resource->mipLevels &&
+        (resource->extent.width >> mipTailFirstLod) >= granularity.width &&
+        (resource->extent.height >> mipTailFirstLod) >= granularity.height)
+    {
+        ++mipTailFirstLod;
+    }
+    VkSparseImageMemoryRequirements& requirements = pSparseMemoryRequirements[0];
+    requirements = {};
+    requirements.formatProperties.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    requirements.formatProperties.imageGranularity = granularity;
+    requirements.imageMipTailFirstLod = mipTailFirstLod;
+    requirements.imageMipTailSize = SPARSE_PAGE_SIZE;
+    requirements.imageMipTailOffset = resource->size - SPARSE_PAGE_SIZE;
+    *pSparseMemoryRequirementCount = 1;
+}
+
+inline VmaVulkanFunctions GetVulkanFunctions()
+{
+    VmaVulkanFunctions functions = {};
+    functions.vkGetPhysicalDeviceProperties = StubGetPhysicalDeviceProperties;
+    functions.vkGetPhysicalDeviceMemoryProperties = StubGetPhysicalDeviceMemoryProperties;
+#if VMA_MEMORY_BUDGET || VMA_VULKAN_VERSION >= 1001000
+    functions.vkGetPhysicalDeviceMemoryProperties2KHR = StubGetPhysicalDeviceMemoryProperties2;
+#endif
+    functions.vkAllocateMemory = StubAllocateMemory;
+    functions.vkFreeMemory = StubFreeMemory;
+    functions.vkMapMemory = StubMapMemory;
+    functions.vkUnmapMemory = StubUnmapMemory;
+    functions.vkFlushMappedMemoryRanges = StubFlushMappedMemoryRanges;
+    functions.vkInvalidateMappedMemoryRanges = StubFlushMappedMemoryRanges;
+    functions.vkBindBufferMemory = StubBindBufferMemory;
+    functions.vkBindImageMemory = StubBindImageMemory;
+    functions.vkGetBufferMemoryRequirements = StubGetBufferMemoryRequirements;
+    functions.vkGetImageMemoryRequirements = StubGetImageMemoryRequirements;
+    functions.vkCreateBuffer = StubCreateBuffer;
+    functions.vkDestroyBuffer = StubDestroyBuffer;
+    functions.vkCreateImage = StubCreateImage;
+    functions.vkDestroyImage = StubDestroyImage;
+    functions.vkCmdCopyBuffer = StubCmdCopyBuffer;
+    functions.vkQueueBindSparse = StubQueueBindSparse;
+    functions.vkGetImageSparseMemoryRequirements = StubGetImageSparseMemoryRequirements;
+#if VMA_TIMELINE_SEMAPHORE
+    functions.vkCreateCommandPool = StubCreateCommandPool;
+    functions.vkDestroyCommandPool = StubDestroyCommandPool;
+    functions.vkAllocateCommandBuffers = StubAllocateCommandBuffers;
+    functions.vkResetCommandPool = StubResetCommandPool;
+    functions.vkBeginCommandBuffer = StubBeginCommandBuffer;
+    functions.vkEndCommandBuffer = StubEndCommandBuffer;
+    functions.vkQueueSubmit = StubQueueSubmit;
+    functions.vkCreateSemaphore = StubCreateSemaphore;
+    functions.vkDestroySemaphore = StubDestroySemaphore;
+    functions.vkGetSemaphoreCounterValue = StubGetSemaphoreCounterValue;
+    functions.vkWaitSemaphores = StubWaitSemaphores;
+#endif
+    return functions;
+}
+
+// Creates an allocator on the stub device. Fields of createInfo that identify the device are filled in.
+// pVulkanFunctions is taken from GetVulkanFunctions() if null.
+inline VmaAllocator CreateAllocator(VmaAllocatorCreateInfo createInfo)
+{
+    static const VmaVulkanFunctions functions = GetVulkanFunctions();
+    createInfo.physicalDevice = (VkPhysicalDevice)(uintptr_t)16;
+    createInfo.device = (VkDevice)(uintptr_t)32;
+    createInfo.instance = (VkInstance)(uintptr_t)48;
+    if (createInfo.pVulkanFunctions == nullptr)
+        createInfo.pVulkanFunctions = &functions;
+    VmaAllocator allocator = VK_NULL_HANDLE;
+    if (vmaCreateAllocator(&createInfo, &allocator) != VK_SUCCESS)
+    {
+        fprintf(stderr, "vmaCreateAllocator failed.\n");
+        exit(1);
+    }
+    return allocator;
+}
+
+} // namespace VmaTest
+
+// Checks a condition also in release builds, which tests and benchmarks are usually built as.
+#define TEST(cond) \
+    do { \
+        if (!(cond)) \
+        { \
+            fprintf(stderr, "%s:%d: Test failed: %s\n", __FILE__, __LINE__, #cond); \
+            abort(); \
+        } \
+    } while (false)
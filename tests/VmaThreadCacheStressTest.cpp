@@ -0,0 +1,137 @@
+//
+// Stress test of VMA_ALLOCATOR_CREATE_THREAD_CACHE_BIT, meant to be run also under ThreadSanitizer
+// (configure with -DVMA_TESTS_THREAD_SANITIZER=ON).
+//
+// Worker threads create and destroy small buffers in a default pool, most of them served from
+// their caches, while another thread keeps flushing all caches and calculating statistics.
+// Every buffer is filled with a tag of its owner through vmaMapMemory() and checked before
+// it is destroyed, so a suballocation handed out twice is detected. Some workers exit early,
+// leaving their caches to the flushes. At the end no allocation may remain.
+//
+// Usage: VmaThreadCacheStressTest [threadCount] [iterationCount]
+//
+
+#define VMA_IMPLEMENTATION
+#define VMA_STATIC_VULKAN_FUNCTIONS 0
+#define VMA_DYNAMIC_VULKAN_FUNCTIONS 0
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+#include <vk_mem_alloc.h>
+#include "VmaTestDevice.h"
+
+namespace
+{
+
+struct Buffer
+{
+    VkBuffer buffer;
+    VmaAllocation allocation;
+    uint32_t tag;
+};
+
+void Fill(VmaAllocator allocator, const Buffer& buffer)
+{
+    uint32_t* pData = nullptr;
+    TEST(vmaMapMemory(allocator, buffer.allocation, (void**)&pData) == VK_SUCCESS);
+    VmaAllocationInfo info;
+    vmaGetAllocationInfo(allocator, buffer.allocation, &info);
+    for (size_t i = 0; i < info.size / sizeof(uint32_t); ++i)
+        pData[i] = buffer.tag;
+    vmaUnmapMemory(allocator, buffer.allocation);
+}
+
+void CheckAndDestroy(VmaAllocator allocator, const Buffer& buffer)
+{
+    uint32_t* pData = nullptr;
+    TEST(vmaMapMemory(allocator, buffer.allocation, (void**)&pData) == VK_SUCCESS);
+    VmaAllocationInfo info;
+    vmaGetAllocationInfo(allocator, buffer.allocation, &info);
+    for (size_t i = 0; i < info.size / sizeof(uint32_t); ++i)
+        TEST(pData[i] == buffer.tag);
+    vmaUnmapMemory(allocator, buffer.allocation);
+    vmaDestroyBuffer(allocator, buffer.buffer, buffer.allocation);
+}
+
+void Work(VmaAllocator allocator, uint32_t threadIndex, uint32_t iterationCount)
+{
+    std::mt19937 random(threadIndex + 1);
+    std::vector<Buffer> buffers;
+    for (uint32_t i = 0; i < iterationCount; ++i)
+    {
+        if (buffers.size() < 8 || (buffers.size() < 256 && random() % 2 == 0))
+        {
+            VkBufferCreateInfo bufCreateInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+            // Mostly sizes served by the caches, some larger ones going to the blocks directly.
+            bufCreateInfo.size = random() % 16 != 0 ? 64 + random() % (16 * 1024) : 64 * 1024 + random() % (128 * 1024);
+            bufCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+            VmaAllocationCreateInfo allocCreateInfo = {};
+            allocCreateInfo.memoryTypeBits = 0x2;
+            Buffer buffer = {};
+            buffer.tag = (threadIndex << 24) | i;
+            TEST(vmaCreateBuffer(allocator, &bufCreateInfo, &allocCreateInfo, &buffer.buffer, &buffer.allocation, nullptr) == VK_SUCCESS);
+            Fill(allocator, buffer);
+            buffers.push_back(buffer);
+        }
+        else
+        {
+            const size_t index = random() % buffers.size();
+            CheckAndDestroy(allocator, buffers[index]);
+            buffers[index] = buffers.back();
+            buffers.pop_back();
+        }
+    }
+    for (const Buffer& buffer : buffers)
+        CheckAndDestroy(allocator, buffer);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const uint32_t threadCount = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : 8;
+    const uint32_t iterationCount = argc > 2 ? (uint32_t)strtoul(argv[2], nullptr, 10) : 20000;
+
+    VmaAllocatorCreateInfo allocatorCreateInfo = {};
+    allocatorCreateInfo.flags = VMA_ALLOCATOR_CREATE_THREAD_CACHE_BIT;
+    allocatorCreateInfo.preferredLargeHeapBlockSize = 4ull << 20;
+    VmaAllocator allocator = VmaTest::CreateAllocator(allocatorCreateInfo);
+
+    std::atomic<bool> done{ false };
+    std::thread flusher([&]()
+    {
+        while (!done)
+        {
+            vmaFlushThreadCaches(allocator);
+            VmaTotalStatistics stats;
+            vmaCalculateStatistics(allocator, &stats);
+            VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+            vmaGetHeapBudgets(allocator, budgets);
+            std::this_thread::yield();
+        }
+    });
+
+    // Odd workers run a quarter of the iterations, so their threads exit with filled caches.
+    std::vector<std::thread> workers;
+    for (uint32_t i = 0; i < threadCount; ++i)
+        workers.emplace_back(Work, allocator, i, i % 2 == 0 ? iterationCount : iterationCount / 4);
+    for (std::thread& worker : workers)
+        worker.join();
+    done = true;
+    flusher.join();
+
+    vmaFlushThreadCaches(allocator);
+    VmaTotalStatistics stats;
+    vmaCalculateStatistics(allocator, &stats);
+    TEST(stats.total.statistics.allocationCount == 0);
+    TEST(stats.total.statistics.allocationBytes == 0);
+    vmaDestroyAllocator(allocator);
+    TEST(VmaTest::GetDevice().heapUsage[0] == 0 && VmaTest::GetDevice().heapUsage[1] == 0);
+
+    printf("Thread cache stress test passed with %u threads, %u iterations.\n", threadCount, iterationCount);
+    return 0;
+}